@@ -12,6 +12,8 @@
 #include <string>
 #include <iostream>
 #include <thread>
+#include <vector>
+#include <algorithm>
 #include "jtil/math/math_types.h"
 #include "kinect_interface_primesense/depth_images_io.h"
 #include "kinect_interface_primesense/hand_detector/evaluate_decision_forest.h"
@@ -19,6 +21,8 @@
 #include "kinect_interface_primesense/hand_detector/decision_tree_structs.h"
 #include "kinect_interface_primesense/hand_detector/common_tree_funcs.h"
 #include "kinect_interface_primesense/hand_detector/forest_io.h"
+#include "kinect_interface_primesense/hand_detector/decision_forest_sweep.h"
+#include "kinect_interface/task_scheduler.h"
 #include "jtil/string_util/string_util.h"
 #include "jtil/image_util/image_util.h"
 #include "jtil/clk/clk.h"
@@ -33,6 +37,7 @@ using std::runtime_error;
 using std::cout;
 using std::endl;
 using namespace jtil::threading;
+using kinect_interface::TaskScheduler;
 using namespace kinect_interface_primesense;
 using namespace kinect_interface_primesense::hand_detector;
 
@@ -51,6 +56,8 @@ typedef enum {
   #define FOREST_DATA_FILENAME string("./forest_data.bin")
   #define PROGRAM_SETTINGS_FILENAME string("./hand_forests_settings.csv")
 #endif
+#define FOREST_SWEEP_FILENAME string("./forest_sweep.csv")
+#define SWEEP_MAX_COMBINATIONS 10000  // Tree combinations to try (at most)
 
 #define SAFE_DELETE(x) do { if (x != NULL) { delete x; x = NULL; } } while (0); 
 #define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0); 
@@ -128,6 +135,90 @@ void shutdown() {
   if (forest) {
     releaseForest(forest, prog_settings.num_trees);
   }
+  TaskScheduler::shutdown();
+}
+
+// addSweepConfigs - The evaluation sweep: the first 4 trees vs tree height
+// (num_height configs), the first n trees vs n (num_trees configs) and, if
+// there aren't too many, every combination of 4 trees (NUM_TREES CHOOSE 4)
+void addSweepConfigs(std::vector<ForestSweepConfig>& configs,
+  uint32_t& num_height, const DecisionTree* forest, const uint32_t num_trees,
+  const bool combinations) {
+  ForestSweepConfig config;
+  const uint32_t ntrees = std::min<uint32_t>(num_trees, 4);
+  for (uint32_t i = 0; i < ntrees; i++) {
+    config.trees.push_back(i);
+  }
+  num_height = 0;
+  for (uint32_t i = 5; i <= forest->tree_height; i++) {
+    config.max_height = i;
+    configs.push_back(config);
+    num_height++;
+  }
+  config.trees.clear();
+  config.max_height = forest->tree_height;
+  for (uint32_t i = 0; i < num_trees; i++) {
+    config.trees.push_back(i);
+    configs.push_back(config);
+  }
+  if (!combinations || num_trees <= ntrees) {
+    return;
+  }
+  uint64_t num_combinations = 1;
+  for (uint32_t i = 0; i < ntrees; i++) {
+    num_combinations = num_combinations * (num_trees - i) / (i + 1);
+  }
+  if (num_combinations > SWEEP_MAX_COMBINATIONS) {
+    cout << "Skipping the " << num_combinations << " tree combinations";
+    cout << endl;
+    return;
+  }
+  config.trees.resize(ntrees);
+  for (uint32_t i = 0; i < ntrees; i++) {
+    config.trees[i] = i;
+  }
+  while (true) {
+    configs.push_back(config);
+    // Next combination in lexicographic order
+    int32_t i = ntrees - 1;
+    while (i >= 0 && config.trees[i] == num_trees - ntrees + i) {
+      i--;
+    }
+    if (i < 0) {
+      break;
+    }
+    config.trees[i]++;
+    for (uint32_t j = i + 1; j < ntrees; j++) {
+      config.trees[j] = config.trees[j - 1] + 1;
+    }
+  }
+}
+
+void printSweepResults(const std::vector<ForestSweepConfig>& configs,
+  const uint32_t num_height, const uint32_t num_trees,
+  const char* data_set) {
+  for (uint32_t i = 0; i < num_height; i++) {
+    cout << configs[i].max_height << " height --> error on " << data_set;
+    cout << " set = " << (configs[i].error*100) << "%" << endl;
+  }
+  for (uint32_t i = num_height; i < num_height + num_trees; i++) {
+    cout << configs[i].trees.size() << " trees --> error on " << data_set;
+    cout << " set = " << (configs[i].error*100) << "%" << endl;
+  }
+  const ForestSweepConfig* best = NULL;
+  for (uint32_t i = num_height + num_trees; i < configs.size(); i++) {
+    if (best == NULL || configs[i].error < best->error) {
+      best = &configs[i];
+    }
+  }
+  if (best != NULL) {
+    cout << "best combination of " << best->trees.size() << " trees (";
+    for (uint32_t i = 0; i < best->trees.size(); i++) {
+      cout << (i > 0 ? ", " : "") << best->trees[i];
+    }
+    cout << ") --> error on " << data_set << " set = ";
+    cout << (best->error*100) << "%" << endl;
+  }
 }
 
 int main(int argc, char *argv[]) { 
@@ -266,7 +357,8 @@ int main(int argc, char *argv[]) {
       
       cout << endl << "Saving Forest to file..." << endl << endl;
       prog_settings.num_trees = total_num_trees;  // Just pretend we have this many trees
-      saveForest(forest, total_num_trees, FOREST_DATA_FILENAME);
+      saveForestContainer(forest, total_num_trees, FOREST_DATA_FILENAME);
+      verifyForestContainer(forest, total_num_trees, FOREST_DATA_FILENAME);
     } else {
       wl_set.wl_coeffs0 = NULL;
       wl_set.wl_coeffs1 = NULL;
@@ -279,36 +371,28 @@ int main(int argc, char *argv[]) {
       prog_settings.num_trees = (uint32_t)ntrees;
     }
     
-    // NOTE, THE COMBINATION CODE IS MISSING!  IT MUST HAVE BEEN LOST IN A
-    // COMMIT SOMEWHERE AND NEEDS TO BE RE-WRITTEN :-(
-    // NUM_TREES CHOOSE 4 COMBINATIONS AND SEARCH FOR LOWEST TEST SET ERROR
+    // Every configuration is scored from cached leaves (see
+    // decision_forest_sweep.h), which is much quicker than calling
+    // evaluateDecisionForestError for each one.  The whole table goes to
+    // FOREST_SWEEP_FILENAME.
     if (test_data->num_images > 0) {
-      // MEASURE VS TREE HEIGHT
-      const uint32_t ntrees = std::min<uint32_t>(prog_settings.num_trees, 4);
-      for (uint32_t i = 5; i <= forest->tree_height; i+= 1) {
-        float error = evaluateDecisionForestError(test_data, forest, ntrees, false, 
-          0, i);
-        cout << i << " height --> error on test set = " << (error*100) << "%" << endl;
-      }
-      for (uint32_t i = 5; i <= forest->tree_height; i+= 1) {
-        float error = evaluateDecisionForestError(training_data, forest, ntrees, false, 
-          0, i);
-        cout << i << " height --> error on training set = " << (error*100) << "%" << endl;
-      }
-
-      // MEASURE VS NUMBER OF TREES
-      cout << "Evaluating results on test set vs num_trees..." << endl;
-      for (uint32_t i = 0; i < prog_settings.num_trees; i++) {
-        float error = evaluateDecisionForestError(test_data, forest, i+1, false, 
-          0, forest->tree_height);
-        cout << i+1 << " trees --> error on test set = " << (error*100) << "%" << endl;
-      }
-      cout << "Evaluating results on training set vs num_trees..." << endl;
-      for (uint32_t i = 0; i < prog_settings.num_trees; i++) {
-        float error = evaluateDecisionForestError(training_data, forest, i+1, false, 
-          0, forest->tree_height);
-        cout << i+1 << " trees --> error on training set = " << (error*100) << "%" << endl;
+      DecisionForestSweep sweep(TaskScheduler::get());
+      DepthImageData* sweep_data[2] = {test_data, training_data};
+      const char* sweep_names[2] = {"test", "training"};
+      for (uint32_t s = 0; s < 2; s++) {
+        cout << "Evaluating results on " << sweep_names[s] << " set..." << endl;
+        sweep.init(sweep_data[s], forest, prog_settings.num_trees);
+        std::vector<ForestSweepConfig> configs;
+        uint32_t num_height;
+        addSweepConfigs(configs, num_height, forest, prog_settings.num_trees,
+          s == 0);
+        sweep.evaluate(&configs[0], (uint32_t)configs.size());
+        printSweepResults(configs, num_height, prog_settings.num_trees,
+          sweep_names[s]);
+        DecisionForestSweep::saveCSV(FOREST_SWEEP_FILENAME, sweep_names[s],
+          &configs[0], (uint32_t)configs.size(), s != 0);
       }
+      cout << "Sweep results saved to " << FOREST_SWEEP_FILENAME << endl;
     }
 
     // Save some data to create pictures for the paper:
@@ -21,15 +21,16 @@
 #include "jtil/math/math_types.h"
 #include "jtil/data_str/vector_managed.h"
 #include "kinect_interface_primesense/depth_images_io.h"
+#include "kinect_interface_primesense/red_hand_relabeler.h"
 #include "kinect_interface_primesense/hand_detector/forest_io.h"
 #include "kinect_interface_primesense/hand_detector/hand_detector.h"
 #include "kinect_interface_primesense/hand_detector/decision_tree_structs.h"  // MAX_DIST
+#include "kinect_interface/task_scheduler.h"
 #include "jtil/string_util/string_util.h"
 #include "jtil/image_util/image_util.h"
 #include "jtil/clk/clk.h"
 #include "jtil/threading/callback.h"
 #include "jtil/threading/thread.h"
-#include "jtil/threading/thread_pool.h"
 #include "jtil/video/video_stream.h"
 #include "jtorch/jtorch.h"
 #include "jtil/debug_util/debug_util.h"  // Must come last in main.cpp
@@ -49,11 +50,15 @@ using namespace jtil::image_util;
 using namespace kinect_interface_primesense;
 using namespace kinect_interface_primesense::hand_detector;
 using namespace jtil::threading;
+using kinect_interface::TaskScheduler;
 using renderer::Texture;
 
 #define LOAD_PROCESSED_IMAGES
 //#define SAFE_FLIPPED
 //#define DISABLE_ALL_SAVES
+// KHPD files also hold the DT_DOWNSAMPLE images, so training doesn't have to
+// downsample every frame at load time (loading reads both formats)
+#define PROCESSED_SAVE_FORMAT PROCESSED_DOWNSAMPLED_RLE
 
 #if defined(__APPLE__)
   #define KINECT_HANDS_ROOT string("./../../../../../../")
@@ -187,7 +192,7 @@ void saveData() {
 #ifndef DISABLE_ALL_SAVES
   string full_filename = IMAGE_DIRECTORY + string(im_files[cur_image].first);
   image_io->saveProcessedDepthLabel(full_filename, cur_depth_data, 
-    cur_label_data);
+    cur_label_data, PROCESSED_SAVE_FORMAT);
 #ifdef SAFE_FLIPPED
   string name_dir, name_file;
   DepthImagesIO::extractDirFile(full_filename, name_dir, name_file);
@@ -209,7 +214,7 @@ void saveData() {
     }
     string flipped_file = name_dir + name_file;
     image_io->saveProcessedDepthLabel(flipped_file, cur_depth_data_flipped,
-      cur_label_data_flipped);
+      cur_label_data_flipped, PROCESSED_SAVE_FORMAT);
   } else {
     std::cout << name_file << " is already a flipped file" << std::endl;
   }
@@ -574,6 +579,13 @@ void keyboard(unsigned char key, int x, int y) {
       break;
     }
     break;
+  case 'G':
+  case 'g':
+    DepthImagesIO::use_graph_cut = !DepthImagesIO::use_graph_cut;
+    cout << "use_graph_cut = " << (DepthImagesIO::use_graph_cut ? "true" : 
+      "false") << endl;
+    image_changed = true;
+    break;
   case 'S':
   case 's':
     saveData();
@@ -735,6 +747,7 @@ void reshape(const int width, const int height) {
 void shutdown() {
   jtorch::ShutdownJTorch();
   SAFE_DELETE(hd);
+  TaskScheduler::shutdown();
   SAFE_DELETE(image_io);
   SAFE_DELETE_ARR(texture_data);
   SAFE_DELETE(video_stream);
@@ -792,11 +805,66 @@ void shutdown() {
     return files_in_directory.size();
   };
 
+// relabelDirectory - The batch version of 'p': relabel every hands_*.bin
+// file in directory with the current red hand parameters and save the
+// processed_* files, on all of the scheduler's threads.
+int relabelDirectory(string directory, const bool use_graph_cut) {
+  if (directory.length() > 0 && directory[directory.length() - 1] != '/' &&
+    directory[directory.length() - 1] != '\\') {
+    directory += "/";
+  }
+  Vector<Triple<char*, int64_t, int64_t>> files_in_directory;
+  GetFilesInDirectory(files_in_directory, directory, NULL);
+  std::vector<string> files;
+  for (uint32_t i = 0; i < files_in_directory.size(); i++) {
+    files.push_back(directory + string(files_in_directory[i].first));
+    delete[] files_in_directory[i].first;
+  }
+  if (files.size() == 0) {
+    cout << "No image files in " << directory << endl;
+    return -1;
+  }
+
+  RedHandParams params = DepthImagesIO::redHandParams();
+  params.use_graph_cut = use_graph_cut;
+  RedHandRelabeler relabeler(TaskScheduler::get(), params, 
+    PROCESSED_SAVE_FORMAT);
+  cout << "Relabeling " << files.size() << " files in " << directory;
+  cout << " on " << relabeler.num_contexts() << " threads";
+  cout << (use_graph_cut ? " (with graph cut)" : "") << endl;
+  jtil::clk::Clk clk;
+  double t0 = clk.getTime();
+  uint32_t num_saved = relabeler.relabelFiles(files);
+  double t1 = clk.getTime();
+  cout << "Saved " << num_saved << " of " << files.size() << " files in ";
+  cout << (t1 - t0) << "s" << endl;
+  TaskScheduler::shutdown();
+  return num_saved == files.size() ? 0 : -1;
+}
+
 int main(int argc, char *argv[]) { 
-  static_cast<void>(argc);  // Get rid of unused variable warning
-  static_cast<void>(argv);
+  if (argc >= 2 && string(argv[1]) == "--relabel") {
+    try {
+      bool use_graph_cut = false;
+      string directory = IMAGE_DIRECTORY;
+      for (int i = 2; i < argc; i++) {
+        if (string(argv[i]) == "--graph_cut") {
+          use_graph_cut = true;
+        } else {
+          directory = argv[i];
+        }
+      }
+      return relabelDirectory(directory, use_graph_cut);
+    } catch(runtime_error e) {
+      printf("std::runtime_error caught!:\n");
+      printf("  %s\n", e.what());
+      return -1;
+    }
+  }
 
   cout << "USAGE:" << endl;
+  cout << "data_edit --relabel [directory] [--graph_cut] - Relabel and save ";
+  cout << "every image in directory (no GUI)" << endl << endl;
   cout << "q - Quit" << endl;
   cout << "d - Delete current image" << endl;
   cout << "r - Change render output" << endl;
@@ -809,6 +877,7 @@ int main(int argc, char *argv[]) {
   cout << "p - Play images and save labeling to file" << endl;
   cout << "[ - Go back to the start image" << endl;
   cout << "z - Change depth coloring (0 - rainbow, 1 - grey)" << endl;
+  cout << "g - Graph cut refinement of the red hand labels on/off" << endl;
   cout << "x - start / stop video stream (overwrites old file)" << endl;
   cout << "c - Manually add 10 frames to video file" << endl << endl;
   cout << "mouse-left - Flood fill inverse label large (when rendering depth)" << endl;
@@ -836,8 +905,8 @@ int main(int argc, char *argv[]) {
     // Initialize jtorch and use it's OpenCL context:
     const bool use_cpu = false;
     jtorch::InitJTorch("../jtorch", use_cpu);
-    ThreadPool* tp = new ThreadPool(4);
-    hd = new HandDetector(tp);
+    TaskScheduler::init(4);
+    hd = new HandDetector(TaskScheduler::get());
     hd->init(src_width, src_height, KINECT_HANDS_ROOT + FOREST_DATA_FILENAME);
 
     image_io = new DepthImagesIO();
@@ -0,0 +1,261 @@
+//
+//  main_forest_prune.cpp
+//
+//  ForestPrune: turns a trained forest (the HandForests output) into a
+//  smaller, faster one for serving.  The trees are picked by greedy forward
+//  selection on a validation set and then pruned (see
+//  prune_decision_forest.h).  Prints the trees, nodes, validation error and
+//  evaluation time before and after.
+//
+//  Usage:
+//    ForestPrune <forest_in> <forest_out> [--images dir] [--trees n]
+//      [--tolerance f] [--val_frac f] [--stride n] [--convert]
+//
+//  --trees is the most trees to keep (default 4), --tolerance the largest
+//  increase in validation error (fraction of pixels) the pruning may cost
+//  (default 0.001).  The validation set is every (1 / val_frac)th image of
+//  the processed hand database, as in HandForests.
+//
+//  forest_in can be either forest file format (see forest_io.h).  forest_out
+//  is always a container, and is checked by loading it back both mapped and
+//  copied; ForestPrune fails if either load differs from the pruned forest.
+//  Use --convert to skip the selection and pruning and just write forest_in
+//  out as a (checked) container.
+//
+
+#if defined(WIN32) || defined(_WIN32)
+  #include <Windows.h>
+#endif
+#include <stdexcept>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include "jtil/math/math_types.h"
+#include "kinect_interface_primesense/depth_images_io.h"
+#include "kinect_interface_primesense/depth_image_data.h"
+#include "kinect_interface_primesense/hand_detector/evaluate_decision_forest.h"
+#include "kinect_interface_primesense/hand_detector/prune_decision_forest.h"
+#include "kinect_interface_primesense/hand_detector/decision_tree_structs.h"
+#include "kinect_interface_primesense/hand_detector/forest_io.h"
+#include "jtil/string_util/string_util.h"
+#include "jtil/clk/clk.h"
+
+using std::string;
+using std::cout;
+using std::endl;
+using jtil::string_util::Str2Num;
+using namespace kinect_interface_primesense;
+using namespace kinect_interface_primesense::hand_detector;
+
+#define IMAGE_DIRECTORY string("./data/hand_depth_data_processed_for_DF/")
+
+#define SAFE_DELETE(x) do { if (x != NULL) { delete x; x = NULL; } } while (0);
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+
+struct PruneOptions {
+  string forest_in;
+  string forest_out;
+  string image_dir;
+  uint32_t max_trees;
+  float tolerance;
+  float frac_val_data;
+  uint32_t file_stride;
+  bool convert;
+};
+
+void printUsage() {
+  cout << "Usage: ForestPrune <forest_in> <forest_out> [--images dir]";
+  cout << " [--trees n] [--tolerance f] [--val_frac f] [--stride n]";
+  cout << " [--convert]" << endl;
+}
+
+bool parseArgs(int argc, char* argv[], PruneOptions& opts) {
+  if (argc < 3) {
+    return false;
+  }
+  opts.forest_in = argv[1];
+  opts.forest_out = argv[2];
+  opts.image_dir = IMAGE_DIRECTORY;
+  opts.max_trees = 4;
+  opts.tolerance = 0.001f;
+  opts.frac_val_data = 0.05f;
+  opts.file_stride = 1;
+  opts.convert = false;
+  for (int i = 3; i < argc; i++) {
+    const string arg = argv[i];
+    if (arg == "--convert") {
+      opts.convert = true;
+      continue;
+    }
+    if (i + 1 == argc) {
+      return false;  // Every other flag has a value
+    }
+    const string val = argv[++i];
+    if (arg == "--images") {
+      opts.image_dir = val;
+    } else if (arg == "--trees") {
+      opts.max_trees = std::max<uint32_t>(Str2Num<uint32_t>(val), 1);
+    } else if (arg == "--tolerance") {
+      opts.tolerance = Str2Num<float>(val);
+    } else if (arg == "--val_frac") {
+      opts.frac_val_data = Str2Num<float>(val);
+    } else if (arg == "--stride") {
+      opts.file_stride = std::max<uint32_t>(Str2Num<uint32_t>(val), 1);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// timeForest - ms to label one validation image
+double timeForest(const DepthImageData* data, const DecisionTree* forest,
+  const uint32_t num_trees, const uint32_t max_height, uint8_t* labels) {
+  const int32_t im_size = data->im_width * data->im_height;
+  jtil::clk::Clk clk;
+  const double t0 = clk.getTime();
+  for (int32_t i = 0; i < data->num_images; i++) {
+    evaluateDecisionForest(labels, forest, max_height, num_trees,
+      &data->image_data[i * im_size], data->im_width, data->im_height);
+  }
+  const double t1 = clk.getTime();
+  return 1e3 * (t1 - t0) / (double)data->num_images;
+}
+
+void printForest(const char* name, const DecisionTree* forest,
+  const uint32_t num_trees, const float error, const double time_ms) {
+  cout << name << ": " << num_trees << " trees, ";
+  cout << countDecisionForestNodes(forest, num_trees) << " nodes, ";
+  cout << "validation error = " << (error * 100) << "%, ";
+  cout << time_ms << " ms per image" << endl;
+}
+
+// convertForest - Writes forest_in out as a container (no pruning)
+int convertForest(const PruneOptions& opts) {
+  DecisionTree* forest = NULL;
+  int32_t num_trees = 0;
+  int ret = 0;
+  try {
+    cout << "Loading Forest from file..." << endl;
+    loadForest(forest, num_trees, opts.forest_in);
+    cout << "Saving Forest to " << opts.forest_out << "..." << endl;
+    saveForestContainer(forest, num_trees, opts.forest_out);
+    verifyForestContainer(forest, num_trees, opts.forest_out);
+    cout << num_trees << " trees, " << countDecisionForestNodes(forest,
+      num_trees) << " nodes: mapped and copied loads match" << endl;
+  } catch (const std::runtime_error &e) {
+    cout << "std::runtime_error caught!:" << endl;
+    cout << "  " << e.what() << endl;
+    ret = -1;
+  }
+  if (forest) {
+    releaseForest(forest, num_trees);
+  }
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  PruneOptions opts;
+  if (!parseArgs(argc, argv, opts)) {
+    printUsage();
+    return -1;
+  }
+  if (opts.convert) {
+    return convertForest(opts);
+  }
+
+  DepthImagesIO* images_io = NULL;
+  DepthImageData* training_data = NULL;
+  DepthImageData* val_data = NULL;
+  DecisionTree* forest = NULL;
+  DecisionTree* forest_out = NULL;
+  int32_t num_trees = 0;
+  uint32_t num_trees_out = 0;
+  uint32_t* selected = NULL;
+  uint8_t* labels = NULL;
+  int ret = 0;
+
+  try {
+    cout << "Loading Forest from file..." << endl;
+    loadForest(forest, num_trees, opts.forest_in);
+    uint32_t max_height = 0;
+    for (int32_t i = 0; i < num_trees; i++) {
+      max_height = std::max<uint32_t>(max_height, forest[i].tree_height);
+    }
+
+    images_io = new DepthImagesIO();
+    cout << "loading image data from file..." << endl;
+    images_io->LoadDepthImagesFromDirectoryForDT(opts.image_dir,
+      training_data, val_data, opts.frac_val_data, opts.file_stride);
+    DepthImagesIO::releaseImages(training_data);  // Only need validation
+    if (val_data->num_images == 0) {
+      throw std::runtime_error("ForestPrune - ERROR: empty validation set!");
+    }
+    labels = new uint8_t[val_data->im_width * val_data->im_height];
+
+    const float error_in = evaluateDecisionForestError(val_data, forest,
+      num_trees, false, 0, max_height);
+    const double time_in = timeForest(val_data, forest, num_trees,
+      max_height, labels);
+
+    cout << "Selecting trees..." << endl;
+    const uint32_t max_trees = std::min<uint32_t>(opts.max_trees, num_trees);
+    selected = new uint32_t[max_trees];
+    const float error_selected = selectDecisionForestTrees(selected,
+      num_trees_out, val_data, forest, num_trees, max_trees);
+    if (num_trees_out == 0) {
+      throw std::runtime_error("ForestPrune - ERROR: no tree beats labeling "
+        "every pixel as background!");
+    }
+    copyDecisionForest(forest_out, forest, selected, num_trees_out);
+    const double time_selected = timeForest(val_data, forest_out,
+      num_trees_out, max_height, labels);
+    const uint32_t nodes_selected = countDecisionForestNodes(forest_out,
+      num_trees_out);
+
+    cout << "Pruning trees..." << endl;
+    pruneDecisionForest(forest_out, num_trees_out, val_data, opts.tolerance);
+    const float error_out = evaluateDecisionForestError(val_data, forest_out,
+      num_trees_out, false, 0, max_height);
+    const double time_out = timeForest(val_data, forest_out, num_trees_out,
+      max_height, labels);
+
+    cout << endl << "Selected trees: ";
+    for (uint32_t i = 0; i < num_trees_out; i++) {
+      cout << selected[i] << (i + 1 < num_trees_out ? ", " : "");
+    }
+    cout << endl;
+    printForest("Input forest   ", forest, num_trees, error_in, time_in);
+    cout << "Selected forest: " << num_trees_out << " trees, ";
+    cout << nodes_selected << " nodes, validation error = ";
+    cout << (error_selected * 100) << "%, " << time_selected;
+    cout << " ms per image" << endl;
+    printForest("Pruned forest  ", forest_out, num_trees_out, error_out,
+      time_out);
+
+    cout << "Saving Forest to " << opts.forest_out << "..." << endl;
+    saveForestContainer(forest_out, num_trees_out, opts.forest_out);
+    verifyForestContainer(forest_out, num_trees_out, opts.forest_out);
+  } catch (const std::runtime_error &e) {
+    cout << "std::runtime_error caught!:" << endl;
+    cout << "  " << e.what() << endl;
+    ret = -1;
+  }
+
+  if (val_data) {
+    DepthImagesIO::releaseImages(val_data);
+  }
+  if (training_data) {
+    DepthImagesIO::releaseImages(training_data);
+  }
+  if (forest) {
+    releaseForest(forest, num_trees);
+  }
+  if (forest_out) {
+    releaseForest(forest_out, num_trees_out);
+  }
+  SAFE_DELETE_ARR(selected);
+  SAFE_DELETE_ARR(labels);
+  SAFE_DELETE(images_io);
+  return ret;
+}
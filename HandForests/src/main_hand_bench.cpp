@@ -0,0 +1,421 @@
+//
+//  main_hand_bench.cpp
+//
+//  hand_bench: runs the hand pipeline over a directory of recorded frames
+//  (hands<kinect>_*.bin, as saved by KinectHands) with no sensor, and reports
+//  the throughput and the time spent per stage:
+//
+//    load        - DepthImagesIO::LoadCompressedImage (disk + fastlz)
+//    xyz         - UVD --> XYZ
+//    hand_labels - HandDetector::findHandLabels (forest + filter + flood fill)
+//    hand_image  - HandImageGenerator::calcHandImage (via HandNet)
+//    convnet     - HandNet::evaluateConvnet
+//    heat_map_fit- HandNet::fitHeatMaps (LM gaussian fit per heat map)
+//    pose        - HandNet::calcConvnetPose (PSO model fit, --pso iterations)
+//
+//  The pose stage needs the hand model, which HandModel loads through the
+//  renderer's GeometryManager, so it creates the renderer (and its GL
+//  context).  Nothing is ever drawn.  "--pso 0" skips the stage and the
+//  renderer, for a box with no GL at all.
+//
+//  --check prints a checksum of the labels, the heat map coefficients and the
+//  fitted pose of every frame (and of the whole run), so that a performance
+//  change can be checked to be behavior preserving: run it before and after
+//  on the same machine and diff the output.  The coefficients are hashed bit
+//  for bit, so only compare runs on the same OpenCL device.
+//
+//  --seed n makes the whole run repeatable: it seeds rand() (like the forest
+//  trainer's srand(0)) and the generator that picks the --frames subset, and
+//  every pass restarts the pose tracking from the rest pose.  Every pass is
+//  checked against the first one, and --check fails (returns -1) if any pass
+//  differs.  Without --seed the first --frames frames are used.
+//
+//  The cmake build (HandForests/CMakeLists.txt) is CPU-only: it defines
+//  HAND_BENCH_CPU_ONLY, which makes --cpu the default and leaves out the
+//  pose stage and the renderer (it doesn't link GL), so --pso is always 0.
+//  Model fitting is only benchmarked by the visual studio build.
+//
+//  Usage:
+//    HandBench <data_dir> [--kinect n] [--frames n] [--seed n] [--passes n]
+//      [--threads n] [--pso n] [--cpu] [--check] [--forest file]
+//      [--convnet file]
+//
+//  Run it from the KinectHands working directory (HandNet::loadFromFile
+//  reads coeff_hand_rest_pose.bin from ./).
+//
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include "jtil/math/math_types.h"
+#include "jtil/data_str/vector.h"
+#include "jtil/data_str/triple.h"
+#include "jtil/string_util/string_util.h"
+#include "jtil/clk/clk.h"
+#include "jtil/exceptions/wruntime_error.h"
+#include "kinect_interface_primesense/depth_images_io.h"
+#include "kinect_interface_primesense/hand_detector/hand_detector.h"
+#include "kinect_interface_primesense/hand_net/hand_net.h"
+#include "kinect_interface_primesense/hand_net/hand_model_coeff.h"
+#include "kinect_interface/task_scheduler.h"
+#include "jtorch/jtorch.h"
+#if !defined(HAND_BENCH_CPU_ONLY)
+  #include "jtil/renderer/renderer.h"
+#endif
+
+using std::string;
+using std::cout;
+using std::endl;
+using namespace jtil::data_str;
+using kinect_interface::TaskScheduler;
+#if !defined(HAND_BENCH_CPU_ONLY)
+using jtil::renderer::Renderer;
+#endif
+using namespace kinect_interface_primesense;
+using namespace kinect_interface_primesense::hand_detector;
+using namespace kinect_interface_primesense::hand_net;
+
+#define SAFE_DELETE(x) do { if (x != NULL) { delete x; x = NULL; } } while (0);
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+#if defined(HAND_BENCH_CPU_ONLY)
+  #define HB_USE_CPU true
+  #define HB_PSO_ITERATIONS 0  // No renderer, so no pose stage
+#else
+  #define HB_USE_CPU false
+  #define HB_PSO_ITERATIONS 40  // The default --pso
+#endif
+
+typedef enum {
+  STAGE_LOAD = 0,
+  STAGE_XYZ = 1,
+  STAGE_HAND_LABELS = 2,
+  STAGE_HAND_IMAGE = 3,
+  STAGE_CONVNET = 4,
+  STAGE_HEAT_MAP_FIT = 5,
+  STAGE_POSE = 6,
+  NUM_STAGES = 7,
+} BenchStage;
+
+const char* stage_names[NUM_STAGES] = {"load", "xyz", "hand_labels",
+  "hand_image", "convnet", "heat_map_fit", "pose"};
+
+struct BenchOptions {
+  string data_dir;
+  uint32_t kinect_num;
+  uint32_t max_frames;  // 0 --> all of them
+  uint32_t seed;  // 0 --> the first max_frames frames
+  uint32_t num_passes;
+  uint32_t num_threads;  // 0 --> TaskScheduler::defaultNumWorkers()
+  uint32_t pso_iterations;  // 0 --> no pose stage (and no renderer)
+  bool use_cpu;
+  bool check;
+  string forest_file;
+  string convnet_file;
+};
+
+// FNV-1a
+uint64_t hashBytes(const void* data, const size_t size,
+  uint64_t hash = FNV_OFFSET) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+void printUsage() {
+  cout << "Usage: HandBench <data_dir> [--kinect n] [--frames n] [--seed n]";
+  cout << " [--passes n] [--threads n] [--pso n] [--cpu] [--check]";
+  cout << " [--forest file] [--convnet file]" << endl;
+}
+
+bool parseArgs(int argc, char* argv[], BenchOptions& opts) {
+  if (argc < 2) {
+    return false;
+  }
+  opts.data_dir = argv[1];
+  opts.kinect_num = 0;
+  opts.max_frames = 0;
+  opts.seed = 0;
+  opts.num_passes = 1;
+  opts.num_threads = 0;
+  opts.pso_iterations = HB_PSO_ITERATIONS;
+  opts.use_cpu = HB_USE_CPU;
+  opts.check = false;
+  opts.forest_file = FOREST_DATA_FILENAME;
+  opts.convnet_file = CONVNET_FILE;
+  for (int i = 2; i < argc; i++) {
+    const string arg = argv[i];
+    if (arg == "--cpu") {
+      opts.use_cpu = true;
+    } else if (arg == "--check") {
+      opts.check = true;
+    } else if (i + 1 >= argc) {
+      return false;
+    } else if (arg == "--forest") {
+      opts.forest_file = argv[++i];
+    } else if (arg == "--convnet") {
+      opts.convnet_file = argv[++i];
+    } else {
+      const uint32_t val = jtil::string_util::Str2Num<uint32_t>(argv[++i]);
+      if (arg == "--kinect") {
+        opts.kinect_num = val;
+      } else if (arg == "--frames") {
+        opts.max_frames = val;
+      } else if (arg == "--seed") {
+        opts.seed = val;
+      } else if (arg == "--passes") {
+        opts.num_passes = std::max<uint32_t>(val, 1);
+      } else if (arg == "--threads") {
+        opts.num_threads = val;
+      } else if (arg == "--pso") {
+#if defined(HAND_BENCH_CPU_ONLY)
+        if (val > 0) {
+          cout << "HandBench - ERROR: --pso needs the renderer, which the";
+          cout << " CPU-only build leaves out (use --pso 0)" << endl;
+          return false;
+        }
+#endif
+        opts.pso_iterations = val;
+      } else {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// selectFrames - The frames to run, in recording order
+void selectFrames(std::vector<string>& frames,
+  Vector<Triple<char*, int64_t, int64_t>>& files, const BenchOptions& opts,
+  std::mt19937& rng) {
+  std::vector<uint32_t> indices;
+  for (uint32_t i = 0; i < files.size(); i++) {
+    indices.push_back(i);
+  }
+  if (opts.max_frames > 0 && opts.max_frames < indices.size()) {
+    if (opts.seed != 0) {
+      std::shuffle(indices.begin(), indices.end(), rng);
+    }
+    indices.resize(opts.max_frames);
+    std::sort(indices.begin(), indices.end());
+  }
+  for (uint32_t i = 0; i < indices.size(); i++) {
+    frames.push_back(opts.data_dir + string("/") +
+      string(files[indices[i]].first));
+  }
+}
+
+void printStage(const char* name, std::vector<double>& times_ms) {
+  cout << "  " << std::left << std::setw(14) << name << std::right;
+  if (times_ms.size() == 0) {
+    cout << "not run" << endl;
+    return;
+  }
+  std::sort(times_ms.begin(), times_ms.end());
+  double sum = 0;
+  for (size_t i = 0; i < times_ms.size(); i++) {
+    sum += times_ms[i];
+  }
+  const size_t n = times_ms.size();
+  cout << std::fixed << std::setprecision(3);
+  cout << "count " << std::setw(7) << n;
+  cout << "  mean " << std::setw(9) << sum / (double)n << "ms";
+  cout << "  p50 " << std::setw(9) << times_ms[(n - 1) / 2] << "ms";
+  cout << "  p99 " << std::setw(9) << times_ms[(n - 1) * 99 / 100] << "ms";
+  cout << "  max " << std::setw(9) << times_ms[n - 1] << "ms" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  BenchOptions opts;
+  if (!parseArgs(argc, argv, opts)) {
+    printUsage();
+    return -1;
+  }
+
+  DepthImagesIO* image_io = NULL;
+  HandDetector* hd = NULL;
+  HandNet* hn = NULL;
+  int16_t* depth = NULL;
+  uint8_t* labels = NULL;
+  uint8_t* labels_file = NULL;
+  float* xyz = NULL;
+  Vector<Triple<char*, int64_t, int64_t>> files;
+  bool renderer_started = false;
+  int ret = 0;
+
+  // Everything random in the run follows the seed
+  std::mt19937 rng(opts.seed);
+  srand(opts.seed);
+
+  try {
+    jtorch::InitJTorch("../jtorch", opts.use_cpu);
+    if (opts.num_threads > 0) {
+      TaskScheduler::init(opts.num_threads);
+    }
+    hd = new HandDetector(TaskScheduler::get());
+    hd->init(src_width, src_height, opts.forest_file);
+    hn = new HandNet();
+    hn->loadFromFile(opts.convnet_file);
+#if !defined(HAND_BENCH_CPU_ONLY)
+    if (opts.pso_iterations > 0) {
+      // Only for HandModel's geometry (nothing is rendered)
+      Renderer::InitRenderer();
+      renderer_started = true;
+      hn->loadHandModels();
+      hn->setModelVisibility(false);
+    }
+#endif
+
+    image_io = new DepthImagesIO();
+    image_io->GetFilesInDirectory(files, opts.data_dir, opts.kinect_num);
+    std::vector<string> frames;
+    selectFrames(frames, files, opts, rng);
+    if (frames.size() == 0) {
+      throw std::wruntime_error("HandBench - ERROR: No frames in directory!");
+    }
+    cout << "HandBench - " << frames.size() << " frames, " << opts.num_passes;
+    cout << " passes, " << opts.pso_iterations << " PSO iterations" << endl;
+
+    depth = new int16_t[src_dim];
+    labels = new uint8_t[src_dim];
+    labels_file = new uint8_t[src_dim];
+    xyz = new float[src_dim * 3];
+    const uint32_t num_coeff = NUM_COEFFS_PER_GAUSSIAN *
+      hn->num_output_features();
+
+    jtil::clk::Clk clk;
+    std::vector<double> times_ms[NUM_STAGES];
+    std::vector<double> frame_ms;
+    std::vector<uint64_t> frame_hashes;  // Of the first pass
+    uint64_t labels_hash = FNV_OFFSET;
+    uint64_t coeff_hash = FNV_OFFSET;
+    uint64_t pose_hash = FNV_OFFSET;
+    uint32_t num_hands = 0;
+    uint32_t num_pass_diffs = 0;  // Frames that differ from the first pass
+    const double t_start = clk.getTime();
+    for (uint32_t pass = 0; pass < opts.num_passes; pass++) {
+      // Each pass tracks the same sequence from the same start
+      hn->resetTracking();
+      for (uint32_t i = 0; i < frames.size(); i++) {
+        double t[NUM_STAGES + 1];
+        t[0] = clk.getTime();
+        image_io->LoadCompressedImage(frames[i], depth, labels_file);
+        t[1] = clk.getTime();
+        DepthImagesIO::convertKinectSingleImageToXYZ(xyz, depth);
+        t[2] = clk.getTime();
+        memset(labels, 0, sizeof(labels[0]) * src_dim);
+        const bool found = hd->findHandLabels(depth, xyz,
+          HDLabelMethod::HDFloodfill, labels);
+        t[3] = clk.getTime();
+        uint32_t num_stages = STAGE_HAND_LABELS + 1;
+        if (found) {
+          hn->calcHandImage(depth, labels);
+          t[4] = clk.getTime();
+          hn->evaluateConvnet(false);
+          t[5] = clk.getTime();
+          hn->fitHeatMaps();
+          t[6] = clk.getTime();
+          num_stages = STAGE_HEAT_MAP_FIT + 1;
+          if (opts.pso_iterations > 0) {
+            hn->calcConvnetPose(depth, labels, 0, opts.pso_iterations);
+            t[7] = clk.getTime();
+            num_stages = NUM_STAGES;
+          }
+          num_hands++;
+        }
+        for (uint32_t s = 0; s < num_stages; s++) {
+          times_ms[s].push_back(1e3 * (t[s + 1] - t[s]));
+        }
+        frame_ms.push_back(1e3 * (t[num_stages] - t[0]));
+
+        if (opts.check) {
+          uint64_t lh = hashBytes(&found, sizeof(found));
+          lh = hashBytes(labels, sizeof(labels[0]) * src_dim, lh);
+          uint64_t ch = FNV_OFFSET;
+          uint64_t ph = FNV_OFFSET;
+          if (found) {
+            ch = hashBytes(hn->gauss_coeff(), sizeof(float) * num_coeff);
+          }
+          if (opts.pso_iterations > 0) {
+            // The pose carries over from frame to frame, so hash it always
+            ph = hashBytes(hn->rhand_cur_pose()->coeff(),
+              sizeof(float) * HAND_NUM_COEFF);
+          }
+          uint64_t fh = hashBytes(&ch, sizeof(ch), lh);
+          fh = hashBytes(&ph, sizeof(ph), fh);
+          if (pass == 0) {
+            frame_hashes.push_back(fh);
+            labels_hash = hashBytes(&lh, sizeof(lh), labels_hash);
+            coeff_hash = hashBytes(&ch, sizeof(ch), coeff_hash);
+            pose_hash = hashBytes(&ph, sizeof(ph), pose_hash);
+            cout << std::hex << std::setfill('0');
+            cout << "frame " << std::dec << i << " labels " << std::hex;
+            cout << std::setw(16) << lh << " coeff " << std::setw(16) << ch;
+            cout << " pose " << std::setw(16) << ph;
+            cout << std::dec << std::setfill(' ') << endl;
+          } else if (frame_hashes[i] != fh) {
+            cout << "frame " << i << " of pass " << pass << " differs from";
+            cout << " pass 0" << endl;
+            num_pass_diffs++;
+          }
+        }
+      }
+    }
+    const double t_total = clk.getTime() - t_start;
+
+    const uint32_t num_frames = (uint32_t)frames.size() * opts.num_passes;
+    cout << std::fixed << std::setprecision(2);
+    cout << "HandBench - " << num_frames << " frames (" << num_hands;
+    cout << " with a hand) in " << t_total << "s: ";
+    cout << (double)num_frames / t_total << " fps" << endl;
+    for (uint32_t s = 0; s < NUM_STAGES; s++) {
+      printStage(stage_names[s], times_ms[s]);
+    }
+    printStage("frame", frame_ms);
+    if (opts.check) {
+      cout << std::hex << std::setfill('0');
+      cout << "checksum labels " << std::setw(16) << labels_hash;
+      cout << " coeff " << std::setw(16) << coeff_hash;
+      cout << " pose " << std::setw(16) << pose_hash << endl;
+      cout << std::dec << std::setfill(' ');
+      if (num_pass_diffs > 0) {
+        cout << "HandBench - ERROR: " << num_pass_diffs << " frames differ";
+        cout << " between passes (the run is not repeatable)" << endl;
+        ret = -1;
+      }
+    }
+  } catch (const std::runtime_error &e) {
+    cout << "std::runtime_error caught!:" << endl;
+    cout << "  " << e.what() << endl;
+    ret = -1;
+  }
+
+  for (uint32_t i = 0; i < files.size(); i++) {
+    SAFE_DELETE_ARR(files[i].first);
+  }
+  SAFE_DELETE_ARR(depth);
+  SAFE_DELETE_ARR(labels);
+  SAFE_DELETE_ARR(labels_file);
+  SAFE_DELETE_ARR(xyz);
+  SAFE_DELETE(image_io);
+  SAFE_DELETE(hn);
+  SAFE_DELETE(hd);
+#if !defined(HAND_BENCH_CPU_ONLY)
+  if (renderer_started) {
+    Renderer::ShutdownRenderer();
+  }
+#endif
+  TaskScheduler::shutdown();
+  jtorch::ShutdownJTorch();
+  return ret;
+}
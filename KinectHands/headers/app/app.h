@@ -12,16 +12,22 @@
 #include <random>
 #include "jtil/jtil.h"
 #include "kinect_interface/kinect_interface.h"
+#include "app/app_settings.h"
 
 #define MAX_NUM_KINECTS 4
-#define NUM_APP_WORKER_THREADS 4
+#define NUM_APP_WORKER_THREADS 4  // Workers of the process-wide TaskScheduler
+#define KINECT_EXTRINSICS_FILENAME "./data/kinect_extrinsics.txt"
+#define HAND_NET_FILENAME "./data/handmodel.net.convnet"
 
 #if defined(_WIN32)
 class DebugBuf;
 #endif
 
 namespace kinect_interface { namespace hand_detector { class HandDetector; } }
-namespace jtil { namespace threading { class ThreadPool; } }
+namespace kinect_interface { namespace hand_detector { class MultiHandDetector; } }
+namespace kinect_interface { namespace hand_detector { class HandFusion; } }
+namespace kinect_interface { namespace hand_net { class HandNet; } }
+namespace kinect_interface { class TaskScheduler; }
 namespace jtil { namespace renderer { class GeometryInstance; } }
 namespace jzmq { class Connection; }
 
@@ -82,6 +88,11 @@ namespace app {
 #endif
     bool app_running_;
 
+    // Settings read by the main loop (settings_ is this frame's snapshot)
+    AppSettingsCache* settings_cache_;
+    AppSettings settings_;
+    int clear_color_background_;  // background_color clear_color is from
+
     bool is_time_server_;
     jzmq::Connection* time_server_conn_;  // Either a publisher or subscriber
 
@@ -131,6 +142,22 @@ namespace app {
     // Randomized Decision Forest Hand Detector
     kinect_interface::hand_detector::HandDetector* hd_;
     uint8_t hand_labels_[kinect_interface::depth_dim];
+    // One detector context per kinect, running on its own thread (created
+    // the first time detect_hands_all_kinects is turned on)
+    kinect_interface::hand_detector::MultiHandDetector* mhd_;
+    uint64_t mhd_num_updates_;  // mhd_->num_updates() at the last fuse
+    kinect_interface::hand_detector::HandFusion* hf_;  // Fuses mhd_'s hands
+
+    // HandNet runs on the best view of the most confident fused hand (or on
+    // the current kinect when only it is searched).  The view can change
+    // from frame to frame, so it has its own detector and copy of the data.
+    kinect_interface::hand_net::HandNet* hand_net_;  // Loaded on first use
+    kinect_interface::hand_detector::HandDetector* pose_hd_;
+    uint32_t pose_kinect_;  // The kinect hand_net_ last saw
+    uint64_t pose_frame_number_;
+    uint16_t pose_depth_[kinect_interface::depth_dim];
+    float pose_xyz_[kinect_interface::depth_dim * 3];
+    uint8_t pose_labels_[kinect_interface::depth_dim];
 
     void run();
     void init();
@@ -141,17 +168,14 @@ namespace app {
     void addStuff();
     void registerNewRenderer();
     void initRainbowPallet();
+    void detectPose(const uint32_t kinect, const bool roi_tracking);
 
     // Multithreading
-    // Thread pool to get the KinectData from the kinects in parallel:
-    jtil::threading::ThreadPool* tp_;
-    int32_t threads_finished_;
-    std::mutex thread_update_lock_;
-    std::condition_variable not_finished_;
+    // The process-wide scheduler (also used by the hand detectors) to get
+    // the KinectData from the kinects in parallel:
+    kinect_interface::TaskScheduler* ts_;  // Not owned here
     jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* data_save_cbs_; 
     void saveKinectData(const uint32_t index);
-    void executeThreadCallbacks(jtil::threading::ThreadPool* tp, 
-      jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* cbs);
 
     // Non-copyable, non-assignable.
     App(App&);
@@ -0,0 +1,130 @@
+//
+//  app_settings.h
+//
+//  Every GET_SETTING is a string keyed map lookup under the settings lock,
+//  and App::run() used to do a dozen or so of them every frame.  Instead the
+//  settings the main loop reads are listed once below (APP_SETTINGS_LIST),
+//  which generates a plain struct with one field per setting and a typed
+//  handle per setting.  AppSettingsCache rebuilds the struct (one pass over
+//  the list) only when something may have changed a setting, and the main
+//  loop reads the fields of its per-frame copy.
+//
+//  jtil's settings manager doesn't tell anyone when a setting changes, so
+//  the app keeps its own settings version (settingsVersion()).  Every
+//  setting the app writes goes through setSetting() (or the typed
+//  AppSettingsCache::set()), which bumps the version, and every cache
+//  rebuilds when the version it was built from is out of date.  Do not call
+//  SET_SETTING directly from the app.  The UI writes settings without going
+//  through setSetting(), so:
+//    - App bumps the version (settingsChanged()) from its keyboard and mouse
+//      callbacks
+//    - the snapshot is rebuilt at least every APP_SETTINGS_MAX_AGE_FRAMES
+//      frames to catch anything else
+//
+//  To add a setting to the snapshot, add it to APP_SETTINGS_LIST (with the
+//  same name and type as in settings.csv).
+//
+
+#ifndef APP_APP_SETTINGS_HEADER
+#define APP_APP_SETTINGS_HEADER
+
+#include "jtil/math/math_types.h"
+#include "jtil/settings/settings_manager.h"
+
+#define APP_SETTINGS_MAX_AGE_FRAMES 30
+// #define APP_SETTINGS_BENCHMARK  // Time GET_SETTING vs the snapshot on init
+
+// X(name, type)
+#define APP_SETTINGS_LIST(X) \
+  X(cur_kinect, int) \
+  X(kinect_output, int) \
+  X(pause_stream, bool) \
+  X(render_point_cloud, bool) \
+  X(background_color, int) \
+  X(render_joints, bool) \
+  X(detect_hands, bool) \
+  X(detect_pose, bool) \
+  X(detect_hands_all_kinects, bool) \
+  X(rdf_roi_tracking, bool) \
+  X(render_hand_labels, int) \
+  X(stretch_image, bool) \
+  X(render_kinect_fps, bool) \
+  X(continuous_snapshot, bool) \
+  X(compress_data, bool) \
+  X(camera_speed, float) \
+  X(camera_speed_fast, float) \
+  X(camera_speed_rotation, float)
+
+namespace app {
+
+  struct AppSettings {
+#define APP_SETTINGS_FIELD(name, type) type name;
+    APP_SETTINGS_LIST(APP_SETTINGS_FIELD)
+#undef APP_SETTINGS_FIELD
+    uint64_t version;  // Incremented every time the snapshot is rebuilt
+  };
+
+  // A typed handle: the settings manager key and the snapshot field
+  template <typename T>
+  struct AppSetting {
+    const char* name;
+    T AppSettings::*field;
+  };
+
+  namespace app_setting {
+#define APP_SETTINGS_HANDLE(name, type) \
+    static const AppSetting<type> name = {#name, &AppSettings::name};
+    APP_SETTINGS_LIST(APP_SETTINGS_HANDLE)
+#undef APP_SETTINGS_HANDLE
+  };  // namespace app_setting
+
+  // settingsVersion - Incremented by every settingsChanged() (thread safe)
+  uint64_t settingsVersion();
+  void settingsChanged();
+
+  // setSetting - SET_SETTING and bump the settings version
+  template <typename T>
+  void setSetting(const char* name, const T& value) {
+    SET_SETTING(name, T, value);
+    settingsChanged();
+  }
+
+  class AppSettingsCache {
+  public:
+    AppSettingsCache();
+    ~AppSettingsCache();
+
+    // snapshot - Call once per frame from the main thread.  Only does the
+    // settings lookups if the snapshot may be stale.
+    const AppSettings& snapshot();
+
+    // set - setSetting() with a typed handle
+    template <typename T>
+    void set(const AppSetting<T>& setting, const T& value) {
+      setSetting<T>(setting.name, value);
+    }
+
+    inline uint64_t num_rebuilds() const { return snapshot_.version; }
+
+#ifdef APP_SETTINGS_BENCHMARK
+    // benchmark - Print the cost per frame of reading the settings with
+    // GET_SETTING and with snapshot() (on the settings manager the app is
+    // running with)
+    static void benchmark(const uint32_t num_frames);
+#endif
+
+  private:
+    AppSettings snapshot_;
+    uint64_t settings_version_;  // settingsVersion() the snapshot is from
+    uint32_t age_;  // Frames since the last rebuild
+
+    void rebuild();
+
+    // Non-copyable, non-assignable.
+    AppSettingsCache(AppSettingsCache&);
+    AppSettingsCache& operator=(const AppSettingsCache&);
+  };
+
+};  // namespace app
+
+#endif  // APP_APP_SETTINGS_HEADER
@@ -9,11 +9,15 @@
 #include "jtil/ui/ui.h"
 #include "kinect_interface/kinect_interface.h"
 #include "kinect_interface/hand_detector/hand_detector.h"
+#include "kinect_interface/hand_detector/multi_hand_detector.h"
+#include "kinect_interface/hand_detector/hand_fusion.h"
 #include "kinect_interface/hand_detector/decision_tree_structs.h"
+#include "kinect_interface/hand_net/hand_net.h"
+#include "kinect_interface/task_scheduler.h"
+#include "kinect_interface/trace.h"
 #include "jtil/glew/glew.h"
 #include "jtil/image_util/image_util.h"
 #include "jtil/fastlz/fastlz.h"
-#include "jtil/threading/thread_pool.h"
 #include "jtil/threading/thread.h"
 #include "jtorch/jtorch.h"
 #include "jtil/video/video_stream.h"
@@ -42,6 +46,7 @@ using namespace jtil::math;
 using namespace jtil::settings;
 using namespace kinect_interface;
 using namespace kinect_interface::hand_detector;
+using namespace kinect_interface::hand_net;
 using namespace jtil::renderer;
 using namespace jtil::image_util;
 using namespace jtil::threading;
@@ -58,19 +63,27 @@ namespace app {
   App::App() {
     app_running_ = false;
     clk_ = NULL;
+    settings_cache_ = new AppSettingsCache();
+    clear_color_background_ = -1;
     for (uint32_t i = 0; i < MAX_NUM_KINECTS; i++) {
       kinects_[i] = NULL;
     }
     depth_tex_ = NULL;
     rgb_tex_ = NULL;
-    tp_ = NULL;
-    threads_finished_ = false;
+    ts_ = NULL;
     data_save_cbs_ = NULL;
     depth_frame_number_ = 0;
     num_kinects_ = 0;
     time_server_conn_ = NULL;
     depth_undistort_lookup_table = NULL;
     hd_ = NULL;
+    mhd_ = NULL;
+    mhd_num_updates_ = 0;
+    hf_ = NULL;
+    hand_net_ = NULL;
+    pose_hd_ = NULL;
+    pose_kinect_ = 0;
+    pose_frame_number_ = 0;
     for (uint32_t i = 0; i < MAX_NUM_KINECTS; i++) {
       kinect_last_saved_depth_time_[i] = 0;
     }
@@ -78,27 +91,36 @@ namespace app {
 
   App::~App() {
     SAFE_DELETE(hd_);
+    SAFE_DELETE(mhd_);
+    SAFE_DELETE(hf_);
+    SAFE_DELETE(hand_net_);
+    SAFE_DELETE(pose_hd_);
     for (uint32_t i = 0; i < MAX_NUM_KINECTS; i++) {
       if (kinects_[i]) {
         kinects_[i]->shutdownKinect(); 
       }
       SAFE_DELETE(kinects_[i]);
     }
+#ifdef KINECT_INTERFACE_TRACE
+    // The capture threads have stopped, so the trace is complete
+    Tracer::exportChromeTrace("trace.json");
+    Tracer::exportHistograms("trace_histograms.txt");
+#endif
     SAFE_DELETE(clk_);
     SAFE_DELETE(depth_tex_);
     SAFE_DELETE(rgb_tex_);
     SAFE_DELETE(data_save_cbs_);
     SAFE_DELETE_ARR(depth_undistort_lookup_table);
-    if (tp_) {
-      tp_->stop();
-    }
-    SAFE_DELETE(tp_);
+    // Everything that submits work to the scheduler is gone by now
+    ts_ = NULL;
+    TaskScheduler::shutdown();
     if (time_server_conn_) {
       time_server_conn_->killConn();
       SAFE_DELETE(time_server_conn_);
     }
     Renderer::ShutdownRenderer();
     jtorch::ShutdownJTorch();
+    SAFE_DELETE(settings_cache_);  // After the renderer (and its callbacks)
   }
 
   void App::newApp() {
@@ -143,14 +165,18 @@ namespace app {
     for (uint32_t i = 0; i < num_kinects_ && i < MAX_NUM_KINECTS; i++) {
       kinects_[i] = new KinectInterface(ids[i]);
     }
+#ifdef APP_SETTINGS_BENCHMARK
+    AppSettingsCache::benchmark(10000);
+#endif
     int cur_kinect;
     GET_SETTING("cur_kinect", int, cur_kinect);
     if (cur_kinect >= (int)num_kinects_) {
       cur_kinect = num_kinects_ - 1;
-      SET_SETTING("cur_kinect", int, cur_kinect);
+      settings_cache_->set(app_setting::cur_kinect, cur_kinect);
     }
 
-    tp_ = new ThreadPool(NUM_APP_WORKER_THREADS);
+    TaskScheduler::init(NUM_APP_WORKER_THREADS);
+    ts_ = TaskScheduler::get();
     data_save_cbs_ = new VectorManaged<Callback<void>*>(num_kinects_);
     for (uint32_t i = 0; i < num_kinects_; i++) {
       data_save_cbs_->pushBack(MakeCallableMany(&App::saveKinectData, this, i));
@@ -159,8 +185,15 @@ namespace app {
     initRainbowPallet();
     depth_undistort_lookup_table = KinectInterface::loadDepthUndistortLookupTable();
 
-    hd_ = new HandDetector(tp_);
+    hd_ = new HandDetector(ts_);
     hd_->init(depth_w, depth_h);
+    hf_ = new HandFusion();
+    hf_->init(num_kinects_);
+    if (!hf_->loadExtrinsics(KINECT_EXTRINSICS_FILENAME)) {
+      std::cout << "App::init() - WARNING: Couldn't open ";
+      std::cout << KINECT_EXTRINSICS_FILENAME << " (using identity kinect ";
+      std::cout << "extrinsics)" << std::endl;
+    }
 
     bool is_time_server;
     int time_server_port;
@@ -214,9 +247,9 @@ namespace app {
     // Set the camera to the camera parameters
     float view_plane_near = -1;
     float view_plane_far = -5000;
-    SET_SETTING("view_plane_near", float, view_plane_near);
-    SET_SETTING("view_plane_far", float, view_plane_far);
-    SET_SETTING("fov_deg", float, depth_vfov);
+    setSetting<float>("view_plane_near", view_plane_near);
+    setSetting<float>("view_plane_far", view_plane_far);
+    setSetting<float>("fov_deg", depth_vfov);
 
     g_app_->addStuff();
   }
@@ -254,6 +287,7 @@ namespace app {
 
   void App::run() {
     while (app_running_) {
+      TRACE_SCOPE(TRACE_APP_FRAME);
       frame_time_prev_ = frame_time_;
       frame_time_ = clk_->getTime();
       double dt = frame_time_ - frame_time_prev_;
@@ -285,24 +319,55 @@ namespace app {
         } while (bytes_received > 0);
       }
 
-      int kinect_output = 0, cur_kinect = 0, label_type_enum = 0;
-      int background_color = 0, render_hand_labels = 0;
-      bool pause_stream, render_point_cloud, render_joints, detect_hands;
-      bool detect_pose;
-      GET_SETTING("cur_kinect", int, cur_kinect);
-      GET_SETTING("kinect_output", int, kinect_output);
-      GET_SETTING("pause_stream", bool, pause_stream);
-      GET_SETTING("render_point_cloud", bool, render_point_cloud);
-      GET_SETTING("background_color", int, background_color);
-      GET_SETTING("render_joints", bool, render_joints);
-      GET_SETTING("detect_hands", bool, detect_hands);
-      GET_SETTING("detect_pose", bool, detect_pose);
-      GET_SETTING("render_hand_labels", int, render_hand_labels);
+      // One snapshot per frame (no settings lookups unless one changed)
+      settings_ = settings_cache_->snapshot();
+      int cur_kinect = settings_.cur_kinect;
+      const int kinect_output = settings_.kinect_output;
+      const bool pause_stream = settings_.pause_stream;
+      const bool render_point_cloud = settings_.render_point_cloud;
+      const int background_color = settings_.background_color;
+      const bool render_joints = settings_.render_joints;
+      const bool detect_hands = settings_.detect_hands;
+      const bool detect_pose = settings_.detect_pose;
+      const bool detect_hands_all_kinects = settings_.detect_hands_all_kinects;
+      const bool rdf_roi_tracking = settings_.rdf_roi_tracking;
+      const int render_hand_labels = settings_.render_hand_labels;
 
       if (cur_kinect >= (int)num_kinects_) {
         cur_kinect = num_kinects_ - 1;
       }
 
+      // Find the hands in every kinect's newest frame.  mhd_ does this on
+      // its own thread and publishes the results per kinect, so this loop
+      // never waits on the forest.
+      if (detect_hands_all_kinects && !pause_stream) {
+        if (mhd_ == NULL) {
+          mhd_ = new MultiHandDetector(ts_);
+          mhd_->init(num_kinects_, depth_w, depth_h);
+        }
+        mhd_->start(kinects_, num_kinects_);
+      } else if (mhd_ != NULL) {
+        mhd_->stop();
+      }
+      if (mhd_ != NULL && mhd_->num_updates() != mhd_num_updates_) {
+        mhd_num_updates_ = mhd_->num_updates();
+        // Fuse the newest results into world space hand positions
+        SensorHands hands[MAX_NUM_KINECTS];
+        for (uint32_t i = 0; i < num_kinects_; i++) {
+          mhd_->sensorHands(i, hands[i]);
+        }
+        hf_->fuse(hands);
+      }
+
+      // Feed HandNet the view the fusion picked (when every kinect is
+      // searched), otherwise the current kinect
+      if (detect_pose && !pause_stream) {
+        uint32_t pose_kinect = (uint32_t)cur_kinect;
+        if (!detect_hands_all_kinects || hf_->bestView(pose_kinect)) {
+          detectPose(pose_kinect, rdf_roi_tracking);
+        }
+      }
+
       bool new_data = false;
       if (kinects_[cur_kinect]->depth_frame_number() > depth_frame_number_) {
         new_data = true;
@@ -322,27 +387,31 @@ namespace app {
       default:
         throw std::wruntime_error("App::run() - background_color enum invalid");
       }
-      SET_SETTING("clear_color", Float3, rgb_background);
+      if (clear_color_background_ != background_color) {
+        setSetting<Float3>("clear_color", rgb_background);
+        clear_color_background_ = background_color;
+      }
 
       // Create the image data (in RGB)
       if (new_data && !pause_stream) {
         // Get the lock and do as little work within it as possible!
         kinects_[cur_kinect]->lockData();
         {
+          TRACE_SCOPE(TRACE_APP_COPY);
           memcpy(depth_, kinects_[cur_kinect]->depth(), sizeof(depth_[0]) * 
             depth_dim);
           memcpy(rgb_, kinects_[cur_kinect]->rgb(), sizeof(rgb_[0]) * 
             rgb_dim * 3);
-          for (uint32_t i = 0; i < depth_dim; i++) {
-            xyz_[i*3] = kinects_[cur_kinect]->xyz()[i].x;
-            xyz_[i*3+1] = kinects_[cur_kinect]->xyz()[i].y;
-            xyz_[i*3+2] = kinects_[cur_kinect]->xyz()[i].z;
-          }
+          // XYZPoint is 3 packed floats (checked in KinectInterface::init())
+          memcpy(xyz_, kinects_[cur_kinect]->xyz(), sizeof(xyz_[0]) * 
+            depth_dim * 3);
           memcpy(depth_colored_, kinects_[cur_kinect]->depth_colored(), 
             sizeof(depth_colored_[0]) * depth_dim * 3);
           // Update the frame number and timestamp
           depth_frame_number_ = kinects_[cur_kinect]->depth_frame_number();
           depth_frame_time_ = kinects_[cur_kinect]->depth_frame_time();
+          // Everything this thread traces from here on is for this frame
+          TRACE_SET_FRAME(depth_frame_number_);
         }
         kinects_[cur_kinect]->unlockData();
 
@@ -477,8 +546,12 @@ namespace app {
         // Update the hand points
         bool hand_found = false;
         if (detect_hands) {
-          hand_found = hd_->findHandLabels((int16_t*)depth_, xyz_, 
-            HDLabelMethod::HDFloodfill, hand_labels_);
+          {
+            TRACE_SCOPE(TRACE_DETECT);
+            hd_->roi_tracking() = rdf_roi_tracking;
+            hand_found = hd_->findHandLabels((int16_t*)depth_, xyz_, 
+              HDLabelMethod::HDFloodfill, hand_labels_);
+          }
 
           if (hand_found && render_hand_labels != 0) {
             switch (render_hand_labels) {
@@ -537,6 +610,23 @@ namespace app {
         std::stringstream ss;
         for (uint32_t i = 0; i < num_kinects_; i++) {
           ss << "K" << i << ": " << kinects_[i]->kinect_fps_str() << "fps, ";
+          if (detect_hands_all_kinects && mhd_ != NULL) {
+            SensorHands hands;
+            mhd_->sensorHands(i, hands);
+            ss << "hands (frame " << hands.frame_number << "): ";
+            ss << (hands.lhand_found ? "L" : "-");
+            ss << (hands.rhand_found ? "R" : "-") << ", ";
+          }
+        }
+        if (detect_hands_all_kinects) {
+          for (uint32_t i = 0; i < hf_->fused_hands().size(); i++) {
+            const FusedHand& hand = hf_->fused_hands()[i];
+            ss << "H" << hand.track_id << ": " << hand.num_views;
+            ss << " views (best K" << hand.best_sensor << "), ";
+          }
+        }
+        if (detect_pose && hand_net_ != NULL) {
+          ss << "HandNet: K" << pose_kinect_ << ", ";
         }
         int64_t t_days = (int64_t)remote_time_since_start_ / (60 * 60 * 24);
         int64_t t_hrs = (int64_t)remote_time_since_start_ / (60 * 60) % 24;
@@ -554,9 +644,8 @@ namespace app {
 
         // Sync the data with the correct texture and set the correct
         // background texture
-        bool stretch_image;
-        GET_SETTING("stretch_image", bool, stretch_image);
-        Renderer::g_renderer()->setBackgroundTextureStrech(stretch_image);
+        Renderer::g_renderer()->setBackgroundTextureStrech(
+          settings_.stretch_image);
         switch (kinect_output) {
         case OUTPUT_RGB:
           jtil::image_util::FlipImageVertInPlace<uint8_t>(rgb_im_,
@@ -584,21 +673,20 @@ namespace app {
       }
       moveStuff(dt);
 
-      bool render_kinect_fps;
-      GET_SETTING("render_kinect_fps", bool, render_kinect_fps);
       Renderer::g_renderer()->ui()->setTextWindowVisibility("kinect_fps_wnd",
-        render_kinect_fps);
+        settings_.render_kinect_fps);
 
       geom_inst_pts_->render() = render_point_cloud;
       geom_inst_joints_->render() = render_joints;
 
-      Renderer::g_renderer()->renderFrame();
+      {
+        TRACE_SCOPE(TRACE_RENDER);
+        Renderer::g_renderer()->renderFrame();
+      }
 
       // Save the frame to file if we have been asked to:
-      bool continuous_snapshot;
-      GET_SETTING("continuous_snapshot", bool, continuous_snapshot);
-      if (continuous_snapshot) {
-        executeThreadCallbacks(tp_, data_save_cbs_);
+      if (settings_.continuous_snapshot) {
+        ts_->run(data_save_cbs_);
       }
 
       // Give OS the opportunity to deschedule
@@ -606,6 +694,48 @@ namespace app {
     }
   }
 
+  void App::detectPose(const uint32_t kinect, const bool roi_tracking) {
+    if (hand_net_ == NULL) {
+      jtorch::InitJTorch("../jtorch");
+      hand_net_ = new HandNet();
+      hand_net_->loadFromFile(HAND_NET_FILENAME);
+      pose_hd_ = new HandDetector(ts_);
+      pose_hd_->init(depth_w, depth_h);
+    }
+    if (kinect != pose_kinect_) {
+      // The tracked hand ROI belongs to the old view
+      pose_hd_->reset();
+      pose_kinect_ = kinect;
+      pose_frame_number_ = 0;
+    }
+    if (kinects_[kinect]->depth_frame_number() <= pose_frame_number_) {
+      return;
+    }
+
+    // Get the lock and do as little work within it as possible!
+    kinects_[kinect]->lockData();
+    {
+      TRACE_SCOPE(TRACE_APP_COPY);
+      memcpy(pose_depth_, kinects_[kinect]->depth(), sizeof(pose_depth_[0]) *
+        depth_dim);
+      memcpy(pose_xyz_, kinects_[kinect]->xyz(), sizeof(pose_xyz_[0]) *
+        depth_dim * 3);
+      pose_frame_number_ = kinects_[kinect]->depth_frame_number();
+    }
+    kinects_[kinect]->unlockData();
+
+    bool hand_found;
+    {
+      TRACE_SCOPE(TRACE_DETECT);
+      pose_hd_->roi_tracking() = roi_tracking;
+      hand_found = pose_hd_->findHandLabels((int16_t*)pose_depth_, pose_xyz_,
+        HDLabelMethod::HDFloodfill, pose_labels_);
+    }
+    if (hand_found) {
+      hand_net_->calcConvnetHeatMap((int16_t*)pose_depth_, pose_labels_);
+    }
+  }
+
   void App::moveCamera(double dt) {
     renderer::Camera* camera = Renderer::g_renderer()->camera();
     
@@ -619,8 +749,7 @@ namespace app {
         in_screen && left_mouse_button) {
       float dx = static_cast<float>(mouse_pos_[0] - mouse_pos_old_[0]);
       float dy = static_cast<float>(mouse_pos_[1] - mouse_pos_old_[1]);
-      float camera_speed_rotation;
-      GET_SETTING("camera_speed_rotation", float, camera_speed_rotation);
+      const float camera_speed_rotation = settings_.camera_speed_rotation;
       camera->rotateCamera(dx * camera_speed_rotation,
                            dy * camera_speed_rotation);
     }
@@ -654,31 +783,13 @@ namespace app {
     }
     if (!(cur_dir[0] == 0.0f && cur_dir[1] == 0.0f && cur_dir[2] == 0.0f)) {
       cur_dir.normalize();
-      float camera_speed = 1.0f;
-      if (LShift) {
-        GET_SETTING("camera_speed_fast", float, camera_speed);
-      } else {
-        GET_SETTING("camera_speed", float, camera_speed);        
-      }
+      const float camera_speed = LShift ? settings_.camera_speed_fast : 
+        settings_.camera_speed;
       Float3::scale(cur_dir, camera_speed * static_cast<float>(dt));
       camera->moveCamera(cur_dir);      
     }
   }
 
-  void App::executeThreadCallbacks(jtil::threading::ThreadPool* tp, 
-    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* cbs) {
-    threads_finished_ = 0;
-    for (uint32_t i = 0; i < cbs->size(); i++) {
-      tp_->addTask((*cbs)[i]);
-    }
-    // Wait for all threads to finish
-    std::unique_lock<std::mutex> ul(thread_update_lock_);  // Get lock
-    while (threads_finished_ != static_cast<int32_t>(cbs->size())) {
-      not_finished_.wait(ul);
-    }
-    ul.unlock();  // Release lock
-  }
-
   void App::moveStuff(const double dt) {
 
   }
@@ -745,6 +856,8 @@ namespace app {
 
     ui->addHeadingText("RDF:");
     ui->addCheckbox("detect_hands", "RDF On");
+    ui->addCheckbox("detect_hands_all_kinects", "RDF On (All Devices)");
+    ui->addCheckbox("rdf_roi_tracking", "RDF Hand Tracking ROI");
     ui->addSelectbox("render_hand_labels", "Render RDF Labels");
     ui->addSelectboxItem("render_hand_labels", 
       ui::UIEnumVal(RDF_LABELS_NONE, "None"));
@@ -872,6 +985,8 @@ namespace app {
   }
 
   void App::keyboardCB(int key, int scancode, int action, int mods) {
+    // The UI may have changed a setting
+    settingsChanged();
     switch (key) {
     case KEY_ESC:
       if (action == PRESSED) {
@@ -888,17 +1003,18 @@ namespace app {
   }
   
   void App::mouseButtonCB(int button, int action, int mods) {
- 
+    // The UI may have changed a setting
+    settingsChanged();
   }
   
   void App::mouseWheelCB(double xoffset, double yoffset) {
-
+    settingsChanged();
   }
 
   // Save's data for a single kinect.  This is run in parallel.
   void App::saveKinectData(const uint32_t i) {
-    bool compress_data;
-    GET_SETTING("compress_data", bool, compress_data);
+    // settings_ doesn't change while the save tasks run
+    const bool compress_data = settings_.compress_data;
 
     // Save the depth and colored depth together
     if (kinects_[i]->depth_frame_time() > kinect_last_saved_depth_time_[i]) {
@@ -954,12 +1070,6 @@ namespace app {
       file.close();
       kinect_last_saved_depth_time_[i] = time_stamp;
     }
-
-    // Signal that we're done
-    std::unique_lock<std::mutex> ul(thread_update_lock_);
-    threads_finished_++;
-    not_finished_.notify_all();  // Signify that all threads might have finished
-    ul.unlock();
   }
 
 }  // namespace app
@@ -0,0 +1,90 @@
+#include <cstring>
+#include <atomic>
+#include "app/app_settings.h"
+
+#ifdef APP_SETTINGS_BENCHMARK
+  #include <iostream>
+  #include "jtil/clk/clk.h"
+#endif
+
+namespace app {
+
+  // Starts at 1 so that a new cache (settings_version_ = 0) always rebuilds
+  static std::atomic<uint64_t> settings_version(1);
+
+  uint64_t settingsVersion() {
+    return settings_version;
+  }
+
+  void settingsChanged() {
+    settings_version++;
+  }
+
+  AppSettingsCache::AppSettingsCache() {
+    memset(&snapshot_, 0, sizeof(snapshot_));
+    settings_version_ = 0;
+    age_ = 0;
+  }
+
+  AppSettingsCache::~AppSettingsCache() {
+    // Nothing to do
+  }
+
+  const AppSettings& AppSettingsCache::snapshot() {
+    age_++;
+    // Read the version before rebuild() so that a change during the rebuild
+    // isn't lost
+    const uint64_t version = settings_version;
+    if (version != settings_version_ || age_ >= APP_SETTINGS_MAX_AGE_FRAMES) {
+      settings_version_ = version;
+      rebuild();
+    }
+    return snapshot_;
+  }
+
+  void AppSettingsCache::rebuild() {
+#define APP_SETTINGS_GET(name, type) \
+    GET_SETTING(#name, type, snapshot_.name);
+    APP_SETTINGS_LIST(APP_SETTINGS_GET)
+#undef APP_SETTINGS_GET
+    snapshot_.version++;
+    age_ = 0;
+  }
+
+#ifdef APP_SETTINGS_BENCHMARK
+  void AppSettingsCache::benchmark(const uint32_t num_frames) {
+    jtil::clk::Clk clk;
+    AppSettings tmp;
+    // Keep the compiler from throwing the reads away
+    volatile int sink = 0;
+
+    // The old main loop: one GET_SETTING per setting per frame
+    double t0 = clk.getTime();
+    for (uint32_t i = 0; i < num_frames; i++) {
+#define APP_SETTINGS_GET(name, type) \
+      GET_SETTING(#name, type, tmp.name);
+      APP_SETTINGS_LIST(APP_SETTINGS_GET)
+#undef APP_SETTINGS_GET
+      sink += tmp.cur_kinect + (int)tmp.detect_hands;
+    }
+    double t1 = clk.getTime();
+
+    // The new main loop: snapshot() + plain field reads.  Nothing changes
+    // the settings here, so the cache only rebuilds when the snapshot gets
+    // too old (and once for the first frame).
+    AppSettingsCache cache;
+    for (uint32_t i = 0; i < num_frames; i++) {
+      const AppSettings& s = cache.snapshot();
+      sink += s.cur_kinect + (int)s.detect_hands;
+    }
+    double t2 = clk.getTime();
+
+    std::cout << "AppSettingsCache::benchmark() - " << num_frames;
+    std::cout << " frames, GET_SETTING: " << 1e6 * (t1 - t0) / num_frames;
+    std::cout << " us/frame, snapshot: " << 1e6 * (t2 - t1) / num_frames;
+    std::cout << " us/frame (" << cache.num_rebuilds() << " rebuilds)";
+    std::cout << std::endl;
+  }
+#endif
+
+};  // namespace app
@@ -0,0 +1,86 @@
+//
+//  depth_ray_table.h
+//
+//  Per-pixel (x/z, y/z) ray table for converting depth frames to XYZ.  The
+//  rays are computed once (from the approximate FOV model, or from the SDK's
+//  depth to camera space table) and already include the mm to meters scale,
+//  so each pixel costs 3 multiplies and no divides:
+//
+//    x = ray_x[i] * depth[i],  y = ray_y[i] * depth[i],  z = depth[i] / 1000
+//
+//  The rays are stored SoA so that the inner loops vectorize.  Optionally the
+//  depth undistortion (KinectInterface::undistortDepthPointwise) can be fused
+//  into the same pass by setting the undistortion table.
+//
+//  Zero (missing) depth pixels map to (0, 0, 0) like the approximate model,
+//  unless setZeroDepthValue() is used: the SDK's MapDepthFrameToCameraSpace
+//  gives -inf for them, and code reading KinectInterface::xyz() relies on it.
+//
+
+#pragma once
+
+#include "jtil/math/math_types.h"
+
+struct XYZPoint;
+struct XYPoint;
+
+namespace kinect_interface {
+
+  class DepthRayTable {
+  public:
+    DepthRayTable();
+    ~DepthRayTable();
+
+    // initApprox - Same model as KinectInterface::convertDepthFrameToApproxXYZ
+    void initApprox(const uint32_t width, const uint32_t height,
+      const float hfov_deg, const float vfov_deg);
+    // initFromLookupTable - table is KinectInterface::getDepthLookupTable()
+    // (the SDK's per pixel x/z and y/z for z = 1 meter)
+    void initFromLookupTable(const uint32_t width, const uint32_t height,
+      const XYPoint* table);
+
+    // setUndistortTable - lookup_table is from
+    // KinectInterface::loadDepthUndistortLookupTable() (not owned here).  Pass
+    // NULL to turn the undistortion off again.
+    void setUndistortTable(const float* lookup_table);
+
+    // setZeroDepthValue - x, y and z of the zero depth pixels (default 0)
+    void setZeroDepthValue(const float val);
+
+    // convert - n_pts = width * height.  If depth_out is not NULL it receives
+    // the (undistorted) depth image that the XYZ values were computed from.
+    void convert(const uint16_t* depth, float* xyz,
+      uint16_t* depth_out = NULL) const;  // AoS
+    void convert(const uint16_t* depth, XYZPoint* xyz,
+      uint16_t* depth_out = NULL) const;  // AoS
+    void convert(const uint16_t* depth, float* x, float* y, float* z,
+      uint16_t* depth_out = NULL) const;  // SoA
+    // convertPartial - The first n_pts pixels (in raster order) only, with
+    // the same zero depth handling but no undistortion
+    void convertPartial(const uint32_t n_pts, const uint16_t* depth,
+      float* xyz) const;  // AoS
+
+    inline const uint32_t width() const { return width_; }
+    inline const uint32_t height() const { return height_; }
+    inline const float* ray_x() const { return ray_x_; }
+    inline const float* ray_y() const { return ray_y_; }
+
+  private:
+    uint32_t width_;
+    uint32_t height_;
+    float* ray_x_;
+    float* ray_y_;
+    int32_t* undistort_src_;  // Source pixel per pixel (-1 --> zero depth)
+    uint16_t* depth_tmp_;  // Undistorted depth when depth_out is NULL
+    float zero_depth_val_;
+
+    void allocate(const uint32_t width, const uint32_t height);
+    // undistort - Returns the depth image to read from
+    const uint16_t* undistort(const uint16_t* depth, uint16_t* depth_out) const;
+
+    // Non-copyable, non-assignable.
+    DepthRayTable(DepthRayTable&);
+    DepthRayTable& operator=(const DepthRayTable&);
+  };
+
+};  // namespace kinect_interface
@@ -67,12 +67,13 @@
   }
   */
 
-FORCEINLINE bool WL_FUNC(const int32_t index, const int32_t coeff0, 
-  const int32_t coeff1, const int16_t coeff2, const uint8_t coeff3, 
-  const int32_t width, const int32_t height, const int16_t* image_data) {
-  int32_t im_index = index % (width * height);
-  int32_t u = im_index % width;
-  int32_t v = im_index / width;
+// WL_FUNC_UV - WL_FUNC when the pixel's u, v (im_index % width,
+// im_index / width) are already known, ie. once per pixel rather than once
+// per node when evaluating a forest.
+FORCEINLINE bool WL_FUNC_UV(const int32_t index, const int32_t u,
+  const int32_t v, const int32_t coeff0, const int32_t coeff1, 
+  const int16_t coeff2, const int32_t width, const int32_t height, 
+  const int16_t* image_data) {
   int32_t cur_u_offset = coeff0 / image_data[index];
   int32_t cur_v_offset = coeff1 / image_data[index];
   int32_t u_offset = u + cur_u_offset;
@@ -84,3 +85,13 @@ FORCEINLINE bool WL_FUNC(const int32_t index, const int32_t coeff0,
     return (image_data[index_offset] - image_data[index]) >= coeff2;
   }
 }
+
+FORCEINLINE bool WL_FUNC(const int32_t index, const int32_t coeff0, 
+  const int32_t coeff1, const int16_t coeff2, const uint8_t coeff3, 
+  const int32_t width, const int32_t height, const int16_t* image_data) {
+  int32_t im_index = index % (width * height);
+  int32_t u = im_index % width;
+  int32_t v = im_index / width;
+  return WL_FUNC_UV(index, u, v, coeff0, coeff1, coeff2, width, height,
+    image_data);
+}
@@ -0,0 +1,100 @@
+//
+//  hand_blob_labeler.h
+//
+//  Two-pass, row-run based connected components labeling for the (filtered)
+//  hand label image.  This replaces the BFS flood fill in HandDetector.
+//
+//  Each row of the label image is reduced to runs of foreground pixels.  Runs
+//  are joined to the 8-connected runs in the row above with union-find, and
+//  the per-run statistics (pixel count, UV sums and hand depth sums) are
+//  accumulated while the runs are extracted, so no second image scan is
+//  required.  The image is split into horizontal bands which can be labeled
+//  on separate threads (labelBand), then joined along the band boundaries
+//  (mergeBands).
+//
+//  Union is always performed towards the smaller run index, and run indices
+//  increase in raster order.  Therefore blobs() are returned in the order in
+//  which their first pixel is encountered in a raster scan (the same order the
+//  old flood fill discovered them).
+//
+
+#pragma once
+
+#include "jtil/math/math_types.h"
+#include "jtil/data_str/vector.h"
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  struct HandBlob {
+    uint32_t n_pts;  // Number of foreground pixels in the blob
+    uint32_t n_hand_pts;  // Number of pixels also labeled hand before filtering
+    int32_t u_sum;
+    int32_t v_sum;
+    int32_t depth_sum;  // Summed over the n_hand_pts pixels only
+  };
+
+  class HandBlobLabeler {
+  public:
+    HandBlobLabeler();
+    ~HandBlobLabeler();
+
+    void init(const int32_t width, const int32_t height,
+      const int32_t num_bands);
+
+    // Set the images to label (none are owned here).  A pixel is foreground
+    // if labels[i] == 1, and contributes to the depth sum if
+    // labels_hand[i] == 1.
+    void setInputs(const uint8_t* labels, const uint8_t* labels_hand,
+      const int16_t* depth);
+
+    // labelBand - Pass 1 for one band.  Distinct bands may be labeled
+    // concurrently.
+    void labelBand(const int32_t band);
+
+    // mergeBands - Pass 2: join runs across band boundaries and reduce the
+    // per-run statistics into blobs().  Call once all bands are labeled.
+    void mergeBands();
+
+    // label - Convenience: labelBand for every band then mergeBands
+    void label(const uint8_t* labels, const uint8_t* labels_hand,
+      const int16_t* depth);
+
+    inline const int32_t num_bands() const { return num_bands_; }
+    inline jtil::data_str::Vector<HandBlob>& blobs() { return blobs_; }
+
+  private:
+    struct Run {
+      int32_t v;
+      int32_t u_start;
+      int32_t u_end;  // inclusive
+      HandBlob stats;
+    };
+
+    int32_t width_;
+    int32_t height_;
+    int32_t num_bands_;
+    int32_t max_runs_per_row_;
+    const uint8_t* labels_;  // Not owned here
+    const uint8_t* labels_hand_;  // Not owned here
+    const int16_t* depth_;  // Not owned here
+
+    Run* runs_;  // Band b owns [band_start_row_[b] * max_runs_per_row_, ...)
+    uint32_t* parent_;
+    uint32_t* run_blob_;
+    uint32_t* row_run_start_;  // per row
+    uint32_t* row_run_end_;  // per row (exclusive)
+    int32_t* band_start_row_;  // num_bands_ + 1 entries
+    jtil::data_str::Vector<HandBlob> blobs_;
+
+    uint32_t findRoot(uint32_t run);
+    void unionRuns(const uint32_t a, const uint32_t b);
+    void unionRows(const int32_t v_above, const int32_t v);
+
+    // Non-copyable, non-assignable.
+    HandBlobLabeler(HandBlobLabeler&);
+    HandBlobLabeler& operator=(const HandBlobLabeler&);
+  };
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
@@ -7,8 +7,6 @@
 #pragma once
 
 #include <string>
-#include <mutex>
-#include <condition_variable>
 #include "jtil/math/math_types.h"
 #include "jtil/data_str/vector.h"
 #include "jtil/threading/callback.h"
@@ -21,10 +19,14 @@
 #define HD_STARTING_SHRINK_FILT_RAD 0 
 #define HD_STARTING_MED_FILT_RAD 2  // EDIT: 2/13 (prev 1)
 #define HD_STARTING_GROW_FILT_RAD 2
+#define HD_STARTING_ROI_TRACKING false  // See hand_tracker.h
 
 // Post processing variables
 #define HD_SMALL_HAND_RADIUS (20.0f / XYZ_UNIT)  // In XYZ Space
 #define HD_DISCONT_FILT_RAD 3
+#define HD_UPCONVERT_GROW_FILT_RAD 4
+// Largest LFDepthDiscontinuity / LFGrowDepthThreshold radius (label_filter.h)
+#define HD_MAX_EXTREMUM_FILT_RAD 4
 #define HD_DISCONT_FILT_DEPTH_THRESH 25
 #define HD_SMALL_HAND_RADIUS_MIN_UV 10  // In UV Space
 #define HD_N_PTS_FILL_KERNEL (8*3)
@@ -36,11 +38,11 @@
 #define HD_FILL_FINE_RADIUS (1 / XYZ_UNIT) 
 #define HD_BACKGROUND_THRESH_GROW 100  // In depth space
 
-namespace jtil { namespace threading { class ThreadPool; } }
 namespace jtil { namespace data_str { template <typename T> class VectorManaged; } }
 
 namespace kinect_interface {
   class KinectInterface;
+  class TaskScheduler;
 namespace hand_detector {
 
   typedef enum {
@@ -49,20 +51,37 @@ namespace hand_detector {
   } HDLabelMethod;
 
   struct DecisionTree;
+  class SharedForest;
+  struct HandBlob;
+  class HandBlobLabeler;
+  class HandTracker;
+  struct HandROI;
+  class LabelFilter;
 
   class HandDetector {
   public:
-    HandDetector(jtil::threading::ThreadPool* tp);
+    // ts may be NULL, in which case all work is done on the calling thread.
+    // Otherwise it is usually TaskScheduler::get() (findHands() may then be
+    // called from a task of the same scheduler).
+    HandDetector(TaskScheduler* ts);
     ~HandDetector();
+    // init - The forest in filename is shared with every other detector in
+    // the process that uses the same file (see SharedForest).
     void init(const uint32_t im_width, const uint32_t im_height,
       const std::string filename = FOREST_DATA_FILENAME);
+    // init - Use a forest loaded elsewhere (not owned here).  The forest is
+    // only read, so it can be shared by many detectors.
+    void init(const uint32_t im_width, const uint32_t im_height,
+      DecisionTree* forest, const int32_t num_trees);
 
     void findHands(const int16_t* depth_data, bool& rhand_found, bool& lhand_found, 
       float* rhand_uvd, float* lhand_uvd);
     bool findHandLabels(const int16_t* depth_in, const float* xyz, 
       const HDLabelMethod method, uint8_t* label_out);
 
-    void evaluateForest(const int16_t* depth_data);  // Result is in labels_evaluated_
+    // evaluateForest - Result is in labels_evaluated_.  If roi is not NULL
+    // only pixels inside it are evaluated (the rest are labeled background).
+    void evaluateForest(const int16_t* depth_data, const HandROI* roi = NULL);
 
     void reset();
 
@@ -78,13 +97,20 @@ namespace hand_detector {
     // Setters
     inline int32_t& stage2_med_filter_radius() { return stage2_med_filter_radius_; }
     inline int32_t& stage1_shrink_filter_radius() { return stage1_shrink_filter_radius_; }
+    // roi_tracking - findHandLabels(HDFloodfill) evaluates the forest only
+    // around the hand predicted by a HandTracker (see hand_tracker.h)
+    inline bool& roi_tracking() { return roi_tracking_; }
     void num_trees_to_evaluate(const int32_t val);
     void max_height_to_evaluate(const int32_t val);
 
     jtil::data_str::Vector<jtil::math::Float3>& hands_uvd() { return hands_uvd_; }
+    // Statistics for every connected blob in labels_filtered_ (including the
+    // ones too small to be hands), in raster order of their first pixel.
+    jtil::data_str::Vector<HandBlob>& hand_blobs();
 
   private:
     DecisionTree* forest_;
+    SharedForest* shared_forest_;  // NULL if the forest was passed to init()
     int32_t num_trees_;
     int32_t max_height_;
     uint8_t* labels_evaluated_;
@@ -105,35 +131,50 @@ namespace hand_detector {
     uint32_t* pixel_queue_;
     jtil::data_str::Vector<jtil::math::Float3> hands_uvd_;  // In depth space
     jtil::data_str::Vector<uint32_t> hands_n_pts_;
+    bool roi_tracking_;
+    HandTracker* tracker_;
+    HandROI* roi_;  // The pixels evaluateForest() labels
     uint32_t queue_head_;
     uint32_t queue_tail_;
     uint8_t* pixel_on_queue_;
+    HandBlobLabeler* blob_labeler_;
+    LabelFilter* label_filter_down_;  // down_width_ x down_height_
+    LabelFilter* label_filter_src_;  // src_width_ x src_height_
+    LabelFilter* cur_label_filter_;  // The filter label_filter_*_cbs_ run
 
     // Multithreading
-    jtil::threading::ThreadPool* tp_;  // Not owned here
-    uint32_t threads_finished_;
-    std::mutex thread_update_lock_;
-    std::condition_variable not_finished_;
+    TaskScheduler* ts_;  // Not owned here
     jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* thread_cbs_;
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* blob_cbs_;
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* label_filter_row_cbs_;
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* label_filter_col_cbs_;
 
     static const float floodFillKernel_[HD_N_PTS_FILL_KERNEL][2]; 
 
-    void processNeighbour(int u, int v);
-
     // if lhand is NULL then it'll just find one hand
-    // floodFillLabelData --> Find's hand points by doing bloob detection
+    // floodFillLabelData --> Find's hand points by doing blob detection
+    // (union-find connected components, see hand_blob_labeler.h)
     void floodFillLabelData(bool* rhand_found, float* rhand_uvd, 
       bool* lhand_found = NULL, float* lhand_uvd = NULL);
 
-    void createLabels(const int16_t* depth_data);
+    void initBuffers(const uint32_t im_width, const uint32_t im_height);
+    void createLabels(const int16_t* depth_data, const HandROI* roi = NULL);
     void filterLabels(uint8_t*& dst, uint8_t*& src, uint8_t*& tmp,
     int16_t* depth, const int32_t w, const int32_t h);
     void filterLabelsThreshold(uint8_t*& dst, uint8_t*& src, uint8_t*& tmp,
     int16_t* depth, const int32_t w, const int32_t h);  // Newer method
+    // runLabelFilter --> One label_filter.h filter, with the image split into
+    // one band per worker thread.  w x h picks label_filter_down_ or 
+    // label_filter_src_.
+    void runLabelFilter(const int32_t w, const int32_t h, const int type, 
+      uint8_t* dst, const uint8_t* src, const int16_t* depth, 
+      const int32_t rad, const int32_t depth_thresh = 0);
 
     void evaluateForestMultithreaded();  // Sets up the work queue and fire's off threads
-    void evaluateForestPixelRange(const uint32_t istart, const uint32_t iend);
-    void evaluateForestPixel(const uint32_t index);
+    void evaluateForestBand(const int32_t band);  // Rows of roi_
+    void labelBlobsBand(const int32_t band);
+    void labelFilterRowsBand(const int32_t band);
+    void labelFilterColsBand(const int32_t band);
 
     // findHandLabelsFloodFill --> Performs a floodfill from the hand point
     // which is sensitive to depth discontinuities.
@@ -145,12 +186,10 @@ namespace hand_detector {
       float* pt_hand_uvd, int radius);
     void processNeighbour(const int* nieghbourPtUV, const int curPtIndex, 
       const float* ptHand, const float* xyz);
-    static void GrowFilterDepthThreshold(uint8_t* labels_dst, 
-      uint8_t* labels_src, const int16_t* depth, const int32_t w, 
-      const int32_t h, const int32_t rad);
 
     // findHand --> Just find A hand (will find the biggest of the hand blobs)
-    void findHand(const int16_t* depth_data, bool& hand_found, float* hand_uvd);
+    void findHand(const int16_t* depth_data, bool& hand_found, float* hand_uvd,
+      const HandROI* roi = NULL);
   };
 
 };  // namespace hand_detector
@@ -0,0 +1,106 @@
+//
+//  hand_fusion.h
+//
+//  Fuses the per-sensor hand detections (see multi_hand_detector.h) into a
+//  single set of 3D hand positions in a common world frame.
+//
+//  1. Every detection is converted from its sensor's UVD space to sensor XYZ
+//     (KinectInterface::convertUVDToApproxXYZ) and then to world space using
+//     that sensor's stored extrinsics (world_from_sensor, a row major 3x4
+//     matrix [R | t] in meters).
+//  2. Detections are associated greedily across sensors: best view first,
+//     each one joins the closest fused hand within HF_ASSOCIATION_RADIUS
+//     that doesn't already have a detection from the same sensor.
+//  3. Each fused hand is the view weighted mean of its detections.  Its
+//     confidence is the fraction of the sensors with data that saw it.  The
+//     sensor with the best view (the closest one) is also recorded, so that
+//     HandNet only needs to run once per hand on that sensor's image.
+//  4. Fused hands are matched to last frame's tracks (within
+//     HF_TRACK_RADIUS) so that track ids are stable over time.
+//
+//  The detector's left / right decision is based on image position, which
+//  isn't consistent across sensors, so it's ignored when associating.
+//
+
+#pragma once
+
+#include <string>
+#include "jtil/math/math_types.h"
+#include "jtil/data_str/vector.h"
+
+#define HF_ASSOCIATION_RADIUS 0.1f  // In meters (world space)
+#define HF_TRACK_RADIUS 0.15f  // In meters (world space)
+#define HF_EXTRINSICS_SIZE 12  // row major 3x4 [R | t]
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  struct SensorHands;
+
+  struct FusedHand {
+    uint32_t track_id;
+    uint32_t track_age;  // Number of consecutive frames tracked
+    float xyz[3];  // World space
+    float confidence;  // In [0, 1]
+    uint32_t num_views;
+    uint32_t best_sensor;  // The sensor to feed to HandNet
+    float best_uvd[3];  // The hand position in best_sensor's depth space
+  };
+
+  class HandFusion {
+  public:
+    HandFusion();
+    ~HandFusion();
+
+    // init - All sensors start with identity extrinsics
+    void init(const uint32_t num_sensors);
+
+    void setExtrinsics(const uint32_t sensor, const float* world_from_sensor);
+    // loadExtrinsics - Text file with one row per sensor of
+    // HF_EXTRINSICS_SIZE floats (row major [R | t]).  Returns false if the
+    // file could not be opened.
+    bool loadExtrinsics(const std::string& filename);
+
+    // fuse - hands has num_sensors entries (sensors with frame_number == 0
+    // have no data yet and are skipped).  Result is in fused_hands().
+    void fuse(const SensorHands* hands);
+
+    // bestView - The best sensor of the most confident fused hand (the
+    // older track on ties).  This is the view to feed to HandNet.  Returns
+    // false if there are no fused hands.
+    bool bestView(uint32_t& sensor);
+
+    inline jtil::data_str::Vector<FusedHand>& fused_hands() {
+      return fused_hands_;
+    }
+    inline const uint32_t num_sensors() const { return num_sensors_; }
+
+  private:
+    struct Detection {
+      uint32_t sensor;
+      float uvd[3];
+      float xyz[3];  // World space
+      float weight;
+    };
+
+    uint32_t num_sensors_;
+    float* extrinsics_;  // num_sensors_ * HF_EXTRINSICS_SIZE
+    uint32_t next_track_id_;
+    jtil::data_str::Vector<Detection> detections_;
+    jtil::data_str::Vector<FusedHand> fused_hands_;
+    jtil::data_str::Vector<FusedHand> prev_fused_hands_;
+    jtil::data_str::Vector<float> fused_weight_;
+    jtil::data_str::Vector<uint32_t> fused_sensor_mask_;
+
+    void addDetection(const uint32_t sensor, const float* uvd);
+    void associateDetections();
+    void updateTracks();
+    static float distSq(const float* a, const float* b);
+
+    // Non-copyable, non-assignable.
+    HandFusion(HandFusion&);
+    HandFusion& operator=(const HandFusion&);
+  };
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
@@ -0,0 +1,87 @@
+//
+//  hand_tracker.h
+//
+//  Constant velocity (alpha-beta filter) tracker over the hand blob centroid
+//  and depth that HandDetector::findHand returns.  It predicts where the hand
+//  will be in the next frame, so that the decision forest only needs to be
+//  evaluated inside a padded box around that point instead of over the whole
+//  downsampled image.
+//
+//  The box half size is HT_ROI_HAND_RADII hand radii (HD_HAND_RADIUS)
+//  projected at the predicted depth, plus HT_ROI_VEL_FRAMES frames of the
+//  current image space velocity.  predictROI() asks for a full frame scan
+//  when there is no track, after the track is lost (no hand in the box, or a
+//  depth jump of more than HT_MAX_DEPTH_JUMP) and at least every
+//  HT_FULL_SCAN_FRAMES frames, so a hand entering elsewhere is still found.
+//
+//  Forest labels inside the box are identical to a full frame evaluation
+//  (every pixel is evaluated independently); outside it they are background.
+//
+
+#pragma once
+
+#include "jtil/math/math_types.h"
+
+#define HT_FULL_SCAN_FRAMES 15  // A full frame scan at least this often
+#define HT_GAIN_POS 0.85f  // alpha
+#define HT_GAIN_VEL 0.5f  // beta
+#define HT_ROI_HAND_RADII 1.5f
+#define HT_ROI_VEL_FRAMES 2.0f
+#define HT_MIN_DEPTH 200.0f  // Clamp on the predicted depth (mm)
+#define HT_MAX_DEPTH_JUMP 350.0f  // Larger frame to frame jumps are a new hand
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  // HandROI - Inclusive pixel bounds in the downsampled image
+  struct HandROI {
+    int32_t u_min;
+    int32_t u_max;
+    int32_t v_min;
+    int32_t v_max;
+  };
+
+  class HandTracker {
+  public:
+    HandTracker();
+    ~HandTracker();
+
+    // init - src_width x src_height is the depth image size (hand_uvd is in
+    // this space), downsample the forest's downsample factor and hfov / vfov
+    // the depth camera field of view in degrees.
+    void init(const int32_t src_width, const int32_t src_height,
+      const int32_t downsample, const float hfov_deg, const float vfov_deg);
+
+    // predictROI - false if the next frame should be a full frame scan,
+    // otherwise roi is the box to evaluate
+    bool predictROI(HandROI& roi) const;
+
+    // update - With the result for the frame just evaluated.  hand_uvd is
+    // only read if found.  full_frame is whether the frame was a full scan.
+    void update(const bool found, const float* hand_uvd,
+      const bool full_frame);
+
+    void reset();
+
+    inline const bool tracking() const { return tracking_; }
+    // fullROI - The whole downsampled image
+    void fullROI(HandROI& roi) const;
+
+  private:
+    int32_t down_width_;
+    int32_t down_height_;
+    int32_t downsample_;
+    float focal_u_;  // In src pixels
+    float focal_v_;
+    bool tracking_;
+    int32_t frames_since_full_scan_;
+    float pos_[3];  // u, v (src pixels), depth (mm)
+    float vel_[3];  // Per frame
+
+    // Non-copyable, non-assignable.
+    HandTracker(HandTracker&);
+    HandTracker& operator=(const HandTracker&);
+  };
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
@@ -0,0 +1,127 @@
+//
+//  label_filter.h
+//
+//  Radius independent versions of the label post-processing filters used by
+//  HandDetector (jtil's ShrinkFilter, GrowFilter and MedianLabelFilter for
+//  binary labels, the depth discontinuity test and the depth thresholded
+//  grow filter).
+//
+//  Every filter is separable into a horizontal pass (filterRowsBand) and a
+//  vertical pass (filterColsBand):
+//    - Shrink, grow and median use running window counts.
+//    - The depth discontinuity test uses van Herk / Gil-Werman min and max
+//      (3 comparisons per pixel regardless of radius).
+//    - The depth thresholded grow uses van Herk / Gil-Werman min and max of
+//      the labeled depths in the window, and grows a pixel whose depth is
+//      within depth_thresh of that range (see growDepthRange()).
+//  Inner loops run along image rows so the compiler can vectorize them.
+//
+//  The image is split into horizontal bands.  All bands of the row pass must
+//  finish before any band of the column pass starts (see HandDetector for the
+//  thread pool version, or call filter() to run everything on this thread).
+//
+//  Windows are clipped to the image (pixels outside the image are ignored).
+//
+
+#pragma once
+
+#include "jtil/math/math_types.h"
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  typedef enum {
+    LFShrink,  // Any 0 in the window --> 0, otherwise src
+    LFGrow,  // Any 1 in the window --> 1, otherwise src
+    LFMedian,  // Binary majority vote over the pixels with valid depth
+    LFDepthDiscontinuity,  // Remove labels where the window max - min depth
+                           // exceeds depth_thresh (or has invalid depth)
+    LFGrowDepthThreshold,  // Grow only into pixels within depth_thresh
+  } LabelFilterType;
+
+  class LabelFilter {
+  public:
+    LabelFilter();
+    ~LabelFilter();
+
+    // max_extremum_rad is the largest radius LFDepthDiscontinuity and
+    // LFGrowDepthThreshold will be called with (it sizes the van Herk
+    // scratch buffers).
+    void init(const int32_t width, const int32_t height,
+      const int32_t num_bands, const int32_t max_extremum_rad);
+
+    // setFilter - Configure the next filter.  dst may alias src (src is only
+    // read at the center pixel once the row pass is done).  depth is only
+    // read by LFMedian, LFDepthDiscontinuity and LFGrowDepthThreshold.
+    void setFilter(const LabelFilterType type, uint8_t* dst,
+      const uint8_t* src, const int16_t* depth, const int32_t rad,
+      const int32_t depth_thresh = 0);
+
+    void filterRowsBand(const int32_t band);
+    void filterColsBand(const int32_t band);
+
+    // filter - setFilter then both passes for every band on this thread
+    void filter(const LabelFilterType type, uint8_t* dst,
+      const uint8_t* src, const int16_t* depth, const int32_t rad,
+      const int32_t depth_thresh = 0);
+
+    inline const int32_t num_bands() const { return num_bands_; }
+
+  private:
+    int32_t width_;
+    int32_t height_;
+    int32_t num_bands_;
+    int32_t max_extremum_rad_;
+    int32_t* band_start_row_;  // num_bands_ + 1 entries
+
+    // The current filter
+    LabelFilterType type_;
+    uint8_t* dst_;  // Not owned here
+    const uint8_t* src_;  // Not owned here
+    const int16_t* depth_;  // Not owned here
+    int32_t rad_;
+    int32_t depth_thresh_;
+
+    // Row pass results (full image)
+    uint16_t* row_count_a_;
+    uint16_t* row_count_b_;
+    int16_t* row_min_;
+    int16_t* row_max_;
+    int16_t* col_min_;
+    int16_t* col_max_;
+    uint8_t* row_grown_;
+
+    // Per band scratch
+    int32_t band_row_scratch_size_;
+    int32_t band_col_scratch_size_;
+    uint8_t* band_pred_a_;
+    uint8_t* band_pred_b_;
+    uint16_t* band_prefix_a_;
+    uint16_t* band_prefix_b_;
+    uint32_t* band_acc_a_;
+    uint32_t* band_acc_b_;
+    int16_t* band_g_;
+    int16_t* band_h_;
+
+    void boxCountRow(uint16_t* count, const uint8_t* pred,
+      uint16_t* prefix) const;
+    void boxCountCols(uint32_t* acc, const uint16_t* row_count,
+      const int32_t v, const int32_t v_start) const;
+    template <bool IS_MIN>
+    void extremumRow(int16_t* dst, const int16_t* src, int16_t* g,
+      int16_t* h) const;
+    template <bool IS_MIN>
+    void extremumCols(int16_t* dst, const int16_t* src, const int32_t v_start,
+      const int32_t v_end, int16_t* g, int16_t* h) const;
+
+    inline bool validDepth(const int16_t d) const;
+    inline bool growDepthRange(const int16_t d, const int16_t lo,
+      const int16_t hi) const;
+
+    // Non-copyable, non-assignable.
+    LabelFilter(LabelFilter&);
+    LabelFilter& operator=(const LabelFilter&);
+  };
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
@@ -0,0 +1,119 @@
+//
+//  multi_hand_detector.h
+//
+//  Runs hand detection on every connected sensor each frame.  There is one
+//  HandDetector context (label and filter buffers) per sensor, but they all
+//  share a single read-only copy of the decision forest (a SharedForest, so
+//  it is also shared with any other detector in the process).  Sensors are
+//  processed in parallel (one task per sensor) on the process-wide
+//  TaskScheduler, and the results are published per sensor along with the
+//  depth frame number and timestamp they were computed from.
+//
+//  Each per-sensor HandDetector splits its own work into tasks on the same
+//  scheduler (a sensor task waiting on them runs queued tasks meanwhile), so
+//  one sensor can use every core when the others have no new frame.
+//
+//  detect() blocks until every sensor is done.  start() instead runs it in a
+//  loop on a background thread until stop(), so a render loop only ever
+//  reads the latest published results (sensorHands(), num_updates()).
+//
+
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "jtil/math/math_types.h"
+#include "jtil/threading/callback.h"
+#include "kinect_interface/hand_detector/hand_detector.h"
+
+#define MHD_IDLE_SLEEP_MS 2  // Background thread poll when no frame is new
+
+namespace jtil { namespace data_str { template <typename T> class VectorManaged; } }
+
+namespace kinect_interface {
+  class KinectInterface;
+  class TaskScheduler;
+namespace hand_detector {
+
+  struct DecisionTree;
+  class SharedForest;
+
+  struct SensorHands {
+    uint64_t frame_number;  // depth_frame_number() used (0 --> none yet)
+    int64_t frame_time;  // depth_frame_time() used
+    bool rhand_found;
+    bool lhand_found;
+    float rhand_uvd[3];  // In the sensor's depth space
+    float lhand_uvd[3];
+  };
+
+  class MultiHandDetector {
+  public:
+    MultiHandDetector(TaskScheduler* ts);
+    ~MultiHandDetector();
+
+    void init(const uint32_t num_sensors, const uint32_t im_width,
+      const uint32_t im_height,
+      const std::string filename = FOREST_DATA_FILENAME);
+
+    // detect - Run detection on every sensor that has a depth frame newer
+    // than the last one processed, then wait for them to finish.  Returns
+    // the number of sensors that were updated.
+    uint32_t detect(KinectInterface** kinects, const uint32_t num_kinects);
+
+    // start - Call detect() continuously on a background thread.  kinects
+    // must stay valid until stop() (which the destructor also calls).
+    void start(KinectInterface** kinects, const uint32_t num_kinects);
+    void stop();
+    inline const bool running() const { return detect_thread_ != NULL; }
+
+    // num_updates - Incremented every time a sensor result is published
+    inline const uint64_t num_updates() const { return num_updates_; }
+
+    // sensorHands - Thread safe copy of the latest result for one sensor
+    void sensorHands(const uint32_t sensor, SensorHands& hands);
+
+    inline const uint32_t num_sensors() const { return num_sensors_; }
+    // The per-sensor detector (to get at its label images).  Don't use it
+    // while detect() is running.
+    inline HandDetector* detector(const uint32_t sensor) {
+      return detectors_[sensor];
+    }
+
+  private:
+    SharedForest* shared_forest_;
+    DecisionTree* forest_;  // Owned by shared_forest_
+    int32_t num_trees_;
+    uint32_t num_sensors_;
+    uint32_t im_dim_;
+    HandDetector** detectors_;
+    int16_t** depth_;  // One depth image copy per sensor
+    SensorHands* hands_;  // Published results (guarded by results_lock_)
+    std::mutex results_lock_;
+    std::atomic<uint64_t> num_updates_;
+    KinectInterface** kinects_;  // Not owned here (only valid in detect())
+
+    // Background detection (see start())
+    std::thread* detect_thread_;
+    std::atomic<bool> stop_detect_thread_;
+    KinectInterface** thread_kinects_;  // Not owned here
+    uint32_t thread_num_kinects_;
+
+    // Multithreading
+    TaskScheduler* ts_;  // Not owned here
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* sensor_cbs_;
+
+    void detectSensor(const uint32_t sensor);
+    uint32_t detectNewFrames(KinectInterface** kinects,
+      const uint32_t num_kinects);
+    void detectThread();
+
+    // Non-copyable, non-assignable.
+    MultiHandDetector(MultiHandDetector&);
+    MultiHandDetector& operator=(const MultiHandDetector&);
+  };
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
@@ -0,0 +1,88 @@
+//
+//  grid_normal_engine.h
+//
+//  Per-pixel normals for a labeled XYZ image, computed straight from the
+//  depth grid.  The result is the same as building the triangle mesh of
+//  HandImageGenerator (one or two triangles per quad of labeled pixels,
+//  split down the same diagonal) and scattering the face normals onto the
+//  vertices, but no vertex or index buffers are created:  every pixel gathers
+//  the faces of the 4 quads it touches.  This makes each output pixel
+//  independent, so the rows inside the label bounding box are split into
+//  bands and processed on the TaskScheduler.
+//
+//  The weighting (NormalApproximationMethod) is a template parameter, so the
+//  per-face switch is resolved at compile time.
+//
+//  Each pixel adds up its faces in the same order (raster order of the quads,
+//  then the faces within a quad) and with the same arithmetic as the old
+//  scatter loop, so the normals are bit for bit the same.  The only
+//  difference: pixels that are not part of any face (including every
+//  unlabeled pixel) get a zero normal instead of NaN.
+//
+
+#pragma once
+
+#include "jtil/math/math_types.h"
+#include "jtil/threading/callback.h"
+
+namespace jtil { namespace data_str { template <typename T> class VectorManaged; } }
+
+namespace kinect_interface {
+  class TaskScheduler;
+namespace hand_net {
+
+  typedef enum {
+    BasicNormalApproximation,  // average normals (no weighting)
+    SimpleNormalApproximation,  // average normals around vert weighted by area
+    RobustNormalApproximation,  // average normals weighted by angle at the vert
+  } NormalApproximationMethod;
+
+  class GridNormalEngine {
+  public:
+    // ts may be NULL (then everything is done on the calling thread)
+    GridNormalEngine(TaskScheduler* ts);
+    ~GridNormalEngine();
+
+    void init(const uint32_t width, const uint32_t height);
+
+    // calcNormals - normals_xyz and xyz are AoS (width * height * 3)
+    void calcNormals(float* normals_xyz, const float* xyz,
+      const uint8_t* labels, const NormalApproximationMethod method);
+
+    // The label bounding box used by the last calcNormals call (inclusive)
+    inline const jtil::math::Int4& label_bbox() const { return label_bbox_; }
+
+  private:
+    uint32_t width_;
+    uint32_t height_;
+    jtil::math::Int4 label_bbox_;  // u_min, v_min, u_max, v_max
+
+    // The current job
+    float* normals_xyz_;  // Not owned here
+    const float* xyz_;  // Not owned here
+    const uint8_t* labels_;  // Not owned here
+    NormalApproximationMethod method_;
+
+    // Multithreading
+    TaskScheduler* ts_;  // Not owned here
+    uint32_t num_bands_;
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* band_cbs_;
+
+    bool calcLabelBBox();
+    void calcNormalsBand(const uint32_t band);
+    template <NormalApproximationMethod M>
+    void calcNormalsRows(const int32_t v_start, const int32_t v_end);
+    template <NormalApproximationMethod M>
+    void addQuadFaces(float* acc, const int32_t p, const int32_t u,
+      const int32_t v) const;
+    template <NormalApproximationMethod M>
+    void addFace(float* acc, const int32_t p, const int32_t v1,
+      const int32_t v2, const int32_t v3) const;
+
+    // Non-copyable, non-assignable.
+    GridNormalEngine(GridNormalEngine&);
+    GridNormalEngine& operator=(const GridNormalEngine&);
+  };
+
+};  // namespace hand_net
+};  // namespace kinect_interface
@@ -11,6 +11,7 @@
 
 #include "jtil/math/math_types.h"
 #include "kinect_interface/hand_net/hand_net.h"
+#include "kinect_interface/hand_net/grid_normal_engine.h"
 #include "jtil/threading/callback.h"
 #include "jtil/data_str/vector.h"
 
@@ -38,18 +39,14 @@ namespace jtorch {
 }
 
 namespace kinect_interface {
+  class TaskScheduler;
 namespace hand_net {
 
-  typedef enum {
-    BasicNormalApproximation,  // average normals (no weighting)
-    SimpleNormalApproximation,  // average normals around vert weighted by area
-    RobustNormalApproximation,  // average normals weighted by angle at the vert
-  } NormalApproximationMethod;
-  
   class HandImageGenerator {
   public:
     // Constructor / Destructor
-    HandImageGenerator(const int32_t num_banks);
+    // ts is used to calculate the normal image (may be NULL)
+    HandImageGenerator(const int32_t num_banks, TaskScheduler* ts = NULL);
     ~HandImageGenerator();
 
     void createLabelFromSyntheticDepth(const float* depth, uint8_t* label);
@@ -99,9 +96,7 @@ namespace hand_net {
     jtil::math::Int4 hand_pos_wh_;  // Lower left pos and width/height of the hand image
     double* im_temp_double_;
     jtorch::Parallel* norm_module_;  // One per bank
-    jtil::data_str::Vector<jtil::math::Int3> hand_mesh_indices_;
-    jtil::data_str::Vector<jtil::math::Float3> hand_mesh_vertices_;
-    jtil::data_str::Vector<jtil::math::Float3> hand_mesh_normals_;
+    GridNormalEngine* normal_engine_;
     const NormalApproximationMethod norm_method_;
 
     void calcCroppedHand(const int16_t* depth_in, const uint8_t* label_in, 
@@ -113,18 +108,6 @@ namespace hand_net {
     void renderCrossToImageArr(const float* uv, uint8_t* im, const int32_t w, 
       const int32_t h, const int32_t rad, const int32_t color_ind,
       const jtil::math::Int4& hand_pos_wh) const;
-    void calcNormalUnNormalized(jtil::math::Float3& normal, 
-      const jtil::math::Float3& pt0, const jtil::math::Float3& pt1, 
-      const jtil::math::Float3& pt2);
-    void calcNormal(jtil::math::Float3& normal, const jtil::math::Float3& pt0,
-      const jtil::math::Float3& pt1, const jtil::math::Float3& pt2);
-    float calcAngleSafe(const jtil::math::Float3& pt0, 
-      const jtil::math::Float3& pt1, const jtil::math::Float3& pt2);
-
-    // Create hand geometry from xyz + label data
-    void createHandMeshVertices(const float* xyz);  // Step 1
-    void createHandMeshIndices(const uint8_t* labels);  // Step 2
-    void createHandMeshNormals();  // Step 3
 
     // Non-copyable, non-assignable.
     HandImageGenerator(HandImageGenerator&);
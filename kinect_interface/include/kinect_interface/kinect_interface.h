@@ -62,6 +62,7 @@ struct XYPoint {
 };
 		
 namespace kinect_interface {
+  class DepthRayTable;
 
   typedef enum {
     DEPTH_STREAM = 0,
@@ -207,6 +208,7 @@ namespace kinect_interface {
     uint8_t rgb_[rgb_dim * 4];  // enough space for 4 channels are allocated, but we only use 3
     XYZPoint xyz_[depth_dim];
     XYPoint uv_depth_2_rgb_[depth_dim];
+    DepthRayTable* ray_table_;  // From the SDK's depth to camera space table
     bool user_tracked_[num_users];
     jtil::math::Float3 user_joints_[num_users][num_user_joints];
     uint64_t depth_frame_number_;
@@ -0,0 +1,155 @@
+//
+//  task_scheduler.h
+//
+//  A single work stealing scheduler for the whole process.  Every component
+//  that used to own a jtil ThreadPool (App, HandDetector, MultiHandDetector,
+//  GridNormalEngine) submits its tasks here instead, so running N sensors no
+//  longer means N pools of worker threads fighting over the same cores.
+//
+//  Each worker has its own deque.  Tasks submitted from a worker go on the
+//  back of its own deque and it pops from the back (the data is likely still
+//  in its cache), idle workers steal from the front of the others.  Tasks
+//  submitted from any other thread are spread round robin over the deques.
+//
+//  Tasks belong to a TaskGroup.  wait(group) doesn't just block: the waiting
+//  thread runs queued tasks until the group has finished.  So the caller acts
+//  as one more worker (like it did with the old thread pool barriers), and a
+//  task may itself submit and wait on a nested group without deadlocking the
+//  workers.  A task can also be added with a dependency on another group, in
+//  which case it is only queued once that group has finished.
+//
+//  The Callback objects are not owned here (the components keep theirs in a
+//  VectorManaged and resubmit them every frame).
+//
+//  kinect_interface_primesense compiles this same file into its library
+//  (rather than linking kinect_interface), so its devices, HandDetector,
+//  DecisionForestSweep and RedHandRelabeler use this scheduler too.  No
+//  target links both libraries.
+//
+//  test/task_scheduler_test.cpp runs two devices on one scheduler (see
+//  BUILD_KINECT_INTERFACE_TESTS in the top level CMakeLists.txt).
+//
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "jtil/math/math_types.h"
+#include "jtil/threading/callback.h"
+
+#define TASK_SCHEDULER_MAX_WORKERS 64
+
+namespace jtil { namespace data_str { template <typename T> class VectorManaged; } }
+
+namespace kinect_interface {
+
+  class TaskGroup;
+
+  struct ScheduledTask {
+    jtil::threading::Callback<void>* cb;  // Not owned here
+    TaskGroup* group;
+  };
+
+  class TaskGroup {
+  public:
+    TaskGroup();
+    ~TaskGroup();
+
+    // finished - No task of the group is queued, deferred or running
+    inline bool finished() const { return pending_ == 0; }
+
+  private:
+    friend class TaskScheduler;
+    std::atomic<uint32_t> pending_;  // Only modified with lock_ held
+    std::mutex lock_;
+    std::vector<ScheduledTask> dependents_;  // Queued when pending_ hits 0
+
+    // Non-copyable, non-assignable.
+    TaskGroup(TaskGroup&);
+    TaskGroup& operator=(const TaskGroup&);
+  };
+
+  class TaskScheduler {
+  public:
+    // get - The process-wide scheduler, started on first use with
+    // num_workers() from init() (or defaultNumWorkers() if init() was never
+    // called).
+    static TaskScheduler* get();
+    // init - Set the number of worker threads before the first get().  It
+    // is an error to ask for a different number once it is running.
+    static void init(const uint32_t num_workers);
+    // shutdown - Finish the queued tasks and join the workers.  A later
+    // get() starts a new scheduler.
+    static void shutdown();
+    // defaultNumWorkers - One less than the number of cores (the thread that
+    // waits on a group does work too)
+    static uint32_t defaultNumWorkers();
+
+    // addTask - Queue cb as part of group (the tasks of a group run in any
+    // order).  If after is not NULL, cb is only queued once after has
+    // finished.
+    void addTask(jtil::threading::Callback<void>* cb, TaskGroup& group,
+      TaskGroup* after = NULL);
+    void addTasks(
+      jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* cbs,
+      TaskGroup& group, TaskGroup* after = NULL);
+
+    // wait - Run queued tasks on this thread until group has finished
+    void wait(TaskGroup& group);
+
+    // run - addTasks() + wait() (the replacement for the old per-component
+    // executeThreadCallbacks() barriers)
+    void run(
+      jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* cbs);
+
+    inline const uint32_t num_workers() const { return num_workers_; }
+    // num_threads - The threads that take part in a wait() (the workers plus
+    // the waiting thread): how many bands to split a job into.
+    inline const uint32_t num_threads() const { return num_workers_ + 1; }
+
+  private:
+    struct TaskDeque {
+      std::mutex lock;
+      std::deque<ScheduledTask> tasks;
+    };
+
+    uint32_t num_workers_;
+    std::thread** workers_;
+    std::thread::id* worker_ids_;  // Fixed once started_ is set
+    TaskDeque* deques_;
+    std::atomic<uint32_t> num_queued_;
+    std::atomic<uint32_t> next_deque_;  // Round robin for non-worker threads
+    bool started_;
+    bool stopping_;
+    std::mutex idle_lock_;
+    std::condition_variable idle_;  // New task, finished group or stopping
+
+    static std::mutex instance_lock_;
+    static TaskScheduler* instance_;
+    static uint32_t instance_num_workers_;  // 0 --> defaultNumWorkers()
+
+    TaskScheduler(const uint32_t num_workers);
+    ~TaskScheduler();
+
+    void workerThread(const uint32_t worker);
+    int32_t workerIndex() const;  // -1 if not called from a worker
+    void queueTask(const ScheduledTask& task);
+    bool popTask(const int32_t worker, ScheduledTask& task);
+    bool runTask(const int32_t worker);
+    void finishTask(TaskGroup& group);
+
+    // Non-copyable, non-assignable.
+    TaskScheduler(TaskScheduler&);
+    TaskScheduler& operator=(const TaskScheduler&);
+  };
+
+  // runTasks - ts->run(cbs), or every callback in order on this thread if ts
+  // is NULL.
+  void runTasks(TaskScheduler* ts,
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* cbs);
+
+};  // namespace kinect_interface
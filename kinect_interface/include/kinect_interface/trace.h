@@ -0,0 +1,112 @@
+//
+//  trace.h
+//
+//  Low overhead per-stage latency tracing.  Each thread that records an
+//  event gets its own ring buffer of (stage, frame id, start, end), so
+//  recording is two clock reads and a store with no locking.  The ring keeps
+//  the newest TRACE_BUFFER_SIZE events per thread.
+//
+//  Everything is compiled out unless KINECT_INTERFACE_TRACE is defined: the
+//  TRACE_ macros expand to nothing and the exporters write empty reports.
+//
+//  Usage:
+//    TRACE_SET_FRAME(depth_frame_number);  // Frame id for this thread
+//    {
+//      TRACE_SCOPE(TRACE_FOREST_EVAL);  // Records until the end of scope
+//      ...
+//    }
+//    Tracer::exportChromeTrace("trace.json");  // chrome://tracing
+//    Tracer::exportHistograms("trace_histograms.txt");  // p50 / p99
+//
+//  The sensor timestamp isn't on our clock, so TRACE_SENSOR_FRAME maps it
+//  with the smallest (host - sensor) offset seen so far.  The TRACE_SENSOR
+//  stage is therefore the latency above the best frame seen, not the
+//  absolute sensor to host latency.
+//
+//  The frame lifetime histogram is per frame id: the end of its last stage
+//  minus the start of its first one.  Frame ids come from the sensor's frame
+//  counter, so with more than one sensor the lifetimes are mixed together.
+//
+
+#pragma once
+
+#include <string>
+#include "jtil/math/math_types.h"
+
+// #define KINECT_INTERFACE_TRACE
+#define TRACE_BUFFER_SIZE 16384  // Events per thread (must be a power of 2)
+
+namespace kinect_interface {
+
+  typedef enum {
+    TRACE_SENSOR = 0,  // Sensor timestamp --> frame acquired
+    TRACE_CAPTURE = 1,  // Copying the frame out of the driver
+    TRACE_CONVERT = 2,  // depth --> xyz, rgb --> depth
+    TRACE_DETECT = 3,  // Whole hand detection stage
+    TRACE_FOREST_EVAL = 4,
+    TRACE_LABEL_FILTER = 5,
+    TRACE_FLOOD_FILL = 6,
+    TRACE_CONVNET = 7,
+    TRACE_PSO = 8,
+    TRACE_MULTI_DETECT = 9,  // MultiHandDetector::detect
+    TRACE_APP_COPY = 10,  // App copying the newest frame
+    TRACE_RENDER = 11,
+    TRACE_APP_FRAME = 12,  // One iteration of App::run
+    TRACE_NUM_STAGES = 13,
+  } TraceStage;
+
+  class Tracer {
+  public:
+    // now - Nanoseconds on the trace clock
+    static int64_t now();
+    static void record(const TraceStage stage, const uint64_t frame_id,
+      const int64_t start, const int64_t end);
+    // setFrame - The frame id that TRACE_SCOPE uses on this thread
+    static void setFrame(const uint64_t frame_id);
+    static uint64_t frame();
+    // recordSensorFrame - A TRACE_SENSOR event from the (mapped) sensor
+    // timestamp to now
+    static void recordSensorFrame(const uint64_t frame_id,
+      const int64_t sensor_time_ns);
+
+    // exportChromeTrace - Every buffered event as Chrome trace JSON
+    static void exportChromeTrace(const std::string& filename);
+    // exportHistograms - count, mean, p50, p99 and max per stage (and the
+    // frame lifetime) plus a log2 histogram of the durations
+    static void exportHistograms(const std::string& filename);
+    // clear - Drop all buffered events
+    static void clear();
+
+    static const char* stageName(const TraceStage stage);
+  };
+
+  class TraceScope {
+  public:
+    TraceScope(const TraceStage stage) {
+      stage_ = stage;
+      start_ = Tracer::now();
+    }
+    ~TraceScope() {
+      Tracer::record(stage_, Tracer::frame(), start_, Tracer::now());
+    }
+  private:
+    TraceStage stage_;
+    int64_t start_;
+  };
+
+};  // namespace kinect_interface
+
+#ifdef KINECT_INTERFACE_TRACE
+  #define TRACE_CONCAT_INNER(a, b) a##b
+  #define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+  #define TRACE_SCOPE(stage) \
+    kinect_interface::TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(stage)
+  #define TRACE_SET_FRAME(frame_id) \
+    kinect_interface::Tracer::setFrame(frame_id)
+  #define TRACE_SENSOR_FRAME(frame_id, sensor_time_ns) \
+    kinect_interface::Tracer::recordSensorFrame(frame_id, sensor_time_ns)
+#else
+  #define TRACE_SCOPE(stage)
+  #define TRACE_SET_FRAME(frame_id)
+  #define TRACE_SENSOR_FRAME(frame_id, sensor_time_ns)
+#endif
@@ -0,0 +1,168 @@
+#include <string>
+#include <stdexcept>
+#include "kinect_interface/depth_ray_table.h"
+#include "kinect_interface/kinect_interface.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+#define DRT_DEPTH_TO_M (1.0f / 1000.0f)  // The new kinect has units in meters
+
+namespace kinect_interface {
+
+  DepthRayTable::DepthRayTable() {
+    width_ = 0;
+    height_ = 0;
+    ray_x_ = NULL;
+    ray_y_ = NULL;
+    undistort_src_ = NULL;
+    depth_tmp_ = NULL;
+    zero_depth_val_ = 0;
+  }
+
+  DepthRayTable::~DepthRayTable() {
+    SAFE_DELETE_ARR(ray_x_);
+    SAFE_DELETE_ARR(ray_y_);
+    SAFE_DELETE_ARR(undistort_src_);
+    SAFE_DELETE_ARR(depth_tmp_);
+  }
+
+  void DepthRayTable::allocate(const uint32_t width, const uint32_t height) {
+    if (width == 0 || height == 0) {
+      throw std::wruntime_error("DepthRayTable::allocate() - ERROR: "
+        "width and height must be positive!");
+    }
+    SAFE_DELETE_ARR(ray_x_);
+    SAFE_DELETE_ARR(ray_y_);
+    SAFE_DELETE_ARR(undistort_src_);
+    SAFE_DELETE_ARR(depth_tmp_);
+    width_ = width;
+    height_ = height;
+    ray_x_ = new float[width_ * height_];
+    ray_y_ = new float[width_ * height_];
+  }
+
+  // FROM: XnOpenNI.cpp (via KinectInterface::convertDepthFrameToApproxXYZ)
+  void DepthRayTable::initApprox(const uint32_t width, const uint32_t height,
+    const float hfov_deg, const float vfov_deg) {
+    allocate(width, height);
+    const float vfov_rad = 2.0f * (float)M_PI * (vfov_deg / 360.0f);
+    const float hfov_rad = 2.0f * (float)M_PI * (hfov_deg / 360.0f);
+    const float fXToZ = tanf(hfov_rad / 2) * 2;
+    const float fYToZ = tanf(vfov_rad / 2) * 2;
+    for (uint32_t v = 0; v < height_; v++) {
+      const float fNormalizedY = 0.5f - (float)v / (float)height_;
+      for (uint32_t u = 0; u < width_; u++) {
+        const float fNormalizedX = (float)u / (float)width_ - 0.5f;
+        ray_x_[v * width_ + u] = fNormalizedX * fXToZ * DRT_DEPTH_TO_M;
+        ray_y_[v * width_ + u] = fNormalizedY * fYToZ * DRT_DEPTH_TO_M;
+      }
+    }
+  }
+
+  void DepthRayTable::initFromLookupTable(const uint32_t width,
+    const uint32_t height, const XYPoint* table) {
+    allocate(width, height);
+    for (uint32_t i = 0; i < width_ * height_; i++) {
+      ray_x_[i] = table[i].x * DRT_DEPTH_TO_M;
+      ray_y_[i] = table[i].y * DRT_DEPTH_TO_M;
+    }
+  }
+
+  void DepthRayTable::setUndistortTable(const float* lookup_table) {
+    if (lookup_table == NULL) {
+      SAFE_DELETE_ARR(undistort_src_);
+      SAFE_DELETE_ARR(depth_tmp_);
+      return;
+    }
+    if (width_ == 0) {
+      throw std::wruntime_error("DepthRayTable::setUndistortTable() - ERROR: "
+        "init the ray table first!");
+    }
+    if (undistort_src_ == NULL) {
+      undistort_src_ = new int32_t[width_ * height_];
+      depth_tmp_ = new uint16_t[width_ * height_];
+    }
+    // Same rounding and bounds as KinectInterface::undistortDepthPointwise,
+    // but done once here instead of every frame.
+    for (uint32_t i = 0; i < width_ * height_; i++) {
+      const int32_t u = static_cast<int32_t>(lookup_table[i * 2]);
+      const int32_t v = static_cast<int32_t>(lookup_table[i * 2 + 1]);
+      if (u >= 0 && u < (int32_t)width_ && v >= 0 && v < (int32_t)height_) {
+        undistort_src_[i] = v * width_ + u;
+      } else {
+        undistort_src_[i] = -1;
+      }
+    }
+  }
+
+  void DepthRayTable::setZeroDepthValue(const float val) {
+    zero_depth_val_ = val;
+  }
+
+  const uint16_t* DepthRayTable::undistort(const uint16_t* depth,
+    uint16_t* depth_out) const {
+    if (undistort_src_ == NULL) {
+      if (depth_out != NULL) {
+        memcpy(depth_out, depth, sizeof(depth_out[0]) * width_ * height_);
+      }
+      return depth;
+    }
+    uint16_t* dst = depth_out != NULL ? depth_out : depth_tmp_;
+    for (uint32_t i = 0; i < width_ * height_; i++) {
+      const int32_t isrc = undistort_src_[i];
+      dst[i] = isrc >= 0 ? depth[isrc] : 0;
+    }
+    return dst;
+  }
+
+  void DepthRayTable::convert(const uint16_t* depth, float* x, float* y,
+    float* z, uint16_t* depth_out) const {
+    const uint16_t* d = undistort(depth, depth_out);
+    const uint32_t n_pts = width_ * height_;
+    const float* ray_x = ray_x_;
+    const float* ray_y = ray_y_;
+    const float zero_val = zero_depth_val_;
+    for (uint32_t i = 0; i < n_pts; i++) {
+      const float cur_d = (float)d[i];
+      // A select rather than a branch, so the loop still vectorizes
+      x[i] = d[i] != 0 ? ray_x[i] * cur_d : zero_val;
+      y[i] = d[i] != 0 ? ray_y[i] * cur_d : zero_val;
+      z[i] = d[i] != 0 ? cur_d * DRT_DEPTH_TO_M : zero_val;
+    }
+  }
+
+  void DepthRayTable::convert(const uint16_t* depth, float* xyz,
+    uint16_t* depth_out) const {
+    const uint16_t* d = undistort(depth, depth_out);
+    const uint32_t n_pts = width_ * height_;
+    const float zero_val = zero_depth_val_;
+    for (uint32_t i = 0; i < n_pts; i++) {
+      const float cur_d = (float)d[i];
+      xyz[i * 3] = d[i] != 0 ? ray_x_[i] * cur_d : zero_val;
+      xyz[i * 3 + 1] = d[i] != 0 ? ray_y_[i] * cur_d : zero_val;
+      xyz[i * 3 + 2] = d[i] != 0 ? cur_d * DRT_DEPTH_TO_M : zero_val;
+    }
+  }
+
+  void DepthRayTable::convertPartial(const uint32_t n_pts,
+    const uint16_t* depth, float* xyz) const {
+    if (n_pts > width_ * height_) {
+      throw std::wruntime_error("DepthRayTable::convertPartial() - ERROR: "
+        "n_pts is larger than the table!");
+    }
+    const float zero_val = zero_depth_val_;
+    for (uint32_t i = 0; i < n_pts; i++) {
+      const float cur_d = (float)depth[i];
+      xyz[i * 3] = depth[i] != 0 ? ray_x_[i] * cur_d : zero_val;
+      xyz[i * 3 + 1] = depth[i] != 0 ? ray_y_[i] * cur_d : zero_val;
+      xyz[i * 3 + 2] = depth[i] != 0 ? cur_d * DRT_DEPTH_TO_M : zero_val;
+    }
+  }
+
+  void DepthRayTable::convert(const uint16_t* depth, XYZPoint* xyz,
+    uint16_t* depth_out) const {
+    // XYZPoint is 3 packed floats (KinectInterface checks this at startup)
+    convert(depth, reinterpret_cast<float*>(xyz), depth_out);
+  }
+
+};  // namespace kinect_interface
@@ -12,6 +12,7 @@ using namespace jtil::image_util;
 
 namespace kinect_interface {
 namespace hand_detector {
+
   void evaluateDecisionForest(uint8_t* label_data,
     const DecisionTree* forest, const uint32_t max_height,
     const uint32_t num_trees, const int16_t* image_data,
@@ -48,6 +49,8 @@ namespace hand_detector {
         hist[i] = 1;
 #endif
       }
+      const int32_t u = index % width;
+      const int32_t v = index / width;
       for (int32_t cur_tree = 0; cur_tree < static_cast<int32_t>(num_trees); cur_tree++) {
         DecisionTreeNode* cur_node = &forest[cur_tree].tree[0];
         uint32_t cur_height = 1;
@@ -68,8 +71,8 @@ namespace hand_detector {
             break;
           }
 
-          bool result = WL_FUNC(index, cur_node->coeff0, cur_node->coeff1, 
-            cur_node->coeff2, cur_node->wl_func, width, height, image_data);
+          bool result = WL_FUNC_UV(index, u, v, cur_node->coeff0, 
+            cur_node->coeff1, cur_node->coeff2, width, height, image_data);
 
           if (result) {
             // Go left
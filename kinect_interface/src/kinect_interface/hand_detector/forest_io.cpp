@@ -4,9 +4,17 @@
   #include <stdio.h>
   #include <strsafe.h>
   #pragma comment(lib, "User32.lib")
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
 #endif
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <map>
+#include <mutex>
 #include <stdexcept>
 #include <iostream>
 #include "kinect_interface/hand_detector/forest_io.h"
@@ -23,6 +31,10 @@ using std::runtime_error;
 
 namespace kinect_interface {
 namespace hand_detector {
+
+  static void loadForestContainer(DecisionTree*& forest, int32_t& num_trees,
+    const std::string& filename);
+
   void saveForest(DecisionTree*& forest, const int32_t num_trees, 
     const std::string& filename) {
     std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
@@ -35,7 +47,7 @@ namespace hand_detector {
       file.write(reinterpret_cast<const char*>(&forest[i].tree_height), 
         1 * sizeof(forest->tree_height));
       file.write(reinterpret_cast<const char*>(&forest[i].num_nodes), 
-        1 * sizeof(forest->tree_height));
+        1 * sizeof(forest->num_nodes));
       file.write(reinterpret_cast<const char*>(forest[i].tree), 
         forest[i].num_nodes * sizeof(forest[i].tree[0]));
     }
@@ -53,6 +65,12 @@ namespace hand_detector {
         "forget to unzip the .bin.zip file in the root directory?).");
     }
 
+    if (isForestContainer(filename)) {
+      in_file.close();
+      loadForestContainer(forest, num_trees, filename);
+      return;
+    }
+
     in_file.read(reinterpret_cast<char*>(&num_trees), 
       1 * sizeof(num_trees));
 
@@ -75,11 +93,323 @@ namespace hand_detector {
   }
 
   void releaseForest(DecisionTree*& forest, const int32_t num_trees) {
+    if (forest == NULL) {
+      return;
+    }
     for (int32_t i = 0; i < num_trees; i++) {
       SAFE_DELETE_ARR(forest[i].tree);
     }
     SAFE_DELETE_ARR(forest);
-}
+  }
+
+  static uint64_t alignForestOffset(const uint64_t offset) {
+    return ((offset + FOREST_FILE_ALIGNMENT - 1) / FOREST_FILE_ALIGNMENT) * 
+      FOREST_FILE_ALIGNMENT;
+  }
+
+  void saveForestContainer(const DecisionTree* forest, 
+    const int32_t num_trees, const std::string& filename) {
+    if (forest == NULL || num_trees <= 0) {
+      throw std::runtime_error("saveForestContainer() - forest is empty.");
+    }
+
+    // Lay the file out in memory first (so the checksum can be computed)
+    ForestFileTree* trees = new ForestFileTree[num_trees];
+    uint64_t offset = sizeof(ForestFileHeader) + 
+      num_trees * sizeof(ForestFileTree);
+    for (int32_t i = 0; i < num_trees; i++) {
+      offset = alignForestOffset(offset);
+      trees[i].node_offset = offset;
+      trees[i].num_nodes = forest[i].num_nodes;
+      trees[i].tree_height = forest[i].tree_height;
+      offset += forest[i].num_nodes * sizeof(DecisionTreeNode);
+    }
+    const uint64_t file_size = alignForestOffset(offset);
+
+    uint8_t* data = new uint8_t[static_cast<size_t>(file_size)];
+    memset(data, 0, static_cast<size_t>(file_size));  // Padding too
+    memcpy(&data[sizeof(ForestFileHeader)], trees, 
+      num_trees * sizeof(ForestFileTree));
+    for (int32_t i = 0; i < num_trees; i++) {
+      memcpy(&data[trees[i].node_offset], forest[i].tree, 
+        forest[i].num_nodes * sizeof(DecisionTreeNode));
+    }
+
+    ForestFileHeader header;
+    header.magic = FOREST_FILE_MAGIC;
+    header.endian = FOREST_FILE_ENDIAN;
+    header.version = FOREST_FILE_VERSION;
+    header.node_size = sizeof(DecisionTreeNode);
+    header.num_labels = NUM_LABELS;
+    header.num_trees = num_trees;
+    header.file_size = file_size;
+    header.checksum = forestChecksum(&data[sizeof(header)], 
+      file_size - sizeof(header));
+    memcpy(data, &header, sizeof(header));
+
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+      SAFE_DELETE_ARR(trees);
+      SAFE_DELETE_ARR(data);
+      throw std::runtime_error("saveForestContainer() error opening file.");
+    }
+    file.write(reinterpret_cast<const char*>(data), file_size);
+    file.flush();
+    file.close();
+    SAFE_DELETE_ARR(trees);
+    SAFE_DELETE_ARR(data);
+  }
+
+  bool isForestContainer(const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    uint32_t magic = 0;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    return file.good() && magic == FOREST_FILE_MAGIC;
+  }
+
+  uint64_t forestChecksum(const uint8_t* data, const uint64_t size) {
+    // Fletcher-64 with the modulo deferred: 2^16 words can't overflow sum2
+    const uint64_t modulus = 0xffffffff;
+    const uint64_t block = 1 << 16;
+    const uint64_t num_words = size / 4;
+    uint64_t sum1 = 0;
+    uint64_t sum2 = 0;
+    for (uint64_t i = 0; i < num_words; i += block) {
+      const uint64_t end = num_words - i > block ? i + block : num_words;
+      for (uint64_t j = i; j < end; j++) {
+        uint32_t word;
+        memcpy(&word, &data[j * 4], sizeof(word));
+        sum1 += word;
+        sum2 += sum1;
+      }
+      sum1 %= modulus;
+      sum2 %= modulus;
+    }
+    return (sum2 << 32) | sum1;
+  }
+
+  // checkForestContainer - Throws if the size-byte container in data is not
+  // one this build can evaluate in place.
+  static void checkForestContainer(const uint8_t* data, const uint64_t size,
+    const std::string& filename) {
+    const string err = "checkForestContainer() - " + filename + ": ";
+    if (size < sizeof(ForestFileHeader)) {
+      throw std::runtime_error(err + "file is too short.");
+    }
+    const ForestFileHeader* header = 
+      reinterpret_cast<const ForestFileHeader*>(data);
+    if (header->magic != FOREST_FILE_MAGIC) {
+      throw std::runtime_error(err + "not a forest container.");
+    }
+    if (header->endian != FOREST_FILE_ENDIAN) {
+      throw std::runtime_error(err + "written with a different byte order.");
+    }
+    if (header->version != FOREST_FILE_VERSION) {
+      throw std::runtime_error(err + "unsupported version.");
+    }
+    if (header->node_size != sizeof(DecisionTreeNode) || 
+        header->num_labels != NUM_LABELS) {
+      throw std::runtime_error(err + "DecisionTreeNode layout doesn't match "
+        "this build.");
+    }
+    if (header->file_size != size || size % 4 != 0 || 
+        header->num_trees <= 0 || sizeof(ForestFileHeader) + 
+        header->num_trees * sizeof(ForestFileTree) > size) {
+      throw std::runtime_error(err + "file is truncated or corrupt.");
+    }
+    if (forestChecksum(&data[sizeof(ForestFileHeader)], 
+        size - sizeof(ForestFileHeader)) != header->checksum) {
+      throw std::runtime_error(err + "checksum mismatch.");
+    }
+    const ForestFileTree* trees = reinterpret_cast<const ForestFileTree*>(
+      &data[sizeof(ForestFileHeader)]);
+    for (int32_t i = 0; i < header->num_trees; i++) {
+      if (trees[i].node_offset % FOREST_FILE_ALIGNMENT != 0 ||
+          trees[i].node_offset > size || trees[i].num_nodes > 
+          (size - trees[i].node_offset) / sizeof(DecisionTreeNode)) {
+        throw std::runtime_error(err + "tree table is corrupt.");
+      }
+    }
+  }
+
+  // makeForestFromContainer - DecisionTree array whose nodes point into data
+  static DecisionTree* makeForestFromContainer(const uint8_t* data) {
+    const ForestFileHeader* header = 
+      reinterpret_cast<const ForestFileHeader*>(data);
+    const ForestFileTree* trees = reinterpret_cast<const ForestFileTree*>(
+      &data[sizeof(ForestFileHeader)]);
+    DecisionTree* forest = new DecisionTree[header->num_trees];
+    for (int32_t i = 0; i < header->num_trees; i++) {
+      forest[i].tree = reinterpret_cast<DecisionTreeNode*>(
+        const_cast<uint8_t*>(&data[trees[i].node_offset]));
+      forest[i].num_nodes = trees[i].num_nodes;
+      forest[i].tree_height = trees[i].tree_height;
+    }
+    return forest;
+  }
+
+  static void loadForestContainer(DecisionTree*& forest, int32_t& num_trees,
+    const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error("loadForestContainer() error opening file.");
+    }
+    file.seekg(0, std::ios::end);
+    const uint64_t size = static_cast<uint64_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+    uint8_t* data = new uint8_t[static_cast<size_t>(size)];
+    file.read(reinterpret_cast<char*>(data), size);
+    file.close();
+    try {
+      checkForestContainer(data, size, filename);
+    } catch (std::runtime_error e) {
+      SAFE_DELETE_ARR(data);
+      throw;
+    }
+
+    // Copy the nodes out so the result can be freed with releaseForest()
+    DecisionTree* mapped = makeForestFromContainer(data);
+    num_trees = reinterpret_cast<const ForestFileHeader*>(data)->num_trees;
+    forest = new DecisionTree[num_trees];
+    for (int32_t i = 0; i < num_trees; i++) {
+      forest[i].num_nodes = mapped[i].num_nodes;
+      forest[i].tree_height = mapped[i].tree_height;
+      forest[i].tree = new DecisionTreeNode[forest[i].num_nodes];
+      memcpy(forest[i].tree, mapped[i].tree, 
+        forest[i].num_nodes * sizeof(DecisionTreeNode));
+    }
+    SAFE_DELETE_ARR(mapped);
+    SAFE_DELETE_ARR(data);
+  }
+
+  // The SharedForest registry (one entry per filename)
+  static std::mutex shared_forests_lock_;
+  static std::map<string, SharedForest*> shared_forests_;
+
+  SharedForest* SharedForest::acquire(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(shared_forests_lock_);
+    std::map<string, SharedForest*>::iterator it = 
+      shared_forests_.find(filename);
+    if (it != shared_forests_.end()) {
+      it->second->ref_count_++;
+      return it->second;
+    }
+    // Loaded while holding the lock, so that a second caller waits for this
+    // one rather than loading the same file again.
+    SharedForest* shared = new SharedForest(filename);
+    try {
+      if (isForestContainer(filename)) {
+        shared->map();
+      } else {
+        loadForest(shared->forest_, shared->num_trees_, filename);
+      }
+    } catch (std::runtime_error e) {
+      SAFE_DELETE(shared);
+      throw;
+    }
+    shared->ref_count_ = 1;
+    shared_forests_[filename] = shared;
+    return shared;
+  }
+
+  void SharedForest::release(SharedForest*& forest) {
+    if (forest == NULL) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(shared_forests_lock_);
+    forest->ref_count_--;
+    if (forest->ref_count_ == 0) {
+      shared_forests_.erase(forest->filename_);
+      delete forest;
+    }
+    forest = NULL;
+  }
+
+  SharedForest::SharedForest(const std::string& filename) : 
+    filename_(filename) {
+    forest_ = NULL;
+    num_trees_ = 0;
+    mapping_ = NULL;
+    mapping_size_ = 0;
+    ref_count_ = 0;
+  }
+
+  SharedForest::~SharedForest() {
+    if (mapping_ != NULL) {
+      SAFE_DELETE_ARR(forest_);  // The nodes belong to the mapping
+      unmap();
+    } else {
+      releaseForest(forest_, num_trees_);
+    }
+  }
+
+  void SharedForest::map() {
+    const string err = "SharedForest::map() - " + filename_ + ": ";
+#if defined(WIN32) || defined(_WIN32)
+    HANDLE file = CreateFileA(filename_.c_str(), GENERIC_READ, 
+      FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+      throw std::runtime_error(err + "error opening file.");
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+      CloseHandle(file);
+      throw std::runtime_error(err + "error reading file size.");
+    }
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);  // The mapping keeps the file open
+    if (mapping == NULL) {
+      throw std::runtime_error(err + "CreateFileMapping failed.");
+    }
+    mapping_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);  // The view keeps the mapping alive
+    if (mapping_ == NULL) {
+      throw std::runtime_error(err + "MapViewOfFile failed.");
+    }
+    mapping_size_ = static_cast<uint64_t>(size.QuadPart);
+#else
+    int fd = open(filename_.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error(err + "error opening file.");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      close(fd);
+      throw std::runtime_error(err + "error reading file size.");
+    }
+    void* mapping = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, 
+      MAP_SHARED, fd, 0);
+    close(fd);  // The mapping keeps the file open
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error(err + "mmap failed.");
+    }
+    mapping_ = mapping;
+    mapping_size_ = static_cast<uint64_t>(st.st_size);
+#endif
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(mapping_);
+    try {
+      checkForestContainer(data, mapping_size_, filename_);
+    } catch (std::runtime_error e) {
+      unmap();
+      throw;
+    }
+    forest_ = makeForestFromContainer(data);
+    num_trees_ = reinterpret_cast<const ForestFileHeader*>(data)->num_trees;
+  }
+
+  void SharedForest::unmap() {
+    if (mapping_ == NULL) {
+      return;
+    }
+#if defined(WIN32) || defined(_WIN32)
+    UnmapViewOfFile(mapping_);
+#else
+    munmap(mapping_, static_cast<size_t>(mapping_size_));
+#endif
+    mapping_ = NULL;
+    mapping_size_ = 0;
+  }
 
 };  // namespace hand_detector
 };  // namespace kinect_interface
@@ -0,0 +1,203 @@
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include "kinect_interface/hand_detector/hand_blob_labeler.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+using jtil::data_str::Vector;
+
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  HandBlobLabeler::HandBlobLabeler() {
+    width_ = 0;
+    height_ = 0;
+    num_bands_ = 0;
+    max_runs_per_row_ = 0;
+    labels_ = NULL;
+    labels_hand_ = NULL;
+    depth_ = NULL;
+    runs_ = NULL;
+    parent_ = NULL;
+    run_blob_ = NULL;
+    row_run_start_ = NULL;
+    row_run_end_ = NULL;
+    band_start_row_ = NULL;
+  }
+
+  HandBlobLabeler::~HandBlobLabeler() {
+    SAFE_DELETE_ARR(runs_);
+    SAFE_DELETE_ARR(parent_);
+    SAFE_DELETE_ARR(run_blob_);
+    SAFE_DELETE_ARR(row_run_start_);
+    SAFE_DELETE_ARR(row_run_end_);
+    SAFE_DELETE_ARR(band_start_row_);
+  }
+
+  void HandBlobLabeler::init(const int32_t width, const int32_t height,
+    const int32_t num_bands) {
+    if (width <= 0 || height <= 0 || num_bands <= 0) {
+      throw std::wruntime_error("HandBlobLabeler::init() - ERROR: width, "
+        "height and num_bands must be positive!");
+    }
+    width_ = width;
+    height_ = height;
+    num_bands_ = std::min<int32_t>(num_bands, height);
+    // A row of width w can hold at most ceil(w/2) separate runs
+    max_runs_per_row_ = (width_ + 1) / 2;
+
+    const uint32_t max_runs = max_runs_per_row_ * height_;
+    runs_ = new Run[max_runs];
+    parent_ = new uint32_t[max_runs];
+    run_blob_ = new uint32_t[max_runs];
+    row_run_start_ = new uint32_t[height_];
+    row_run_end_ = new uint32_t[height_];
+    band_start_row_ = new int32_t[num_bands_ + 1];
+
+    // Split the rows as evenly as possible
+    for (int32_t b = 0; b <= num_bands_; b++) {
+      band_start_row_[b] = (b * height_) / num_bands_;
+    }
+    blobs_.capacity(max_runs_per_row_);
+  }
+
+  void HandBlobLabeler::setInputs(const uint8_t* labels,
+    const uint8_t* labels_hand, const int16_t* depth) {
+    labels_ = labels;
+    labels_hand_ = labels_hand;
+    depth_ = depth;
+  }
+
+  void HandBlobLabeler::label(const uint8_t* labels,
+    const uint8_t* labels_hand, const int16_t* depth) {
+    setInputs(labels, labels_hand, depth);
+    for (int32_t b = 0; b < num_bands_; b++) {
+      labelBand(b);
+    }
+    mergeBands();
+  }
+
+  void HandBlobLabeler::labelBand(const int32_t band) {
+    const int32_t v_start = band_start_row_[band];
+    const int32_t v_end = band_start_row_[band + 1];
+    uint32_t cur_run = v_start * max_runs_per_row_;
+
+    for (int32_t v = v_start; v < v_end; v++) {
+      const uint8_t* label_row = &labels_[v * width_];
+      const uint8_t* hand_row = &labels_hand_[v * width_];
+      const int16_t* depth_row = &depth_[v * width_];
+      row_run_start_[v] = cur_run;
+
+      int32_t u = 0;
+      while (u < width_) {
+        if (label_row[u] != 1) {
+          u++;
+          continue;
+        }
+        // Start of a new run: walk to its end accumulating the statistics
+        Run& run = runs_[cur_run];
+        run.v = v;
+        run.u_start = u;
+        run.stats.n_hand_pts = 0;
+        run.stats.depth_sum = 0;
+        run.stats.u_sum = 0;
+        for (; u < width_ && label_row[u] == 1; u++) {
+          run.stats.u_sum += u;
+          if (hand_row[u] == 1) {
+            run.stats.depth_sum += (int32_t)depth_row[u];
+            run.stats.n_hand_pts++;
+          }
+        }
+        run.u_end = u - 1;
+        run.stats.n_pts = (uint32_t)(u - run.u_start);
+        run.stats.v_sum = (int32_t)run.stats.n_pts * v;
+        parent_[cur_run] = cur_run;
+        cur_run++;
+      }
+      row_run_end_[v] = cur_run;
+
+      if (v > v_start) {
+        unionRows(v - 1, v);
+      }
+    }
+  }
+
+  void HandBlobLabeler::mergeBands() {
+    // Join runs that touch across the band boundaries
+    for (int32_t b = 1; b < num_bands_; b++) {
+      const int32_t v = band_start_row_[b];
+      unionRows(v - 1, v);
+    }
+
+    // Reduce the per-run statistics into blobs.  The root of each set is its
+    // smallest run index, so it is always visited before the other runs in
+    // its set and blobs come out in raster order.
+    blobs_.resize(0);
+    for (int32_t v = 0; v < height_; v++) {
+      for (uint32_t i = row_run_start_[v]; i < row_run_end_[v]; i++) {
+        const uint32_t root = findRoot(i);
+        const HandBlob& src = runs_[i].stats;
+        if (root == i) {
+          run_blob_[i] = blobs_.size();
+          blobs_.pushBack(src);
+        } else {
+          HandBlob& dst = blobs_[run_blob_[root]];
+          dst.n_pts += src.n_pts;
+          dst.n_hand_pts += src.n_hand_pts;
+          dst.u_sum += src.u_sum;
+          dst.v_sum += src.v_sum;
+          dst.depth_sum += src.depth_sum;
+        }
+      }
+    }
+  }
+
+  uint32_t HandBlobLabeler::findRoot(uint32_t run) {
+    uint32_t root = run;
+    while (parent_[root] != root) {
+      root = parent_[root];
+    }
+    // Path compression
+    while (parent_[run] != root) {
+      const uint32_t next = parent_[run];
+      parent_[run] = root;
+      run = next;
+    }
+    return root;
+  }
+
+  void HandBlobLabeler::unionRuns(const uint32_t a, const uint32_t b) {
+    const uint32_t root_a = findRoot(a);
+    const uint32_t root_b = findRoot(b);
+    if (root_a < root_b) {
+      parent_[root_b] = root_a;
+    } else if (root_b < root_a) {
+      parent_[root_a] = root_b;
+    }
+  }
+
+  void HandBlobLabeler::unionRows(const int32_t v_above, const int32_t v) {
+    uint32_t i = row_run_start_[v_above];
+    uint32_t j = row_run_start_[v];
+    const uint32_t i_end = row_run_end_[v_above];
+    const uint32_t j_end = row_run_end_[v];
+    while (i < i_end && j < j_end) {
+      const Run& above = runs_[i];
+      const Run& cur = runs_[j];
+      // 8-connected: diagonal neighbours also touch
+      if (above.u_start <= cur.u_end + 1 && cur.u_start <= above.u_end + 1) {
+        unionRuns(i, j);
+      }
+      // Advance whichever run finishes first; it can't touch any later run
+      if (above.u_end < cur.u_end) {
+        i++;
+      } else {
+        j++;
+      }
+    }
+  }
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
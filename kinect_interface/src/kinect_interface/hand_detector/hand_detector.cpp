@@ -6,9 +6,13 @@
 #include "kinect_interface/hand_detector/forest_io.h"
 #include "kinect_interface/hand_detector/decision_tree_structs.h"
 #include "kinect_interface/hand_detector/evaluate_decision_forest.h"
+#include "kinect_interface/hand_detector/hand_blob_labeler.h"
+#include "kinect_interface/hand_detector/hand_tracker.h"
+#include "kinect_interface/hand_detector/label_filter.h"
+#include "kinect_interface/task_scheduler.h"
+#include "kinect_interface/trace.h"
 #include "jtil/image_util/image_util.h"
 #include "jtil/file_io/file_io.h"
-#include "jtil/threading/thread_pool.h"
 #include "jtorch/jtorch.h"
 #include "jtil/data_str/vector_managed.h"
 
@@ -38,12 +42,13 @@ namespace hand_detector {
      {-o_r, -o_r}, {-o_r, 0}, {-o_r, +o_r}, {0, +o_r}, {+o_r, +o_r}, {+o_r, 0},
      {+o_r, -o_r}, {0, -o_r}};
 
-  HandDetector::HandDetector(ThreadPool* tp) {
+  HandDetector::HandDetector(TaskScheduler* ts) {
     stage2_med_filter_radius_ = HD_STARTING_MED_FILT_RAD;
     stage3_grow_filter_radius_ = HD_STARTING_GROW_FILT_RAD;
     stage1_shrink_filter_radius_ = HD_STARTING_SHRINK_FILT_RAD;
     num_trees_to_evaluate_ = HD_STARTING_NUM_TREES_TO_EVALUATE;
     max_height_to_evaluate_ = HD_STARTING_MAX_TREE_HEIGHT_TO_EVALUATE;
+    roi_tracking_ = HD_STARTING_ROI_TRACKING;
 
     src_width_ = 0;
     src_height_ = 0;
@@ -57,29 +62,69 @@ namespace hand_detector {
     depth_downsampled_ = NULL;
     pixel_queue_ = NULL;
     pixel_on_queue_ = NULL;
+    blob_labeler_ = NULL;
+    label_filter_down_ = NULL;
+    label_filter_src_ = NULL;
+    cur_label_filter_ = NULL;
+    tracker_ = NULL;
+    roi_ = NULL;
 
     forest_ = NULL;
+    shared_forest_ = NULL;
     num_trees_ = 0;
 
-    tp_ = tp;
+    ts_ = ts;
     thread_cbs_ = NULL;
+    blob_cbs_ = NULL;
+    label_filter_row_cbs_ = NULL;
+    label_filter_col_cbs_ = NULL;
   }
 
   HandDetector::~HandDetector() {
-    releaseForest(forest_, num_trees_);
+    SharedForest::release(shared_forest_);
     SAFE_DELETE_ARR(labels_evaluated_);
     SAFE_DELETE_ARR(labels_filtered_);
     SAFE_DELETE_ARR(labels_temp_);
     SAFE_DELETE_ARR(labels_temp2_);
     SAFE_DELETE_ARR(depth_downsampled_);
     SAFE_DELETE(thread_cbs_);
-    SAFE_DELETE_ARR(thread_cbs_);
+    SAFE_DELETE(blob_cbs_);
+    SAFE_DELETE(label_filter_row_cbs_);
+    SAFE_DELETE(label_filter_col_cbs_);
     SAFE_DELETE_ARR(pixel_on_queue_);
     SAFE_DELETE_ARR(pixel_queue_);
+    SAFE_DELETE(blob_labeler_);
+    SAFE_DELETE(label_filter_down_);
+    SAFE_DELETE(label_filter_src_);
+    SAFE_DELETE(tracker_);
+    SAFE_DELETE(roi_);
   }
 
   void HandDetector::init(const uint32_t im_width, const uint32_t im_height,
       const std::string filename) {
+    shared_forest_ = SharedForest::acquire(filename);
+    forest_ = shared_forest_->forest();
+    num_trees_ = shared_forest_->num_trees();
+    std::cout << "HandDetector() - Decision Forest: " << filename;
+    std::cout << (shared_forest_->mapped() ? " mapped" : " loaded");
+    std::cout << std::endl;
+    initBuffers(im_width, im_height);
+  }
+
+  void HandDetector::init(const uint32_t im_width, const uint32_t im_height,
+    DecisionTree* forest, const int32_t num_trees) {
+    if (forest == NULL || num_trees <= 0) {
+      throw std::wruntime_error("HandDetector::init() - ERROR: forest is "
+        "empty!");
+    }
+    forest_ = forest;
+    shared_forest_ = NULL;
+    num_trees_ = num_trees;
+    initBuffers(im_width, im_height);
+  }
+
+  void HandDetector::initBuffers(const uint32_t im_width, 
+    const uint32_t im_height) {
     if (im_width % DT_DOWNSAMPLE != 0 || im_height % DT_DOWNSAMPLE != 0) {
       throw runtime_error(string("HandDetector() - ERROR: downsample factor") +
         string(" is not an integer multiple!"));
@@ -98,9 +143,11 @@ namespace hand_detector {
     pixel_queue_ = new uint32_t[src_width_ * src_height_];
     pixel_on_queue_ = new uint8_t[src_width_ * src_height_];
 
-    loadForest(forest_, num_trees_, filename);
-    std::cout << "HandDetector() - Decision Forest: " << filename << " loaded";
-    std::cout << std::endl;
+    tracker_ = new HandTracker();
+    tracker_->init(src_width_, src_height_, DT_DOWNSAMPLE, depth_hfov_fit,
+      depth_vfov_fit);
+    roi_ = new HandROI();
+    tracker_->fullROI(*roi_);
 
     num_trees_to_evaluate_ = num_trees_ < num_trees_to_evaluate_ ? num_trees_ 
                              : num_trees_to_evaluate_;
@@ -114,73 +161,76 @@ namespace hand_detector {
     max_height_to_evaluate_ = max_height_ < max_height_to_evaluate_ ? max_height_ 
                              : max_height_to_evaluate_;
 
-    const int num_threads = tp_->num_workers();
+    const int num_threads = ts_ != NULL ? ts_->num_threads() : 1;
     thread_cbs_ = new VectorManaged<Callback<void>*>(num_threads);
 
-    // Figure out the load balance accross worker threads.  This thread will act
-    // as a worker thread as well.
-    uint32_t n_pixels = down_width_*down_height_;
-    uint32_t n_pixels_per_thread = 1 + n_pixels / num_threads;
+    // The rows of roi_ are split accross the worker threads each frame (see
+    // evaluateForestBand).  This thread will act as a worker thread as well
+    // (it helps while it waits on the scheduler).
+    for (int32_t i = 0; i < num_threads; i++) {
+      thread_cbs_->pushBack(MakeCallableMany(&HandDetector::evaluateForestBand, 
+        this, i));
+    }
+
+    // The blob labeler splits the downsampled image into one horizontal band
+    // per worker thread
+    blob_labeler_ = new HandBlobLabeler();
+    blob_labeler_->init(down_width_, down_height_, num_threads);
+    blob_cbs_ = new VectorManaged<Callback<void>*>(blob_labeler_->num_bands());
+    for (int32_t i = 0; i < blob_labeler_->num_bands(); i++) {
+      blob_cbs_->pushBack(MakeCallableMany(&HandDetector::labelBlobsBand, 
+        this, i));
+    }
+
+    // The label filters are split the same way, with one set of callbacks
+    // per pass.
+    label_filter_down_ = new LabelFilter();
+    label_filter_down_->init(down_width_, down_height_, num_threads, 
+      HD_MAX_EXTREMUM_FILT_RAD);
+    label_filter_src_ = new LabelFilter();
+    label_filter_src_->init(src_width_, src_height_, num_threads, 
+      HD_MAX_EXTREMUM_FILT_RAD);
+    label_filter_row_cbs_ = new VectorManaged<Callback<void>*>(num_threads);
+    label_filter_col_cbs_ = new VectorManaged<Callback<void>*>(num_threads);
     for (int32_t i = 0; i < num_threads; i++) {
-      uint32_t start = i * n_pixels_per_thread;
-      uint32_t end = std::min<uint32_t>(((i + 1) * n_pixels_per_thread) - 1,
-        n_pixels - 1);
-      thread_cbs_->pushBack(MakeCallableMany(&HandDetector::evaluateForestPixelRange, 
-        this, start, end));
+      label_filter_row_cbs_->pushBack(MakeCallableMany(
+        &HandDetector::labelFilterRowsBand, this, i));
+      label_filter_col_cbs_->pushBack(MakeCallableMany(
+        &HandDetector::labelFilterColsBand, this, i));
     }
   }
 
   bool HandDetector::findHandLabels(const int16_t* depth_in, const float* xyz, 
     const HDLabelMethod method, uint8_t* label_out) {
     const int32_t disc_filt_rad = 2;
-    int16_t cur_depth_min;
-    int16_t cur_depth_max;
-    uint32_t index = 0;
     switch (method) {
     case HDUpconvert:
       createLabels(depth_in);
       UpsampleNoFiltering<uint8_t>(labels_temp_, labels_evaluated_, 
         down_width_, down_height_, DT_DOWNSAMPLE);
-      ShrinkFilter<uint8_t>(labels_filtered_, labels_temp_,
-        src_width_, src_height_, 2);
-      for (int32_t v = 0; v < (int32_t)src_height_; v++) {
-        for (int32_t u = 0; u < (int32_t)src_width_; u++) {
-          cur_depth_min = max_depth;
-          cur_depth_max = 0;
-          if (labels_filtered_[index] == 1 && depth_in[index] > 0 || 
-            depth_in[index] < max_depth) {
-            for (int32_t v_off = v - disc_filt_rad; v_off <= v + disc_filt_rad; v_off++) {
-              for (int32_t u_off = u - disc_filt_rad; u_off <= u + disc_filt_rad; u_off++) {   
-                int32_t ioff = v_off * src_width_ + u_off;
-                if (depth_in[ioff] <= 0 || depth_in[ioff] >= max_depth) {
-                    cur_depth_max = max_depth;
-                    cur_depth_min = 0;
-                } else {
-                  cur_depth_max = std::max<int16_t>(cur_depth_max, depth_in[ioff]);
-                  cur_depth_min = std::min<int16_t>(cur_depth_min, depth_in[ioff]);        
-                }
-              }
-            }
-            if ((cur_depth_max - cur_depth_min) > 2 * HD_DISCONT_FILT_DEPTH_THRESH) {
-              labels_filtered_[index] = 0;
-            }
-          } else {
-            labels_filtered_[index] = 0;
-          }
-          index++;
-        }
-      }
-
-
-      GrowFilterDepthThreshold(label_out, labels_filtered_, depth_in,
-        src_width_, src_height_, 4);
+      runLabelFilter(src_width_, src_height_, LFShrink, labels_filtered_, 
+        labels_temp_, NULL, 2);
+      // Remove labels near depth discontinuities (or invalid depth)
+      runLabelFilter(src_width_, src_height_, LFDepthDiscontinuity, 
+        labels_filtered_, labels_filtered_, depth_in, disc_filt_rad,
+        2 * HD_DISCONT_FILT_DEPTH_THRESH);
+      runLabelFilter(src_width_, src_height_, LFGrowDepthThreshold, label_out,
+        labels_filtered_, depth_in, HD_UPCONVERT_GROW_FILT_RAD, 
+        HD_BACKGROUND_THRESH_GROW);
       return true;
 
-    case HDFloodfill:
-      // Find the center hand point
+    case HDFloodfill: {
+      // Find the center hand point (only around the predicted hand if we
+      // are tracking it)
       bool hand_found;
       float hand_uvd[3];
-      findHand(depth_in, hand_found, hand_uvd);
+      HandROI roi;
+      const bool use_roi = roi_tracking_ && tracker_->predictROI(roi);
+      findHand(depth_in, hand_found, hand_uvd, use_roi ? &roi : NULL);
+      if (roi_tracking_) {
+        tracker_->update(hand_found, hand_uvd, !use_roi);
+      }
+
       if (!hand_found) { 
         return false;
       }
@@ -188,8 +238,8 @@ namespace hand_detector {
       // Now start a flood fill from this point
       memset(label_out, 0, sizeof(label_out[0]) * src_width_ * src_height_);
       findHandLabelsFloodFill(hand_uvd, xyz, label_out);
-
       return true;
+    }
     default:
       throw std::wruntime_error("HandDetector::findHandLabels() - ERROR: "
         "Unsupported labeling method!");
@@ -213,8 +263,8 @@ namespace hand_detector {
   }
 
   void HandDetector::findHand(const int16_t* depth_data, bool& hand_found,
-    float* hand_uvd) {
-    createLabels(depth_data);
+    float* hand_uvd, const HandROI* roi) {
+    createLabels(depth_data, roi);
     // Copy labels labels_evaluated_ since the filter methods may destroy
     // the source image.
     memcpy(labels_temp_, labels_evaluated_, down_width_*down_height_*
@@ -227,7 +277,8 @@ namespace hand_detector {
     floodFillLabelData(&hand_found, hand_uvd, NULL, NULL);
   }
 
-  void HandDetector::evaluateForest(const int16_t* depth_data) {
+  void HandDetector::evaluateForest(const int16_t* depth_data, 
+    const HandROI* roi) {
     depth_ = depth_data;
     // Downsample the input image
     if (DT_DOWNSAMPLE > 1) {
@@ -255,112 +306,116 @@ namespace hand_detector {
     //evaluateDecisionForest(labels_evaluated_, forest_, max_height_to_evaluate_, 
     //  num_trees_to_evaluate_, depth_downsampled_, down_width_, down_height_);
     // Multi threaded
+    if (roi != NULL) {
+      *roi_ = *roi;
+    } else {
+      tracker_->fullROI(*roi_);
+    }
+    // Rows outside the ROI are background (the bands clear the columns)
+    memset(labels_evaluated_, 0, roi_->v_min * down_width_ * 
+      sizeof(labels_evaluated_[0]));
+    memset(&labels_evaluated_[(roi_->v_max + 1) * down_width_], 0, 
+      (down_height_ - 1 - roi_->v_max) * down_width_ * 
+      sizeof(labels_evaluated_[0]));
     evaluateForestMultithreaded();
   }
 
-  void HandDetector::createLabels(const int16_t* depth_data) {
-    evaluateForest(depth_data);
+  void HandDetector::createLabels(const int16_t* depth_data, 
+    const HandROI* roi) {
+    TRACE_SCOPE(TRACE_FOREST_EVAL);
+    evaluateForest(depth_data, roi);
   }
 
   void HandDetector::filterLabels(uint8_t*& dst, uint8_t*& src, uint8_t*& tmp,
     int16_t* depth, const int32_t w, const int32_t h) {
-    ShrinkFilter<uint8_t>(tmp, src, w, h, 
+    TRACE_SCOPE(TRACE_LABEL_FILTER);
+    runLabelFilter(w, h, LFShrink, tmp, src, NULL, 
       stage1_shrink_filter_radius_);
-    MedianLabelFilter<uint8_t, int16_t>(dst, tmp, depth, w, h, 
-      stage2_med_filter_radius_, NUM_LABELS, max_depth);
-    GrowFilter<uint8_t>(tmp, dst, w, h, stage3_grow_filter_radius_);
-    // Now swap the buffers
-    uint8_t* tmp_local = tmp;
-    tmp = dst;
-    dst = tmp_local;
+    runLabelFilter(w, h, LFMedian, dst, tmp, depth, 
+      stage2_med_filter_radius_);
+    runLabelFilter(w, h, LFGrow, dst, dst, NULL, stage3_grow_filter_radius_);
   }
 
   void HandDetector::filterLabelsThreshold(uint8_t*& dst, uint8_t*& src, 
     uint8_t*& tmp, int16_t* depth, const int32_t w, const int32_t h) {
-    memcpy(tmp, src, w * h * sizeof(tmp[0]));
-    GrowFilterDepthThreshold(dst, tmp, depth, w, h, 
-      stage3_grow_filter_radius_);
+    TRACE_SCOPE(TRACE_LABEL_FILTER);
+    runLabelFilter(w, h, LFGrowDepthThreshold, dst, src, depth,
+      stage3_grow_filter_radius_, HD_BACKGROUND_THRESH_GROW);
   }
 
-
-  void HandDetector::GrowFilterDepthThreshold(uint8_t* labels_dst, 
-    uint8_t* labels_src, const int16_t* depth, const int32_t w, 
-    const int32_t h, const int32_t rad) {
-    memcpy(labels_dst, labels_src, w * h * sizeof(labels_dst[0]));
-    // Grow horizontally
-    int32_t index = 0;
-    for (int32_t v = 0; v < h; v++) {
-      for (int32_t u = 0; u < w; u++) {
-        if (labels_dst[index] == 1) {
-          int16_t cur_depth = depth[index];
-          for (int32_t u_offset = std::max<int32_t>(u - rad, 0); 
-            u_offset <= u + rad && u_offset < w; u_offset++) {
-            int32_t offset = v * w + u_offset;
-            int16_t delta_depth = cur_depth - depth[offset];
-            if (delta_depth < 0) {
-              delta_depth = -delta_depth; 
-            }
-            if (delta_depth < HD_BACKGROUND_THRESH_GROW) {
-              labels_src[offset] = 1;
-            }
-          }
-        }
-        index++;
-      }
+  void HandDetector::runLabelFilter(const int32_t w, const int32_t h, 
+    const int type, uint8_t* dst, const uint8_t* src, const int16_t* depth, 
+    const int32_t rad, const int32_t depth_thresh) {
+    if (w == down_width_ && h == down_height_) {
+      cur_label_filter_ = label_filter_down_;
+    } else if (w == src_width_ && h == src_height_) {
+      cur_label_filter_ = label_filter_src_;
+    } else {
+      throw std::wruntime_error("HandDetector::runLabelFilter() - ERROR: "
+        "Unsupported image size!");
     }
-    // Grow vertically
-    index = 0;
-    for (int32_t v = 0; v < h; v++) {
-      for (int32_t u = 0; u < w; u++) {
-        if (labels_src[index] == 1) {
-          int16_t cur_depth = depth[index];
-          for (int32_t v_offset = std::max<int32_t>(v - rad, 0); 
-            v_offset <= v + rad && v_offset < h; v_offset++) {
-            int32_t offset = v_offset * w + u;
-            int16_t delta_depth = cur_depth - depth[offset];
-            if (delta_depth < 0) {
-              delta_depth = -delta_depth; 
-            }
-            if (delta_depth < HD_BACKGROUND_THRESH_GROW) {
-              labels_dst[offset] = 1;
-            }
-          }
-        }
-        index++;
-      }
+    cur_label_filter_->setFilter((LabelFilterType)type, dst, src, depth, rad,
+      depth_thresh);
+    if (ts_ == NULL) {
+      runTasks(NULL, label_filter_row_cbs_);
+      runTasks(NULL, label_filter_col_cbs_);
+      return;
     }
-  };
+    // Every row band must finish before any column band starts, but the
+    // column bands are queued as soon as that happens (no barrier here)
+    TaskGroup rows;
+    TaskGroup cols;
+    ts_->addTasks(label_filter_row_cbs_, rows);
+    ts_->addTasks(label_filter_col_cbs_, cols, &rows);
+    ts_->wait(cols);
+  }
 
   void HandDetector::evaluateForestMultithreaded() {
-    threads_finished_ = 0;
-    for (uint32_t i = 0; i < thread_cbs_->size(); i++) {
-      tp_->addTask((*thread_cbs_)[i]);
-    }
+    runTasks(ts_, thread_cbs_);
+  }
 
-    // Wait until the other threads are done
-    std::unique_lock<std::mutex> ul(thread_update_lock_);  // Get lock
-    while (threads_finished_ != thread_cbs_->size()) {
-      not_finished_.wait(ul);
+  // Threads past the last row of roi_ get an empty range
+  void HandDetector::evaluateForestBand(const int32_t band) {
+    const int32_t num_bands = (int32_t)thread_cbs_->size();
+    const int32_t n_rows = roi_->v_max - roi_->v_min + 1;
+    const int32_t n_rows_per_band = 1 + n_rows / num_bands;
+    const int32_t vstart = roi_->v_min + band * n_rows_per_band;
+    const int32_t vend = std::min<int32_t>(vstart + n_rows_per_band - 1, 
+      roi_->v_max);
+    const int32_t ustart = roi_->u_min;
+    const int32_t uend = roi_->u_max;
+    for (int32_t v = vstart; v <= vend; v++) {
+      uint8_t* label_row = &labels_evaluated_[v * down_width_];
+      memset(label_row, 0, ustart * sizeof(label_row[0]));
+      memset(&label_row[uend + 1], 0, 
+        (down_width_ - 1 - uend) * sizeof(label_row[0]));
+      for (int32_t u = ustart; u <= uend; u++) {
+        hand_detector::evaluateDecisionForestPixel(labels_evaluated_, forest_,
+          max_height_to_evaluate_, num_trees_to_evaluate_, depth_downsampled_, 
+          down_width_, down_height_, v * down_width_ + u);
+      }
     }
-    ul.unlock();  // Release lock
   }
 
-  void HandDetector::evaluateForestPixelRange(const uint32_t istart, 
-    const uint32_t iend) {
-    for (uint32_t i = istart; i <= iend; i++) {
-      evaluateForestPixel(i);
+  void HandDetector::labelBlobsBand(const int32_t band) {
+    blob_labeler_->labelBand(band);
+  }
+
+  // Images with fewer rows than threads have fewer bands
+  void HandDetector::labelFilterRowsBand(const int32_t band) {
+    if (band < cur_label_filter_->num_bands()) {
+      cur_label_filter_->filterRowsBand(band);
     }
+  }
 
-    std::unique_lock<std::mutex> ul(thread_update_lock_);
-    threads_finished_++;
-    not_finished_.notify_all();  // Signify that all threads might have finished
-    ul.unlock();
+  void HandDetector::labelFilterColsBand(const int32_t band) {
+    if (band < cur_label_filter_->num_bands()) {
+      cur_label_filter_->filterColsBand(band);
+    }
   }
 
-  void HandDetector::evaluateForestPixel(const uint32_t index) {
-    hand_detector::evaluateDecisionForestPixel(labels_evaluated_, forest_,
-      max_height_to_evaluate_, num_trees_to_evaluate_, depth_downsampled_, 
-      down_width_, down_height_, index);
+  Vector<HandBlob>& HandDetector::hand_blobs() {
+    return blob_labeler_->blobs();
   }
 
   void HandDetector::reset() {
@@ -368,77 +423,37 @@ namespace hand_detector {
     //hands_uv_max_.resize(0);
     hands_n_pts_.resize(0);
     hands_uvd_.resize(0);
+    if (tracker_ != NULL) {
+      tracker_->reset();
+    }
   }
 
   void HandDetector::floodFillLabelData(bool* rhand_found, float* rhand_uvd, 
     bool* lhand_found, float* lhand_uvd) {
+    TRACE_SCOPE(TRACE_FLOOD_FILL);
     // re-use the labels_evaluated data instead of allocating more
     //hands_uv_min_.resize(0);
     //hands_uv_max_.resize(0);
     hands_n_pts_.resize(0);
     hands_uvd_.resize(0);
 
-    memset(pixel_on_queue_, 0, down_width_ * down_height_ * 
-      sizeof(pixel_on_queue_[0]));
-    queue_head_ = 0;
-    queue_tail_ = 0; // When queue_head_ == queue_tail_ the queue is empty
-    for (int v = 0; v < static_cast<int>(down_height_); v++) {
-      for (int u = 0; u < static_cast<int>(down_width_); u++) {
-        int cur_index = v * static_cast<int>(down_width_) + u;
-        if (labels_filtered_[cur_index] == 1 && !pixel_on_queue_[cur_index]) {
-          // We haven't already visited this pixel perform a floodfill 
-          // starting from this pixel --> Potentially a new blob
-
-          // Add the current pixel to the end of the queue
-          pixel_queue_[queue_tail_] = cur_index;
-          pixel_on_queue_[cur_index] = true;
-          queue_tail_++;
-          uint32_t n_blob_pts = 0;
-          uint32_t n_hand_pts = 0;
-
-          int u_ave = 0;
-          int v_ave = 0;
-          int depth_ave = 0;
-          //cur_uv_min_.set(down_width_, down_height_);
-          //cur_uv_max_.set(-1, -1);
-
-          while (queue_head_ != queue_tail_) {
-            // Take the pixel off the head
-            int cur_pixel = pixel_queue_[queue_head_];
-
-            int cur_u = cur_pixel % down_width_;
-            int cur_v = cur_pixel / down_width_;
-            queue_head_++;
-            n_blob_pts++;
-
-            if (labels_evaluated_[cur_pixel] == 1) {
-              depth_ave += (int)depth_downsampled_[cur_pixel];
-              n_hand_pts += 1;
-            }
-
-            u_ave += cur_u;
-            v_ave += cur_v;
-
-            // Process the 8 surrounding neighbours
-            processNeighbour(cur_u-1, cur_v-1);
-            processNeighbour(cur_u-1, cur_v);
-            processNeighbour(cur_u-1, cur_v+1);
-            processNeighbour(cur_u, cur_v-1);
-            processNeighbour(cur_u, cur_v+1);
-            processNeighbour(cur_u+1, cur_v-1);
-            processNeighbour(cur_u+1, cur_v);
-            processNeighbour(cur_u+1, cur_v+1);
-          }
-          // Finished processing the entire blob
-          if (n_blob_pts >= HD_MIN_PTS_PER_HAND_BLOB) {
-            hands_n_pts_.pushBack(n_blob_pts);
-
-            Float3 center(DT_DOWNSAMPLE * (float)u_ave / (float)n_blob_pts, 
-              DT_DOWNSAMPLE * (float)v_ave / (float)n_blob_pts, 
-              (float)depth_ave / (float)n_hand_pts);
-            hands_uvd_.pushBack(center);
-          }
-        }
+    // Label the connected components of labels_filtered_ (one band per
+    // worker thread), accumulating the blob statistics as we go.
+    blob_labeler_->setInputs(labels_filtered_, labels_evaluated_, 
+      depth_downsampled_);
+    runTasks(ts_, blob_cbs_);
+    blob_labeler_->mergeBands();
+
+    Vector<HandBlob>& blobs = blob_labeler_->blobs();
+    for (uint32_t i = 0; i < blobs.size(); i++) {
+      const HandBlob& blob = blobs[i];
+      if (blob.n_pts >= HD_MIN_PTS_PER_HAND_BLOB) {
+        hands_n_pts_.pushBack(blob.n_pts);
+
+        Float3 center(DT_DOWNSAMPLE * (float)blob.u_sum / (float)blob.n_pts, 
+          DT_DOWNSAMPLE * (float)blob.v_sum / (float)blob.n_pts, 
+          (float)blob.depth_sum / (float)blob.n_hand_pts);
+        hands_uvd_.pushBack(center);
       }
     }
 
@@ -514,19 +529,6 @@ namespace hand_detector {
     return r<0 ? r+m : r;
   }
 
-  void HandDetector::processNeighbour(int u, int v) {
-    if (u < static_cast<int>(down_width_) && u >=0 && 
-        v < static_cast<int>(down_height_) && v >= 0) {
-      int cur_index = u + v * down_width_;
-      if ((labels_filtered_[cur_index] == 1) && (pixel_on_queue_[cur_index] == 0)) {
-        // Add the pixel to the back of the queue
-        pixel_queue_[queue_tail_] = cur_index;
-        pixel_on_queue_[cur_index] = 1;
-        queue_tail_++;
-      }
-    }
-  }
-
   float floorf_sym(float value) {
     if (value < 0.0f) {
       return ceilf(value);
@@ -552,6 +554,7 @@ namespace hand_detector {
   // HandStatistics --> One day I will completely remove HandStatistics
   void HandDetector::findHandLabelsFloodFill(const float* pt_hand_uvd, 
     const float* xyz, uint8_t* label) {
+    TRACE_SCOPE(TRACE_FLOOD_FILL);
     float pt_hand_xyz[3];
     KinectInterface::convertUVDToApproxXYZ(1, pt_hand_uvd, pt_hand_xyz);
     // Search in a small UV window for the minimum depth value around
@@ -0,0 +1,246 @@
+#include <string>
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include "kinect_interface/kinect_interface.h"
+#include "kinect_interface/hand_detector/hand_fusion.h"
+#include "kinect_interface/hand_detector/multi_hand_detector.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+using jtil::data_str::Vector;
+
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+#define HF_MAX_SENSORS 32  // fused_sensor_mask_ is a uint32_t bitmask
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  HandFusion::HandFusion() {
+    num_sensors_ = 0;
+    extrinsics_ = NULL;
+    next_track_id_ = 0;
+  }
+
+  HandFusion::~HandFusion() {
+    SAFE_DELETE_ARR(extrinsics_);
+  }
+
+  void HandFusion::init(const uint32_t num_sensors) {
+    if (num_sensors == 0 || num_sensors > HF_MAX_SENSORS) {
+      throw std::wruntime_error("HandFusion::init() - ERROR: invalid number "
+        "of sensors!");
+    }
+    num_sensors_ = num_sensors;
+    extrinsics_ = new float[num_sensors_ * HF_EXTRINSICS_SIZE];
+    const float identity[HF_EXTRINSICS_SIZE] = {1, 0, 0, 0,
+                                                0, 1, 0, 0,
+                                                0, 0, 1, 0};
+    for (uint32_t i = 0; i < num_sensors_; i++) {
+      setExtrinsics(i, identity);
+    }
+    // Each sensor can see at most 2 hands
+    detections_.capacity(2 * num_sensors_);
+    fused_hands_.capacity(2 * num_sensors_);
+    prev_fused_hands_.capacity(2 * num_sensors_);
+    fused_weight_.capacity(2 * num_sensors_);
+    fused_sensor_mask_.capacity(2 * num_sensors_);
+  }
+
+  void HandFusion::setExtrinsics(const uint32_t sensor,
+    const float* world_from_sensor) {
+    if (sensor >= num_sensors_) {
+      throw std::wruntime_error("HandFusion::setExtrinsics() - ERROR: "
+        "sensor index out of range!");
+    }
+    memcpy(&extrinsics_[sensor * HF_EXTRINSICS_SIZE], world_from_sensor,
+      sizeof(extrinsics_[0]) * HF_EXTRINSICS_SIZE);
+  }
+
+  bool HandFusion::loadExtrinsics(const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::in);
+    if (!file.is_open()) {
+      return false;
+    }
+    float mat[HF_EXTRINSICS_SIZE];
+    for (uint32_t i = 0; i < num_sensors_; i++) {
+      for (uint32_t j = 0; j < HF_EXTRINSICS_SIZE; j++) {
+        if (!(file >> mat[j])) {
+          throw std::wruntime_error("HandFusion::loadExtrinsics() - ERROR: "
+            "not enough values in the extrinsics file!");
+        }
+      }
+      setExtrinsics(i, mat);
+    }
+    file.close();
+    return true;
+  }
+
+  void HandFusion::fuse(const SensorHands* hands) {
+    detections_.resize(0);
+    uint32_t num_active_sensors = 0;
+    for (uint32_t i = 0; i < num_sensors_; i++) {
+      if (hands[i].frame_number == 0) {
+        continue;  // No data from this sensor yet
+      }
+      num_active_sensors++;
+      if (hands[i].rhand_found) {
+        addDetection(i, hands[i].rhand_uvd);
+      }
+      if (hands[i].lhand_found) {
+        addDetection(i, hands[i].lhand_uvd);
+      }
+    }
+
+    associateDetections();
+    for (uint32_t i = 0; i < fused_hands_.size(); i++) {
+      fused_hands_[i].confidence = (float)fused_hands_[i].num_views /
+        (float)num_active_sensors;
+    }
+    updateTracks();
+  }
+
+  void HandFusion::addDetection(const uint32_t sensor, const float* uvd) {
+    float xyz_sensor[3];
+    KinectInterface::convertUVDToApproxXYZ(1, uvd, xyz_sensor);
+    if (xyz_sensor[2] <= 0) {
+      return;  // No valid depth at the hand center
+    }
+
+    Detection det;
+    det.sensor = sensor;
+    det.uvd[0] = uvd[0];
+    det.uvd[1] = uvd[1];
+    det.uvd[2] = uvd[2];
+    const float* m = &extrinsics_[sensor * HF_EXTRINSICS_SIZE];
+    for (uint32_t r = 0; r < 3; r++) {
+      det.xyz[r] = m[r * 4] * xyz_sensor[0] + m[r * 4 + 1] * xyz_sensor[1] +
+        m[r * 4 + 2] * xyz_sensor[2] + m[r * 4 + 3];
+    }
+    // Depth noise (and hand size in pixels) gets worse with distance, so
+    // closer views get more weight
+    det.weight = 1.0f / (xyz_sensor[2] * xyz_sensor[2]);
+
+    // Keep detections_ sorted by decreasing weight (there are only a few)
+    detections_.pushBack(det);
+    for (uint32_t i = detections_.size() - 1; i > 0 &&
+      detections_[i - 1].weight < detections_[i].weight; i--) {
+      Detection tmp = detections_[i - 1];
+      detections_[i - 1] = detections_[i];
+      detections_[i] = tmp;
+    }
+  }
+
+  void HandFusion::associateDetections() {
+    fused_hands_.resize(0);
+    fused_weight_.resize(0);
+    fused_sensor_mask_.resize(0);
+    const float assoc_rad_sq = HF_ASSOCIATION_RADIUS * HF_ASSOCIATION_RADIUS;
+    for (uint32_t i = 0; i < detections_.size(); i++) {
+      const Detection& det = detections_[i];
+      const uint32_t sensor_bit = 1u << det.sensor;
+
+      uint32_t best = MAX_UINT32;
+      float best_dist_sq = assoc_rad_sq;
+      for (uint32_t j = 0; j < fused_hands_.size(); j++) {
+        if ((fused_sensor_mask_[j] & sensor_bit) != 0) {
+          continue;  // One detection per sensor per hand
+        }
+        const float dist_sq = distSq(fused_hands_[j].xyz, det.xyz);
+        if (dist_sq < best_dist_sq) {
+          best_dist_sq = dist_sq;
+          best = j;
+        }
+      }
+
+      if (best == MAX_UINT32) {
+        // Detections are sorted by weight, so the first detection of a hand
+        // is also its best view.
+        FusedHand hand;
+        hand.track_id = 0;
+        hand.track_age = 0;
+        hand.xyz[0] = det.xyz[0];
+        hand.xyz[1] = det.xyz[1];
+        hand.xyz[2] = det.xyz[2];
+        hand.confidence = 0;
+        hand.num_views = 1;
+        hand.best_sensor = det.sensor;
+        hand.best_uvd[0] = det.uvd[0];
+        hand.best_uvd[1] = det.uvd[1];
+        hand.best_uvd[2] = det.uvd[2];
+        fused_hands_.pushBack(hand);
+        fused_weight_.pushBack(det.weight);
+        fused_sensor_mask_.pushBack(sensor_bit);
+      } else {
+        FusedHand& hand = fused_hands_[best];
+        const float w_old = fused_weight_[best];
+        const float w_new = w_old + det.weight;
+        for (uint32_t k = 0; k < 3; k++) {
+          hand.xyz[k] = (hand.xyz[k] * w_old + det.xyz[k] * det.weight) /
+            w_new;
+        }
+        hand.num_views++;
+        fused_weight_[best] = w_new;
+        fused_sensor_mask_[best] |= sensor_bit;
+      }
+    }
+  }
+
+  void HandFusion::updateTracks() {
+    const float track_rad_sq = HF_TRACK_RADIUS * HF_TRACK_RADIUS;
+    // Greedy nearest neighbour (there are only a few hands)
+    for (uint32_t i = 0; i < fused_hands_.size(); i++) {
+      FusedHand& hand = fused_hands_[i];
+      uint32_t best = MAX_UINT32;
+      float best_dist_sq = track_rad_sq;
+      for (uint32_t j = 0; j < prev_fused_hands_.size(); j++) {
+        if (prev_fused_hands_[j].track_age == 0) {
+          continue;  // Already claimed this frame
+        }
+        const float dist_sq = distSq(prev_fused_hands_[j].xyz, hand.xyz);
+        if (dist_sq < best_dist_sq) {
+          best_dist_sq = dist_sq;
+          best = j;
+        }
+      }
+      if (best != MAX_UINT32) {
+        hand.track_id = prev_fused_hands_[best].track_id;
+        hand.track_age = prev_fused_hands_[best].track_age + 1;
+        prev_fused_hands_[best].track_age = 0;
+      } else {
+        hand.track_id = next_track_id_++;
+        hand.track_age = 1;
+      }
+    }
+
+    prev_fused_hands_.resize(0);
+    for (uint32_t i = 0; i < fused_hands_.size(); i++) {
+      prev_fused_hands_.pushBack(fused_hands_[i]);
+    }
+  }
+
+  bool HandFusion::bestView(uint32_t& sensor) {
+    uint32_t best = MAX_UINT32;
+    for (uint32_t i = 0; i < fused_hands_.size(); i++) {
+      if (best == MAX_UINT32 ||
+        fused_hands_[i].confidence > fused_hands_[best].confidence ||
+        (fused_hands_[i].confidence == fused_hands_[best].confidence &&
+        fused_hands_[i].track_age > fused_hands_[best].track_age)) {
+        best = i;
+      }
+    }
+    if (best == MAX_UINT32) {
+      return false;
+    }
+    sensor = fused_hands_[best].best_sensor;
+    return true;
+  }
+
+  float HandFusion::distSq(const float* a, const float* b) {
+    const float dx = a[0] - b[0];
+    const float dy = a[1] - b[1];
+    const float dz = a[2] - b[2];
+    return dx * dx + dy * dy + dz * dz;
+  }
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
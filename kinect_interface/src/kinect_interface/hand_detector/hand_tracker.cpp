@@ -0,0 +1,106 @@
+#include <cmath>
+#include <algorithm>
+#include "kinect_interface/hand_detector/hand_tracker.h"
+#include "kinect_interface/hand_detector/hand_detector.h"
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  HandTracker::HandTracker() {
+    down_width_ = 0;
+    down_height_ = 0;
+    downsample_ = 1;
+    focal_u_ = 0;
+    focal_v_ = 0;
+    reset();
+  }
+
+  HandTracker::~HandTracker() {
+  }
+
+  void HandTracker::init(const int32_t src_width, const int32_t src_height,
+    const int32_t downsample, const float hfov_deg, const float vfov_deg) {
+    down_width_ = src_width / downsample;
+    down_height_ = src_height / downsample;
+    downsample_ = downsample;
+    const float deg_to_rad = (float)M_PI / 180.0f;
+    focal_u_ = 0.5f * (float)src_width / tanf(0.5f * hfov_deg * deg_to_rad);
+    focal_v_ = 0.5f * (float)src_height / tanf(0.5f * vfov_deg * deg_to_rad);
+    reset();
+  }
+
+  void HandTracker::reset() {
+    tracking_ = false;
+    frames_since_full_scan_ = 0;
+    for (uint32_t i = 0; i < 3; i++) {
+      pos_[i] = 0;
+      vel_[i] = 0;
+    }
+  }
+
+  void HandTracker::fullROI(HandROI& roi) const {
+    roi.u_min = 0;
+    roi.u_max = down_width_ - 1;
+    roi.v_min = 0;
+    roi.v_max = down_height_ - 1;
+  }
+
+  bool HandTracker::predictROI(HandROI& roi) const {
+    fullROI(roi);
+    if (!tracking_ || frames_since_full_scan_ >= HT_FULL_SCAN_FRAMES - 1) {
+      return false;
+    }
+
+    const float u = pos_[0] + vel_[0];
+    const float v = pos_[1] + vel_[1];
+    const float d = std::max<float>(pos_[2] + vel_[2], HT_MIN_DEPTH);
+    const float radius = HT_ROI_HAND_RADII * HD_HAND_RADIUS * XYZ_UNIT / d;
+    const float rad_u = radius * focal_u_ + HT_ROI_VEL_FRAMES * fabsf(vel_[0]);
+    const float rad_v = radius * focal_v_ + HT_ROI_VEL_FRAMES * fabsf(vel_[1]);
+
+    const float ds = (float)downsample_;
+    roi.u_min = std::max<int32_t>((int32_t)floorf((u - rad_u) / ds), 0);
+    roi.u_max = std::min<int32_t>((int32_t)ceilf((u + rad_u) / ds),
+      down_width_ - 1);
+    roi.v_min = std::max<int32_t>((int32_t)floorf((v - rad_v) / ds), 0);
+    roi.v_max = std::min<int32_t>((int32_t)ceilf((v + rad_v) / ds),
+      down_height_ - 1);
+    if (roi.u_min > roi.u_max || roi.v_min > roi.v_max) {
+      fullROI(roi);  // Predicted off screen
+      return false;
+    }
+    return true;
+  }
+
+  void HandTracker::update(const bool found, const float* hand_uvd,
+    const bool full_frame) {
+    // Depth is averaged over the blob's hand pixels (there may be none)
+    if (!found || !(hand_uvd[2] > 0)) {
+      reset();
+      return;
+    }
+    const bool jump =
+      fabsf(hand_uvd[2] - (pos_[2] + vel_[2])) > HT_MAX_DEPTH_JUMP;
+    if (tracking_ && jump && !full_frame) {
+      reset();  // Probably another object in the box: look everywhere
+      return;
+    }
+    if (!tracking_ || jump) {
+      for (uint32_t i = 0; i < 3; i++) {
+        pos_[i] = hand_uvd[i];
+        vel_[i] = 0;
+      }
+      tracking_ = true;
+    } else {
+      for (uint32_t i = 0; i < 3; i++) {
+        const float pred = pos_[i] + vel_[i];
+        const float residual = hand_uvd[i] - pred;
+        pos_[i] = pred + HT_GAIN_POS * residual;
+        vel_[i] = vel_[i] + HT_GAIN_VEL * residual;
+      }
+    }
+    frames_since_full_scan_ = full_frame ? 0 : frames_since_full_scan_ + 1;
+  }
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
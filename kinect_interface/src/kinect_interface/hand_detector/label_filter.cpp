@@ -0,0 +1,460 @@
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cstdlib>
+#include "kinect_interface/hand_detector/label_filter.h"
+#include "kinect_interface/kinect_interface.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+#define LF_MAX_COUNT_RAD 127  // (2*rad+1)^2 must fit in a uint16_t
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  LabelFilter::LabelFilter() {
+    width_ = 0;
+    height_ = 0;
+    num_bands_ = 0;
+    max_extremum_rad_ = 0;
+    band_start_row_ = NULL;
+    type_ = LFShrink;
+    dst_ = NULL;
+    src_ = NULL;
+    depth_ = NULL;
+    rad_ = 0;
+    depth_thresh_ = 0;
+    row_count_a_ = NULL;
+    row_count_b_ = NULL;
+    row_min_ = NULL;
+    row_max_ = NULL;
+    col_min_ = NULL;
+    col_max_ = NULL;
+    row_grown_ = NULL;
+    band_row_scratch_size_ = 0;
+    band_col_scratch_size_ = 0;
+    band_pred_a_ = NULL;
+    band_pred_b_ = NULL;
+    band_prefix_a_ = NULL;
+    band_prefix_b_ = NULL;
+    band_acc_a_ = NULL;
+    band_acc_b_ = NULL;
+    band_g_ = NULL;
+    band_h_ = NULL;
+  }
+
+  LabelFilter::~LabelFilter() {
+    SAFE_DELETE_ARR(band_start_row_);
+    SAFE_DELETE_ARR(row_count_a_);
+    SAFE_DELETE_ARR(row_count_b_);
+    SAFE_DELETE_ARR(row_min_);
+    SAFE_DELETE_ARR(row_max_);
+    SAFE_DELETE_ARR(col_min_);
+    SAFE_DELETE_ARR(col_max_);
+    SAFE_DELETE_ARR(row_grown_);
+    SAFE_DELETE_ARR(band_pred_a_);
+    SAFE_DELETE_ARR(band_pred_b_);
+    SAFE_DELETE_ARR(band_prefix_a_);
+    SAFE_DELETE_ARR(band_prefix_b_);
+    SAFE_DELETE_ARR(band_acc_a_);
+    SAFE_DELETE_ARR(band_acc_b_);
+    SAFE_DELETE_ARR(band_g_);
+    SAFE_DELETE_ARR(band_h_);
+  }
+
+  void LabelFilter::init(const int32_t width, const int32_t height,
+    const int32_t num_bands, const int32_t max_extremum_rad) {
+    if (width <= 0 || height <= 0 || num_bands <= 0 || max_extremum_rad < 0) {
+      throw std::wruntime_error("LabelFilter::init() - ERROR: invalid image "
+        "size, band count or radius!");
+    }
+    width_ = width;
+    height_ = height;
+    num_bands_ = std::min<int32_t>(num_bands, height);
+    max_extremum_rad_ = max_extremum_rad;
+
+    band_start_row_ = new int32_t[num_bands_ + 1];
+    int32_t max_band_rows = 0;
+    for (int32_t b = 0; b <= num_bands_; b++) {
+      band_start_row_[b] = (b * height_) / num_bands_;
+      if (b > 0) {
+        max_band_rows = std::max<int32_t>(max_band_rows,
+          band_start_row_[b] - band_start_row_[b - 1]);
+      }
+    }
+
+    const int32_t dim = width_ * height_;
+    row_count_a_ = new uint16_t[dim];
+    row_count_b_ = new uint16_t[dim];
+    row_min_ = new int16_t[dim];
+    row_max_ = new int16_t[dim];
+    col_min_ = new int16_t[dim];
+    col_max_ = new int16_t[dim];
+    row_grown_ = new uint8_t[dim];
+
+    // The van Herk buffers hold one padded row (for the row pass) or one
+    // padded band of rows (for the column pass)
+    const int32_t pad = 2 * max_extremum_rad_;
+    band_row_scratch_size_ = width_ + 1;
+    band_col_scratch_size_ = std::max<int32_t>(width_ + pad,
+      (max_band_rows + pad) * width_);
+    band_pred_a_ = new uint8_t[num_bands_ * band_row_scratch_size_];
+    band_pred_b_ = new uint8_t[num_bands_ * band_row_scratch_size_];
+    band_prefix_a_ = new uint16_t[num_bands_ * band_row_scratch_size_];
+    band_prefix_b_ = new uint16_t[num_bands_ * band_row_scratch_size_];
+    band_acc_a_ = new uint32_t[num_bands_ * band_row_scratch_size_];
+    band_acc_b_ = new uint32_t[num_bands_ * band_row_scratch_size_];
+    band_g_ = new int16_t[num_bands_ * band_col_scratch_size_];
+    band_h_ = new int16_t[num_bands_ * band_col_scratch_size_];
+  }
+
+  void LabelFilter::setFilter(const LabelFilterType type, uint8_t* dst,
+    const uint8_t* src, const int16_t* depth, const int32_t rad,
+    const int32_t depth_thresh) {
+    if (rad < 0 || rad > LF_MAX_COUNT_RAD) {
+      throw std::wruntime_error("LabelFilter::setFilter() - ERROR: radius is "
+        "out of range!");
+    }
+    if ((type == LFDepthDiscontinuity || type == LFGrowDepthThreshold) &&
+      rad > max_extremum_rad_) {
+      throw std::wruntime_error("LabelFilter::setFilter() - ERROR: radius is "
+        "larger than the max_extremum_rad passed to init()!");
+    }
+    type_ = type;
+    dst_ = dst;
+    src_ = src;
+    depth_ = depth;
+    rad_ = rad;
+    depth_thresh_ = depth_thresh;
+  }
+
+  void LabelFilter::filter(const LabelFilterType type, uint8_t* dst,
+    const uint8_t* src, const int16_t* depth, const int32_t rad,
+    const int32_t depth_thresh) {
+    setFilter(type, dst, src, depth, rad, depth_thresh);
+    for (int32_t b = 0; b < num_bands_; b++) {
+      filterRowsBand(b);
+    }
+    for (int32_t b = 0; b < num_bands_; b++) {
+      filterColsBand(b);
+    }
+  }
+
+  // count[u] = number of pred[x] != 0 for x in [u - rad, u + rad] (clipped)
+  void LabelFilter::boxCountRow(uint16_t* count, const uint8_t* pred,
+    uint16_t* prefix) const {
+    prefix[0] = 0;
+    for (int32_t u = 0; u < width_; u++) {
+      prefix[u + 1] = prefix[u] + pred[u];
+    }
+    const int32_t u_mid_start = std::min<int32_t>(rad_, width_);
+    const int32_t u_mid_end = std::max<int32_t>(u_mid_start,
+      width_ - rad_ - 1);
+    int32_t u = 0;
+    for (; u < u_mid_start; u++) {
+      count[u] = prefix[std::min<int32_t>(u + rad_ + 1, width_)] - prefix[0];
+    }
+    for (; u < u_mid_end; u++) {
+      count[u] = prefix[u + rad_ + 1] - prefix[u - rad_];
+    }
+    for (; u < width_; u++) {
+      count[u] = prefix[width_] -
+        prefix[std::max<int32_t>(u - rad_, 0)];
+    }
+  }
+
+  // Add (sign = 1) or subtract (sign = -1) row v of row_count into acc
+  static inline void accumulateRow(uint32_t* acc, const uint16_t* row_count,
+    const int32_t width, const int32_t sign) {
+    if (sign > 0) {
+      for (int32_t u = 0; u < width; u++) {
+        acc[u] += row_count[u];
+      }
+    } else {
+      for (int32_t u = 0; u < width; u++) {
+        acc[u] -= row_count[u];
+      }
+    }
+  }
+
+  // Set acc to the clipped vertical window sum of row_count centered on v
+  void LabelFilter::boxCountCols(uint32_t* acc, const uint16_t* row_count,
+    const int32_t v, const int32_t v_start) const {
+    if (v == v_start) {
+      memset(acc, 0, width_ * sizeof(acc[0]));
+      const int32_t v0 = std::max<int32_t>(v - rad_, 0);
+      const int32_t v1 = std::min<int32_t>(v + rad_, height_ - 1);
+      for (int32_t vi = v0; vi <= v1; vi++) {
+        accumulateRow(acc, &row_count[vi * width_], width_, 1);
+      }
+    } else {
+      // Slide the window down by one row
+      if (v + rad_ < height_) {
+        accumulateRow(acc, &row_count[(v + rad_) * width_], width_, 1);
+      }
+      if (v - rad_ - 1 >= 0) {
+        accumulateRow(acc, &row_count[(v - rad_ - 1) * width_], width_, -1);
+      }
+    }
+  }
+
+  template <bool IS_MIN>
+  static inline int16_t extremumOp(const int16_t a, const int16_t b) {
+    return IS_MIN ? (a < b ? a : b) : (a > b ? a : b);
+  }
+
+  template <bool IS_MIN>
+  static inline int16_t extremumIdentity() {
+    return IS_MIN ? std::numeric_limits<int16_t>::max() :
+      std::numeric_limits<int16_t>::min();
+  }
+
+  // van Herk / Gil-Werman: dst[u] = op(src[u - rad ... u + rad]), clipped.
+  // The row is padded by rad on either side with the op's identity, split
+  // into blocks of k = 2*rad+1, and every window is the op of a block suffix
+  // (h) and the following block prefix (g).
+  template <bool IS_MIN>
+  void LabelFilter::extremumRow(int16_t* dst, const int16_t* src,
+    int16_t* g, int16_t* h) const {
+    const int32_t k = 2 * rad_ + 1;
+    const int32_t len = width_ + 2 * rad_;
+    const int16_t identity = extremumIdentity<IS_MIN>();
+    for (int32_t p = 0; p < len; p++) {
+      const int32_t u = p - rad_;
+      const int16_t x = (u >= 0 && u < width_) ? src[u] : identity;
+      g[p] = (p % k == 0) ? x : extremumOp<IS_MIN>(g[p - 1], x);
+    }
+    for (int32_t p = len - 1; p >= 0; p--) {
+      const int32_t u = p - rad_;
+      const int16_t x = (u >= 0 && u < width_) ? src[u] : identity;
+      h[p] = (p % k == k - 1 || p == len - 1) ? x :
+        extremumOp<IS_MIN>(h[p + 1], x);
+    }
+    for (int32_t u = 0; u < width_; u++) {
+      dst[u] = extremumOp<IS_MIN>(h[u], g[u + 2 * rad_]);
+    }
+  }
+
+  // Same as extremumRow but down the columns of rows [v_start, v_end).  Each
+  // padded row of g and h is a full image row, so the inner loops run along u.
+  template <bool IS_MIN>
+  void LabelFilter::extremumCols(int16_t* dst, const int16_t* src,
+    const int32_t v_start, const int32_t v_end, int16_t* g,
+    int16_t* h) const {
+    const int32_t k = 2 * rad_ + 1;
+    const int32_t len = (v_end - v_start) + 2 * rad_;
+    const int16_t identity = extremumIdentity<IS_MIN>();
+    for (int32_t p = 0; p < len; p++) {
+      const int32_t v = v_start - rad_ + p;
+      int16_t* g_row = &g[p * width_];
+      if (v < 0 || v >= height_) {
+        for (int32_t u = 0; u < width_; u++) {
+          g_row[u] = (p % k == 0) ? identity : g_row[u - width_];
+        }
+      } else if (p % k == 0) {
+        memcpy(g_row, &src[v * width_], width_ * sizeof(g_row[0]));
+      } else {
+        const int16_t* src_row = &src[v * width_];
+        const int16_t* g_prev = g_row - width_;
+        for (int32_t u = 0; u < width_; u++) {
+          g_row[u] = extremumOp<IS_MIN>(g_prev[u], src_row[u]);
+        }
+      }
+    }
+    for (int32_t p = len - 1; p >= 0; p--) {
+      const int32_t v = v_start - rad_ + p;
+      int16_t* h_row = &h[p * width_];
+      const bool block_end = (p % k == k - 1 || p == len - 1);
+      if (v < 0 || v >= height_) {
+        for (int32_t u = 0; u < width_; u++) {
+          h_row[u] = block_end ? identity : h_row[u + width_];
+        }
+      } else if (block_end) {
+        memcpy(h_row, &src[v * width_], width_ * sizeof(h_row[0]));
+      } else {
+        const int16_t* src_row = &src[v * width_];
+        const int16_t* h_next = h_row + width_;
+        for (int32_t u = 0; u < width_; u++) {
+          h_row[u] = extremumOp<IS_MIN>(h_next[u], src_row[u]);
+        }
+      }
+    }
+    for (int32_t v = v_start; v < v_end; v++) {
+      const int16_t* h_row = &h[(v - v_start) * width_];
+      const int16_t* g_row = &g[(v - v_start + 2 * rad_) * width_];
+      int16_t* dst_row = &dst[v * width_];
+      for (int32_t u = 0; u < width_; u++) {
+        dst_row[u] = extremumOp<IS_MIN>(h_row[u], g_row[u]);
+      }
+    }
+  }
+
+  // Same test as jtil's MedianLabelFilter
+  bool LabelFilter::validDepth(const int16_t d) const {
+    return d != 0 && d < (int16_t)max_depth;
+  }
+
+  // Grow into a pixel if its depth is within depth_thresh of the [lo, hi]
+  // depth range of the labeled pixels in its window (lo > hi if there are
+  // none).  This is the same as "within depth_thresh of some labeled pixel"
+  // unless the labeled depths in the window have a gap of 2 * depth_thresh
+  // or more, where pixels with depths inside the gap are grown too.
+  bool LabelFilter::growDepthRange(const int16_t d, const int16_t lo,
+    const int16_t hi) const {
+    return lo <= hi && (int32_t)d > (int32_t)lo - depth_thresh_ &&
+      (int32_t)d < (int32_t)hi + depth_thresh_;
+  }
+
+  void LabelFilter::filterRowsBand(const int32_t band) {
+    const int32_t v_start = band_start_row_[band];
+    const int32_t v_end = band_start_row_[band + 1];
+    uint8_t* pred_a = &band_pred_a_[band * band_row_scratch_size_];
+    uint8_t* pred_b = &band_pred_b_[band * band_row_scratch_size_];
+    uint16_t* prefix_a = &band_prefix_a_[band * band_row_scratch_size_];
+    uint16_t* prefix_b = &band_prefix_b_[band * band_row_scratch_size_];
+    int16_t* g = &band_g_[band * band_col_scratch_size_];
+    int16_t* h = &band_h_[band * band_col_scratch_size_];
+
+    for (int32_t v = v_start; v < v_end; v++) {
+      const int32_t i0 = v * width_;
+      const uint8_t* src = &src_[i0];
+      switch (type_) {
+      case LFShrink:
+        for (int32_t u = 0; u < width_; u++) {
+          pred_a[u] = src[u] == 0 ? 1 : 0;
+        }
+        boxCountRow(&row_count_a_[i0], pred_a, prefix_a);
+        break;
+      case LFGrow:
+        for (int32_t u = 0; u < width_; u++) {
+          pred_a[u] = src[u] == 1 ? 1 : 0;
+        }
+        boxCountRow(&row_count_a_[i0], pred_a, prefix_a);
+        break;
+      case LFMedian:
+        {
+          const int16_t* depth = &depth_[i0];
+          for (int32_t u = 0; u < width_; u++) {
+            pred_a[u] = validDepth(depth[u]) ? 1 : 0;
+            pred_b[u] = (pred_a[u] && src[u] == 1) ? 1 : 0;
+          }
+          boxCountRow(&row_count_a_[i0], pred_a, prefix_a);
+          boxCountRow(&row_count_b_[i0], pred_b, prefix_b);
+        }
+        break;
+      case LFDepthDiscontinuity:
+        {
+          // Invalid depth forces the window range to [0, max_depth]
+          int16_t* depth_lo = &row_min_[i0];
+          int16_t* depth_hi = &row_max_[i0];
+          const int16_t* depth = &depth_[i0];
+          for (int32_t u = 0; u < width_; u++) {
+            const bool valid = depth[u] > 0 && depth[u] < (int16_t)max_depth;
+            depth_lo[u] = valid ? depth[u] : 0;
+            depth_hi[u] = valid ? depth[u] : (int16_t)max_depth;
+          }
+          // extremumRow doesn't read src once it starts writing dst
+          extremumRow<true>(depth_lo, depth_lo, g, h);
+          extremumRow<false>(depth_hi, depth_hi, g, h);
+        }
+        break;
+      case LFGrowDepthThreshold:
+        {
+          // Min and max depth of the labeled pixels in the window (the
+          // identity where there are none).  Labels on invalid depth are
+          // kept but not grown from, they would stretch the range to 0.
+          const int16_t* depth = &depth_[i0];
+          uint8_t* grown = &row_grown_[i0];
+          int16_t* lab_lo = &row_min_[i0];
+          int16_t* lab_hi = &row_max_[i0];
+          for (int32_t u = 0; u < width_; u++) {
+            const bool seed = src[u] == 1 && validDepth(depth[u]);
+            lab_lo[u] = seed ? depth[u] : extremumIdentity<true>();
+            lab_hi[u] = seed ? depth[u] : extremumIdentity<false>();
+          }
+          extremumRow<true>(lab_lo, lab_lo, g, h);
+          extremumRow<false>(lab_hi, lab_hi, g, h);
+          for (int32_t u = 0; u < width_; u++) {
+            grown[u] = growDepthRange(depth[u], lab_lo[u], lab_hi[u]) ? 1 :
+              src[u];
+          }
+          // Same again over the grown pixels for the column pass
+          for (int32_t u = 0; u < width_; u++) {
+            const bool seed = grown[u] == 1 && validDepth(depth[u]);
+            lab_lo[u] = seed ? depth[u] : extremumIdentity<true>();
+            lab_hi[u] = seed ? depth[u] : extremumIdentity<false>();
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  void LabelFilter::filterColsBand(const int32_t band) {
+    const int32_t v_start = band_start_row_[band];
+    const int32_t v_end = band_start_row_[band + 1];
+    uint32_t* acc_a = &band_acc_a_[band * band_row_scratch_size_];
+    uint32_t* acc_b = &band_acc_b_[band * band_row_scratch_size_];
+    int16_t* g = &band_g_[band * band_col_scratch_size_];
+    int16_t* h = &band_h_[band * band_col_scratch_size_];
+
+    if (type_ == LFDepthDiscontinuity) {
+      extremumCols<true>(col_min_, row_min_, v_start, v_end, g, h);
+      extremumCols<false>(col_max_, row_max_, v_start, v_end, g, h);
+      for (int32_t i = v_start * width_; i < v_end * width_; i++) {
+        const bool discont = (col_max_[i] - col_min_[i]) > depth_thresh_;
+        dst_[i] = (src_[i] == 1 && !discont) ? 1 : 0;
+      }
+      return;
+    }
+
+    if (type_ == LFGrowDepthThreshold) {
+      // row_min_ / row_max_ hold the depth of the row grown pixels
+      extremumCols<true>(col_min_, row_min_, v_start, v_end, g, h);
+      extremumCols<false>(col_max_, row_max_, v_start, v_end, g, h);
+      for (int32_t i = v_start * width_; i < v_end * width_; i++) {
+        dst_[i] = growDepthRange(depth_[i], col_min_[i], col_max_[i]) ? 1 :
+          row_grown_[i];
+      }
+      return;
+    }
+
+    for (int32_t v = v_start; v < v_end; v++) {
+      const int32_t i0 = v * width_;
+      const uint8_t* src = &src_[i0];
+      uint8_t* dst = &dst_[i0];
+      switch (type_) {
+      case LFShrink:
+        boxCountCols(acc_a, row_count_a_, v, v_start);
+        for (int32_t u = 0; u < width_; u++) {
+          dst[u] = acc_a[u] > 0 ? 0 : src[u];
+        }
+        break;
+      case LFGrow:
+        boxCountCols(acc_a, row_count_a_, v, v_start);
+        for (int32_t u = 0; u < width_; u++) {
+          dst[u] = acc_a[u] > 0 ? 1 : src[u];
+        }
+        break;
+      case LFMedian:
+        {
+          // acc_a = number of valid pixels, acc_b = number of valid hand
+          // pixels.  Ties go to label 0 (the lower label).
+          boxCountCols(acc_a, row_count_a_, v, v_start);
+          boxCountCols(acc_b, row_count_b_, v, v_start);
+          const int16_t* depth = &depth_[i0];
+          for (int32_t u = 0; u < width_; u++) {
+            dst[u] = (validDepth(depth[u]) && 2 * acc_b[u] > acc_a[u]) ? 1 : 0;
+          }
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
@@ -0,0 +1,204 @@
+#include <string>
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include "kinect_interface/kinect_interface.h"
+#include "kinect_interface/hand_detector/multi_hand_detector.h"
+#include "kinect_interface/hand_detector/forest_io.h"
+#include "kinect_interface/hand_detector/decision_tree_structs.h"
+#include "kinect_interface/task_scheduler.h"
+#include "kinect_interface/trace.h"
+#include "jtil/data_str/vector_managed.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+using jtil::data_str::VectorManaged;
+using jtil::threading::Callback;
+using namespace jtil::threading;
+
+#define SAFE_DELETE(x) do { if (x != NULL) { delete x; x = NULL; } } while (0);
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+
+namespace kinect_interface {
+namespace hand_detector {
+
+  MultiHandDetector::MultiHandDetector(TaskScheduler* ts) {
+    shared_forest_ = NULL;
+    forest_ = NULL;
+    num_trees_ = 0;
+    num_sensors_ = 0;
+    im_dim_ = 0;
+    detectors_ = NULL;
+    depth_ = NULL;
+    hands_ = NULL;
+    kinects_ = NULL;
+    num_updates_ = 0;
+    detect_thread_ = NULL;
+    stop_detect_thread_ = false;
+    thread_kinects_ = NULL;
+    thread_num_kinects_ = 0;
+    ts_ = ts;
+    sensor_cbs_ = NULL;
+  }
+
+  MultiHandDetector::~MultiHandDetector() {
+    stop();
+    // The detectors reference forest_, so delete them first
+    for (uint32_t i = 0; i < num_sensors_; i++) {
+      SAFE_DELETE(detectors_[i]);
+      SAFE_DELETE_ARR(depth_[i]);
+    }
+    SAFE_DELETE_ARR(detectors_);
+    SAFE_DELETE_ARR(depth_);
+    SAFE_DELETE_ARR(hands_);
+    SAFE_DELETE(sensor_cbs_);
+    forest_ = NULL;
+    SharedForest::release(shared_forest_);
+  }
+
+  void MultiHandDetector::init(const uint32_t num_sensors,
+    const uint32_t im_width, const uint32_t im_height,
+    const std::string filename) {
+    if (num_sensors == 0) {
+      throw std::wruntime_error("MultiHandDetector::init() - ERROR: "
+        "num_sensors must be positive!");
+    }
+    if (ts_ == NULL) {
+      throw std::wruntime_error("MultiHandDetector::init() - ERROR: "
+        "a task scheduler is required!");
+    }
+
+    shared_forest_ = SharedForest::acquire(filename);
+    forest_ = shared_forest_->forest();
+    num_trees_ = shared_forest_->num_trees();
+    std::cout << "MultiHandDetector() - Decision Forest: " << filename;
+    std::cout << " loaded (shared by " << num_sensors << " sensors)";
+    std::cout << std::endl;
+
+    num_sensors_ = num_sensors;
+    im_dim_ = im_width * im_height;
+    detectors_ = new HandDetector*[num_sensors_];
+    depth_ = new int16_t*[num_sensors_];
+    hands_ = new SensorHands[num_sensors_];
+    sensor_cbs_ = new VectorManaged<Callback<void>*>(num_sensors_);
+    for (uint32_t i = 0; i < num_sensors_; i++) {
+      detectors_[i] = NULL;
+      depth_[i] = NULL;
+    }
+    for (uint32_t i = 0; i < num_sensors_; i++) {
+      detectors_[i] = new HandDetector(ts_);
+      detectors_[i]->init(im_width, im_height, forest_, num_trees_);
+      depth_[i] = new int16_t[im_dim_];
+      memset(&hands_[i], 0, sizeof(hands_[i]));
+      sensor_cbs_->pushBack(MakeCallableMany(&MultiHandDetector::detectSensor,
+        this, i));
+    }
+  }
+
+  uint32_t MultiHandDetector::detect(KinectInterface** kinects,
+    const uint32_t num_kinects) {
+    if (running()) {
+      throw std::wruntime_error("MultiHandDetector::detect() - ERROR: "
+        "detection is already running in the background (see start())!");
+    }
+    return detectNewFrames(kinects, num_kinects);
+  }
+
+  void MultiHandDetector::start(KinectInterface** kinects,
+    const uint32_t num_kinects) {
+    if (running()) {
+      return;
+    }
+    if (num_sensors_ == 0) {
+      throw std::wruntime_error("MultiHandDetector::start() - ERROR: "
+        "init() has not been called!");
+    }
+    thread_kinects_ = kinects;
+    thread_num_kinects_ = num_kinects;
+    stop_detect_thread_ = false;
+    detect_thread_ = new std::thread(&MultiHandDetector::detectThread, this);
+  }
+
+  void MultiHandDetector::stop() {
+    if (!running()) {
+      return;
+    }
+    stop_detect_thread_ = true;
+    detect_thread_->join();
+    SAFE_DELETE(detect_thread_);
+    thread_kinects_ = NULL;
+    thread_num_kinects_ = 0;
+  }
+
+  void MultiHandDetector::detectThread() {
+    while (!stop_detect_thread_) {
+      uint32_t num_updated;
+      {
+        TRACE_SCOPE(TRACE_MULTI_DETECT);
+        num_updated = detectNewFrames(thread_kinects_, thread_num_kinects_);
+      }
+      if (num_updated == 0) {
+        std::this_thread::sleep_for(
+          std::chrono::milliseconds(MHD_IDLE_SLEEP_MS));
+      }
+    }
+  }
+
+  uint32_t MultiHandDetector::detectNewFrames(KinectInterface** kinects,
+    const uint32_t num_kinects) {
+    const uint32_t n = std::min<uint32_t>(num_kinects, num_sensors_);
+    kinects_ = kinects;
+
+    TaskGroup sensors;
+    uint32_t num_tasks = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      // hands_[i] is written by detectSensor() on the scheduler's workers,
+      // but only by the tasks of an earlier call, and the ts_->wait() below
+      // orders those writes before this read.  So no lock is needed as long
+      // as one thread at a time calls this (detect() refuses to run while
+      // the background thread does).
+      if (kinects_[i]->depth_frame_number() > hands_[i].frame_number) {
+        ts_->addTask((*sensor_cbs_)[i], sensors);
+        num_tasks++;
+      }
+    }
+    ts_->wait(sensors);
+
+    kinects_ = NULL;
+    return num_tasks;
+  }
+
+  void MultiHandDetector::detectSensor(const uint32_t sensor) {
+    SensorHands cur_hands;
+    // Get the lock and do as little work within it as possible!
+    kinects_[sensor]->lockData();
+    {
+      memcpy(depth_[sensor], kinects_[sensor]->depth(),
+        sizeof(depth_[sensor][0]) * im_dim_);
+      cur_hands.frame_number = kinects_[sensor]->depth_frame_number();
+      cur_hands.frame_time = kinects_[sensor]->depth_frame_time();
+    }
+    kinects_[sensor]->unlockData();
+    TRACE_SET_FRAME(cur_hands.frame_number);  // Scheduler worker thread
+
+    detectors_[sensor]->findHands(depth_[sensor], cur_hands.rhand_found,
+      cur_hands.lhand_found, cur_hands.rhand_uvd, cur_hands.lhand_uvd);
+
+    std::unique_lock<std::mutex> ul_results(results_lock_);
+    hands_[sensor] = cur_hands;
+    ul_results.unlock();
+    num_updates_++;
+  }
+
+  void MultiHandDetector::sensorHands(const uint32_t sensor,
+    SensorHands& hands) {
+    if (sensor >= num_sensors_) {
+      throw std::wruntime_error("MultiHandDetector::sensorHands() - ERROR: "
+        "sensor index out of range!");
+    }
+    std::unique_lock<std::mutex> ul(results_lock_);
+    hands = hands_[sensor];
+    ul.unlock();
+  }
+
+};  // namespace hand_detector
+};  // namespace kinect_interface
@@ -0,0 +1,292 @@
+#include <cmath>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include "kinect_interface/hand_net/grid_normal_engine.h"
+#include "kinect_interface/task_scheduler.h"
+#include "jtil/data_str/vector_managed.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+using jtil::data_str::VectorManaged;
+using jtil::threading::Callback;
+using namespace jtil::threading;
+using jtil::math::Int4;
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+
+namespace kinect_interface {
+namespace hand_net {
+
+  namespace {
+    inline void sub3(float* ret, const float* a, const float* b) {
+      ret[0] = a[0] - b[0];
+      ret[1] = a[1] - b[1];
+      ret[2] = a[2] - b[2];
+    }
+
+    inline void cross3(float* ret, const float* a, const float* b) {
+      ret[0] = a[1] * b[2] - a[2] * b[1];
+      ret[1] = a[2] * b[0] - a[0] * b[2];
+      ret[2] = a[0] * b[1] - a[1] * b[0];
+    }
+
+    inline float length3(const float* a) {
+      return sqrtf(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    }
+
+    // Same arithmetic as Float3::normalize (scale by one over the length)
+    inline void normalize3(float* a) {
+      const float one_over_len = 1.0f / length3(a);
+      a[0] *= one_over_len;
+      a[1] *= one_over_len;
+      a[2] *= one_over_len;
+    }
+
+    // The angle at pt1 of the triangle (pt0, pt1, pt2).  Same arithmetic as
+    // the old HandImageGenerator::calcAngleSafe, except that a zero length
+    // edge gives a zero angle instead of NaN.
+    inline float calcAngleSafe(const float* pt0, const float* pt1,
+      const float* pt2) {
+      float e1[3], e2[3];
+      sub3(e1, pt0, pt1);
+      sub3(e2, pt2, pt1);
+      if (length3(e1) <= 0 || length3(e2) <= 0) {
+        return 0;
+      }
+      normalize3(e1);
+      normalize3(e2);
+      float dot = e1[0] * e2[0] + e1[1] * e2[1] + e1[2] * e2[2];
+      dot = dot > 1 ? 1 : dot;
+      dot = dot < -1 ? -1 : dot;
+      return acosf(dot);
+    }
+
+    // FaceWeight<M>::weight - scale applied to the un-normalized face normal
+    // (the cross product of two edges) for the vertex self.
+    template <NormalApproximationMethod M>
+    struct FaceWeight;
+
+    template <>
+    struct FaceWeight<BasicNormalApproximation> {
+      // Unit face normals (no weighting)
+      static inline float weight(const float* normal, const float* self,
+        const float* other0, const float* other1) {
+        const float len = length3(normal);
+        return len > 0 ? 1.0f / len : 0.0f;
+      }
+    };
+
+    template <>
+    struct FaceWeight<SimpleNormalApproximation> {
+      // The cross product length is 2 x the triangle area
+      static inline float weight(const float* normal, const float* self,
+        const float* other0, const float* other1) {
+        return 1.0f;
+      }
+    };
+
+    template <>
+    struct FaceWeight<RobustNormalApproximation> {
+      // Weight by the angle the face forms at the vertex
+      static inline float weight(const float* normal, const float* self,
+        const float* other0, const float* other1) {
+        return calcAngleSafe(other0, self, other1);
+      }
+    };
+  }  // unnamed namespace
+
+  GridNormalEngine::GridNormalEngine(TaskScheduler* ts) {
+    width_ = 0;
+    height_ = 0;
+    normals_xyz_ = NULL;
+    xyz_ = NULL;
+    labels_ = NULL;
+    method_ = BasicNormalApproximation;
+    ts_ = ts;
+    num_bands_ = 0;
+    band_cbs_ = NULL;
+  }
+
+  GridNormalEngine::~GridNormalEngine() {
+    SAFE_DELETE(band_cbs_);
+  }
+
+  void GridNormalEngine::init(const uint32_t width, const uint32_t height) {
+    if (width < 2 || height < 2) {
+      throw std::wruntime_error("GridNormalEngine::init() - ERROR: image "
+        "is too small!");
+    }
+    width_ = width;
+    height_ = height;
+    num_bands_ = ts_ != NULL ? ts_->num_threads() : 1;
+    band_cbs_ = new VectorManaged<Callback<void>*>(num_bands_);
+    for (uint32_t i = 0; i < num_bands_; i++) {
+      band_cbs_->pushBack(MakeCallableMany(&GridNormalEngine::calcNormalsBand,
+        this, i));
+    }
+  }
+
+  void GridNormalEngine::calcNormals(float* normals_xyz, const float* xyz,
+    const uint8_t* labels, const NormalApproximationMethod method) {
+    normals_xyz_ = normals_xyz;
+    xyz_ = xyz;
+    labels_ = labels;
+    method_ = method;
+
+    memset(normals_xyz_, 0, sizeof(normals_xyz_[0]) * width_ * height_ * 3);
+    if (!calcLabelBBox()) {
+      return;  // No labeled pixels
+    }
+
+    runTasks(ts_, band_cbs_);
+  }
+
+  bool GridNormalEngine::calcLabelBBox() {
+    int32_t u_min = (int32_t)width_;
+    int32_t u_max = -1;
+    int32_t v_min = (int32_t)height_;
+    int32_t v_max = -1;
+    for (int32_t v = 0; v < (int32_t)height_; v++) {
+      const uint8_t* label_row = &labels_[v * width_];
+      int32_t u = 0;
+      for (; u < (int32_t)width_ && label_row[u] == 0; u++);
+      if (u == (int32_t)width_) {
+        continue;  // Empty row
+      }
+      u_min = std::min<int32_t>(u_min, u);
+      for (u = (int32_t)width_ - 1; label_row[u] == 0; u--);
+      u_max = std::max<int32_t>(u_max, u);
+      v_min = std::min<int32_t>(v_min, v);
+      v_max = v;
+    }
+    label_bbox_.set(u_min, v_min, u_max, v_max);
+    return v_max >= 0;
+  }
+
+  void GridNormalEngine::calcNormalsBand(const uint32_t band) {
+    const int32_t v_min = label_bbox_[1];
+    const int32_t n_rows = label_bbox_[3] - v_min + 1;
+    const int32_t v_start = v_min + (band * n_rows) / num_bands_;
+    const int32_t v_end = v_min + ((band + 1) * n_rows) / num_bands_;
+    switch (method_) {
+    case BasicNormalApproximation:
+      calcNormalsRows<BasicNormalApproximation>(v_start, v_end);
+      break;
+    case SimpleNormalApproximation:
+      calcNormalsRows<SimpleNormalApproximation>(v_start, v_end);
+      break;
+    case RobustNormalApproximation:
+      calcNormalsRows<RobustNormalApproximation>(v_start, v_end);
+      break;
+    }
+  }
+
+  template <NormalApproximationMethod M>
+  void GridNormalEngine::calcNormalsRows(const int32_t v_start,
+    const int32_t v_end) {
+    const int32_t w = (int32_t)width_;
+    const int32_t h = (int32_t)height_;
+    for (int32_t v = v_start; v < v_end; v++) {
+      for (int32_t u = label_bbox_[0]; u <= label_bbox_[2]; u++) {
+        const int32_t p = v * w + u;
+        if (labels_[p] == 0) {
+          continue;  // Not a vertex of any face
+        }
+        // Gather the faces of the (up to) 4 quads that share this pixel
+        float acc[3] = {0, 0, 0};
+        if (v > 0 && u > 0) {
+          addQuadFaces<M>(acc, p, u - 1, v - 1);
+        }
+        if (v > 0 && u < w - 1) {
+          addQuadFaces<M>(acc, p, u, v - 1);
+        }
+        if (v < h - 1 && u > 0) {
+          addQuadFaces<M>(acc, p, u - 1, v);
+        }
+        if (v < h - 1 && u < w - 1) {
+          addQuadFaces<M>(acc, p, u, v);
+        }
+        if (length3(acc) > 0) {
+          normalize3(acc);
+          normals_xyz_[p * 3] = acc[0];
+          normals_xyz_[p * 3 + 1] = acc[1];
+          normals_xyz_[p * 3 + 2] = acc[2];
+        }
+      }
+    }
+  }
+
+  // The quad with top left pixel (u, v).  Same faces (and winding) as
+  // HandImageGenerator::createHandMeshIndices.
+  template <NormalApproximationMethod M>
+  void GridNormalEngine::addQuadFaces(float* acc, const int32_t p,
+    const int32_t u, const int32_t v) const {
+    const int32_t p0 = v * width_ + u;  // top left
+    const int32_t p1 = v * width_ + (u + 1);  // top right
+    const int32_t p2 = (v + 1) * width_ + u;  // bottom left
+    const int32_t p3 = (v + 1) * width_ + (u + 1);  // bottom right
+    uint32_t verts_case = 0;
+    if (labels_[p0] != 0) {
+      verts_case = verts_case | 1;
+    }
+    if (labels_[p1] != 0) {
+      verts_case = verts_case | 2;
+    }
+    if (labels_[p2] != 0) {
+      verts_case = verts_case | 4;
+    }
+    if (labels_[p3] != 0) {
+      verts_case = verts_case | 8;
+    }
+    // Recall: Front face is counter-clockwise
+    switch (verts_case) {
+    case 7:  // 0111 = p2 & p1 & p0
+      addFace<M>(acc, p, p0, p2, p1);
+      break;
+    case 11:  // 1011 = p3 & p1 & p0
+      addFace<M>(acc, p, p0, p3, p1);
+      break;
+    case 13:  // 1101 = p3 & p2 & p0
+      addFace<M>(acc, p, p0, p2, p3);
+      break;
+    case 14:  // 1110 = p3 & p2 & p1
+      addFace<M>(acc, p, p1, p2, p3);
+      break;
+    case 15:  // 1111 = p3 & p2 & p1 & p0
+      addFace<M>(acc, p, p0, p2, p1);
+      addFace<M>(acc, p, p3, p1, p2);
+      break;
+    }
+  }
+
+  template <NormalApproximationMethod M>
+  void GridNormalEngine::addFace(float* acc, const int32_t p,
+    const int32_t v1, const int32_t v2, const int32_t v3) const {
+    const float* x1 = &xyz_[v1 * 3];
+    const float* x2 = &xyz_[v2 * 3];
+    const float* x3 = &xyz_[v3 * 3];
+    // The other two vertices, in the same order as the old scatter loop
+    const float* self;
+    const float* other0;
+    const float* other1;
+    if (p == v1) {
+      self = x1; other0 = x3; other1 = x2;
+    } else if (p == v2) {
+      self = x2; other0 = x1; other1 = x3;
+    } else if (p == v3) {
+      self = x3; other0 = x2; other1 = x1;
+    } else {
+      return;  // p isn't a vertex of this face
+    }
+    float e1[3], e2[3], normal[3];
+    sub3(e1, x1, x2);
+    sub3(e2, x3, x2);
+    cross3(normal, e1, e2);
+    const float weight = FaceWeight<M>::weight(normal, self, other0, other1);
+    acc[0] += normal[0] * weight;
+    acc[1] += normal[1] * weight;
+    acc[2] += normal[2] * weight;
+  }
+
+};  // namespace hand_net
+};  // namespace kinect_interface
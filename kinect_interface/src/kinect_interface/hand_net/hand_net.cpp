@@ -14,6 +14,7 @@
 #include "jtorch/tensor.h"
 #include "kinect_interface/hand_net/hand_model_coeff.h"  // for HandCoeff
 #include "kinect_interface/hand_net/hand_model.h"  // for HandModel
+#include "kinect_interface/trace.h"
 #include "jtil/image_util/image_util.h"
 #include "jtil/data_str/vector.h"
 #include "jtil/exceptions/wruntime_error.h"
@@ -191,6 +192,7 @@ namespace hand_net {
 
   void HandNet::calcConvnetHeatMap(const int16_t* depth, 
     const uint8_t* label) {
+    TRACE_SCOPE(TRACE_CONVNET);
     if (conv_network_ == NULL || image_generator_ == NULL) {
       std::cout << "HandNet::calcHandCoeff() - ERROR: Convnet not loaded";
       std::cout << " from file!" << std::endl;
@@ -266,6 +268,7 @@ namespace hand_net {
 
   void HandNet::calcConvnetPose(const int16_t* depth, const uint8_t* label,
     const float smoothing_factor, const uint64_t max_pso_iterations) {
+    TRACE_SCOPE(TRACE_PSO);
     // Try fitting in projected space from the rest pose:
     rhand_prev_pose_->copyCoeffFrom(rhand_cur_pose_);
     g_hand_net_ = this;
@@ -13,6 +13,8 @@
 #include "jtil/settings/settings_manager.h"
 #include "jtil/exceptions/wruntime_error.h"
 #include "kinect_interface/kinect_interface.h"
+#include "kinect_interface/depth_ray_table.h"
+#include "kinect_interface/trace.h"
 #include "jtil/threading/thread_pool.h"
 #include "jtil/renderer/camera/camera.h"
 #include "Kinect.h"
@@ -67,6 +69,34 @@ namespace kinect_interface {
   Vector<KinectInterface*> KinectInterface::open_kinects_;
   std::recursive_mutex KinectInterface::sdk_static_lock_;
 
+  // The approximate (FOV based) model only depends on constants, so one ray
+  // table is shared by every KinectInterface.  It's built the first time it
+  // is used (and only then, since it's two depth sized float arrays).
+  namespace {
+    struct ApproxRayTable {
+      DepthRayTable* table;
+      std::once_flag init_once;
+      ApproxRayTable() {
+        table = NULL;
+      }
+      ~ApproxRayTable() {
+        SAFE_DELETE(table);
+      }
+    };
+    ApproxRayTable approx_ray_table;
+
+    void initApproxRayTable() {
+      approx_ray_table.table = new DepthRayTable();
+      approx_ray_table.table->initApprox(depth_w, depth_h, depth_hfov_fit,
+        depth_vfov_fit);
+    }
+
+    const DepthRayTable& approxRayTable() {
+      std::call_once(approx_ray_table.init_once, initApproxRayTable);
+      return *approx_ray_table.table;
+    }
+  }
+
   KinectInterface::KinectInterface(const char* device_id) {
     sdk_static_lock_.lock();
     device_initialized_ = false;
@@ -75,6 +105,7 @@ namespace kinect_interface {
     rgb_frame_reader_ = NULL;
     coord_mapper_ = NULL;
     body_frame_reader_ = NULL;
+    ray_table_ = NULL;
 
     // NOTE: depth_ and depth_colored_ are actually one contiguous array:
     // depth_colored_ just indexes into depth_
@@ -111,6 +142,7 @@ namespace kinect_interface {
       SafeRelease(body_frame_reader_);
       SafeRelease(kinect_sensor_);
     }
+    SAFE_DELETE(ray_table_);
   }
 
   // ************************************************************
@@ -323,6 +355,7 @@ namespace kinect_interface {
       data_lock_.lock();
 
       if (SUCCEEDED(hr) && depth_frame != NULL) {
+        TRACE_SCOPE(TRACE_CAPTURE);
         new_depth = true;
 
         // Copy over the underlying data
@@ -341,6 +374,8 @@ namespace kinect_interface {
         depth_frame_number_++;
         // Kinect time stamp is in units of 100ns (or 0.1us)
         depth_frame->get_RelativeTime(&depth_frame_time_);
+        TRACE_SET_FRAME(depth_frame_number_);
+        TRACE_SENSOR_FRAME(depth_frame_number_, 100 * depth_frame_time_);
         if (depth_first_frame_time_ == -1) {
           depth_first_frame_time_ = depth_frame_time_;
         }
@@ -426,6 +461,7 @@ namespace kinect_interface {
 
       // ***** Aquire the colored depth frame *****
       if (new_depth && sync_depth_colored_) {
+        TRACE_SCOPE(TRACE_CONVERT);
         CALL_SAFE(coord_mapper_->MapDepthFrameToColorSpace(depth_dim, 
           (UINT16*)depth_, depth_dim, (ColorSpacePoint*)uv_depth_2_rgb_),
           "could not map depth frame to rgb space");
@@ -450,9 +486,33 @@ namespace kinect_interface {
 
       // ***** Aquire the XYZ frame *****
       if (new_depth && sync_xyz_) {
+        TRACE_SCOPE(TRACE_CONVERT);
         //convertDepthFrameToApproxXYZ(depth_dim, depth_, xyz_);
-        coord_mapper_->MapDepthFrameToCameraSpace(depth_dim, depth_, depth_dim,
-          (CameraSpacePoint*)xyz_);
+        if (ray_table_ == NULL) {
+          // The SDK's table may not be ready until the sensor is streaming,
+          // so keep trying until it is.
+          uint32_t cnt = 0;
+          PointF* table_pts = NULL;
+          hr = coord_mapper_->GetDepthFrameToCameraSpaceTable(&cnt, 
+            &table_pts);
+          if (SUCCEEDED(hr) && cnt == depth_dim) {
+            ray_table_ = new DepthRayTable();
+            ray_table_->initFromLookupTable(depth_w, depth_h, 
+              (XYPoint*)table_pts);
+            // Same as MapDepthFrameToCameraSpace for missing depth
+            ray_table_->setZeroDepthValue(
+              -std::numeric_limits<float>::infinity());
+          }
+          if (table_pts != NULL) {
+            CoTaskMemFree(table_pts);
+          }
+        }
+        if (ray_table_ != NULL) {
+          ray_table_->convert(depth_, xyz_);
+        } else {
+          coord_mapper_->MapDepthFrameToCameraSpace(depth_dim, depth_, 
+            depth_dim, (CameraSpacePoint*)xyz_);
+        }
       }
 
       // ***** Aquire the body frame *****
@@ -690,53 +750,23 @@ namespace kinect_interface {
     }
   }
 
-  // FROM: XnOpenNI.cpp (and slightly edited)
   void KinectInterface::convertDepthFrameToApproxXYZ(const uint32_t n_pts, 
     const uint16_t* depth, XYZPoint* xyz) {
-    float depth_vfov_rad = 2.0f * (float)M_PI * (depth_vfov_fit / 360.0f);
-    float depth_hfov_rad = 2.0f * (float)M_PI * (depth_hfov_fit / 360.0f);
-    float fXToZ = tanf(depth_hfov_rad / 2) * 2;
-    float fYToZ = tanf(depth_vfov_rad / 2) * 2;
-    
-    for (uint32_t i = 0; i < n_pts; i++) {
-      float uvd[3] = {(float)(i % depth_w), (float)(i / depth_w), (float)depth[i]};
-      float fNormalizedX = (uvd[0] / depth_w - 0.5f);
-      xyz[i].x = (float)(fNormalizedX * uvd[2] * fXToZ);
-      
-      float fNormalizedY = (0.5f - uvd[1] / depth_h);
-      xyz[i].y = (float)(fNormalizedY * uvd[2] * fYToZ);
-      
-      xyz[i].z = uvd[2];
-
-      // The new kinect has units in meters
-      xyz[i].x *= (1.0f / 1000.0f);
-      xyz[i].y *= (1.0f / 1000.0f);
-      xyz[i].z *= (1.0f / 1000.0f);
-    }
+    // XYZPoint is 3 packed floats (checked in init())
+    convertDepthFrameToApproxXYZ(n_pts, depth, reinterpret_cast<float*>(xyz));
   }
 
-  // FROM: XnOpenNI.cpp (and slightly edited)
   void KinectInterface::convertDepthFrameToApproxXYZ(const uint32_t n_pts, 
     const uint16_t* depth, float* xyz) {
-    float depth_vfov_rad = 2.0f * (float)M_PI * (depth_vfov_fit / 360.0f);
-    float depth_hfov_rad = 2.0f * (float)M_PI * (depth_hfov_fit / 360.0f);
-    float fXToZ = tanf(depth_hfov_rad / 2) * 2;
-    float fYToZ = tanf(depth_vfov_rad / 2) * 2;
-    
-    for (uint32_t i = 0; i < n_pts; i++) {
-      float uvd[3] = {(float)(i % depth_w), (float)(i / depth_w), (float)depth[i]};
-      float fNormalizedX = (uvd[0] / depth_w - 0.5f);
-      xyz[i*3] = (float)(fNormalizedX * uvd[2] * fXToZ);
-      
-      float fNormalizedY = (0.5f - uvd[1] / depth_h);
-      xyz[i*3+1] = (float)(fNormalizedY * uvd[2] * fYToZ);
-      
-      xyz[i*3+2] = uvd[2];
-
-      // The new kinect has units in meters
-      xyz[i*3] *= (1.0f / 1000.0f);
-      xyz[i*3+1] *= (1.0f / 1000.0f);
-      xyz[i*3+2] *= (1.0f / 1000.0f);
+    if (n_pts > depth_dim) {
+      throw std::wruntime_error("KinectInterface::"
+        "convertDepthFrameToApproxXYZ() - ERROR: n_pts > depth_dim!");
+    }
+    if (n_pts == depth_dim) {
+      approxRayTable().convert(depth, xyz);
+    } else {
+      // Partial frame (pixels are in raster order starting at (0, 0))
+      approxRayTable().convertPartial(n_pts, depth, xyz);
     }
   }
 
@@ -0,0 +1,264 @@
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include "kinect_interface/task_scheduler.h"
+#include "jtil/data_str/vector_managed.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+using jtil::data_str::VectorManaged;
+using jtil::threading::Callback;
+
+#define SAFE_DELETE(x) do { if (x != NULL) { delete x; x = NULL; } } while (0);
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+
+namespace kinect_interface {
+
+  std::mutex TaskScheduler::instance_lock_;
+  TaskScheduler* TaskScheduler::instance_ = NULL;
+  uint32_t TaskScheduler::instance_num_workers_ = 0;
+
+  TaskGroup::TaskGroup() {
+    pending_ = 0;
+  }
+
+  TaskGroup::~TaskGroup() {
+    // Nothing to do: wait() guarantees no task still references the group
+  }
+
+  TaskScheduler* TaskScheduler::get() {
+    std::unique_lock<std::mutex> ul(instance_lock_);
+    if (instance_ == NULL) {
+      instance_ = new TaskScheduler(instance_num_workers_ != 0 ?
+        instance_num_workers_ : defaultNumWorkers());
+    }
+    return instance_;
+  }
+
+  void TaskScheduler::init(const uint32_t num_workers) {
+    if (num_workers == 0 || num_workers > TASK_SCHEDULER_MAX_WORKERS) {
+      throw std::wruntime_error("TaskScheduler::init() - ERROR: "
+        "num_workers is out of range!");
+    }
+    std::unique_lock<std::mutex> ul(instance_lock_);
+    if (instance_ != NULL && instance_->num_workers() != num_workers) {
+      throw std::wruntime_error("TaskScheduler::init() - ERROR: the "
+        "scheduler is already running with a different number of workers!");
+    }
+    instance_num_workers_ = num_workers;
+  }
+
+  void TaskScheduler::shutdown() {
+    std::unique_lock<std::mutex> ul(instance_lock_);
+    SAFE_DELETE(instance_);
+  }
+
+  uint32_t TaskScheduler::defaultNumWorkers() {
+    // hardware_concurrency() may return 0 if it can't tell
+    const uint32_t num_cores = std::thread::hardware_concurrency();
+    if (num_cores <= 1) {
+      return 1;
+    }
+    return std::min<uint32_t>(num_cores - 1, TASK_SCHEDULER_MAX_WORKERS);
+  }
+
+  TaskScheduler::TaskScheduler(const uint32_t num_workers) {
+    num_workers_ = num_workers;
+    num_queued_ = 0;
+    next_deque_ = 0;
+    started_ = false;
+    stopping_ = false;
+    deques_ = new TaskDeque[num_workers_];
+    worker_ids_ = new std::thread::id[num_workers_];
+    workers_ = new std::thread*[num_workers_];
+    for (uint32_t i = 0; i < num_workers_; i++) {
+      workers_[i] = new std::thread(&TaskScheduler::workerThread, this, i);
+      worker_ids_[i] = workers_[i]->get_id();
+    }
+    // The workers don't touch anything until worker_ids_ is filled in
+    std::unique_lock<std::mutex> ul(idle_lock_);
+    started_ = true;
+    idle_.notify_all();
+  }
+
+  TaskScheduler::~TaskScheduler() {
+    std::unique_lock<std::mutex> ul(idle_lock_);
+    stopping_ = true;
+    idle_.notify_all();
+    ul.unlock();
+    for (uint32_t i = 0; i < num_workers_; i++) {
+      workers_[i]->join();
+      SAFE_DELETE(workers_[i]);
+    }
+    SAFE_DELETE_ARR(workers_);
+    SAFE_DELETE_ARR(worker_ids_);
+    SAFE_DELETE_ARR(deques_);
+  }
+
+  void TaskScheduler::addTask(Callback<void>* cb, TaskGroup& group,
+    TaskGroup* after) {
+    ScheduledTask task;
+    task.cb = cb;
+    task.group = &group;
+
+    std::unique_lock<std::mutex> ul_group(group.lock_);
+    group.pending_++;
+    ul_group.unlock();
+
+    if (after != NULL) {
+      std::unique_lock<std::mutex> ul_after(after->lock_);
+      if (after->pending_ > 0) {
+        // finishTask() queues it when the last task of after is done
+        after->dependents_.push_back(task);
+        return;
+      }
+    }
+    queueTask(task);
+  }
+
+  void TaskScheduler::addTasks(VectorManaged<Callback<void>*>* cbs,
+    TaskGroup& group, TaskGroup* after) {
+    for (uint32_t i = 0; i < cbs->size(); i++) {
+      addTask((*cbs)[i], group, after);
+    }
+  }
+
+  void TaskScheduler::wait(TaskGroup& group) {
+    const int32_t worker = workerIndex();
+    while (!group.finished()) {
+      if (runTask(worker)) {
+        continue;
+      }
+      // Nothing to run here: the rest of the group is running on other
+      // threads (or waiting on a dependency)
+      std::unique_lock<std::mutex> ul(idle_lock_);
+      while (!group.finished() && num_queued_ == 0) {
+        idle_.wait(ul);
+      }
+    }
+    // The thread that finished the group may still be holding its lock
+    std::unique_lock<std::mutex> ul_group(group.lock_);
+  }
+
+  void TaskScheduler::run(VectorManaged<Callback<void>*>* cbs) {
+    TaskGroup group;
+    addTasks(cbs, group);
+    wait(group);
+  }
+
+  void TaskScheduler::workerThread(const uint32_t worker) {
+    std::unique_lock<std::mutex> ul(idle_lock_);
+    while (!started_) {
+      idle_.wait(ul);
+    }
+    ul.unlock();
+
+    while (true) {
+      if (runTask(worker)) {
+        continue;
+      }
+      ul.lock();
+      while (num_queued_ == 0 && !stopping_) {
+        idle_.wait(ul);
+      }
+      const bool done = num_queued_ == 0;  // Always drain before stopping
+      ul.unlock();
+      if (done) {
+        return;
+      }
+    }
+  }
+
+  int32_t TaskScheduler::workerIndex() const {
+    const std::thread::id id = std::this_thread::get_id();
+    for (uint32_t i = 0; i < num_workers_; i++) {
+      if (worker_ids_[i] == id) {
+        return (int32_t)i;
+      }
+    }
+    return -1;
+  }
+
+  void TaskScheduler::queueTask(const ScheduledTask& task) {
+    const int32_t worker = workerIndex();
+    const uint32_t dst = worker >= 0 ? (uint32_t)worker :
+      (next_deque_++) % num_workers_;
+    std::unique_lock<std::mutex> ul_deque(deques_[dst].lock);
+    deques_[dst].tasks.push_back(task);
+    ul_deque.unlock();
+
+    std::unique_lock<std::mutex> ul(idle_lock_);
+    num_queued_++;
+    idle_.notify_all();  // Waiters can take it too, not just idle workers
+  }
+
+  bool TaskScheduler::popTask(const int32_t worker, ScheduledTask& task) {
+    if (num_queued_ == 0) {
+      return false;
+    }
+    // Newest task from our own deque first
+    if (worker >= 0) {
+      TaskDeque& own = deques_[worker];
+      std::unique_lock<std::mutex> ul(own.lock);
+      if (!own.tasks.empty()) {
+        task = own.tasks.back();
+        own.tasks.pop_back();
+        num_queued_--;
+        return true;
+      }
+    }
+    // Then steal the oldest task from someone else
+    const uint32_t start = worker >= 0 ? (uint32_t)worker + 1 : 0;
+    for (uint32_t i = 0; i < num_workers_; i++) {
+      TaskDeque& other = deques_[(start + i) % num_workers_];
+      std::unique_lock<std::mutex> ul(other.lock);
+      if (!other.tasks.empty()) {
+        task = other.tasks.front();
+        other.tasks.pop_front();
+        num_queued_--;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool TaskScheduler::runTask(const int32_t worker) {
+    ScheduledTask task;
+    if (!popTask(worker, task)) {
+      return false;
+    }
+    (*task.cb)();
+    finishTask(*task.group);
+    return true;
+  }
+
+  void TaskScheduler::finishTask(TaskGroup& group) {
+    std::vector<ScheduledTask> dependents;
+    std::unique_lock<std::mutex> ul_group(group.lock_);
+    const bool finished = --group.pending_ == 0;
+    if (finished) {
+      dependents.swap(group.dependents_);
+    }
+    ul_group.unlock();
+    // group may be destroyed from here on (once a waiter gets its lock)
+
+    if (!finished) {
+      return;
+    }
+    for (uint32_t i = 0; i < dependents.size(); i++) {
+      queueTask(dependents[i]);
+    }
+    std::unique_lock<std::mutex> ul(idle_lock_);
+    idle_.notify_all();
+  }
+
+  void runTasks(TaskScheduler* ts, VectorManaged<Callback<void>*>* cbs) {
+    if (ts == NULL) {
+      for (uint32_t i = 0; i < cbs->size(); i++) {
+        (*(*cbs)[i])();
+      }
+      return;
+    }
+    ts->run(cbs);
+  }
+
+};  // namespace kinect_interface
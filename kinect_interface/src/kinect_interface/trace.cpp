@@ -0,0 +1,298 @@
+#include <cstring>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include "kinect_interface/trace.h"
+#include "jtil/clk/clk.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+// __declspec(thread) only holds PODs, which is all we need
+#if defined(_MSC_VER) && _MSC_VER < 1900
+  #define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+  #define TRACE_THREAD_LOCAL thread_local
+#endif
+
+#define TRACE_NUM_BUCKETS 24  // log2(us): [0, 1us), [1, 2us), ... >= 4s
+
+using std::wruntime_error;
+
+namespace kinect_interface {
+
+  namespace {
+
+    struct TraceEvent {
+      int64_t start;
+      int64_t end;
+      uint64_t frame_id;
+      uint32_t stage;
+      uint32_t tid;
+    };
+
+    // The exporter may read a slot while its thread overwrites it, so the
+    // fields are (relaxed) atomics.  On x86 these are plain loads and stores.
+    struct TraceSlot {
+      std::atomic<int64_t> start;
+      std::atomic<int64_t> end;
+      std::atomic<uint64_t> frame_id;
+      std::atomic<uint32_t> stage;
+    };
+
+    // Only the owning thread writes to a buffer.  count is the number of
+    // events ever written, so the newest event is at (count - 1) % size.
+    struct TraceBuffer {
+      uint32_t tid;
+      std::atomic<uint64_t> count;
+      std::atomic<uint64_t> cleared;  // count at the last Tracer::clear()
+      TraceSlot events[TRACE_BUFFER_SIZE];
+    };
+
+    jtil::clk::Clk trace_clk;
+    // Buffers are never freed: the events of threads that have exited are
+    // still exported
+    std::mutex buffers_lock;
+    std::vector<TraceBuffer*> buffers;
+    std::atomic<int64_t> sensor_offset(std::numeric_limits<int64_t>::max());
+
+    TRACE_THREAD_LOCAL TraceBuffer* cur_buffer = NULL;
+    TRACE_THREAD_LOCAL uint64_t cur_frame = 0;
+
+    const char* stage_names[TRACE_NUM_STAGES] = {
+      "sensor",
+      "capture",
+      "convert",
+      "detect",
+      "forest_eval",
+      "label_filter",
+      "flood_fill",
+      "convnet",
+      "pso",
+      "multi_detect",
+      "app_copy",
+      "render",
+      "app_frame",
+    };
+
+    TraceBuffer* threadBuffer() {
+      if (cur_buffer == NULL) {
+        TraceBuffer* buffer = new TraceBuffer();
+        buffer->count = 0;
+        buffer->cleared = 0;
+        std::unique_lock<std::mutex> ul(buffers_lock);
+        buffer->tid = (uint32_t)buffers.size();
+        buffers.push_back(buffer);
+        ul.unlock();
+        cur_buffer = buffer;
+      }
+      return cur_buffer;
+    }
+
+    // collect - Copy every buffered event.  Recording may carry on while we
+    // copy, so anything the writer could have overwritten during the copy
+    // is thrown away.
+    void collect(std::vector<TraceEvent>& events) {
+      std::unique_lock<std::mutex> ul(buffers_lock);
+      for (uint32_t i = 0; i < buffers.size(); i++) {
+        TraceBuffer* buffer = buffers[i];
+        const uint64_t end = buffer->count.load(std::memory_order_acquire);
+        uint64_t start = end > TRACE_BUFFER_SIZE ? end - TRACE_BUFFER_SIZE : 0;
+        start = std::max<uint64_t>(start, buffer->cleared.load());
+        const size_t first = events.size();
+        for (uint64_t j = start; j < end; j++) {
+          const TraceSlot& slot = buffer->events[j & (TRACE_BUFFER_SIZE - 1)];
+          TraceEvent event;
+          event.start = slot.start.load(std::memory_order_relaxed);
+          event.end = slot.end.load(std::memory_order_relaxed);
+          event.frame_id = slot.frame_id.load(std::memory_order_relaxed);
+          event.stage = slot.stage.load(std::memory_order_relaxed);
+          event.tid = buffer->tid;
+          events.push_back(event);
+        }
+        // Pairs with the fence in record(): if we read anything written for
+        // event j + size, we see a count of at least j + size here
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t end_after =
+          buffer->count.load(std::memory_order_relaxed);
+        if (end > start && end_after >= start + TRACE_BUFFER_SIZE) {
+          const uint64_t num_stale = std::min<uint64_t>(end - start,
+            end_after - (start + TRACE_BUFFER_SIZE) + 1);
+          events.erase(events.begin() + first,
+            events.begin() + first + (size_t)num_stale);
+        }
+      }
+    }
+
+    void openFile(std::ofstream& file, const std::string& filename) {
+      file.open(filename.c_str(), std::ios::out);
+      if (!file.is_open()) {
+        throw wruntime_error(std::string("Tracer - ERROR: Could not open ") +
+          filename);
+      }
+    }
+
+    uint32_t bucket(const int64_t duration_ns) {
+      int64_t us = duration_ns / 1000;
+      uint32_t b = 0;
+      while (us > 0 && b < TRACE_NUM_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+      }
+      return b;
+    }
+
+    // writeHistogram - sorts durations
+    void writeHistogram(std::ofstream& file, const char* name,
+      std::vector<int64_t>& durations) {
+      file << name << ": count " << durations.size();
+      if (durations.size() == 0) {
+        file << std::endl << std::endl;
+        return;
+      }
+      std::sort(durations.begin(), durations.end());
+      double sum = 0;
+      uint64_t counts[TRACE_NUM_BUCKETS];
+      memset(counts, 0, sizeof(counts));
+      for (size_t i = 0; i < durations.size(); i++) {
+        sum += (double)durations[i];
+        counts[bucket(durations[i])]++;
+      }
+      const size_t n = durations.size();
+      file << ", mean " << 1e-3 * sum / (double)n << "us";
+      file << ", p50 " << 1e-3 * (double)durations[(n - 1) / 2] << "us";
+      file << ", p99 " << 1e-3 * (double)durations[(n - 1) * 99 / 100] << "us";
+      file << ", max " << 1e-3 * (double)durations[n - 1] << "us" << std::endl;
+      for (uint32_t b = 0; b < TRACE_NUM_BUCKETS; b++) {
+        if (counts[b] == 0) {
+          continue;
+        }
+        const int64_t lo = b == 0 ? 0 : ((int64_t)1 << (b - 1));
+        file << "  [" << lo << "us, ";
+        if (b == TRACE_NUM_BUCKETS - 1) {
+          file << "inf)";
+        } else {
+          file << ((int64_t)1 << b) << "us)";
+        }
+        file << " " << counts[b] << std::endl;
+      }
+      file << std::endl;
+    }
+
+  };  // unnamed namespace
+
+  int64_t Tracer::now() {
+    return (int64_t)(trace_clk.getTime() * 1e9);
+  }
+
+  void Tracer::record(const TraceStage stage, const uint64_t frame_id,
+    const int64_t start, const int64_t end) {
+    TraceBuffer* buffer = threadBuffer();
+    const uint64_t count = buffer->count.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceSlot& slot = buffer->events[count & (TRACE_BUFFER_SIZE - 1)];
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    slot.frame_id.store(frame_id, std::memory_order_relaxed);
+    slot.stage.store((uint32_t)stage, std::memory_order_relaxed);
+    buffer->count.store(count + 1, std::memory_order_release);
+  }
+
+  void Tracer::setFrame(const uint64_t frame_id) {
+    cur_frame = frame_id;
+  }
+
+  uint64_t Tracer::frame() {
+    return cur_frame;
+  }
+
+  void Tracer::recordSensorFrame(const uint64_t frame_id,
+    const int64_t sensor_time_ns) {
+    const int64_t t = now();
+    const int64_t offset = t - sensor_time_ns;
+    int64_t min_offset = sensor_offset.load();
+    while (offset < min_offset &&
+      !sensor_offset.compare_exchange_weak(min_offset, offset)) {
+    }
+    min_offset = std::min<int64_t>(offset, min_offset);
+    record(TRACE_SENSOR, frame_id, sensor_time_ns + min_offset, t);
+  }
+
+  void Tracer::exportChromeTrace(const std::string& filename) {
+    std::vector<TraceEvent> events;
+    collect(events);
+    std::ofstream file;
+    openFile(file, filename);
+    // ts and dur are in microseconds
+    file << std::fixed;
+    file.precision(3);
+    file << "{\"traceEvents\":[" << std::endl;
+    for (size_t i = 0; i < events.size(); i++) {
+      const TraceEvent& e = events[i];
+      file << "{\"name\":\"" << stage_names[e.stage] << "\",";
+      file << "\"cat\":\"kinect\",\"ph\":\"X\",";
+      file << "\"ts\":" << 1e-3 * (double)e.start << ",";
+      file << "\"dur\":" << 1e-3 * (double)(e.end - e.start) << ",";
+      file << "\"pid\":0,\"tid\":" << e.tid << ",";
+      file << "\"args\":{\"frame\":" << e.frame_id << "}}";
+      file << (i + 1 < events.size() ? "," : "") << std::endl;
+    }
+    file << "]}" << std::endl;
+    file.close();
+    std::cout << "Tracer::exportChromeTrace() - " << events.size();
+    std::cout << " events written to " << filename << std::endl;
+  }
+
+  void Tracer::exportHistograms(const std::string& filename) {
+    std::vector<TraceEvent> events;
+    collect(events);
+    std::vector<int64_t> durations[TRACE_NUM_STAGES];
+    // frame id --> (first start, last end).  Frame 0 is "no frame set".
+    std::map<uint64_t, std::pair<int64_t, int64_t>> frames;
+    for (size_t i = 0; i < events.size(); i++) {
+      const TraceEvent& e = events[i];
+      durations[e.stage].push_back(e.end - e.start);
+      if (e.frame_id == 0) {
+        continue;
+      }
+      auto it = frames.find(e.frame_id);
+      if (it == frames.end()) {
+        frames[e.frame_id] = std::make_pair(e.start, e.end);
+      } else {
+        it->second.first = std::min<int64_t>(it->second.first, e.start);
+        it->second.second = std::max<int64_t>(it->second.second, e.end);
+      }
+    }
+
+    std::ofstream file;
+    openFile(file, filename);
+    for (uint32_t i = 0; i < TRACE_NUM_STAGES; i++) {
+      writeHistogram(file, stage_names[i], durations[i]);
+    }
+    std::vector<int64_t> lifetimes;
+    for (auto it = frames.begin(); it != frames.end(); it++) {
+      lifetimes.push_back(it->second.second - it->second.first);
+    }
+    writeHistogram(file, "frame_lifetime", lifetimes);
+    file.close();
+    std::cout << "Tracer::exportHistograms() - " << events.size();
+    std::cout << " events written to " << filename << std::endl;
+  }
+
+  void Tracer::clear() {
+    // Only the owning thread may write count, so rather than resetting it
+    // we drop everything before the current one
+    std::unique_lock<std::mutex> ul(buffers_lock);
+    for (uint32_t i = 0; i < buffers.size(); i++) {
+      buffers[i]->cleared = buffers[i]->count.load(std::memory_order_acquire);
+    }
+  }
+
+  const char* Tracer::stageName(const TraceStage stage) {
+    return stage_names[stage];
+  }
+
+};  // namespace kinect_interface
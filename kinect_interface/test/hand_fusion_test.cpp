@@ -0,0 +1,222 @@
+//
+//  hand_fusion_test.cpp
+//
+//  Fuses synthetic detections from two sensors with HandFusion and checks
+//  the fused world position, the number of views, the confidence, the track
+//  ids and which sensor is picked for HandNet (FusedHand::best_sensor and
+//  HandFusion::bestView()).
+//
+//  Sensor 0 is at the world origin looking down +z.  Sensor 1 is at
+//  (2, 0, 2) looking down world -x.  The detections are made by projecting
+//  the true world position into each sensor (the inverse of
+//  KinectInterface::convertUVDToApproxXYZ), and sensor 1 reports its hand
+//  as the left one (the detector's left / right isn't consistent across
+//  views).
+//
+//  Fails (returns 1) if any check fails.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "kinect_interface/kinect_interface.h"
+#include "kinect_interface/hand_detector/hand_fusion.h"
+#include "kinect_interface/hand_detector/multi_hand_detector.h"
+
+using kinect_interface::depth_w;
+using kinect_interface::depth_h;
+using kinect_interface::depth_hfov_fit;
+using kinect_interface::depth_vfov_fit;
+using namespace kinect_interface::hand_detector;
+
+#define TEST_NUM_SENSORS 2
+#define TEST_NUM_STEPS 20
+#define TEST_POS_TOL 0.002f  // meters
+
+static const float world_from_sensor[TEST_NUM_SENSORS][HF_EXTRINSICS_SIZE] = {
+  {1, 0, 0, 0,
+   0, 1, 0, 0,
+   0, 0, 1, 0},
+  {0, 0, -1, 2,
+   0, 1, 0, 0,
+   1, 0, 0, 2},
+};
+
+static uint32_t num_failed = 0;
+
+static void check(const bool ok, const char* what, const uint32_t step) {
+  if (!ok) {
+    printf("  step %u: %s\n", step, what);
+    num_failed++;
+  }
+}
+
+// sensorDepth - The hand's distance along the sensor's view axis (meters)
+static float sensorDepth(const uint32_t sensor, const float* xyz) {
+  const float* m = world_from_sensor[sensor];
+  // The third column of R is the view axis in world space
+  return m[2] * (xyz[0] - m[3]) + m[6] * (xyz[1] - m[7]) +
+    m[10] * (xyz[2] - m[11]);
+}
+
+// project - World space (meters) to the sensor's UVD (pixels and mm)
+static void project(const uint32_t sensor, const float* xyz, float* uvd) {
+  const float* m = world_from_sensor[sensor];
+  const float d[3] = {xyz[0] - m[3], xyz[1] - m[7], xyz[2] - m[11]};
+  float s[3];  // R^T * (xyz - t)
+  for (uint32_t c = 0; c < 3; c++) {
+    s[c] = m[c] * d[0] + m[4 + c] * d[1] + m[8 + c] * d[2];
+  }
+  const float fXToZ = tanf((float)M_PI * depth_hfov_fit / 360.0f) * 2;
+  const float fYToZ = tanf((float)M_PI * depth_vfov_fit / 360.0f) * 2;
+  uvd[0] = (s[0] / (s[2] * fXToZ) + 0.5f) * depth_w;
+  uvd[1] = (0.5f - s[1] / (s[2] * fYToZ)) * depth_h;
+  uvd[2] = s[2] * 1000.0f;
+}
+
+// see - Add a detection of the hand at xyz to a sensor's results.  Sensor 0
+// fills in the right hand first and sensor 1 the left hand.
+static void see(SensorHands& hands, const uint32_t sensor, const float* xyz) {
+  const bool right = sensor == 0 ? !hands.rhand_found : hands.lhand_found;
+  if (right) {
+    hands.rhand_found = true;
+    project(sensor, xyz, hands.rhand_uvd);
+  } else {
+    hands.lhand_found = true;
+    project(sensor, xyz, hands.lhand_uvd);
+  }
+}
+
+static void clearHands(SensorHands* hands, const uint64_t frame_number) {
+  for (uint32_t i = 0; i < TEST_NUM_SENSORS; i++) {
+    memset(&hands[i], 0, sizeof(hands[i]));
+    hands[i].frame_number = frame_number;
+  }
+}
+
+static float dist(const float* a, const float* b) {
+  return sqrtf((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) +
+    (a[2] - b[2]) * (a[2] - b[2]));
+}
+
+int main(int argc, char *argv[]) {
+  HandFusion hf;
+  hf.init(TEST_NUM_SENSORS);
+  for (uint32_t i = 0; i < TEST_NUM_SENSORS; i++) {
+    hf.setExtrinsics(i, world_from_sensor[i]);
+  }
+  SensorHands hands[TEST_NUM_SENSORS];
+  uint32_t step = 0;
+  uint32_t sensor;
+
+  // 1. One hand seen by both sensors, moving from close to sensor 0 to
+  // close to sensor 1.  The track id must stay the same and the best view
+  // must follow the closer sensor.
+  const float start[3] = {0.1f, 0.05f, 1.2f};
+  const float end[3] = {1.2f, -0.05f, 1.9f};
+  uint32_t track_id = 0;
+  uint32_t num_sensor0 = 0;
+  uint32_t num_sensor1 = 0;
+  for (uint32_t i = 0; i < TEST_NUM_STEPS; i++, step++) {
+    const float a = (float)i / (float)(TEST_NUM_STEPS - 1);
+    float xyz[3];
+    for (uint32_t k = 0; k < 3; k++) {
+      xyz[k] = start[k] + a * (end[k] - start[k]);
+    }
+    clearHands(hands, step + 1);
+    see(hands[0], 0, xyz);
+    see(hands[1], 1, xyz);
+    hf.fuse(hands);
+
+    check(hf.fused_hands().size() == 1, "expected one fused hand", step);
+    if (hf.fused_hands().size() != 1) {
+      continue;
+    }
+    const FusedHand& hand = hf.fused_hands()[0];
+    const uint32_t closer = sensorDepth(0, xyz) < sensorDepth(1, xyz) ? 0 : 1;
+    check(dist(hand.xyz, xyz) < TEST_POS_TOL, "fused position is wrong", step);
+    check(hand.num_views == 2, "expected 2 views", step);
+    check(hand.confidence == 1.0f, "expected confidence 1", step);
+    check(hand.best_sensor == closer, "best_sensor isn't the closer one",
+      step);
+    check(hf.bestView(sensor) && sensor == closer,
+      "bestView() isn't the closer sensor", step);
+    if (i == 0) {
+      track_id = hand.track_id;
+    }
+    check(hand.track_id == track_id, "track id changed", step);
+    check(hand.track_age == i + 1, "wrong track age", step);
+    num_sensor0 += closer == 0 ? 1 : 0;
+    num_sensor1 += closer == 1 ? 1 : 0;
+  }
+  // Otherwise the best view never switched and (1) tested less than it says
+  check(num_sensor0 > 0 && num_sensor1 > 0, "best view never switched", step);
+
+  // 2. Only sensor 1 sees the hand
+  clearHands(hands, ++step);
+  see(hands[1], 1, end);
+  hf.fuse(hands);
+  check(hf.fused_hands().size() == 1 && hf.fused_hands()[0].num_views == 1 &&
+    hf.fused_hands()[0].confidence == 0.5f,
+    "one of two views should give confidence 0.5", step);
+  check(hf.bestView(sensor) && sensor == 1, "bestView() should be sensor 1",
+    step);
+
+  // 3. Sensor 1 has no data yet, so it doesn't count against the confidence
+  clearHands(hands, ++step);
+  hands[1].frame_number = 0;
+  see(hands[0], 0, start);
+  hf.fuse(hands);
+  check(hf.fused_hands().size() == 1 &&
+    hf.fused_hands()[0].confidence == 1.0f,
+    "sensors without data shouldn't lower the confidence", step);
+  check(hf.bestView(sensor) && sensor == 0, "bestView() should be sensor 0",
+    step);
+
+  // 4. Two hands, both seen by both sensors.  Hand A (closer to sensor 1)
+  // is tracked first, so it wins the tie.  Then sensor 0 loses hand A and
+  // hand B (closer to sensor 0) is the more confident one.
+  const float hand_a[3] = {1.0f, 0.0f, 1.9f};
+  const float hand_b[3] = {0.0f, 0.0f, 1.0f};
+  for (uint32_t i = 0; i < 3; i++) {
+    clearHands(hands, ++step);
+    see(hands[0], 0, hand_a);
+    see(hands[1], 1, hand_a);
+    hf.fuse(hands);
+  }
+  clearHands(hands, ++step);
+  see(hands[0], 0, hand_a);
+  see(hands[0], 0, hand_b);
+  see(hands[1], 1, hand_a);
+  see(hands[1], 1, hand_b);
+  hf.fuse(hands);
+  check(hf.fused_hands().size() == 2, "expected two fused hands", step);
+  for (uint32_t i = 0; i < hf.fused_hands().size(); i++) {
+    check(hf.fused_hands()[i].num_views == 2, "expected 2 views", step);
+  }
+  check(hf.bestView(sensor) && sensor == 1,
+    "the older track should win the tie", step);
+
+  clearHands(hands, ++step);
+  see(hands[0], 0, hand_b);
+  see(hands[1], 1, hand_a);
+  see(hands[1], 1, hand_b);
+  hf.fuse(hands);
+  check(hf.fused_hands().size() == 2, "expected two fused hands", step);
+  check(hf.bestView(sensor) && sensor == 0,
+    "the more confident hand should win", step);
+
+  // 5. Nothing seen
+  clearHands(hands, ++step);
+  hf.fuse(hands);
+  check(hf.fused_hands().size() == 0 && !hf.bestView(sensor),
+    "expected no hands", step);
+
+  printf("hand_fusion_test: %u steps, best view on sensor 0 for %u and "
+    "sensor 1 for %u of the moving hand steps\n", step, num_sensor0,
+    num_sensor1);
+  printf("  failed checks: %u\n", num_failed);
+  const bool passed = num_failed == 0;
+  printf(passed ? "PASSED\n" : "FAILED\n");
+  return passed ? 0 : 1;
+}
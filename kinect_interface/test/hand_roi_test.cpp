@@ -0,0 +1,236 @@
+//
+//  hand_roi_test.cpp
+//
+//  Replays a synthetic depth sequence through two HandDetectors, one with
+//  roi_tracking() on and one with it off, and compares the final hand labels
+//  of findHandLabels(HDFloodfill) frame by frame.  The tracking detector
+//  drives its HandTracker from its own detections (nothing here knows where
+//  the hand really is), so a hand the tracker loses shows up as a
+//  difference.
+//
+//  The sequence has a hand sized disc that moves fast, leaves the view and
+//  comes back, jumps across the image and back (out of any tracked box),
+//  sensor dropouts and a small static distractor, all in front of a wall.
+//  The forest is one hand made tree that labels a pixel as hand if the depth
+//  TEST_WL_OFFSET / depth downsampled pixels away in all four directions is
+//  more than TEST_WL_DEPTH_DIFF mm further away (so the weak learners read
+//  depth from outside the tracked box).
+//
+//  A frame matches if the two label images differ in at most TEST_LABEL_TOL
+//  of the pixels that either one labels as hand (a hand found by only one
+//  of them is a 100% difference).  Frames that don't match are printed.
+//
+//  Fails (returns 1) if, with and without a TaskScheduler:
+//   - More than TEST_MAX_BAD_FRAMES frames don't match.  The tracking
+//     detector misses the hand in a frame where it jumps out of the box,
+//     but it should scan the full frame (and match again) in the next one.
+//   - The tracking detector never evaluated less than the full frame, or
+//     the full frame detector didn't find the hand in most frames (either
+//     way the comparison tested less than it says)
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "kinect_interface/kinect_interface.h"
+#include "kinect_interface/hand_detector/hand_detector.h"
+#include "kinect_interface/hand_detector/decision_tree_structs.h"
+#include "kinect_interface/task_scheduler.h"
+
+using kinect_interface::KinectInterface;
+using kinect_interface::TaskScheduler;
+using kinect_interface::depth_w;
+using kinect_interface::depth_h;
+using namespace kinect_interface::hand_detector;
+
+#define TEST_NUM_FRAMES 300
+#define TEST_NUM_WORKERS 4
+#define TEST_LABEL_TOL 0.02f  // Fraction of the hand pixels that may differ
+#define TEST_MAX_BAD_FRAMES 2  // One per jump
+#define TEST_WL_OFFSET 16000  // WL offset * depth (mm), 16 down pixels at 1m
+#define TEST_WL_DEPTH_DIFF 400  // mm
+#define TEST_HAND_RADIUS 40.0f  // src pixels
+#define TEST_HAND_DEPTH 800
+#define TEST_DISTRACTOR_RADIUS 12.0f  // src pixels
+#define TEST_DISTRACTOR_DEPTH 1300
+#define TEST_WALL_DEPTH 1800
+
+static uint32_t lcg(uint32_t& seed) {
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 8;
+}
+
+// makeForest - One tree: a chain of the four offset tests (left is pass)
+// ending in a hand leaf, with every failure going to a background leaf
+static void makeForest(DecisionTree* forest) {
+  const int32_t offsets[4][2] = {{TEST_WL_OFFSET, 0}, {-TEST_WL_OFFSET, 0},
+    {0, TEST_WL_OFFSET}, {0, -TEST_WL_OFFSET}};
+  const int32_t num_nodes = 6;
+  const int32_t hand_leaf = 4;
+  const int32_t background_leaf = 5;
+  forest[0].tree = new DecisionTreeNode[num_nodes];
+  forest[0].num_nodes = num_nodes;
+  forest[0].tree_height = 5;
+  for (int32_t i = 0; i < num_nodes; i++) {
+    DecisionTreeNode& node = forest[0].tree[i];
+    memset(&node, 0, sizeof(node));
+    if (i < hand_leaf) {
+      node.coeff0 = offsets[i][0];
+      node.coeff1 = offsets[i][1];
+      node.coeff2 = TEST_WL_DEPTH_DIFF;
+      node.left_child = i + 1;
+      node.right_child = background_leaf;
+    } else {
+      node.left_child = -1;
+      node.right_child = -1;
+      node.prob[0] = i == hand_leaf ? 0.0f : 1.0f;
+      node.prob[1] = 1.0f - node.prob[0];
+    }
+  }
+}
+
+// makeFrame - The hand moves on a fast lissajous path that leaves the view
+// for a while, in front of a wall with a static distractor.  The path keeps
+// the hand far enough from the image edges that the weak learners don't
+// fall off the image.  xyz is what KinectInterface would give for the depth.
+static void makeFrame(const uint32_t frame, int16_t* depth, float* uvd,
+  float* xyz) {
+  uint32_t seed = 12345 + 7919 * frame;
+  const float t = (float)frame;
+  float hand_u = 0.5f * depth_w + 0.32f * depth_w * sinf(0.15f * t);
+  const float hand_v = 0.5f * depth_h + 0.28f * depth_h * cosf(0.21f * t);
+  if (frame >= 120 && frame < 150) {
+    hand_u = -200.0f;  // Out of view
+  } else if (frame >= 200 && frame < 230) {
+    hand_u = (float)depth_w - hand_u;  // Jumps out of the box (twice)
+  }
+  const float hand_d = (float)TEST_HAND_DEPTH + 100.0f * sinf(0.05f * t);
+  const float dist_u = 0.2f * depth_w;
+  const float dist_v = 0.8f * depth_h;
+  for (uint32_t v = 0; v < depth_h; v++) {
+    for (uint32_t u = 0; u < depth_w; u++) {
+      const float du = (float)u - hand_u;
+      const float dv = (float)v - hand_v;
+      const float ddu = (float)u - dist_u;
+      const float ddv = (float)v - dist_v;
+      int32_t z = TEST_WALL_DEPTH + (int32_t)(0.2f * (float)u);
+      if (du * du + dv * dv < TEST_HAND_RADIUS * TEST_HAND_RADIUS) {
+        z = (int32_t)hand_d;
+      } else if (ddu * ddu + ddv * ddv <
+        TEST_DISTRACTOR_RADIUS * TEST_DISTRACTOR_RADIUS) {
+        z = TEST_DISTRACTOR_DEPTH;
+      }
+      const uint32_t r = lcg(seed);
+      if (r % 97 == 0) {
+        z = 0;  // Dropout
+      } else {
+        z += (int32_t)(r % 9) - 4;
+      }
+      const uint32_t i = v * depth_w + u;
+      depth[i] = (int16_t)z;
+      uvd[i * 3] = (float)u;
+      uvd[i * 3 + 1] = (float)v;
+      uvd[i * 3 + 2] = (float)depth[i];
+    }
+  }
+  KinectInterface::convertUVDToApproxXYZ(depth_w * depth_h, uvd, xyz);
+}
+
+struct ReplayStats {
+  uint32_t num_bad_frames;  // Label differences over TEST_LABEL_TOL
+  uint32_t num_roi_frames;  // Frames the tracking detector used a box
+  uint32_t num_found;  // Frames the full frame detector found a hand
+  uint32_t num_found_roi;
+  float max_good_diff;  // Largest difference in a frame that matched
+};
+
+// compareLabels - The number of pixels that differ and the number that
+// either image labels as hand
+static void compareLabels(const uint8_t* a, const uint8_t* b,
+  const uint32_t n, uint32_t& num_diff, uint32_t& num_hand) {
+  num_diff = 0;
+  num_hand = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    num_diff += a[i] != b[i] ? 1 : 0;
+    num_hand += (a[i] != 0 || b[i] != 0) ? 1 : 0;
+  }
+}
+
+static void replay(TaskScheduler* ts, DecisionTree* forest,
+  ReplayStats& stats) {
+  HandDetector hd(ts);
+  hd.init(depth_w, depth_h, forest, 1);
+  hd.roi_tracking() = false;
+  HandDetector hd_roi(ts);
+  hd_roi.init(depth_w, depth_h, forest, 1);
+  hd_roi.roi_tracking() = true;
+  const uint32_t n = depth_w * depth_h;
+  const uint32_t n_down = hd.down_width() * hd.down_height();
+
+  std::vector<int16_t> depth(n);
+  std::vector<float> uvd(n * 3);
+  std::vector<float> xyz(n * 3);
+  std::vector<uint8_t> labels(n);
+  std::vector<uint8_t> labels_roi(n);
+  memset(&stats, 0, sizeof(stats));
+  for (uint32_t frame = 0; frame < TEST_NUM_FRAMES; frame++) {
+    makeFrame(frame, &depth[0], &uvd[0], &xyz[0]);
+
+    // The labels are only written when a hand is found
+    memset(&labels[0], 0, n * sizeof(labels[0]));
+    memset(&labels_roi[0], 0, n * sizeof(labels_roi[0]));
+    const bool found = hd.findHandLabels(&depth[0], &xyz[0],
+      HDLabelMethod::HDFloodfill, &labels[0]);
+    const bool found_roi = hd_roi.findHandLabels(&depth[0], &xyz[0],
+      HDLabelMethod::HDFloodfill, &labels_roi[0]);
+    stats.num_found += found ? 1 : 0;
+    stats.num_found_roi += found_roi ? 1 : 0;
+
+    // Outside the box the tracking detector's forest labels are background
+    uint32_t num_diff, num_hand;
+    compareLabels(hd.labels_evaluated(), hd_roi.labels_evaluated(), n_down,
+      num_diff, num_hand);
+    const bool used_roi = num_diff > 0;
+    stats.num_roi_frames += used_roi ? 1 : 0;
+
+    compareLabels(&labels[0], &labels_roi[0], n, num_diff, num_hand);
+    const float diff = num_hand > 0 ? (float)num_diff / (float)num_hand : 0;
+    if (diff > TEST_LABEL_TOL) {
+      printf("  frame %u: %u of %u hand pixels differ (found %d, with the "
+        "ROI %d%s)\n", frame, num_diff, num_hand, found, found_roi,
+        used_roi ? ", used a box" : "");
+      stats.num_bad_frames++;
+    } else if (diff > stats.max_good_diff) {
+      stats.max_good_diff = diff;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  DecisionTree forest[1];
+  makeForest(forest);
+
+  ReplayStats stats[2];
+  replay(NULL, forest, stats[0]);
+  TaskScheduler::init(TEST_NUM_WORKERS);
+  replay(TaskScheduler::get(), forest, stats[1]);
+  TaskScheduler::shutdown();
+
+  delete[] forest[0].tree;
+
+  bool passed = true;
+  for (uint32_t i = 0; i < 2; i++) {
+    printf("hand_roi_test (%s): %d frames, hand found in %u (%u with the "
+      "ROI), %u frames used a box\n", i == 0 ? "serial" : "workers",
+      TEST_NUM_FRAMES, stats[i].num_found, stats[i].num_found_roi,
+      stats[i].num_roi_frames);
+    printf("  frames over the %.0f%% label tolerance: %u (largest difference "
+      "under it: %.2f%%)\n", 100.0f * TEST_LABEL_TOL, stats[i].num_bad_frames,
+      100.0f * stats[i].max_good_diff);
+    passed = passed && stats[i].num_bad_frames <= TEST_MAX_BAD_FRAMES &&
+      stats[i].num_roi_frames > 0 && stats[i].num_found > TEST_NUM_FRAMES / 2;
+  }
+  printf(passed ? "PASSED\n" : "FAILED\n");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+//
+//  task_scheduler_test.cpp
+//
+//  Two devices sharing one TaskScheduler.  Each device has its own capture
+//  thread and, every frame, splits a box filter of a synthetic depth image
+//  into row bands and then column bands (the column group depends on the row
+//  group, like HandDetector's label filter).  The devices run at the same
+//  time, so their tasks contend for the same workers.  A third pass runs both
+//  devices as nested tasks of one group (like MultiHandDetector).
+//
+//  Fails (returns 1) if:
+//   - Any frame differs from the same device run serially (ts == NULL)
+//   - A column task ran before every row task of its frame had finished
+//   - The process ever had more threads than the main thread, the
+//     scheduler's workers and the two capture threads (linux only)
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#if defined(__linux__)
+  #include <dirent.h>
+#endif
+#include "kinect_interface/task_scheduler.h"
+#include "jtil/data_str/vector_managed.h"
+#include "jtil/threading/callback.h"
+
+using jtil::data_str::VectorManaged;
+using jtil::threading::Callback;
+using jtil::threading::MakeCallableMany;
+using kinect_interface::TaskScheduler;
+using kinect_interface::TaskGroup;
+using kinect_interface::runTasks;
+
+#define TEST_WIDTH 160
+#define TEST_HEIGHT 120
+#define TEST_NUM_FRAMES 200
+#define TEST_NUM_WORKERS 3
+#define TEST_NUM_BANDS 8
+#define TEST_FILTER_RAD 3
+
+static std::atomic<int> max_threads(0);
+
+static int countThreads() {
+#if defined(__linux__)
+  int num_threads = 0;
+  DIR* dir = opendir("/proc/self/task");
+  if (dir == NULL) {
+    return 0;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      num_threads++;
+    }
+  }
+  closedir(dir);
+  return num_threads;
+#else
+  return 0;
+#endif
+}
+
+static void sampleThreads() {
+  const int num_threads = countThreads();
+  int cur_max = max_threads;
+  while (num_threads > cur_max &&
+    !max_threads.compare_exchange_weak(cur_max, num_threads)) {
+  }
+}
+
+class TestDevice {
+public:
+  TestDevice(TaskScheduler* ts, const uint32_t id) : ts_(ts), id_(id) {
+    depth_.resize(TEST_WIDTH * TEST_HEIGHT);
+    tmp_.resize(TEST_WIDTH * TEST_HEIGHT);
+    num_out_of_order_ = 0;
+    rows_done_ = 0;
+    next_frame_ = 0;
+    row_cbs_ = new VectorManaged<Callback<void>*>(TEST_NUM_BANDS);
+    col_cbs_ = new VectorManaged<Callback<void>*>(TEST_NUM_BANDS);
+    for (int32_t i = 0; i < TEST_NUM_BANDS; i++) {
+      row_cbs_->pushBack(MakeCallableMany(&TestDevice::filterRows, this, i));
+      col_cbs_->pushBack(MakeCallableMany(&TestDevice::filterCols, this, i));
+    }
+  }
+
+  ~TestDevice() {
+    delete row_cbs_;
+    delete col_cbs_;
+  }
+
+  // processNextFrame - Make, filter and keep the next synthetic frame
+  void processNextFrame() {
+    makeFrame(next_frame_++);
+    rows_done_ = 0;
+    if (ts_ == NULL) {
+      runTasks(NULL, row_cbs_);
+      runTasks(NULL, col_cbs_);
+    } else {
+      TaskGroup rows;
+      TaskGroup cols;
+      ts_->addTasks(row_cbs_, rows);
+      ts_->addTasks(col_cbs_, cols, &rows);
+      ts_->wait(cols);
+    }
+    sampleThreads();
+    frames_.push_back(std::vector<int16_t>(depth_));
+  }
+
+  void run() {
+    for (uint32_t i = 0; i < TEST_NUM_FRAMES; i++) {
+      processNextFrame();
+    }
+  }
+
+  inline const std::vector<int16_t>& frame(const uint32_t i) const {
+    return frames_[i];
+  }
+  inline const uint32_t num_out_of_order() const { return num_out_of_order_; }
+
+private:
+  TaskScheduler* ts_;
+  uint32_t id_;
+  uint32_t next_frame_;
+  std::vector<int16_t> depth_;
+  std::vector<int16_t> tmp_;
+  std::vector<std::vector<int16_t>> frames_;
+  std::atomic<uint32_t> rows_done_;
+  std::atomic<uint32_t> num_out_of_order_;
+  VectorManaged<Callback<void>*>* row_cbs_;
+  VectorManaged<Callback<void>*>* col_cbs_;
+
+  // makeFrame - A hand sized blob in front of a wall with some noise (an LCG,
+  // so every frame is the same on every platform)
+  void makeFrame(const uint32_t frame) {
+    uint32_t seed = 12345 + 7919 * frame + 104729 * id_;
+    const int32_t blob_u = (TEST_WIDTH / 4) + (frame % (TEST_WIDTH / 2));
+    const int32_t blob_v = TEST_HEIGHT / 2;
+    for (int32_t v = 0; v < TEST_HEIGHT; v++) {
+      for (int32_t u = 0; u < TEST_WIDTH; u++) {
+        seed = seed * 1664525 + 1013904223;
+        const int32_t du = u - blob_u;
+        const int32_t dv = v - blob_v;
+        int32_t z = du * du + dv * dv < 400 ? 700 : 1800;
+        z += static_cast<int32_t>((seed >> 16) % 11) - 5;
+        depth_[v * TEST_WIDTH + u] = static_cast<int16_t>(z);
+      }
+    }
+  }
+
+  void bandRange(const int32_t band, const int32_t n, int32_t& start,
+    int32_t& end) {
+    const int32_t n_per_band = 1 + n / TEST_NUM_BANDS;
+    start = band * n_per_band;
+    end = std::min<int32_t>(start + n_per_band, n);
+  }
+
+  // filterRows - Horizontal box filter of the band's rows (depth_ --> tmp_)
+  void filterRows(const int32_t band) {
+    int32_t vstart, vend;
+    bandRange(band, TEST_HEIGHT, vstart, vend);
+    for (int32_t v = vstart; v < vend; v++) {
+      for (int32_t u = 0; u < TEST_WIDTH; u++) {
+        int32_t sum = 0;
+        int32_t count = 0;
+        for (int32_t i = u - TEST_FILTER_RAD; i <= u + TEST_FILTER_RAD; i++) {
+          if (i >= 0 && i < TEST_WIDTH) {
+            sum += depth_[v * TEST_WIDTH + i];
+            count++;
+          }
+        }
+        tmp_[v * TEST_WIDTH + u] = static_cast<int16_t>(sum / count);
+      }
+    }
+    sampleThreads();
+    rows_done_++;
+  }
+
+  // filterCols - Vertical box filter of the band's columns (tmp_ --> depth_).
+  // Reads every row, so every row band must have finished.
+  void filterCols(const int32_t band) {
+    if (rows_done_ != TEST_NUM_BANDS) {
+      num_out_of_order_++;
+    }
+    int32_t ustart, uend;
+    bandRange(band, TEST_WIDTH, ustart, uend);
+    for (int32_t u = ustart; u < uend; u++) {
+      for (int32_t v = 0; v < TEST_HEIGHT; v++) {
+        int32_t sum = 0;
+        int32_t count = 0;
+        for (int32_t i = v - TEST_FILTER_RAD; i <= v + TEST_FILTER_RAD; i++) {
+          if (i >= 0 && i < TEST_HEIGHT) {
+            sum += tmp_[i * TEST_WIDTH + u];
+            count++;
+          }
+        }
+        depth_[v * TEST_WIDTH + u] = static_cast<int16_t>(sum / count);
+      }
+    }
+    sampleThreads();
+  }
+
+  // Non-copyable, non-assignable.
+  TestDevice(TestDevice&);
+  TestDevice& operator=(const TestDevice&);
+};
+
+// compareDevices - The number of frames of dev that differ from ref
+static uint32_t compareDevices(const TestDevice& ref, const TestDevice& dev) {
+  uint32_t num_diff = 0;
+  for (uint32_t i = 0; i < TEST_NUM_FRAMES; i++) {
+    if (ref.frame(i) != dev.frame(i)) {
+      num_diff++;
+    }
+  }
+  return num_diff;
+}
+
+int main(int argc, char *argv[]) {
+  TaskScheduler::init(TEST_NUM_WORKERS);
+  TaskScheduler* ts = TaskScheduler::get();
+  // The threads running now (main, the workers and any the runtime started)
+  // plus the two capture threads
+  const int max_allowed_threads = countThreads() + 2;
+
+  TestDevice* ref[2];
+  TestDevice* dev[2];
+  TestDevice* nested[2];
+  for (uint32_t i = 0; i < 2; i++) {
+    ref[i] = new TestDevice(NULL, i);
+    ref[i]->run();
+    dev[i] = new TestDevice(ts, i);
+    nested[i] = new TestDevice(ts, i);
+  }
+
+  // Both devices at once, each from its own capture thread
+  std::thread capture0(&TestDevice::run, dev[0]);
+  std::thread capture1(&TestDevice::run, dev[1]);
+  capture0.join();
+  capture1.join();
+
+  // Both devices as tasks of one group, each waiting on its own nested groups
+  VectorManaged<Callback<void>*> device_cbs(2);
+  for (uint32_t i = 0; i < 2; i++) {
+    device_cbs.pushBack(MakeCallableMany(&TestDevice::processNextFrame,
+      nested[i]));
+  }
+  for (uint32_t frame = 0; frame < TEST_NUM_FRAMES; frame++) {
+    ts->run(&device_cbs);
+  }
+
+  uint32_t num_diff = 0;
+  uint32_t num_out_of_order = 0;
+  for (uint32_t i = 0; i < 2; i++) {
+    num_diff += compareDevices(*ref[i], *dev[i]);
+    num_diff += compareDevices(*ref[i], *nested[i]);
+    num_out_of_order += dev[i]->num_out_of_order();
+    num_out_of_order += nested[i]->num_out_of_order();
+  }
+  TaskScheduler::shutdown();
+
+  printf("task_scheduler_test: %d workers, %d frames per device\n",
+    TEST_NUM_WORKERS, TEST_NUM_FRAMES);
+  printf("  frames that differ from the serial run: %u\n", num_diff);
+  printf("  column tasks run before their rows: %u\n", num_out_of_order);
+  printf("  max threads: %d (allowed %d)\n", static_cast<int>(max_threads),
+    max_allowed_threads);
+
+  for (uint32_t i = 0; i < 2; i++) {
+    delete ref[i];
+    delete dev[i];
+    delete nested[i];
+  }
+
+  const bool passed = num_diff == 0 && num_out_of_order == 0 &&
+    max_threads <= max_allowed_threads;
+  printf(passed ? "PASSED\n" : "FAILED\n");
+  return passed ? 0 : 1;
+}
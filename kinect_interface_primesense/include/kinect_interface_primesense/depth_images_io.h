@@ -27,6 +27,8 @@
 #define HAND_PTS_GROW_RAD 2000  // Divided by depth!
 #define N_PTS_FILL 8
 
+namespace kinect_interface_primesense { class GridGraphCut; }
+
 namespace kinect_interface_primesense {
 
   typedef enum {
@@ -40,6 +42,46 @@ namespace kinect_interface_primesense {
     IM_NUM_TYPES,
   } IM_TYPE;
 
+  // Processed (depth + label) file formats:
+  //  PROCESSED_FASTLZ - depth with the label in bit 15, FastLZ compressed
+  //  PROCESSED_DOWNSAMPLED_RLE - also stores the depth and labels at
+  //    DT_DOWNSAMPLE resolution (exactly what training would compute), so
+  //    training loads decode straight into the DepthImageData planes:
+  //     1. ProcessedDSHeader (magic 'KHPD' --> never a valid FastLZ stream)
+  //     2. label run lengths (uint16_t, alternating 0 and 1 runs starting
+  //        with 0) at full resolution, then at DT_DOWNSAMPLE resolution
+  //     3. FastLZ depth (no label bit) at full resolution, then at 
+  //        DT_DOWNSAMPLE resolution
+  //  loadProcessedDepthLabel() reads both.
+  typedef enum {
+    PROCESSED_FASTLZ,
+    PROCESSED_DOWNSAMPLED_RLE,
+  } PROCESSED_FORMAT;
+
+  // RedHandParams - The red hand processing parameters for one call.  Get
+  // the current (tweakable) values with DepthImagesIO::redHandParams(), so
+  // that worker threads never read the statics while they are being edited.
+  struct RedHandParams {
+    int32_t red_hue_threshold;
+    int32_t red_sat_threshold;
+    int32_t red_val_threshold;
+    int32_t red_hue_target;
+    int32_t red_sat_target;
+    int32_t red_val_target;
+    int32_t hsv_total_threshold;
+    int32_t red_red_min;
+    int32_t red_blue_max;
+    int32_t red_green_max;
+    float adjacency_gamma;
+    float adjacency_beta;
+    uint32_t graph_cut_affiliation_radius;
+    bool use_graph_cut;
+    int32_t red_shrink_filter_rad;
+    int32_t red_discon_filter_rad;
+    int32_t red_med_filter_rad;
+    int32_t hand_pts_grow_rad_iterations;
+  };
+
   class DepthImagesIO {
   public:
     DepthImagesIO();
@@ -82,6 +124,12 @@ namespace kinect_interface_primesense {
     void LoadCompressedImageWithRedHands(const std::string& file, 
       int16_t* depth_data, uint8_t* label_data, uint8_t* rgb_data = NULL, 
       uint8_t* red_pixels = NULL, uint8_t* hsv_pixels_ret = NULL);
+    // Same as above, but with a fixed set of parameters (rather than the
+    // statics below).  Each thread needs its own DepthImagesIO instance.
+    void LoadCompressedImageWithRedHands(const std::string& file, 
+      const RedHandParams& params, int16_t* depth_data, uint8_t* label_data,
+      uint8_t* rgb_data = NULL, uint8_t* red_pixels = NULL, 
+      uint8_t* hsv_pixels_ret = NULL);
 
     template <typename T>
     void saveUncompressedDepth(const std::string file, const T* depth_data, 
@@ -89,9 +137,23 @@ namespace kinect_interface_primesense {
 
     // saveProcessedDepthLabel for training the decision forest classifier
     bool saveProcessedDepthLabel(const std::string& file,
-      const int16_t* depth_data, const uint8_t* label_data);
+      const int16_t* depth_data, const uint8_t* label_data,
+      const PROCESSED_FORMAT format = PROCESSED_FASTLZ);
+    // compressProcessedDepthLabel - The file contents saveProcessedDepthLabel
+    // would write.  compressed points to internal storage (valid until the
+    // next call) and the return value is its size in bytes.
+    uint32_t compressProcessedDepthLabel(const int16_t* depth_data, 
+      const uint8_t* label_data, const uint8_t*& compressed,
+      const PROCESSED_FORMAT format = PROCESSED_FASTLZ);
+    // processedFilename - file with a "processed_" prefix on the file name
+    static std::string processedFilename(const std::string& file);
     bool loadProcessedDepthLabel(const std::string& file,
       int16_t* depth_data, uint8_t* label_data);
+    // loadProcessedDepthLabelDownsampled - depth and labels at DT_DOWNSAMPLE
+    // resolution.  For PROCESSED_FASTLZ files this loads the full image and
+    // downsamples it.
+    bool loadProcessedDepthLabelDownsampled(const std::string& file,
+      int16_t* depth_data, uint8_t* label_data);
 
     // floodPixel - Manual editing of a label image (by flooding on the depth)
     void floodPixel(uint8_t* label_image, int16_t* depth_image, int u, int v, 
@@ -120,22 +182,33 @@ namespace kinect_interface_primesense {
     static int32_t red_green_max;
     static float adjacency_gamma;
     static float adjacency_beta;
+    static uint32_t graph_cut_affiliation_radius;
+    static bool use_graph_cut;  // Refine the red hand labels with a graph cut
     static int32_t red_shrink_filter_rad;
     static int32_t red_discon_filter_rad;
     static int32_t red_med_filter_rad;
     static int32_t hand_pts_grow_rad_iterations;
 
+    // redHandParams - A copy of the current values of the statics above
+    static RedHandParams redHandParams();
+
   private:
-    void getRedPixels(uint8_t* rgb, uint8_t* hsv, uint8_t* red_pixels);
-    void cleanUpRedPixelsUsingDepth(int16_t* depth_data, uint8_t* red_pixels);
+    void cleanUpRedPixelsUsingDepth(const RedHandParams& params, 
+      int16_t* depth_data, uint8_t* red_pixels);
     void findHandPoints(uint8_t* label_data, uint8_t* red_pixels, 
       int16_t* depth_data);
-    void growHandPoints(uint8_t* new_label_data, uint8_t* label_data, 
-      int16_t* depth_data, float radius);
+    void growHandPoints(const RedHandParams& params, uint8_t* new_label_data,
+      uint8_t* label_data, int16_t* depth_data, float radius);
     void processGloveNeighbour(int16_t* depth_data, int* nieghbourPtUV, 
       int curPtIndex);
     void processFloodPixelNeighbour(int16_t* depth_data, uint8_t* label_data, 
       int* nieghbourPtUV, int curPtIndex, uint8_t label_to_flood);
+    void cleanUpSegmentWithGraphCut(const RedHandParams& params, 
+      uint8_t* return_label_data, int16_t* depth_data, uint8_t* label_data);
+    void countLabelsInWindow(int* label_count, uint8_t* label_data, 
+      int32_t radius);
+    float calculateAdjacentEdgeWeight(const RedHandParams& params, int ind0,
+      int ind1, int16_t* depth_data);
 
     void resetBlobDetection();
     bool findNextBlob(uint32_t& blob_index, uint32_t& blob_size, 
@@ -146,12 +219,21 @@ namespace kinect_interface_primesense {
       uint8_t* labels);
 
     float round(const float num);
+    uint32_t compressProcessedDownsampledRLE(const int16_t* depth_data, 
+      const uint8_t* label_data);
+    int32_t readProcessedFile(const std::string& file);
+    void decodeProcessedFastLZ(const uint32_t size_bytes, int16_t* depth_data,
+      uint8_t* label_data);
+    void decodeProcessedDownsampledRLE(const uint32_t size_bytes, 
+      int16_t* depth_data, uint8_t* label_data, const bool downsampled);
+    const uint8_t* hsvPixel(const int index);
 
     // Some temporary space for processing each image
     uint16_t* compressed_data;
     uint16_t* uncompressed_data;
     uint8_t* user_pixels;
     uint8_t* hsv;
+    uint8_t* hsv_valid;  // hsv is converted lazily (see hsvPixel())
     uint8_t* rgb;  // Doesn't need to be freed! --> Part of uncompressed data
     uint8_t* label_data_tmp;
     int* label_data_int;
@@ -165,6 +247,8 @@ namespace kinect_interface_primesense {
     int* pixel_queue;
     int16_t* cur_image_data;
     uint8_t* cur_label_data;
+    int16_t* cur_image_data_ds;  // At DT_DOWNSAMPLE resolution
+    uint8_t* cur_label_data_ds;
     int queue_head;
     int queue_tail;
     int32_t delta_hsv[3];
@@ -172,6 +256,7 @@ namespace kinect_interface_primesense {
     float affiliation_diam;
     float affiliation_cnt;
     uint32_t blob_i;
+    GridGraphCut* graph_cut;  // Created by the first graph cut
 
     static const int floodFillKernel_[N_PTS_FILL][2];
   };
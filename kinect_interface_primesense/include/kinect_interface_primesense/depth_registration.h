@@ -0,0 +1,85 @@
+//
+//  depth_registration.h
+//
+//  Table driven version of OpenNIFuncs::TranslateSinglePixel (depth pixel +
+//  depth value --> color pixel), built once from the calibration data when it
+//  is loaded.
+//
+//  TranslateSinglePixel is:
+//    x = inflateX(mirror(reg_x[p] + depth_to_shift[z]) / x_val_scale))
+//    y = inflateY(reg_y[p] - lines_shift)
+//  where p is the (possibly mirrored) index into the registration table.  y
+//  doesn't depend on z so it is stored per pixel in final color coordinates.
+//  x can't be split into a per pixel and a per depth term because of the
+//  integer divide, so the per pixel base (reg_x[p]) and the per depth shift
+//  are added and the sum t is looked up in a table that holds the final color
+//  x for every possible t (t <= 2 * 65535).  Every entry is computed with the
+//  same expressions as TranslateSinglePixel, so the result is bit exact.
+//
+//  There is one set of per pixel tables and one x table for each mirror
+//  setting, so setFlipImage() doesn't need a rebuild.
+//
+
+#pragma once
+
+#include "jtil/math/math_types.h"
+
+#define DEPTH_REGISTRATION_NUM_DEPTHS 65536  // MAX_Z + 1
+#define DEPTH_REGISTRATION_MAX_T (2 * 65535)  // max(reg_x) + max(shift)
+
+namespace kinect_interface_primesense {
+
+  class DepthRegistration {
+  public:
+    // reg_table is depth_w * depth_h (x, y) pairs and depth_to_shift is
+    // MAX_Z + 1 entries (both for the current depth mode).  Both are copied.
+    DepthRegistration(const uint16_t* reg_table,
+      const uint16_t* depth_to_shift, const int32_t depth_w,
+      const int32_t depth_h, const int32_t color_w, const int32_t color_h,
+      const int32_t x_val_scale, const uint32_t lines_shift);
+    ~DepthRegistration();
+
+    // translate - The same imageX and imageY as TranslateSinglePixel returns
+    // for z != 0 (this doesn't report the crop window test).
+    inline void translate(const uint32_t x, const uint32_t y,
+      const uint16_t z, const bool mirror, int& color_x, int& color_y) const {
+      const uint32_t m = mirror ? 1 : 0;
+      const uint32_t p = y * depth_w_ + x;
+      color_x = x_table_[m][base_x_[m][p] + depth_to_shift_[z]];
+      color_y = color_y_[m][p];
+    }
+
+    // colorIndices - For the count depth pixels starting at index start:
+    // color_y * color_w + color_x, or -1 if the depth is 0 or the color pixel
+    // is outside the color image.
+    void colorIndices(int32_t* dst, const uint16_t* depth,
+      const uint32_t start, const uint32_t count, const bool mirror) const;
+    void colorIndicesScalar(int32_t* dst, const uint16_t* depth,
+      const uint32_t start, const uint32_t count, const bool mirror) const;
+
+    // registerRGB - Copy the color pixel of each depth pixel start to
+    // start + count - 1 into registered_rgb (black where colorIndices is -1).
+    // Both images are full size (color_w x color_h and depth_w x depth_h).
+    void registerRGB(uint8_t* registered_rgb, const uint8_t* rgb,
+      const uint16_t* depth, const uint32_t start, const uint32_t count,
+      const bool mirror) const;
+
+    inline int32_t color_w() const { return color_w_; }
+    inline int32_t color_h() const { return color_h_; }
+
+  private:
+    int32_t depth_w_;
+    int32_t depth_h_;
+    int32_t color_w_;
+    int32_t color_h_;
+    uint16_t* depth_to_shift_;  // DEPTH_REGISTRATION_NUM_DEPTHS
+    uint16_t* base_x_[2];  // Per pixel reg_x (in mirrored order for [1])
+    int32_t* color_y_[2];  // Per pixel final color y
+    int32_t* x_table_[2];  // Final color x for base_x + shift
+
+    // Non-copyable, non-assignable.
+    DepthRegistration(DepthRegistration&);
+    DepthRegistration& operator=(const DepthRegistration&);
+  };
+
+};  // namespace kinect_interface_primesense
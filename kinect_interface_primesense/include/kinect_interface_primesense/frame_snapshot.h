@@ -0,0 +1,114 @@
+//
+//  frame_snapshot.h
+//
+//  The data of one depth frame as it moves through the KinectInterfacePrimesense
+//  pipeline (capture --> conversion --> detection).  Each stage fills in its
+//  part and hands the snapshot to the next stage through a FrameMailbox.  Once
+//  the detection stage publishes it, a snapshot is never written to again, so
+//  readers can hold on to it for as long as they like without locking.
+//
+//  Snapshots are recycled through a FrameSnapshotPool (a frame is 6MB at VGA):
+//  the buffers go back to the pool when the last shared_ptr is released.
+//
+//  A FrameMailbox holds at most one frame.  If the next stage hasn't taken the
+//  previous frame yet it is replaced by the new one (the newest frame always
+//  wins) and the mailbox counts the drop.
+//
+
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include "jtil/math/math_types.h"
+#include "jtil/data_str/vector.h"
+
+namespace kinect_interface_primesense {
+
+  struct FrameSnapshot {
+  public:
+    FrameSnapshot(const uint32_t w, const uint32_t h);
+    ~FrameSnapshot();
+
+    uint64_t version;  // Publication order (set by the detection stage)
+    uint64_t depth_frame_number;
+    uint64_t rgb_frame_number;
+    uint64_t ir_frame_number;
+    double depth_frame_time;
+    bool detect_hands;  // The "detect_hands" setting when it was captured
+    bool found_hand;
+
+    uint32_t w;
+    uint32_t h;
+    uint16_t* depth;  // 1mm depth, w * h
+    uint8_t* rgb;  // w * h * 3 (the raw, unregistered rgb frame)
+    uint8_t* ir;  // w * h * 2 (GRAY16)
+    uint8_t* registered_rgb;  // w * h * 3
+    float* xyz;  // w * h * 3
+    uint8_t* labels;  // w * h
+    uint8_t* labels_filtered;  // w * h
+    uint8_t* labels_evaluated;  // w * h
+
+  private:
+    // Non-copyable, non-assignable.
+    FrameSnapshot(FrameSnapshot&);
+    FrameSnapshot& operator=(const FrameSnapshot&);
+  };
+
+  class FrameSnapshotPool {
+  public:
+    // create - The pool is shared with the snapshots it hands out so that a
+    // reader may release a snapshot after the device has been destroyed.
+    static std::shared_ptr<FrameSnapshotPool> create(const uint32_t w,
+      const uint32_t h);
+    ~FrameSnapshotPool();
+
+    // acquire - A free snapshot (allocated if none are free).  Its contents
+    // are whatever the last user left in it.
+    std::shared_ptr<FrameSnapshot> acquire();
+
+    uint32_t num_allocated();
+
+  private:
+    std::weak_ptr<FrameSnapshotPool> self_;
+    uint32_t w_;
+    uint32_t h_;
+    std::mutex lock_;
+    jtil::data_str::Vector<FrameSnapshot*> free_;
+    uint32_t num_allocated_;
+
+    FrameSnapshotPool(const uint32_t w, const uint32_t h);
+    void release(FrameSnapshot* frame);
+
+    // Non-copyable, non-assignable.
+    FrameSnapshotPool(FrameSnapshotPool&);
+    FrameSnapshotPool& operator=(const FrameSnapshotPool&);
+  };
+
+  class FrameMailbox {
+  public:
+    FrameMailbox();
+    ~FrameMailbox();
+
+    // put - Replaces (and counts as dropped) a frame that wasn't taken yet
+    void put(const std::shared_ptr<FrameSnapshot>& frame);
+    // take - Blocks until there is a frame.  Returns false once the mailbox
+    // is closed.
+    bool take(std::shared_ptr<FrameSnapshot>& frame);
+    void close();
+
+    uint64_t num_dropped();
+
+  private:
+    std::mutex lock_;
+    std::condition_variable not_empty_;
+    std::shared_ptr<FrameSnapshot> frame_;
+    bool closed_;
+    uint64_t num_dropped_;
+
+    // Non-copyable, non-assignable.
+    FrameMailbox(FrameMailbox&);
+    FrameMailbox& operator=(const FrameMailbox&);
+  };
+
+};  // namespace kinect_interface_primesense
@@ -0,0 +1,120 @@
+//
+//  grid_graph_cut.h
+//
+//  Max-flow / min-cut on an 8-connected image grid.  This is the
+//  Boykov-Kolmogorov algorithm (the same one as maxflow-v3.02), but the
+//  graph topology is implicit: node i's neighbour in direction d is
+//  i + offset[d], so there are no per-edge pointers or node structs.  The
+//  residual capacities are stored SoA (one array per direction) and the grid
+//  is padded by a 1 pixel border of nodes that have no capacity and are never
+//  added to either search tree, so the inner loops need no bounds checks.
+//
+//  The arrays are allocated once in init() and only cleared by reset(), so
+//  processing a sequence of images does not allocate anything.
+//
+//  Usage (same semantics as Graph<float, float, float>):
+//    gc.init(w, h);  // Once
+//    gc.reset();  // Per image
+//    gc.addTerminalWeights(u, v, cap_source, cap_sink);  // add_tweights
+//    gc.addEdge(u, v, GG_RIGHT, cap, rev_cap);  // add_edge
+//    gc.maxflow();
+//    gc.isSource(u, v);  // what_segment() == SOURCE
+//
+
+#pragma once
+
+#include "jtil/math/math_types.h"
+
+namespace kinect_interface_primesense {
+
+  // Opposite directions differ only in the lowest bit
+  typedef enum {
+    GG_RIGHT = 0,
+    GG_LEFT = 1,
+    GG_DOWN = 2,
+    GG_UP = 3,
+    GG_DOWN_RIGHT = 4,
+    GG_UP_LEFT = 5,
+    GG_DOWN_LEFT = 6,
+    GG_UP_RIGHT = 7,
+    GG_NUM_DIRECTIONS = 8,
+  } GridGraphDirection;
+
+  class GridGraphCut {
+  public:
+    GridGraphCut();
+    ~GridGraphCut();
+
+    // init - Only reallocates if the image size changes.  Calls reset().
+    void init(const uint32_t width, const uint32_t height);
+    // reset - Remove all edges and terminal weights
+    void reset();
+
+    // addTerminalWeights - Can be called more than once per pixel
+    void addTerminalWeights(const uint32_t u, const uint32_t v,
+      const float cap_source, const float cap_sink);
+    // addEdge - Adds an edge from (u, v) to its neighbour in direction dir
+    // (with capacity cap) and back (with capacity rev_cap).  Throws if the
+    // neighbour is outside the image.
+    void addEdge(const uint32_t u, const uint32_t v,
+      const GridGraphDirection dir, const float cap, const float rev_cap);
+
+    // maxflow - Returns the total flow (including trivial terminal flow)
+    float maxflow();
+
+    // isSource - Segmentation after maxflow().  Pixels that are in neither
+    // search tree are assigned to the sink (like maxflow-v3.02).
+    inline bool isSource(const uint32_t u, const uint32_t v) const {
+      return tree_[(v + 1) * pw_ + (u + 1)] == GG_TREE_SOURCE;
+    }
+    // getSegmentation - labels[v * width + u] = isSource(u, v) ? 1 : 0
+    void getSegmentation(uint8_t* labels) const;
+
+    inline uint32_t width() const { return w_; }
+    inline uint32_t height() const { return h_; }
+
+  private:
+    enum { GG_TREE_FREE = 0, GG_TREE_SOURCE = 1, GG_TREE_SINK = 2 };
+    enum { GG_PARENT_TERMINAL = 8, GG_PARENT_ORPHAN = 9, GG_PARENT_NONE = 10 };
+
+    uint32_t w_, h_;
+    uint32_t pw_, ph_;  // Padded size
+    int32_t n_;  // Number of padded nodes
+    int32_t offset_[GG_NUM_DIRECTIONS];
+
+    // Per node data (padded image order)
+    float* cap_;  // n_ * GG_NUM_DIRECTIONS, cap_[d * n_ + i] is i --> i+off[d]
+    float* tr_cap_;  // > 0 --> residual from source, < 0 --> to sink
+    uint8_t* tree_;
+    uint8_t* parent_;  // Direction to the parent (or GG_PARENT_XXX)
+    int32_t* ts_;  // Time stamp of dist_
+    int32_t* dist_;  // Distance to the terminal (valid if ts_ is recent)
+    uint8_t* active_;
+
+    // FIFOs of node indices (a node can only be in each one once)
+    int32_t* active_queue_;
+    int32_t active_head_, active_count_;
+    int32_t* orphan_queue_;
+    int32_t orphan_head_, orphan_count_;
+
+    float flow_;
+    int32_t time_;
+
+    inline float& cap(const int32_t dir, const int32_t i) {
+      return cap_[dir * n_ + i];
+    }
+    void setActive(const int32_t i);
+    int32_t nextActive();
+    void setOrphan(const int32_t i);
+    bool grow(const int32_t i, int32_t& src_node, int32_t& dir);
+    void augment(const int32_t src_node, const int32_t dir);
+    void processSourceOrphan(const int32_t i);
+    void processSinkOrphan(const int32_t i);
+    void releaseData();
+
+    // Non-copyable, non-assignable.
+    GridGraphCut(GridGraphCut&);
+    GridGraphCut& operator=(const GridGraphCut&);
+  };
+
+};  // namespace kinect_interface_primesense
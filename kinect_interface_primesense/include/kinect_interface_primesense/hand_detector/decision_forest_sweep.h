@@ -0,0 +1,96 @@
+//
+//  decision_forest_sweep.h
+//
+//  Scores many forest configurations (which trees, in what order, and the
+//  depth cutoff) on one data set.  evaluateDecisionForestError walks every
+//  tree for every pixel of every image for each configuration.  Here every
+//  tree is walked once per pixel in init(), and the leaf each pixel ends up
+//  at is cached.  A configuration is then just a sum of cached leaf
+//  histograms; a depth cutoff maps each cached leaf to its ancestor at that
+//  height.  Both init() and evaluate() are split across the TaskScheduler.
+//
+//  The cache is one int32_t per tree for every pixel with a valid depth, so
+//  for the full training set it can be a few times the size of the depth
+//  images themselves.
+//
+//  The errors match evaluateDecisionForestError(data, trees, num_trees,
+//  false, 0, max_height) exactly (there is no median filter option).
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "jtil/math/math_types.h"
+#include "jtil/threading/callback.h"
+
+namespace jtil { namespace data_str { template <typename T> class VectorManaged; } }
+namespace kinect_interface { class TaskScheduler; }
+
+namespace kinect_interface_primesense {
+
+struct DepthImageData;
+
+namespace hand_detector {
+  struct DecisionTree;
+
+  struct ForestSweepConfig {
+    // Inputs
+    std::vector<uint32_t> trees;  // Forest indices, in evaluation order
+    uint32_t max_height;
+    // Outputs
+    float error;
+    uint64_t num_false_pos;
+    uint64_t num_false_neg;
+  };
+
+  class DecisionForestSweep {
+  public:
+    // ts may be NULL, in which case all work is done on the calling thread
+    DecisionForestSweep(kinect_interface::TaskScheduler* ts);
+    ~DecisionForestSweep();
+
+    // init - Walk every tree once for every pixel of data.  data and forest
+    // are not copied and must not change until the next init().
+    void init(const DepthImageData* data, const DecisionTree* forest,
+      const uint32_t num_trees);
+
+    // evaluate - Fill in the outputs of every config
+    void evaluate(ForestSweepConfig* configs, const uint32_t num_configs);
+
+    // saveCSV - One row per config: data_set, trees (space separated),
+    // num_trees, max_height, error, num_false_pos, num_false_neg.  With
+    // append the header row is skipped.
+    static void saveCSV(const std::string& filename,
+      const std::string& data_set, const ForestSweepConfig* configs,
+      const uint32_t num_configs, const bool append);
+
+  private:
+    kinect_interface::TaskScheduler* ts_;
+    const DepthImageData* data_;
+    const DecisionTree* forest_;
+    uint32_t num_trees_;
+    uint64_t num_pix_;  // Including the pixels that are never evaluated
+    uint64_t num_fixed_false_neg_;  // Hand pixels with no valid depth
+    std::vector<int32_t> pix_;  // Indices of the pixels with a valid depth
+    std::vector<int32_t> leaves_;  // leaves_[tree * pix_.size() + i]
+    std::vector<std::vector<int32_t>> parent_;  // Per tree, -1 for the root
+    std::vector<std::vector<uint32_t>> node_height_;  // Per tree, root is 1
+    std::vector<std::vector<int32_t>> order_;  // Per tree, breadth first
+
+    ForestSweepConfig* configs_;  // Only set during evaluate()
+    uint32_t num_configs_;
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* leaf_cbs_;
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* config_cbs_;
+
+    void cacheLeavesRange(const uint32_t start, const uint32_t end);
+    void evaluateConfigs(const uint32_t thread);
+    void evaluateConfig(ForestSweepConfig& config);
+
+    // Non-copyable, non-assignable.
+    DecisionForestSweep(DecisionForestSweep&);
+    DecisionForestSweep& operator=(const DecisionForestSweep&);
+  };
+
+};  // namespace hand_detector
+};  // namespace kinect_interface_primesense
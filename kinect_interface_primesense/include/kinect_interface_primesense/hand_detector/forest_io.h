@@ -3,17 +3,62 @@
 //
 //  Created by Jonathan Tompson on 7/20/12.
 //
+//  Two file formats:
+//
+//  1. saveForest() / loadForest(): the original bare stream (num_trees, then
+//     per tree: tree_height, num_nodes and the raw DecisionTreeNode array).
+//
+//  2. saveForestContainer(): a versioned container that stores the nodes in
+//     the same layout evaluateDecisionForest() reads, so it can be mapped
+//     read-only and evaluated in place.  All offsets are from the start of
+//     the file and everything is in the writer's native byte order:
+//       ForestFileHeader
+//       ForestFileTree[num_trees]
+//       DecisionTreeNode[num_nodes] per tree (FOREST_FILE_ALIGNMENT aligned)
+//     The checksum covers everything after the header, and is checked
+//     whenever the file is loaded.
+//
+//  loadForest() reads either format into heap arrays.  SharedForest maps
+//  container files (and loads bare ones) once per process, so every
+//  HandDetector that uses the same file shares one read-only copy.
+//
+//  HandForests and ForestPrune write containers, and check each one with
+//  verifyForestContainer() (a mapped load against a copied load) after
+//  saving it.
+//
 
 #pragma once
 
 #include <string>
 #include "jtil/math/math_types.h"
 
+#define FOREST_FILE_MAGIC 0x4644484B  // "KHDF" in a little endian file
+#define FOREST_FILE_ENDIAN 0x01020304  // Reads back byte swapped on mismatch
+#define FOREST_FILE_VERSION 1
+#define FOREST_FILE_ALIGNMENT 64  // Node arrays start on a cache line
+
 namespace kinect_interface_primesense {
 namespace hand_detector {
 
   struct DecisionTree;
 
+  struct ForestFileHeader {
+    uint32_t magic;
+    uint32_t endian;
+    uint32_t version;
+    uint32_t node_size;  // sizeof(DecisionTreeNode) of the writer
+    uint32_t num_labels;  // NUM_LABELS of the writer
+    int32_t num_trees;
+    uint64_t file_size;  // Including the padding after the last tree
+    uint64_t checksum;  // forestChecksum() of bytes [sizeof(header), file_size)
+  };
+
+  struct ForestFileTree {
+    uint64_t node_offset;
+    uint32_t num_nodes;
+    uint32_t tree_height;
+  };
+
   void saveForest(DecisionTree*& forest, const int32_t num_trees, 
     const std::string& filename);
 
@@ -22,5 +67,57 @@ namespace hand_detector {
 
   void releaseForest(DecisionTree*& forest, const int32_t num_trees);
 
+  void saveForestContainer(const DecisionTree* forest, 
+    const int32_t num_trees, const std::string& filename);
+
+  // isForestContainer - true if the file starts with FOREST_FILE_MAGIC
+  bool isForestContainer(const std::string& filename);
+
+  // verifyForestContainer - Loads the container in filename both copied
+  // (loadForest) and mapped (SharedForest) and throws unless both loads
+  // match forest tree for tree and node for node.
+  void verifyForestContainer(const DecisionTree* forest, 
+    const int32_t num_trees, const std::string& filename);
+
+  // forestChecksum - Fletcher-64 over 32 bit words (size must be a multiple
+  // of 4)
+  uint64_t forestChecksum(const uint8_t* data, const uint64_t size);
+
+  // SharedForest - A process wide, reference counted, read-only forest.
+  class SharedForest {
+  public:
+    // acquire - The forest in filename.  The first call for a filename loads
+    // and verifies it (throws on error), later calls return the same object
+    // until every reference has been released.  Thread safe.
+    static SharedForest* acquire(const std::string& filename);
+
+    // release - Drop one reference (the last one unmaps / frees the forest)
+    // and set forest to NULL.  Thread safe.
+    static void release(SharedForest*& forest);
+
+    inline DecisionTree* forest() const { return forest_; }
+    inline const int32_t num_trees() const { return num_trees_; }
+    inline const std::string& filename() const { return filename_; }
+    inline const bool mapped() const { return mapping_ != NULL; }
+
+  private:
+    std::string filename_;
+    DecisionTree* forest_;  // For mapped files the nodes live in mapping_
+    int32_t num_trees_;
+    void* mapping_;
+    uint64_t mapping_size_;
+    uint32_t ref_count_;  // Guarded by the registry lock
+
+    SharedForest(const std::string& filename);
+    ~SharedForest();
+
+    void map();
+    void unmap();
+
+    // Non-copyable, non-assignable.
+    SharedForest(SharedForest&);
+    SharedForest& operator=(const SharedForest&);
+  };
+
 };  // namespace hand_detector
 };  // namespace kinect_interface_primesense
@@ -7,8 +7,6 @@
 #pragma once
 
 #include <string>
-#include <mutex>
-#include <condition_variable>
 #include "jtil/math/math_types.h"
 #include "jtil/data_str/vector.h"
 #include "jtil/threading/callback.h"
@@ -35,8 +33,8 @@
 #define HD_FILL_FINE_RADIUS 1 
 #define HD_BACKGROUND_THRESH_GROW 100.0f  // For hand flood fill
 
-namespace jtil { namespace threading { class ThreadPool; } }
 namespace jtil { namespace data_str { template <typename T> class VectorManaged; } }
+namespace kinect_interface { class TaskScheduler; }
 
 namespace kinect_interface_primesense {
 namespace hand_detector {
@@ -50,7 +48,8 @@ namespace hand_detector {
 
   class HandDetector {
   public:
-    HandDetector(jtil::threading::ThreadPool* tp);
+    // ts may be NULL, in which case all work is done on the calling thread
+    HandDetector(kinect_interface::TaskScheduler* ts);
     ~HandDetector();
     void init(const uint32_t im_width, const uint32_t im_height,
       const std::string filename = FOREST_DATA_FILENAME);
@@ -109,10 +108,7 @@ namespace hand_detector {
     uint8_t* pixel_on_queue_;
 
     // Multithreading
-    jtil::threading::ThreadPool* tp_;  // Not owned here
-    uint32_t threads_finished_;
-    std::mutex thread_update_lock_;
-    std::condition_variable not_finished_;
+    kinect_interface::TaskScheduler* ts_;  // Not owned here
     jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* thread_cbs_;
 
     static const float floodFillKernel_[HD_N_PTS_FILL_KERNEL][2]; 
@@ -0,0 +1,53 @@
+//
+//  prune_decision_forest.h
+//
+//  Shrinks a trained forest into a smaller, faster one for serving.  Both
+//  steps are measured against a validation set (not the training set):
+//
+//  selectDecisionForestTrees - Greedy forward selection.  Starting from no
+//  trees, add the tree that gives the lowest evaluateDecisionForestError,
+//  until max_trees are chosen or no remaining tree lowers the error.
+//
+//  pruneDecisionForest - Cost-complexity (weakest link) pruning, with the
+//  validation error as the cost.  Collapse the subtree whose removal adds
+//  the fewest misclassified pixels per leaf removed, and repeat while the
+//  total error increase stays within max_error_increase (a fraction of the
+//  validation pixels, same units as evaluateDecisionForestError).  Subtrees
+//  whose removal doesn't increase the error are always collapsed.
+//
+
+#pragma once
+
+#include "jtil/math/math_types.h"
+
+// #define VERBOSE_PRUNE  // Print every collapsed subtree
+
+namespace kinect_interface_primesense {
+
+struct DepthImageData;
+
+namespace hand_detector {
+  struct DecisionTree;
+
+  // selectDecisionForestTrees - selected (of size max_trees) holds the tree
+  // indices in the order they were added.  Returns the validation error.
+  float selectDecisionForestTrees(uint32_t* selected, uint32_t& num_selected,
+    const DepthImageData* data, const DecisionTree* forest,
+    const uint32_t num_trees, const uint32_t max_trees);
+
+  // copyDecisionForest - Deep copy of forest[indices[i]], i < num_trees.
+  // Release the copy with releaseForest().
+  void copyDecisionForest(DecisionTree*& forest_out,
+    const DecisionTree* forest, const uint32_t* indices,
+    const uint32_t num_trees);
+
+  // pruneDecisionForest - In place.  The trees are repacked, so the number
+  // of nodes drops as well.  Returns the number of nodes removed.
+  uint32_t pruneDecisionForest(DecisionTree* forest, const uint32_t num_trees,
+    const DepthImageData* data, const float max_error_increase);
+
+  uint32_t countDecisionForestNodes(const DecisionTree* forest,
+    const uint32_t num_trees);
+
+};  // namespace hand_detector
+};  // namespace kinect_interface_primesense
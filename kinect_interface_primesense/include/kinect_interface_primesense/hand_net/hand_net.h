@@ -151,6 +151,12 @@ namespace hand_net {
     // Result is placed in coeff_convnet
     void calcConvnetHeatMap(const int16_t* depth, const uint8_t* label, 
       bool flip_convnet_input);
+    // The two halves of calcConvnetHeatMap (after calcHandImage), so that
+    // they can be timed separately:
+    // evaluateConvnet - hand image --> heat_map_convnet
+    // fitHeatMaps - heat_map_convnet --> gauss_coeff and gauss_coeff_hm
+    void evaluateConvnet(const bool flip_convnet_input);
+    void fitHeatMaps();
     void calcConvnetPose(const int16_t* depth, const uint8_t* label,
       const float smoothing_factor, const uint64_t max_pso_iterations);
     void resetTracking();
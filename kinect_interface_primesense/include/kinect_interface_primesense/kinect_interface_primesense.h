@@ -2,6 +2,13 @@
 //  kinect_interface.h
 //
 //  Jonathan Tompson
+//
+//  Capture, conversion (depth to xyz, rgb to depth) and hand detection run as
+//  three stages on their own threads, connected by single frame mailboxes.
+//  The detection stage publishes each finished frame as an immutable
+//  FrameSnapshot, so readers never stall the sensor thread and a slow
+//  detector drops frames (counted by dropped_frames()) rather than making
+//  capture fall behind.
 // 
 
 #pragma once
@@ -9,6 +16,8 @@
 #include <mutex>
 #include <condition_variable>
 #include <thread>
+#include <atomic>
+#include <memory>
 #include "jtil/math/math_types.h"
 #include "jtil/threading/callback.h"
 #include "jtil/data_str/vector_managed.h"
@@ -17,12 +26,11 @@
 #define SKEL_NJOINTS 25
 #define SKELETON_SMOOTHING 0.05f
 #define MIRROR true  // true if you want to mirror all kinect data
-#define KINECT_INTERFACE_NUM_WORKER_THREADS 4
-#define KINECT_INTERFACE_NUM_CONVERTER_THREADS 4  // cannot be > NUM_WORKER_THREADS
+#define KINECT_INTERFACE_NUM_CONVERTER_THREADS 4  // 1 --> no TaskScheduler tasks
 #define OPENNI_WAIT_TIMEOUT 50  // Maybe ms?
 
 namespace jtil { namespace clk { class Clk; } }
-namespace jtil { namespace threading { class ThreadPool; } }
+namespace kinect_interface { class TaskScheduler; }
 
 namespace openni { class Device; }
 namespace openni { class VideoStream; }
@@ -45,6 +53,9 @@ namespace kinect_interface_primesense {
 
   class OpenNIFuncs;
   class KinectDeviceListener;
+  struct FrameSnapshot;
+  class FrameSnapshotPool;
+  class FrameMailbox;
 
   class KinectInterfacePrimesense {
   public:
@@ -57,25 +68,43 @@ namespace kinect_interface_primesense {
 
     static void findDevices(jtil::data_str::VectorManaged<char*>& devices);
 
+    // latestFrame - The newest frame that has been through every stage (NULL
+    // before the first one).  It is never modified after it is published.
+    std::shared_ptr<const FrameSnapshot> latestFrame();
+    // waitForFrame - Blocks until a frame newer than version (see
+    // FrameSnapshot::version) has been published and returns it, so
+    // waitForFrame(0) waits for the first frame.  Returns NULL if the
+    // pipeline shuts down first.
+    std::shared_ptr<const FrameSnapshot> waitForFrame(const uint64_t version);
+    // dropped_frames - Frames the conversion or detection stage skipped
+    // because it was still busy with an older one
+    uint64_t dropped_frames();
+
+    // The following return the frame that was newest when lockData() was
+    // called.  lockData() no longer blocks the pipeline, it just keeps that
+    // frame alive until unlockData().  Until the first frame has been
+    // published the pointers are NULL and the numbers and times are 0, so
+    // either check for NULL or call waitForFrame(0) before the first
+    // lockData().
     const uint8_t* rgb() const;  // NOT THREAD SAFE!  Use lockData()
     const uint8_t* ir() const;  // NOT THREAD SAFE!  Use lockData()
     const uint8_t* registered_rgb() const;  // NOT THREAD SAFE!  Use lockData()
     const float* xyz() const;  // NOT THREAD SAFE!  Use lockData()
     const uint16_t* depth() const;  // NOT THREAD SAFE!  Use lockData()
     const uint16_t* depth1mm() const;  // NOT THREAD SAFE!  Use lockData()
-    const uint8_t* labels() const { return labels_; }  // NOT THREAD SAFE!  Use lockData()
+    const uint8_t* labels() const;  // NOT THREAD SAFE!  Use lockData()
     const uint8_t* filteredDecisionForestLabels() const;  // NOT THREAD SAFE!  Use lockData()
     const uint8_t* rawDecisionForestLabels() const;  // NOT THREAD SAFE!  Use lockData()
     hand_detector::HandDetector* hand_detector() { return hand_detector_; }
     OpenNIFuncs* openni_funcs() { return openni_funcs_; }
-    double depth_frame_time() { return depth_frame_time_; }
+    double depth_frame_time() const;  // NOT THREAD SAFE!  Use lockData()
 
-    inline void lockData() { data_lock_.lock(); };
-    inline void unlockData() { data_lock_.unlock(); };
+    void lockData();
+    void unlockData();
 
-    const uint64_t depth_frame_number() const { return depth_frame_number_; }
-    const uint64_t ir_frame_number() const { return ir_frame_number_; }
-    const uint64_t rgb_frame_number() const { return rgb_frame_number_; }
+    const uint64_t depth_frame_number() const;  // NOT THREAD SAFE!  Use lockData()
+    const uint64_t ir_frame_number() const;  // NOT THREAD SAFE!  Use lockData()
+    const uint64_t rgb_frame_number() const;  // NOT THREAD SAFE!  Use lockData()
     const jtil::math::Int2& depth_dim() const { return depth_dim_; }
     const jtil::math::Int2& rgb_dim() const { return rgb_dim_; }
     const jtil::math::Int2& ir_dim() const { return ir_dim_; }
@@ -94,15 +123,26 @@ namespace kinect_interface_primesense {
     static jtil::clk::Clk shared_clock_;
     bool device_initialized_;
    
-    // Multi-threading
-    uint32_t threads_finished_;
-    jtil::threading::ThreadPool* tp_;
-    std::mutex thread_update_lock_;  // For workers to communicate with main thread
-    std::condition_variable not_finished_;
+    // Multi-threading (the conversions run on the process-wide scheduler,
+    // which every device shares)
+    kinect_interface::TaskScheduler* ts_;  // Not owned here
     jtil::data_str::VectorManaged<jtil::threading::Callback<void>*> pts_world_thread_cbs_;
     jtil::data_str::VectorManaged<jtil::threading::Callback<void>*> rgb_thread_cbs_;
+    std::thread kinect_thread_;  // Capture stage
+    std::thread convert_thread_;  // Conversion stage
+    std::thread detect_thread_;  // Detection stage
+    FrameMailbox* convert_mailbox_;  // Capture --> conversion
+    FrameMailbox* detect_mailbox_;  // Conversion --> detection
+    std::shared_ptr<FrameSnapshotPool> frame_pool_;
+    FrameSnapshot* converting_;  // The frame the conversion callbacks work on
+    std::mutex latest_lock_;
+    std::shared_ptr<const FrameSnapshot> latest_;
+    uint64_t latest_version_;
+    bool detect_stopped_;  // The detection stage won't publish any more
+    std::condition_variable latest_published_;  // New latest_ or stopped
     std::recursive_mutex data_lock_;
-    std::thread kinect_thread_;
+    uint32_t data_lock_count_;
+    std::shared_ptr<const FrameSnapshot> locked_frame_;
     jtil::math::Int2 depth_dim_;
     int depth_fps_setting_;
     jtil::math::Int2 rgb_dim_;  // RGB dimension always matches depth
@@ -113,15 +153,10 @@ namespace kinect_interface_primesense {
     // Processed data
     bool depth_format_100um_;
     OpenNIFuncs* openni_funcs_;
-    uint16_t* depth_1mm_;
-    uint8_t* registered_rgb_;
-    float* pts_uvd_;
-    float* pts_world_;
-    uint8_t* labels_;  // Generated by hand_detector
-    uint64_t depth_frame_number_;
+    float* pts_uvd_;  // Conversion stage scratch
+    uint64_t depth_frame_number_;  // Capture stage counters
     uint64_t rgb_frame_number_;
     uint64_t ir_frame_number_;
-    double depth_frame_time_;
     float max_depth_;
     bool sync_ir_stream_;  // We can either sync the IR or RGB but not both
     bool flip_image_;
@@ -132,17 +167,21 @@ namespace kinect_interface_primesense {
     // Depth image IO (mostly for loading the debug image)
     DepthImagesIO* image_io_;
     
-    bool kinect_running_;
+    std::atomic<bool> kinect_running_;
     
-    // MAIN UPDATE THREAD:
+    // MAIN UPDATE THREAD (capture stage):
     void kinectUpdateThread();
+    void captureFrame(FrameSnapshot* frame);
+    void convertThread();
+    void detectThread();
+    void detectHands(FrameSnapshot* frame);
     
     void init(const char* device_uri);
     void initOpenNI(const char* device_uri);
     void initDepth();
     void initRGB(const bool start);
     void initIR(const bool start);
-    void performConversions();  // depth to XYZ, rgb to depth
+    void performConversions(FrameSnapshot* frame);  // depth to XYZ, rgb to depth
     void convertDepthToWorld(const uint32_t start, const uint32_t end);
     void convertRGBToDepth(const uint32_t start, const uint32_t end);
     openni::VideoMode findMaxResYFPSMode(const openni::SensorInfo& sensor,
@@ -158,8 +197,6 @@ namespace kinect_interface_primesense {
     void setCropDepthToRGB(const bool crop_depth_to_rgb);  // internal use only
     void setFlipImage(const bool flip_image);  // internal use only
     void setDepthColorSync(const bool depth_color_sync);  // internal use only
-    void executeThreadCallbacks(jtil::threading::ThreadPool* tp, 
-    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>& cbs);
   };
   
 #ifndef EPSILON
@@ -13,6 +13,7 @@
 		
 namespace kinect_interface_primesense {
   struct CalibrationData;
+  class DepthRegistration;
   
   class OpenNIFuncs {
   public:
@@ -40,6 +41,12 @@ namespace kinect_interface_primesense {
     bool TranslateSinglePixel(const uint32_t x, const uint32_t y, 
       uint16_t z, int& imageX, int& imageY, const bool m_isMirrored);
 
+    // registration - Table driven TranslateSinglePixel for whole images
+    // (NULL if the calibration data wasn't loaded)
+    inline const DepthRegistration* registration() const { 
+      return registration_; 
+    }
+
     // The following are for the Kinect
     static uint32_t xnConvertProjectiveToRealWorld(uint32_t nCount,
       const float* aProjective, float* aRealWorld);
@@ -80,6 +87,7 @@ namespace kinect_interface_primesense {
     CalibrationData* cal_data_;
     uint16_t* m_pRegTable;  // Pointer into Calibration data (depending on current resolution)
     uint16_t* m_pDepth2ShiftTable;  // Pointer into Calibration data (depending on current resolution)
+    DepthRegistration* registration_;
     struct {
       int x, y;
     } m_depthResolution, m_colorResolution;
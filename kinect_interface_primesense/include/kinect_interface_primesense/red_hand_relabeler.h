@@ -0,0 +1,104 @@
+//
+//  red_hand_relabeler.h
+//
+//  Bulk version of LoadCompressedImageWithRedHands() + saveProcessedDepthLabel()
+//  for relabeling a whole directory of hands_*.bin files.
+//
+//  There is one task per scheduler thread, each with its own DepthImagesIO
+//  context (so no scratch buffers are shared), and they pull files from a
+//  shared index until there are none left.  All tasks use the same immutable
+//  RedHandParams (copied in the constructor), so the statics in DepthImagesIO
+//  can be edited while a batch is running without affecting it.
+//
+//  The tasks only compress the processed_* file; a single writer thread does
+//  all of the disk writes (in the order the frames finish).  The write queue
+//  is bounded so that the workers stall rather than run out of memory when
+//  the disk is slow.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "jtil/math/math_types.h"
+#include "jtil/threading/callback.h"
+#include "kinect_interface_primesense/depth_images_io.h"
+
+#define RELABELER_MAX_QUEUED_WRITES 32
+
+namespace jtil { namespace data_str { template <typename T> class VectorManaged; } }
+namespace kinect_interface { class TaskScheduler; }
+
+namespace kinect_interface_primesense {
+
+  struct RedHandRelabelContext;
+
+  struct RedHandRelabelWrite {
+    std::string filename;
+    uint8_t* data;  // Owned by the write queue
+    uint32_t size;
+  };
+
+  class RedHandRelabeler {
+  public:
+    // ts may be NULL (then one context does everything on the calling thread)
+    RedHandRelabeler(kinect_interface::TaskScheduler* ts,
+      const RedHandParams& params,
+      const PROCESSED_FORMAT format = PROCESSED_FASTLZ);
+    ~RedHandRelabeler();
+
+    // relabelFiles - Process each (full path) compressed image file and save
+    // its processed_* file next to it.  Blocks until everything is written.
+    // Returns the number of files saved (files that fail are reported and
+    // skipped).
+    uint32_t relabelFiles(const std::vector<std::string>& files);
+
+    // relabelDirectory - relabelFiles() on the hands_<kinect_num>_*.bin files
+    // in directory (see DepthImagesIO::GetFilesInDirectory).
+    uint32_t relabelDirectory(const std::string& directory,
+      const uint32_t kinect_num);
+
+    inline const RedHandParams& params() const { return params_; }
+    inline const uint32_t num_contexts() const { return num_contexts_; }
+
+  private:
+    const RedHandParams params_;
+    const PROCESSED_FORMAT format_;
+    uint32_t num_contexts_;
+    RedHandRelabelContext** contexts_;
+
+    // Per batch data
+    const std::vector<std::string>* files_;  // Not owned here
+    std::atomic<uint32_t> next_file_;
+    std::atomic<uint32_t> num_failed_;
+    std::mutex print_lock_;
+
+    // Multithreading
+    kinect_interface::TaskScheduler* ts_;  // Not owned here
+    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>* context_cbs_;
+
+    // Writer thread
+    std::thread* writer_;
+    std::deque<RedHandRelabelWrite> write_queue_;
+    bool writes_finished_;  // No more writes will be queued this batch
+    uint32_t num_written_;
+    std::mutex write_lock_;
+    std::condition_variable write_queue_not_empty_;
+    std::condition_variable write_queue_not_full_;
+
+    void relabelContext(const uint32_t context);
+    void queueWrite(const std::string& filename, const uint8_t* data,
+      const uint32_t size);
+    void writerThread();
+
+    // Non-copyable, non-assignable.
+    RedHandRelabeler(RedHandRelabeler&);
+    RedHandRelabeler& operator=(const RedHandRelabeler&);
+  };
+
+};  // namespace kinect_interface_primesense
@@ -0,0 +1,89 @@
+//
+//  red_pixel_classifier.h
+//
+//  The per-pixel "red glove" test used by DepthImagesIO, evaluated straight
+//  from the packed RGB image.  The HSV image is only written out if it is
+//  asked for (for debugging).
+//
+//  The HSV values the test is based on come from float math, so to give
+//  exactly the same mask as jtil::image_util::convertRGBToHSV<uint8_t> + the
+//  scalar test, the SSE2 version does the same float operations in the same
+//  order (4 pixels per instruction, 16 pixels per loop iteration) instead of
+//  approximating them with integer math.  The branches in the scalar version
+//  become per-lane selects.
+//
+
+#pragma once
+
+#include <cstdlib>
+#include "jtil/math/math_types.h"
+#include "kinect_interface_primesense/depth_images_io.h"  // RedHandParams
+
+namespace kinect_interface_primesense {
+
+  // rgbToHSVPixel - One pixel of convertRGBToHSV<uint8_t>.  Equations from
+  // here: http://en.wikipedia.org/wiki/HSL_and_HSV
+  inline void rgbToHSVPixel(uint8_t* hsv, const uint8_t* rgb) {
+    float R = static_cast<float>(rgb[0]) / 255.0f;
+    float G = static_cast<float>(rgb[1]) / 255.0f;
+    float B = static_cast<float>(rgb[2]) / 255.0f;
+
+    float max = R >= G ? R : G;
+    max = max >= B ? max : B;
+    float min = R < G ? R : G;
+    min = min < B ? min : B;
+
+    float D = max - min;
+    // max is either 0 or >= 1/255, so this is the same as max < EPSILON
+    float S = max == 0.0f ? 0.0f : D / max;
+
+    float H;
+    if (max == min) {
+      H = 0;  // achromatic
+    } else {
+      if (max == R) {
+        H = (G - B) / D + (G < B ? 6 : 0);
+      } else if (max == G) {
+        H = (B - R) / D + 2;
+      } else {  // max == B
+        H = (R - G) / D + 4;
+      }
+      H /= 6;
+    }
+
+    hsv[0] = static_cast<uint8_t>(H * 255.0f);
+    hsv[1] = static_cast<uint8_t>(S * 255.0f);
+    hsv[2] = static_cast<uint8_t>(max * 255.0f);
+  }
+
+  // isRedPixel - The red test for one pixel
+  inline bool isRedPixel(const RedHandParams& params, const uint8_t* rgb,
+    const uint8_t* hsv) {
+    int32_t hue_offset = (params.red_hue_target + 128) % 255;
+    int32_t delta_hue = (static_cast<int32_t>(hsv[0]) + hue_offset) % 255;
+    delta_hue = abs(delta_hue - 128);
+    int32_t delta_sat = abs(static_cast<int32_t>(hsv[1]) -
+      params.red_sat_target);
+    int32_t delta_val = abs(static_cast<int32_t>(hsv[2]) -
+      params.red_val_target);
+    return (delta_hue < params.red_hue_threshold &&
+            delta_sat < params.red_sat_threshold &&
+            delta_val < params.red_val_threshold &&
+            rgb[0] > params.red_red_min &&
+            rgb[2] < params.red_blue_max &&
+            rgb[1] < params.red_green_max) ||
+           ((hsv[0] + hsv[1] + hsv[2]) >= params.hsv_total_threshold);
+  }
+
+  // classifyRedPixels - red_pixels[i] = 1 if pixel i passes the red test,
+  // otherwise 0.  If hsv is not NULL, the HSV image is written to it.
+  void classifyRedPixels(const RedHandParams& params, const uint8_t* rgb,
+    uint8_t* red_pixels, const uint32_t num_pixels, uint8_t* hsv = NULL);
+
+  // classifyRedPixelsScalar - Same as above, one pixel at a time (the
+  // reference version)
+  void classifyRedPixelsScalar(const RedHandParams& params,
+    const uint8_t* rgb, uint8_t* red_pixels, const uint32_t num_pixels,
+    uint8_t* hsv = NULL);
+
+};  // namespace kinect_interface_primesense
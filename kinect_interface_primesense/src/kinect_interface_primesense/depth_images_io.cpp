@@ -13,7 +13,10 @@
 #include <vector>
 #include <algorithm>
 #include <functional>
+#include <limits>
 #include "kinect_interface_primesense/depth_images_io.h"
+#include "kinect_interface_primesense/grid_graph_cut.h"
+#include "kinect_interface_primesense/red_pixel_classifier.h"
 #include "kinect_interface_primesense/open_ni_funcs.h"
 #include "kinect_interface_primesense/hand_detector/decision_tree_structs.h"
 #include "jtil/math/math_types.h"
@@ -37,7 +40,8 @@ using namespace jtil::image_util;
 
 namespace kinect_interface_primesense {
 
-  // uint32_t DepthImagesIO::graph_cut_affiliation_radius = 5;
+  uint32_t DepthImagesIO::graph_cut_affiliation_radius = 5;
+  bool DepthImagesIO::use_graph_cut = false;
   float DepthImagesIO::adjacency_gamma = 25.0f;
   float DepthImagesIO::adjacency_beta = 0.25f;
 
@@ -102,6 +106,43 @@ namespace kinect_interface_primesense {
   //int32_t DepthImagesIO::red_med_filter_rad = 4;
   //int32_t DepthImagesIO::hand_pts_grow_rad_iterations = 4;
 
+  RedHandParams DepthImagesIO::redHandParams() {
+    RedHandParams params;
+    params.red_hue_threshold = red_hue_threshold;
+    params.red_sat_threshold = red_sat_threshold;
+    params.red_val_threshold = red_val_threshold;
+    params.red_hue_target = red_hue_target;
+    params.red_sat_target = red_sat_target;
+    params.red_val_target = red_val_target;
+    params.hsv_total_threshold = hsv_total_threshold;
+    params.red_red_min = red_red_min;
+    params.red_blue_max = red_blue_max;
+    params.red_green_max = red_green_max;
+    params.adjacency_gamma = adjacency_gamma;
+    params.adjacency_beta = adjacency_beta;
+    params.graph_cut_affiliation_radius = graph_cut_affiliation_radius;
+    params.use_graph_cut = use_graph_cut;
+    params.red_shrink_filter_rad = red_shrink_filter_rad;
+    params.red_discon_filter_rad = red_discon_filter_rad;
+    params.red_med_filter_rad = red_med_filter_rad;
+    params.hand_pts_grow_rad_iterations = hand_pts_grow_rad_iterations;
+    return params;
+  }
+
+  // PROCESSED_DOWNSAMPLED_RLE file header (see depth_images_io.h)
+  struct ProcessedDSHeader {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+    uint16_t downsample;
+    uint16_t reserved;
+    uint32_t num_label_runs;
+    uint32_t num_label_runs_ds;
+    uint32_t depth_size;  // Compressed size in bytes
+    uint32_t depth_size_ds;
+  };
+  static const uint32_t processed_ds_magic = 0x4450484B;  // "KHPD" on disk
+
   const int DepthImagesIO::floodFillKernel_[N_PTS_FILL][2] = 
   {{-1, -1}, {-1, 0}, {-1, +1}, {0, +1}, {+1, +1}, {+1, 0}, {+1, -1}, {0, -1}};
 
@@ -130,6 +171,7 @@ namespace kinect_interface_primesense {
     compressed_data = (uint16_t*)malloc(processed_data_size * 2);
     user_pixels = (uint8_t*)malloc(src_dim * sizeof(dummy8));
     hsv = (uint8_t*)malloc(src_dim * sizeof(dummy8) * 3);
+    hsv_valid = (uint8_t*)malloc(src_dim * sizeof(dummy8));
     rgb = NULL;  // Not actually allocated!
     red_pixels = (uint8_t*)malloc(src_dim * sizeof(dummy8));
     red_pixels_tmp = (uint8_t*)malloc(src_dim * sizeof(dummy8));
@@ -141,7 +183,9 @@ namespace kinect_interface_primesense {
     label_data_int_tmp = (int*)malloc(src_dim * sizeof(dummyint));
     cur_image_data = new int16_t[src_dim];
     cur_label_data = new uint8_t[src_dim];
-    // im_graph = NULL;
+    cur_image_data_ds = new int16_t[src_dim / (DT_DOWNSAMPLE * DT_DOWNSAMPLE)];
+    cur_label_data_ds = new uint8_t[src_dim / (DT_DOWNSAMPLE * DT_DOWNSAMPLE)];
+    graph_cut = NULL;  // Only allocated if use_graph_cut is ever on
   }
 
   DepthImagesIO::~DepthImagesIO() {
@@ -149,6 +193,7 @@ namespace kinect_interface_primesense {
     SAFE_FREE(uncompressed_data);
     SAFE_FREE(user_pixels);
     SAFE_FREE(hsv);
+    SAFE_FREE(hsv_valid);
     SAFE_FREE(red_pixels);
     SAFE_FREE(red_pixels_tmp);
     SAFE_FREE(pixel_on_queue);
@@ -159,7 +204,9 @@ namespace kinect_interface_primesense {
     SAFE_FREE(label_data_int_tmp);
     SAFE_DELETE_ARR(cur_image_data);
     SAFE_DELETE_ARR(cur_label_data);
-    // SAFE_DELETE(im_graph);
+    SAFE_DELETE_ARR(cur_image_data_ds);
+    SAFE_DELETE_ARR(cur_label_data_ds);
+    SAFE_DELETE(graph_cut);
   }
 
   // LoadDepthImagesFromDirectoryForDT
@@ -247,14 +294,8 @@ namespace kinect_interface_primesense {
           cur_training_image++;
         }
 
-        loadProcessedDepthLabel(directory + cur_filename, cur_image_data,
-          cur_label_data);
-        // Downsample but ignore 0 or background pixel values when filtering
-        DownsampleImageWithoutNonZeroPixelsAndBackground<int16_t>(
-          image_dst, cur_image_data, src_width, src_height, DT_DOWNSAMPLE,
-          GDT_MAX_DIST);
-        DownsampleBoolImageConservative<uint8_t>(label_dst, 
-          cur_label_data, src_width, src_height, DT_DOWNSAMPLE, 0, 1);
+        loadProcessedDepthLabelDownsampled(directory + cur_filename, 
+          image_dst, label_dst);
 
       } else {
         if (load_training_data && i % stride_test_data == 0) {
@@ -313,6 +354,14 @@ namespace kinect_interface_primesense {
     return (num > 0.0f) ? floor(num + 0.5f) : ceil(num - 0.5f);
   }
 
+  const uint8_t* DepthImagesIO::hsvPixel(const int index) {
+    if (!hsv_valid[index]) {
+      rgbToHSVPixel(&hsv[index * 3], &rgb[index * 3]);
+      hsv_valid[index] = 1;
+    }
+    return &hsv[index * 3];
+  }
+
   void DepthImagesIO::LoadCompressedImage(const string& file, 
     int16_t* depth_data, uint8_t* label_data, uint8_t* rgb_data) {
     std::ifstream in_file(file.c_str(), std::ios::in | std::ios::binary | 
@@ -369,40 +418,83 @@ namespace kinect_interface_primesense {
   void DepthImagesIO::LoadCompressedImageWithRedHands(const string& file, 
     int16_t* depth_data, uint8_t* label_data, uint8_t* rgb_data, 
     uint8_t* red_pixels_ret, uint8_t* hsv_pixels_ret) {
-    // try loading a already processed one:
+    LoadCompressedImageWithRedHands(file, redHandParams(), depth_data, 
+      label_data, rgb_data, red_pixels_ret, hsv_pixels_ret);
+  }
 
+  void DepthImagesIO::LoadCompressedImageWithRedHands(const string& file, 
+    const RedHandParams& params, int16_t* depth_data, uint8_t* label_data,
+    uint8_t* rgb_data, uint8_t* red_pixels_ret, uint8_t* hsv_pixels_ret) {
     LoadCompressedImage(file, depth_data, label_data, rgb_data);
 
     // Now we need to process the data to find the hand points
     memset(label_data, 0, src_dim * sizeof(label_data[0]));
 
-    convertRGBToHSV<uint8_t>(hsv, rgb, src_width, src_height);  
+    // The red test works straight from the RGB.  Only the flood fill in
+    // findHandPoints needs HSV values (near the hands), so unless the whole
+    // HSV image was asked for they are converted as needed by hsvPixel().
     if (hsv_pixels_ret != NULL) {
+      classifyRedPixels(params, rgb, red_pixels, src_dim, hsv);
       memcpy(hsv_pixels_ret, hsv, 3 * src_dim * sizeof(hsv_pixels_ret[0]));
+      memset(hsv_valid, 1, src_dim * sizeof(hsv_valid[0]));
+    } else {
+      classifyRedPixels(params, rgb, red_pixels, src_dim);
+      memset(hsv_valid, 0, src_dim * sizeof(hsv_valid[0]));
     }
-
-    getRedPixels(rgb, hsv, red_pixels);
     // Run an aggressive median filter to remove outliers
     GrowFilter<uint8_t>(red_pixels_tmp, red_pixels, src_width,
       src_height, 1);
     MedianBoolFilter<uint8_t>(red_pixels, red_pixels_tmp, src_width,
-      src_height, red_med_filter_rad, 1);
+      src_height, params.red_med_filter_rad, 1);
     //memcpy(red_pixels, red_pixels_tmp, sizeof(red_pixels[0])*src_dim);
     if (red_pixels_ret != NULL) {
       memcpy(red_pixels_ret, red_pixels, src_dim * sizeof(red_pixels_ret[0]));
     }
-    cleanUpRedPixelsUsingDepth(depth_data, red_pixels);
+    cleanUpRedPixelsUsingDepth(params, depth_data, red_pixels);
 
     // Now use the red pixels as seed points for a floodfill in the depth image
     findHandPoints(label_data_tmp, red_pixels, depth_data);
 
     // Since the RGB doesn't line up with the depth we need to allow the hand
     // points to grow.  This also cleans up any bad fill behaviour from the HSV.
-    growHandPoints(label_data, label_data_tmp, depth_data, HAND_PTS_GROW_RAD);
+    growHandPoints(params, label_data, label_data_tmp, depth_data, 
+      HAND_PTS_GROW_RAD);
+
+    if (params.use_graph_cut) {
+      // Move the label boundary onto the depth discontinuities
+      memcpy(label_data_tmp, label_data, src_dim * sizeof(label_data_tmp[0]));
+      cleanUpSegmentWithGraphCut(params, label_data, depth_data, 
+        label_data_tmp);
+    }
   }
 
   bool DepthImagesIO::saveProcessedDepthLabel(const std::string& file, 
-    const int16_t* depth_data, const uint8_t* label_data) {
+    const int16_t* depth_data, const uint8_t* label_data, 
+    const PROCESSED_FORMAT format) {
+    const uint8_t* compressed;
+    uint32_t compressed_length = compressProcessedDepthLabel(depth_data, 
+      label_data, compressed, format);
+    string full_filename = processedFilename(file);
+
+    // Now save the array to file
+    std::cout << "Saving " << full_filename << " to file" << std::endl;
+    std::ofstream ofile(full_filename.c_str(), std::ios::out | std::ios::binary);
+    if (!ofile.is_open()) {
+      throw std::runtime_error(std::string("error opening file:") + full_filename);
+    }
+    ofile.write(reinterpret_cast<const char*>(compressed), compressed_length);
+    ofile.flush();
+    ofile.close();
+    return true;
+  }
+
+  uint32_t DepthImagesIO::compressProcessedDepthLabel(
+    const int16_t* depth_data, const uint8_t* label_data, 
+    const uint8_t*& compressed, const PROCESSED_FORMAT format) {
+    compressed = reinterpret_cast<const uint8_t*>(compressed_data);
+    if (format == PROCESSED_DOWNSAMPLED_RLE) {
+      return compressProcessedDownsampledRLE(depth_data, label_data);
+    }
 
     // Get the image data ready for compressing
     int16_t* depth_dst = (int16_t*)uncompressed_data;
@@ -421,24 +513,117 @@ namespace kinect_interface_primesense {
       src_dim * sizeof(depth_dst[0]),
       reinterpret_cast<void*>(compressed_data));
 
+    return static_cast<uint32_t>(compressed_length);
+  }
+
+  // encodeLabelRuns - Returns the number of runs.  Runs longer than 0xffff
+  // are split by a zero length run of the other label.
+  static uint32_t encodeLabelRuns(uint16_t* runs, const uint8_t* label_data,
+    const uint32_t num_pixels) {
+    uint32_t num_runs = 0;
+    uint8_t cur_label = 0;
+    uint32_t i = 0;
+    while (i < num_pixels) {
+      uint32_t run = 0;
+      while (i < num_pixels && label_data[i] == cur_label) {
+        run++;
+        i++;
+      }
+      while (run > 0xffff) {
+        runs[num_runs++] = 0xffff;
+        runs[num_runs++] = 0;
+        run -= 0xffff;
+      }
+      runs[num_runs++] = static_cast<uint16_t>(run);
+      cur_label = 1 - cur_label;
+    }
+    return num_runs;
+  }
+
+  // decodeLabelRuns - memsets each run straight into the label image.
+  // Returns false if the runs don't add up to num_pixels.
+  static bool decodeLabelRuns(uint8_t* label_data, const uint32_t num_pixels,
+    const uint16_t* runs, const uint32_t num_runs) {
+    uint32_t i = 0;
+    uint8_t cur_label = 0;
+    for (uint32_t r = 0; r < num_runs; r++) {
+      if (runs[r] > num_pixels - i) {
+        return false;
+      }
+      memset(&label_data[i], cur_label, runs[r]);
+      i += runs[r];
+      cur_label = 1 - cur_label;
+    }
+    return i == num_pixels;
+  }
+
+  static bool isProcessedDownsampledRLE(const void* data, 
+    const uint32_t size_bytes) {
+    uint32_t magic;
+    if (size_bytes < sizeof(ProcessedDSHeader)) {
+      return false;
+    }
+    memcpy(&magic, data, sizeof(magic));
+    return magic == processed_ds_magic;
+  }
+
+  uint32_t DepthImagesIO::compressProcessedDownsampledRLE(
+    const int16_t* depth_data, const uint8_t* label_data) {
+    const uint32_t dim_ds = src_dim / (DT_DOWNSAMPLE * DT_DOWNSAMPLE);
+
+    // Exactly what loadProcessedDepthLabel would return for a
+    // PROCESSED_FASTLZ file, so the downsampled images are the same as the
+    // ones training used to compute at load time.
+    int16_t* depth_src = (int16_t*)uncompressed_data;
+    for (uint32_t i = 0; i < src_dim; i++) {
+      depth_src[i] = depth_data[i] & 0x7fff;
+      label_data_tmp[i] = label_data[i] == 1 ? 1 : 0;
+    }
+    // Downsample but ignore 0 or background pixel values when filtering
+    DownsampleImageWithoutNonZeroPixelsAndBackground<int16_t>(
+      cur_image_data_ds, depth_src, src_width, src_height, DT_DOWNSAMPLE,
+      GDT_MAX_DIST);
+    DownsampleBoolImageConservative<uint8_t>(cur_label_data_ds, 
+      label_data_tmp, src_width, src_height, DT_DOWNSAMPLE, 0, 1);
+
+    // The runs go first so that they are 2 byte aligned
+    ProcessedDSHeader header;
+    header.magic = processed_ds_magic;
+    header.width = static_cast<uint16_t>(src_width);
+    header.height = static_cast<uint16_t>(src_height);
+    header.downsample = static_cast<uint16_t>(DT_DOWNSAMPLE);
+    header.reserved = 0;
+    uint8_t* dst = reinterpret_cast<uint8_t*>(compressed_data);
+    uint16_t* runs = reinterpret_cast<uint16_t*>(dst + sizeof(header));
+    header.num_label_runs = encodeLabelRuns(runs, label_data_tmp, src_dim);
+    header.num_label_runs_ds = encodeLabelRuns(&runs[header.num_label_runs],
+      cur_label_data_ds, dim_ds);
+
+    static const int compression_level = 1;  // 1 fast, 2 better compression
+    uint8_t* depth_dst = 
+      reinterpret_cast<uint8_t*>(&runs[header.num_label_runs + 
+      header.num_label_runs_ds]);
+    header.depth_size = fastlz_compress_level(compression_level, 
+      reinterpret_cast<void*>(depth_src), src_dim * sizeof(depth_src[0]),
+      reinterpret_cast<void*>(depth_dst));
+    header.depth_size_ds = fastlz_compress_level(compression_level, 
+      reinterpret_cast<void*>(cur_image_data_ds), 
+      dim_ds * sizeof(cur_image_data_ds[0]),
+      reinterpret_cast<void*>(depth_dst + header.depth_size));
+    memcpy(dst, &header, sizeof(header));
+
+    return static_cast<uint32_t>((depth_dst - dst) + header.depth_size + 
+      header.depth_size_ds);
+  }
+
+  string DepthImagesIO::processedFilename(const string& file) {
     // Seperate out the directory string and the filename
     string name_dir, name_file;
     extractDirFile(file, name_dir, name_file);
     if (name_file.substr(0, 10) != string("processed_")) {
       name_file = string("processed_") + name_file;
     }
-    string full_filename = name_dir + name_file;
-
-    // Now save the array to file
-    std::cout << "Saving " << full_filename << " to file" << std::endl;
-    std::ofstream ofile(full_filename.c_str(), std::ios::out | std::ios::binary);
-    if (!ofile.is_open()) {
-      throw std::runtime_error(std::string("error opening file:") + full_filename);
-    }
-    ofile.write(reinterpret_cast<const char*>(compressed_data), compressed_length);
-    ofile.flush();
-    ofile.close();
-    return true;
+    return name_dir + name_file;
   }
 
   void DepthImagesIO::extractDirFile(const string& full_dir_filename, 
@@ -453,28 +638,61 @@ namespace kinect_interface_primesense {
     file = full_dir_filename.substr(cur_char, full_dir_filename.length()-cur_char);
   }
 
-  bool DepthImagesIO::loadProcessedDepthLabel(const std::string& file, 
-    int16_t* depth_data, uint8_t* label_data) {
-
-    // Seperate out the directory string and the filename
-    string name_dir, name_file;
-    extractDirFile(file, name_dir, name_file);
-    if (name_file.substr(0, 10) != string("processed_")) {
-      name_file = string("processed_") + name_file;
-    }
-    string full_filename = name_dir + name_file;
-
+  int32_t DepthImagesIO::readProcessedFile(const std::string& file) {
+    string full_filename = processedFilename(file);
     std::ifstream in_file(full_filename.c_str(), 
       std::ios::in | std::ios::binary | std::ios::ate);
     if (!in_file.is_open()) {
-      return false;
+      return -1;
     }
 
     uint32_t size_bytes = static_cast<uint32_t>(in_file.tellg());
+    if (size_bytes > static_cast<uint32_t>(processed_data_size * 2)) {
+      throw wruntime_error(string("ERROR: processed file ") + full_filename +
+        string(" is too large!"));
+    }
     in_file.seekg (0, std::ios::beg);  // Go to the beginning of the file
     in_file.read(reinterpret_cast<char*>(compressed_data), size_bytes);
     in_file.close();
+    return static_cast<int32_t>(size_bytes);
+  }
 
+  bool DepthImagesIO::loadProcessedDepthLabel(const std::string& file, 
+    int16_t* depth_data, uint8_t* label_data) {
+    int32_t size_bytes = readProcessedFile(file);
+    if (size_bytes < 0) {
+      return false;
+    }
+    if (isProcessedDownsampledRLE(compressed_data, size_bytes)) {
+      decodeProcessedDownsampledRLE(size_bytes, depth_data, label_data, false);
+    } else {
+      decodeProcessedFastLZ(size_bytes, depth_data, label_data);
+    }
+    return true;
+  }
+
+  bool DepthImagesIO::loadProcessedDepthLabelDownsampled(
+    const std::string& file, int16_t* depth_data, uint8_t* label_data) {
+    int32_t size_bytes = readProcessedFile(file);
+    if (size_bytes < 0) {
+      return false;
+    }
+    if (isProcessedDownsampledRLE(compressed_data, size_bytes)) {
+      decodeProcessedDownsampledRLE(size_bytes, depth_data, label_data, true);
+    } else {
+      decodeProcessedFastLZ(size_bytes, cur_image_data, cur_label_data);
+      // Downsample but ignore 0 or background pixel values when filtering
+      DownsampleImageWithoutNonZeroPixelsAndBackground<int16_t>(
+        depth_data, cur_image_data, src_width, src_height, DT_DOWNSAMPLE,
+        GDT_MAX_DIST);
+      DownsampleBoolImageConservative<uint8_t>(label_data, 
+        cur_label_data, src_width, src_height, DT_DOWNSAMPLE, 0, 1);
+    }
+    return true;
+  }
+
+  void DepthImagesIO::decodeProcessedFastLZ(const uint32_t size_bytes, 
+    int16_t* depth_data, uint8_t* label_data) {
     int size_decompress = fastlz_decompress(reinterpret_cast<void*>(compressed_data),
       size_bytes, (void*)(uncompressed_data), processed_data_size * 2);
     if (size_decompress != (src_dim * sizeof(depth_data[0]))) {
@@ -487,22 +705,54 @@ namespace kinect_interface_primesense {
     memcpy(depth_data, depth_file, src_dim * sizeof(depth_data[0]));
 
     memset(label_data, 0, src_dim * sizeof(label_data[0]));
-    //for (uint32_t i = 0; i < src_dim; i++) {
-    //  if (depth_data[i] < 0) {
-    //    label_data[i] = 1;
-    //    depth_data[i] *= -1;
-    //  } 
-    //}
-
     for (uint32_t i = 0; i < src_dim; i++) {
       if (depth_data[i] & 0x8000) {
         label_data[i] = 1;
-        depth_data[i] = depth_data[i];
       } 
       depth_data[i] = depth_data[i] & 0x7fff;  // Set top bit to 0
     }
+  }
 
-    return true;
+  // decodeProcessedDownsampledRLE - The depth is decompressed and the labels
+  // decoded straight into the output images (there's no intermediate copy)
+  void DepthImagesIO::decodeProcessedDownsampledRLE(const uint32_t size_bytes,
+    int16_t* depth_data, uint8_t* label_data, const bool downsampled) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(compressed_data);
+    const uint32_t dim_ds = src_dim / (DT_DOWNSAMPLE * DT_DOWNSAMPLE);
+    ProcessedDSHeader header;
+    memcpy(&header, src, sizeof(header));
+    if (header.width != src_width || header.height != src_height || 
+      header.downsample != DT_DOWNSAMPLE) {
+      throw wruntime_error("ERROR: processed file image size or downsample "
+        "factor is not what we expected!");
+    }
+    const uint16_t* runs = reinterpret_cast<const uint16_t*>(src + 
+      sizeof(header));
+    const uint64_t runs_size = (static_cast<uint64_t>(header.num_label_runs) +
+      header.num_label_runs_ds) * sizeof(runs[0]);
+    if (sizeof(header) + runs_size + header.depth_size + 
+      header.depth_size_ds != size_bytes) {
+      throw wruntime_error("ERROR: processed file size is not what we "
+        "expected!");
+    }
+    const uint8_t* depth_src = src + sizeof(header) + runs_size;
+
+    bool ok;
+    if (!downsampled) {
+      int size_decompress = fastlz_decompress(depth_src, header.depth_size, 
+        depth_data, src_dim * sizeof(depth_data[0]));
+      ok = size_decompress == src_dim * sizeof(depth_data[0]) &&
+        decodeLabelRuns(label_data, src_dim, runs, header.num_label_runs);
+    } else {
+      int size_decompress = fastlz_decompress(depth_src + header.depth_size,
+        header.depth_size_ds, depth_data, dim_ds * sizeof(depth_data[0]));
+      ok = size_decompress == dim_ds * sizeof(depth_data[0]) &&
+        decodeLabelRuns(label_data, dim_ds, &runs[header.num_label_runs],
+        header.num_label_runs_ds);
+    }
+    if (!ok) {
+      throw wruntime_error("ERROR: processed file data is corrupt!");
+    }
   }
 
   void DepthImagesIO::LoadRGBImage(const string& file, uint8_t* rgb) {
@@ -624,44 +874,33 @@ namespace kinect_interface_primesense {
     FindClose(hFind);
 
 #else
-    throw std::wruntime_error("Apple version needs updating!");
-    //string name_preamble;
-    //uint32_t preamble_length;
-    //if (!load_processed_images) {
-    //  name_preamble = string("hands_");
-    //  preamble_length = 6;
-    //} else {
-    //  name_preamble = string("processed_hands_");
-    //  preamble_length = 16;
-    //}
-    //static unsigned char isFile =0x8;
-    //static unsigned char isFolder =0x4;
-    //struct dirent *dp;
-    //DIR *dfd = opendir(directory.c_str());
-    //if(dfd != NULL) {
-    //  while((dp = readdir(dfd)) != NULL) {
-    //    std::string cur_name = string(dp->d_name);
-    //    if (dp->d_type == isFile) {
-    //      if (cur_name.length() > 10) {
-    //        if (cur_name.substr(0,preamble_length) == name_preamble && 
-    //          cur_name.substr(cur_name.length()-4,4) == string(".bin")) {
-    //            char* name = new char[cur_name.length() + 1];
-    //            strcpy(name, cur_name.c_str());
-    //            files.push_back(Pair<char*, int64_t>(name, -1));
-    //        }
-    //      }
-    //    } else if (dp->d_type == isFolder) {
-    //      std::string cur_foldername = string(dp->d_name);
-    //      // std::cout << "Folder in directory: " << cur_foldername << std::endl;
-    //    }
-    //  }
-    //  closedir(dfd);
-    //} else {
-    //  std::stringstream ss;
-    //  ss << "GetFilesInDirectory error getting dir info for dir: ";
-    //  ss << directory << std::endl;
-    //  throw std::wruntime_error(ss.str());
-    //}
+    // Same pattern as FindFirstFile above: <prefix><kinect_num>_*.bin
+    std::string pattern = prefix == NULL ? string("hands") : string(prefix);
+    if (kinect_num_in_filename) {
+      pattern += std::to_string(kinect_num);
+    }
+    pattern += "_";
+    const string extension = ".bin";
+    DIR* dir = opendir(directory.c_str());
+    if (dir == NULL) {
+      std::string err = "GetFilesInDirectory error getting dir info: '" + 
+        directory + "'. Check that directory is not empty!";
+      cout << err;
+      throw std::wruntime_error(err);
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      std::string cur_filename = entry->d_name;
+      if (cur_filename.length() > pattern.length() + extension.length() &&
+        cur_filename.compare(0, pattern.length(), pattern) == 0 &&
+        cur_filename.compare(cur_filename.length() - extension.length(),
+        extension.length(), extension) == 0) {
+        char* name = new char[cur_filename.length() + 1];
+        strcpy(name, cur_filename.c_str());
+        files.push_back(Triple<char*, int64_t, int64_t>(name, -1, -1));
+      }
+    }
+    closedir(dir);
 #endif
     // Now Parse the filenames and get their unique ID number
     for (uint32_t i = 0; i < files.size(); i++) {
@@ -714,84 +953,48 @@ namespace kinect_interface_primesense {
 
   // testRedPixel - Single "red-test" of a hsv+rgb pixel (for debugging only)
   void DepthImagesIO::testRedPixel(uint32_t index, uint8_t* hsv, uint8_t* rgb) {
+    const RedHandParams params = redHandParams();
     int32_t cur_delta[3];
-    int32_t hue_offset = (red_hue_target + 128) % 255;
+    int32_t hue_offset = (params.red_hue_target + 128) % 255;
 
     cur_delta[0] = (static_cast<int32_t>(hsv[index*3]) + hue_offset) % 255;
     cur_delta[1] = static_cast<int32_t>(hsv[index*3+1]);
     cur_delta[2] = static_cast<int32_t>(hsv[index*3+2]);
 
     cur_delta[0] = cur_delta[0] - 128;
-    cur_delta[1] = cur_delta[1] - red_sat_target;
-    cur_delta[2] = cur_delta[2] - red_val_target;
+    cur_delta[1] = cur_delta[1] - params.red_sat_target;
+    cur_delta[2] = cur_delta[2] - params.red_val_target;
 
     cur_delta[0] = abs(cur_delta[0]);
     cur_delta[1] = abs(cur_delta[1]);
     cur_delta[2] = abs(cur_delta[2]);
 
-    if (cur_delta[0] >= red_hue_threshold) {
+    if (cur_delta[0] >= params.red_hue_threshold) {
       std::cout << "pixel hue out of range." << std::endl;
     }
-    if (cur_delta[1] >= red_sat_threshold) {
+    if (cur_delta[1] >= params.red_sat_threshold) {
       std::cout << "pixel sat out of range." << std::endl;
     }
-    if (cur_delta[2] >= red_val_threshold) {
+    if (cur_delta[2] >= params.red_val_threshold) {
       std::cout << "pixel red val out of range." << std::endl;
     }
-    if (rgb[index*3] <= red_red_min) {
+    if (rgb[index*3] <= params.red_red_min) {
       std::cout << "pixel Red bellow min level." << std::endl;
     }
-    if ((hsv[index*3] + hsv[index*3+1] + hsv[index*3+2]) < hsv_total_threshold) {
+    if ((hsv[index*3] + hsv[index*3+1] + hsv[index*3+2]) < 
+      params.hsv_total_threshold) {
       std::cout << "HSV Total out of range." << std::endl;
     }
-    if (rgb[index*3+2] >= red_blue_max) {
+    if (rgb[index*3+2] >= params.red_blue_max) {
       std::cout << "pixel blue above max level." << std::endl;
     }
-    if (rgb[index*3+1] >= red_green_max) {
+    if (rgb[index*3+1] >= params.red_green_max) {
       std::cout << "pixel gren above max level." << std::endl;
     }
   }
 
-  void DepthImagesIO::getRedPixels(uint8_t* rgb, uint8_t* hsv, 
-    uint8_t* red_pixels) {
-    // Search for pixels that are near <1, 1, 1> in HSV space and which
-    // belong to the user
-    int32_t cur_delta[3];
-    int32_t hue_offset = (red_hue_target + 128) % 255;
-
-    memset(red_pixels, 0, src_dim * sizeof(red_pixels[0]));
-    uint32_t index = 0;
-    // uint32_t index_offset;
-    for (uint32_t v = 0; v < src_height; v++) {
-      for (uint32_t u = 0; u < src_width; u++) {
-        cur_delta[0] = (static_cast<int32_t>(hsv[index*3]) + hue_offset) % 255;
-        cur_delta[1] = static_cast<int32_t>(hsv[index*3+1]);
-        cur_delta[2] = static_cast<int32_t>(hsv[index*3+2]);
-
-        cur_delta[0] = cur_delta[0] - 128;
-        cur_delta[1] = cur_delta[1] - red_sat_target;
-        cur_delta[2] = cur_delta[2] - red_val_target;
-
-        cur_delta[0] = abs(cur_delta[0]);
-        cur_delta[1] = abs(cur_delta[1]);
-        cur_delta[2] = abs(cur_delta[2]);
-
-        if ((cur_delta[0] < red_hue_threshold && 
-             cur_delta[1] < red_sat_threshold && 
-             cur_delta[2] < red_val_threshold && 
-             rgb[index*3] > red_red_min && 
-             rgb[index*3+2] < red_blue_max &&
-             rgb[index*3+1] < red_green_max) || 
-             ((hsv[index*3] + hsv[index*3+1] + hsv[index*3+2]) >= hsv_total_threshold)) {
-          red_pixels[index] = 1;
-        }
-        index++;
-      }
-    }
-  };
-
-  void DepthImagesIO::cleanUpRedPixelsUsingDepth(int16_t* depth_data, 
-    uint8_t* red_pixels) {
+  void DepthImagesIO::cleanUpRedPixelsUsingDepth(const RedHandParams& params,
+    int16_t* depth_data, uint8_t* red_pixels) {
 
     //std::cout << "cleanUpRedPixelsUsingDepth() HACK ON" << std::endl;
     //for (uint32_t i = 0; i < src_dim; i++) {
@@ -811,14 +1014,14 @@ namespace kinect_interface_primesense {
     // Now perform a shrink operation of a N pixel radius in-case depth and RGB
     // pixels don't overlap
     memcpy(red_pixels_tmp, red_pixels, src_dim * sizeof(red_pixels_tmp[0]));
-    if (red_shrink_filter_rad > 0) {
+    if (params.red_shrink_filter_rad > 0) {
       // Shrink horizontally
       int32_t index = 0;
       for (int32_t v = 0; v < src_height; v++) {
         for (int32_t u = 0; u < src_width; u++) {
           if (red_pixels_tmp[index] == 0) {
-            for (int32_t u_offset = u - red_shrink_filter_rad; 
-              u_offset <= u + red_shrink_filter_rad; u_offset++) {
+            for (int32_t u_offset = u - params.red_shrink_filter_rad; 
+              u_offset <= u + params.red_shrink_filter_rad; u_offset++) {
                 if (u_offset < src_width && u_offset >= 0) {
                   red_pixels[v * src_width + u_offset] = 0;
                 }
@@ -832,8 +1035,8 @@ namespace kinect_interface_primesense {
       for (int32_t v = 0; v < src_height; v++) {
         for (int32_t u = 0; u < src_width; u++) {
           if (red_pixels[index] == 0) {
-            for (int32_t v_offset = v - red_shrink_filter_rad; 
-              v_offset <= v + red_shrink_filter_rad; v_offset++) {
+            for (int32_t v_offset = v - params.red_shrink_filter_rad; 
+              v_offset <= v + params.red_shrink_filter_rad; v_offset++) {
                 if (v_offset < src_height && v_offset >= 0) {
                   red_pixels_tmp[v_offset * src_width + u] = 0;
                 }
@@ -845,7 +1048,7 @@ namespace kinect_interface_primesense {
     }
 
     // Filter out any pixels that are near a discontinuity
-    if (red_discon_filter_rad > 0) {
+    if (params.red_discon_filter_rad > 0) {
       int16_t cur_depth_min;
       int16_t cur_depth_max;
       uint32_t index = 0;
@@ -854,10 +1057,10 @@ namespace kinect_interface_primesense {
           cur_depth_min = GDT_MAX_DIST;
           cur_depth_max = 0;
           if (red_pixels_tmp[index] == 1) {
-            for (int32_t v_offset = v - red_discon_filter_rad; 
-              v_offset <= v + red_discon_filter_rad; v_offset++) {
-                for (int32_t u_offset = u - red_discon_filter_rad; 
-                  u_offset <= u + red_discon_filter_rad; u_offset++) {   
+            for (int32_t v_offset = v - params.red_discon_filter_rad; 
+              v_offset <= v + params.red_discon_filter_rad; v_offset++) {
+                for (int32_t u_offset = u - params.red_discon_filter_rad; 
+                  u_offset <= u + params.red_discon_filter_rad; u_offset++) {   
                     int32_t index_offset = v_offset * src_width + u_offset;
                     if (depth_data[index_offset] > cur_depth_max) {
                       cur_depth_max = depth_data[index_offset];
@@ -1041,12 +1244,14 @@ namespace kinect_interface_primesense {
                 depth_data[curPtIndex]);
               delta_depth = delta_depth >= 0 ? delta_depth : -delta_depth;  // abs
 
-              delta_hsv[0] = (static_cast<int32_t>(hsv[nieghbourPtIndex*3]) - 
-                static_cast<int32_t>(hsv[curPtIndex*3]));
-              delta_hsv[1] = (static_cast<int32_t>(hsv[nieghbourPtIndex*3 + 1]) - 
-                static_cast<int32_t>(hsv[curPtIndex*3 + 1]));        
-              delta_hsv[2] = (static_cast<int32_t>(hsv[nieghbourPtIndex*3 + 2]) - 
-                static_cast<int32_t>(hsv[curPtIndex*3 + 2]));               
+              const uint8_t* nieghbour_hsv = hsvPixel(nieghbourPtIndex);
+              const uint8_t* cur_hsv = hsvPixel(curPtIndex);
+              delta_hsv[0] = (static_cast<int32_t>(nieghbour_hsv[0]) - 
+                static_cast<int32_t>(cur_hsv[0]));
+              delta_hsv[1] = (static_cast<int32_t>(nieghbour_hsv[1]) - 
+                static_cast<int32_t>(cur_hsv[1]));        
+              delta_hsv[2] = (static_cast<int32_t>(nieghbour_hsv[2]) - 
+                static_cast<int32_t>(cur_hsv[2]));               
               // int32_t len2_sq = (delta_hsv[0] * delta_hsv[0] + 
               //                    delta_hsv[1] * delta_hsv[1] + 
               //                    delta_hsv[2] * delta_hsv[2]);    
@@ -1065,10 +1270,12 @@ namespace kinect_interface_primesense {
   }
 
   // This is very expensive!
-  void DepthImagesIO::growHandPoints(uint8_t* new_label_data, 
-    uint8_t* label_data, int16_t* depth_data, float radius) {
+  void DepthImagesIO::growHandPoints(const RedHandParams& params,
+    uint8_t* new_label_data, uint8_t* label_data, int16_t* depth_data, 
+    float radius) {
     int32_t cur_iteration;
-    for (cur_iteration = 0; cur_iteration < hand_pts_grow_rad_iterations; cur_iteration++) {
+    for (cur_iteration = 0; cur_iteration < params.hand_pts_grow_rad_iterations;
+      cur_iteration++) {
       if ((cur_iteration % 2) == 1) {
         uint8_t* temp = new_label_data;
         new_label_data = label_data;
@@ -1188,130 +1395,118 @@ namespace kinect_interface_primesense {
     delete[] uvd_data;
   }
 
-  // ************* NO LONGER USING GRAPH CUT *************
-  //void DepthImagesIO::AddVertex(GraphFloat* graph, uint32_t cur_ind, 
-  //  int* label_count) {
-  //  vert[cur_ind] = graph->add_node();
-  //  float D_k0;  // Background edge weight
-  //  float D_k1;  // Forground edge weight
-
-  //  if (label_count[cur_ind] == 0) {
-  //    D_k0 = 0;
-  //    D_k1 = std::numeric_limits<float>::infinity();
-  //  } else if (label_count[cur_ind] == affiliation_cnt) {
-  //    D_k0 = std::numeric_limits<float>::infinity();
-  //    D_k1 = 0;
-  //  } else {
-  //    // D_k1 and D_k0 \in 0->1
-  //    D_k1 = static_cast<float>(label_count[cur_ind]) / affiliation_cnt * 0.6f;
-  //    D_k0 = 1.0f - D_k1;  // 0->1
-  //    D_k1 = -log10f(D_k1);
-  //    D_k0 = -log10f(D_k0);
-  //  }
-
-  //  graph->add_tweights(vert[cur_ind], D_k0, D_k1);
-  //}
-
-  //// Adjacency edge weight is: 
-  //// E_a = gamma * max(abs(delta_depth) / max_depth, 1)^2
-  //float DepthImagesIO::CalculateAdjacentEdgeWeight(int ind0, int ind1, 
-  //  int16_t* image_data) {
-  //  float delta_depth = static_cast<float>(image_data[ind1] - image_data[ind0]);
-
-  //  float delta_depth_sq = delta_depth * delta_depth;
-  //  float E_a = adjacency_gamma * exp(-delta_depth_sq * adjacency_beta);
-
-  //  return E_a;
-  //}
-
-  //void DepthImagesIO::graphErrorFunc(const char* err) {
-  //  throw std::runtime_error(string("graphErrorFunc() - ERROR: ") + 
-  //    string(err));
-  //}
-
-  //void DepthImagesIO::cleanUpSegmentWithGraphCut(uint8_t* return_label_data,
-  //  int16_t* image_data, uint8_t* red_label_data) {
-  //  // First, for each pixel count the number of 1 labels within some radius
-  //  // But we need overflow, so we must do this with int precision
-  //  for (uint32_t i = 0; i < src_dim; i++) {
-  //    label_data_int[i] = static_cast<int>(red_label_data[i]);
-  //  }
-  //  IntegrateBooleanLabel<int>(label_data_int_integ, label_data_int_tmp,
-  //                             label_data_int, src_width, src_height, graph_cut_affiliation_radius, 1);
-  //  
-  //  affiliation_diam = static_cast<float>(graph_cut_affiliation_radius * 2 + 1);
-  //  affiliation_cnt = affiliation_diam * affiliation_diam;
-
-  //  // For now delete the graph every frame.
-  //  // This will be slow --> but Graph does not have the ability to remove the edge!
-  //  if(im_graph != NULL) { 
-  //    delete im_graph; 
-  //  }
-  //  static const int num_nodes = src_dim;
-  //  static const int num_edges = (src_width - 1) * (src_height - 1) * 2 + // cross edges
-  //                               (src_height - 1) * src_width + // vertical edges
-  //                               (src_width - 1) * src_height; // horizontal edges
-  //  im_graph = new GraphFloat(num_nodes, num_edges, graphErrorFunc);
-
-  //  // Add all pixels
-
-  //  // Iterate through the vertices and add nodes if we need them
-  //  // bool addNode;
-  //  uint32_t curInd, neighbourInd;
-  //  float edgeWeight;
-  //  // Add all the vertices
-  //  for (uint32_t curY = 0; curY < src_height; curY ++) {
-  //    for (uint32_t curX = 0; curX < src_width; curX ++) {
-  //      curInd = curY * src_width + curX;
-  //      AddVertex(im_graph, curInd, label_data_int_integ);
-  //    }
-  //  }   
-  //  // Add all the edges
-  //  for (uint32_t curY = 0; curY < src_height; curY ++) {
-  //    for (uint32_t curX = 0; curX < src_width; curX ++) {
-  //      curInd = curY * src_width + curX;
-
-  //      // Add it's right edge
-  //      if(curX < (src_width-1)) {
-  //        neighbourInd = curY * src_width + curX + 1;
-  //        edgeWeight = CalculateAdjacentEdgeWeight(curInd, neighbourInd, image_data);
-  //        im_graph->add_edge(vert[curInd],vert[neighbourInd], edgeWeight, edgeWeight);
-  //      } // end if (curX < (width-1))
-
-  //      // Add it's down edge
-  //      if(curY < (src_height-1)) {
-  //        neighbourInd = (curY + 1) * src_width + curX;
-  //        edgeWeight = CalculateAdjacentEdgeWeight(curInd, neighbourInd, image_data);
-  //        im_graph->add_edge(vert[curInd],vert[neighbourInd], edgeWeight, edgeWeight);
-  //      } // end if (curY < (height-1))
-
-  //      // Add it's bottom-right edge
-  //      if(curX < (src_width-1) && curY < (src_height-1)) {
-  //        neighbourInd = (curY + 1) * src_width + curX + 1;
-  //        edgeWeight = CalculateAdjacentEdgeWeight(curInd, neighbourInd, image_data);
-  //        im_graph->add_edge(vert[curInd],vert[neighbourInd], edgeWeight, edgeWeight);
-  //      } // end if (curX < (width-1))
-
-  //      // Add it's bottom-left edge
-  //      if(curX > 0 && curY < (src_height-1)) {
-  //        neighbourInd = (curY + 1) * src_width + curX -1;
-  //        edgeWeight = CalculateAdjacentEdgeWeight(curInd, neighbourInd, image_data);
-  //        im_graph->add_edge(vert[curInd],vert[neighbourInd], edgeWeight, edgeWeight);
-  //      } // end if (curY < (height-1))
-  //    }
-  //  }
-
-  //  // Now do the graph cut
-  //  float flow = im_graph->maxflow();
-
-  //  // Now go through the graph and copy the assignments
-  //  for(int i = 0; i < src_dim; i ++ ) {
-  //    if (im_graph->what_segment(vert[i]) == GraphFloat::SOURCE) {
-  //      return_label_data[i] = 1;
-  //    } else {
-  //      return_label_data[i] = 0;
-  //    }
-  //  }
-  //}
+  // Adjacency edge weight is: 
+  // E_a = gamma * exp(-beta * delta_depth^2)
+  float DepthImagesIO::calculateAdjacentEdgeWeight(
+    const RedHandParams& params, int ind0, int ind1, int16_t* depth_data) {
+    float delta_depth = static_cast<float>(depth_data[ind1] - depth_data[ind0]);
+    float delta_depth_sq = delta_depth * delta_depth;
+    return params.adjacency_gamma * exp(-delta_depth_sq * params.adjacency_beta);
+  }
+
+  // countLabelsInWindow - For each pixel, the number of 1 labels in the
+  // (2 * radius + 1)^2 window around it (the window is clipped at the image
+  // border).  O(n) independant of the radius (running sums in u then v).
+  void DepthImagesIO::countLabelsInWindow(int* label_count, 
+    uint8_t* label_data, int32_t radius) {
+    const int32_t w = static_cast<int32_t>(src_width);
+    const int32_t h = static_cast<int32_t>(src_height);
+    for (int32_t v = 0; v < h; v++) {
+      const uint8_t* src = &label_data[v * w];
+      int* dst = &label_data_int_tmp[v * w];
+      int sum = 0;
+      for (int32_t u = 0; u < radius && u < w; u++) {
+        sum += src[u] == 1 ? 1 : 0;
+      }
+      for (int32_t u = 0; u < w; u++) {
+        if (u + radius < w) {
+          sum += src[u + radius] == 1 ? 1 : 0;
+        }
+        if (u - radius - 1 >= 0) {
+          sum -= src[u - radius - 1] == 1 ? 1 : 0;
+        }
+        dst[u] = sum;
+      }
+    }
+    for (int32_t u = 0; u < w; u++) {
+      int sum = 0;
+      for (int32_t v = 0; v < radius && v < h; v++) {
+        sum += label_data_int_tmp[v * w + u];
+      }
+      for (int32_t v = 0; v < h; v++) {
+        if (v + radius < h) {
+          sum += label_data_int_tmp[(v + radius) * w + u];
+        }
+        if (v - radius - 1 >= 0) {
+          sum -= label_data_int_tmp[(v - radius - 1) * w + u];
+        }
+        label_count[v * w + u] = sum;
+      }
+    }
+  }
+
+  // cleanUpSegmentWithGraphCut - The data term is the fraction of hand labels
+  // around each pixel (pixels with none or all hand labels are fixed) and the
+  // 8-connected smoothness term is calculateAdjacentEdgeWeight.
+  void DepthImagesIO::cleanUpSegmentWithGraphCut(const RedHandParams& params,
+    uint8_t* return_label_data, int16_t* depth_data, uint8_t* label_data) {
+    countLabelsInWindow(label_data_int_integ, label_data, 
+      static_cast<int32_t>(params.graph_cut_affiliation_radius));
+    affiliation_diam = 
+      static_cast<float>(params.graph_cut_affiliation_radius * 2 + 1);
+    affiliation_cnt = affiliation_diam * affiliation_diam;
+
+    if (graph_cut == NULL) {
+      graph_cut = new GridGraphCut();
+      graph_cut->init(src_width, src_height);
+    }
+    graph_cut->reset();
+    for (uint32_t v = 0; v < src_height; v++) {
+      for (uint32_t u = 0; u < src_width; u++) {
+        const uint32_t index = v * src_width + u;
+        const int count = label_data_int_integ[index];
+        float D_k0;  // Background edge weight
+        float D_k1;  // Forground edge weight
+        if (count == 0) {
+          D_k0 = 0;
+          D_k1 = std::numeric_limits<float>::infinity();
+        } else if (count == affiliation_cnt) {
+          D_k0 = std::numeric_limits<float>::infinity();
+          D_k1 = 0;
+        } else {
+          // D_k1 and D_k0 \in 0->1
+          D_k1 = static_cast<float>(count) / affiliation_cnt * 0.6f;
+          D_k0 = 1.0f - D_k1;  // 0->1
+          D_k1 = -log10f(D_k1);
+          D_k0 = -log10f(D_k0);
+        }
+        graph_cut->addTerminalWeights(u, v, D_k0, D_k1);
+
+        float weight;
+        if (u < src_width - 1) {
+          weight = calculateAdjacentEdgeWeight(params, index, index + 1, depth_data);
+          graph_cut->addEdge(u, v, GG_RIGHT, weight, weight);
+        }
+        if (v < src_height - 1) {
+          weight = calculateAdjacentEdgeWeight(params, index, index + src_width, 
+            depth_data);
+          graph_cut->addEdge(u, v, GG_DOWN, weight, weight);
+          if (u < src_width - 1) {
+            weight = calculateAdjacentEdgeWeight(params, index, index + src_width + 1, 
+              depth_data);
+            graph_cut->addEdge(u, v, GG_DOWN_RIGHT, weight, weight);
+          }
+          if (u > 0) {
+            weight = calculateAdjacentEdgeWeight(params, index, index + src_width - 1, 
+              depth_data);
+            graph_cut->addEdge(u, v, GG_DOWN_LEFT, weight, weight);
+          }
+        }
+      }
+    }
+
+    graph_cut->maxflow();
+    graph_cut->getSegmentation(return_label_data);
+  }
 
 }  // namespace kinect_interface_primesense
@@ -0,0 +1,191 @@
+#include <cstring>
+#include <stdexcept>
+#include "kinect_interface_primesense/depth_registration.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define DEPTH_REGISTRATION_SSE2
+  #include <emmintrin.h>
+#endif
+
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+#define REGISTER_RGB_CHUNK 256  // Pixels per colorIndices() call
+
+namespace kinect_interface_primesense {
+
+  DepthRegistration::DepthRegistration(const uint16_t* reg_table,
+    const uint16_t* depth_to_shift, const int32_t depth_w,
+    const int32_t depth_h, const int32_t color_w, const int32_t color_h,
+    const int32_t x_val_scale, const uint32_t lines_shift) {
+    if (depth_w <= 0 || depth_h <= 0 || color_w <= 0 || color_h <= 0 ||
+      x_val_scale <= 0) {
+      throw std::wruntime_error("DepthRegistration::DepthRegistration() - "
+        "ERROR: bad calibration data!");
+    }
+    depth_w_ = depth_w;
+    depth_h_ = depth_h;
+    color_w_ = color_w;
+    color_h_ = color_h;
+    const uint32_t n_pixels = (uint32_t)(depth_w * depth_h);
+    depth_to_shift_ = new uint16_t[DEPTH_REGISTRATION_NUM_DEPTHS];
+    memcpy(depth_to_shift_, depth_to_shift,
+      sizeof(depth_to_shift_[0]) * DEPTH_REGISTRATION_NUM_DEPTHS);
+
+    // Everything from here on uses the same types and expressions as
+    // OpenNIFuncs::TranslateSinglePixel (including the unsigned wrap around
+    // for pixels that map outside the color image).
+    const uint32_t nDepthXRes = (uint32_t)depth_w;
+    const double fullXRes = color_w;
+    double fullYRes;
+    bool bCrop;
+    if ((9 * color_w / color_h) == 16) {
+      fullYRes = color_w * 4 / 5;
+      bCrop = true;
+    } else {
+      fullYRes = color_h;
+      bCrop = false;
+    }
+
+    for (uint32_t m = 0; m < 2; m++) {
+      const bool bMirror = m == 1;
+      base_x_[m] = new uint16_t[n_pixels];
+      color_y_[m] = new int32_t[n_pixels];
+      for (uint32_t y = 0; y < (uint32_t)depth_h; y++) {
+        for (uint32_t x = 0; x < nDepthXRes; x++) {
+          const uint32_t nIndex = bMirror ? ((y+1)*nDepthXRes - x - 1) * 2 :
+            (y*nDepthXRes + x) * 2;
+          const uint32_t nNewY = reg_table[nIndex + 1];
+          int imageY = nNewY - lines_shift;
+          imageY = (uint32_t)(fullYRes / depth_h * imageY);
+          if (bCrop) {
+            imageY -= (uint32_t)(fullYRes - color_h)/2;
+          }
+          base_x_[m][y * nDepthXRes + x] = reg_table[nIndex];
+          color_y_[m][y * nDepthXRes + x] = imageY;
+        }
+      }
+
+      x_table_[m] = new int32_t[DEPTH_REGISTRATION_MAX_T + 1];
+      for (uint32_t t = 0; t <= DEPTH_REGISTRATION_MAX_T; t++) {
+        const uint32_t nNewX = t / x_val_scale;
+        int imageX = bMirror ? (nDepthXRes - nNewX - 1) : nNewX;
+        imageX = (uint32_t)(fullXRes / depth_w * imageX);
+        x_table_[m][t] = imageX;
+      }
+    }
+  }
+
+  DepthRegistration::~DepthRegistration() {
+    SAFE_DELETE_ARR(depth_to_shift_);
+    for (uint32_t m = 0; m < 2; m++) {
+      SAFE_DELETE_ARR(base_x_[m]);
+      SAFE_DELETE_ARR(color_y_[m]);
+      SAFE_DELETE_ARR(x_table_[m]);
+    }
+  }
+
+  void DepthRegistration::colorIndicesScalar(int32_t* dst,
+    const uint16_t* depth, const uint32_t start, const uint32_t count,
+    const bool mirror) const {
+    const uint32_t m = mirror ? 1 : 0;
+    const uint16_t* base_x = base_x_[m];
+    const int32_t* color_y = color_y_[m];
+    const int32_t* x_table = x_table_[m];
+    for (uint32_t i = 0; i < count; i++) {
+      const uint32_t p = start + i;
+      const int32_t x = x_table[base_x[p] + depth_to_shift_[depth[p]]];
+      const int32_t y = color_y[p];
+      if (depth[p] != 0 && (uint32_t)x < (uint32_t)color_w_ &&
+        (uint32_t)y < (uint32_t)color_h_) {
+        dst[i] = y * color_w_ + x;
+      } else {
+        dst[i] = -1;
+      }
+    }
+  }
+
+#ifdef DEPTH_REGISTRATION_SSE2
+
+  void DepthRegistration::colorIndices(int32_t* dst, const uint16_t* depth,
+    const uint32_t start, const uint32_t count, const bool mirror) const {
+    // y * color_w is done with a 16 bit multiply (only valid lanes are kept)
+    if (color_w_ >= 32768 || color_h_ >= 32768) {
+      colorIndicesScalar(dst, depth, start, count, mirror);
+      return;
+    }
+    const uint32_t m = mirror ? 1 : 0;
+    const uint16_t* base_x = base_x_[m];
+    const int32_t* color_y = color_y_[m];
+    const int32_t* x_table = x_table_[m];
+
+    // Unsigned compares are signed compares with the sign bits flipped
+    const __m128i sign = _mm_set1_epi32((int32_t)0x80000000);
+    const __m128i w_max = _mm_xor_si128(_mm_set1_epi32(color_w_), sign);
+    const __m128i h_max = _mm_xor_si128(_mm_set1_epi32(color_h_), sign);
+    const __m128i w_mul = _mm_set1_epi32(color_w_);  // (w, 0) int16 pairs
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i invalid = _mm_set1_epi32(-1);
+
+    const uint32_t count_sse = count - (count % 4);
+    for (uint32_t i = 0; i < count_sse; i += 4) {
+      const uint32_t p = start + i;
+      // SSE2 has no gather, so the two table lookups are scalar
+      const __m128i x = _mm_setr_epi32(
+        x_table[base_x[p] + depth_to_shift_[depth[p]]],
+        x_table[base_x[p + 1] + depth_to_shift_[depth[p + 1]]],
+        x_table[base_x[p + 2] + depth_to_shift_[depth[p + 2]]],
+        x_table[base_x[p + 3] + depth_to_shift_[depth[p + 3]]]);
+      const __m128i y = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(&color_y[p]));
+      const __m128i z = _mm_unpacklo_epi16(_mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(&depth[p])), zero);
+
+      __m128i valid = _mm_andnot_si128(_mm_cmpeq_epi32(z, zero), invalid);
+      valid = _mm_and_si128(valid, _mm_cmplt_epi32(_mm_xor_si128(x, sign),
+        w_max));
+      valid = _mm_and_si128(valid, _mm_cmplt_epi32(_mm_xor_si128(y, sign),
+        h_max));
+      const __m128i index = _mm_add_epi32(_mm_madd_epi16(y, w_mul), x);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_or_si128(
+        _mm_and_si128(valid, index), _mm_andnot_si128(valid, invalid)));
+    }
+    colorIndicesScalar(&dst[count_sse], depth, start + count_sse,
+      count - count_sse, mirror);
+  }
+
+#else
+
+  void DepthRegistration::colorIndices(int32_t* dst, const uint16_t* depth,
+    const uint32_t start, const uint32_t count, const bool mirror) const {
+    colorIndicesScalar(dst, depth, start, count, mirror);
+  }
+
+#endif  // DEPTH_REGISTRATION_SSE2
+
+  void DepthRegistration::registerRGB(uint8_t* registered_rgb,
+    const uint8_t* rgb, const uint16_t* depth, const uint32_t start,
+    const uint32_t count, const bool mirror) const {
+    int32_t indices[REGISTER_RGB_CHUNK];
+    for (uint32_t i = 0; i < count; i += REGISTER_RGB_CHUNK) {
+      const uint32_t n = count - i < REGISTER_RGB_CHUNK ? count - i :
+        REGISTER_RGB_CHUNK;
+      colorIndices(indices, depth, start + i, n, mirror);
+      uint8_t* dst = &registered_rgb[(start + i) * 3];
+      for (uint32_t j = 0; j < n; j++) {
+        if (indices[j] >= 0) {
+          const uint8_t* src = &rgb[indices[j] * 3];
+          dst[j * 3] = src[0];
+          dst[j * 3 + 1] = src[1];
+          dst[j * 3 + 2] = src[2];
+        } else {
+          dst[j * 3] = 0;
+          dst[j * 3 + 1] = 0;
+          dst[j * 3 + 2] = 0;
+        }
+      }
+    }
+  }
+
+};  // namespace kinect_interface_primesense
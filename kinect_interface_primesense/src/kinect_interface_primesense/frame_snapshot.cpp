@@ -0,0 +1,133 @@
+#include <cstring>
+#include "kinect_interface_primesense/frame_snapshot.h"
+
+#define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
+#define SAFE_DELETE_ARR(x) if (x != NULL) { delete[] x; x = NULL; }
+
+namespace kinect_interface_primesense {
+
+  FrameSnapshot::FrameSnapshot(const uint32_t w, const uint32_t h) {
+    this->w = w;
+    this->h = h;
+    version = 0;
+    depth_frame_number = 0;
+    rgb_frame_number = 0;
+    ir_frame_number = 0;
+    depth_frame_time = 0;
+    detect_hands = false;
+    found_hand = false;
+    const uint32_t dim = w * h;
+    depth = new uint16_t[dim];
+    rgb = new uint8_t[dim * 3];
+    ir = new uint8_t[dim * 2];
+    registered_rgb = new uint8_t[dim * 3];
+    xyz = new float[dim * 3];
+    labels = new uint8_t[dim];
+    labels_filtered = new uint8_t[dim];
+    labels_evaluated = new uint8_t[dim];
+    memset(depth, 0, sizeof(depth[0]) * dim);
+    memset(rgb, 0, sizeof(rgb[0]) * dim * 3);
+    memset(ir, 0, sizeof(ir[0]) * dim * 2);
+  }
+
+  FrameSnapshot::~FrameSnapshot() {
+    SAFE_DELETE_ARR(depth);
+    SAFE_DELETE_ARR(rgb);
+    SAFE_DELETE_ARR(ir);
+    SAFE_DELETE_ARR(registered_rgb);
+    SAFE_DELETE_ARR(xyz);
+    SAFE_DELETE_ARR(labels);
+    SAFE_DELETE_ARR(labels_filtered);
+    SAFE_DELETE_ARR(labels_evaluated);
+  }
+
+  std::shared_ptr<FrameSnapshotPool> FrameSnapshotPool::create(
+    const uint32_t w, const uint32_t h) {
+    std::shared_ptr<FrameSnapshotPool> pool(new FrameSnapshotPool(w, h));
+    pool->self_ = pool;
+    return pool;
+  }
+
+  FrameSnapshotPool::FrameSnapshotPool(const uint32_t w, const uint32_t h) {
+    w_ = w;
+    h_ = h;
+    num_allocated_ = 0;
+  }
+
+  FrameSnapshotPool::~FrameSnapshotPool() {
+    // Every snapshot is back in free_ (each one holds a reference to us)
+    for (uint32_t i = 0; i < free_.size(); i++) {
+      SAFE_DELETE(free_[i]);
+    }
+  }
+
+  std::shared_ptr<FrameSnapshot> FrameSnapshotPool::acquire() {
+    FrameSnapshot* frame = NULL;
+    std::unique_lock<std::mutex> ul(lock_);
+    if (free_.size() > 0) {
+      free_.popBackUnsafe(frame);
+    } else {
+      num_allocated_++;
+    }
+    ul.unlock();
+    if (frame == NULL) {
+      frame = new FrameSnapshot(w_, h_);
+    }
+    std::shared_ptr<FrameSnapshotPool> pool = self_.lock();
+    return std::shared_ptr<FrameSnapshot>(frame,
+      [pool](FrameSnapshot* f) { pool->release(f); });
+  }
+
+  void FrameSnapshotPool::release(FrameSnapshot* frame) {
+    std::unique_lock<std::mutex> ul(lock_);
+    free_.pushBack(frame);
+  }
+
+  uint32_t FrameSnapshotPool::num_allocated() {
+    std::unique_lock<std::mutex> ul(lock_);
+    return num_allocated_;
+  }
+
+  FrameMailbox::FrameMailbox() {
+    closed_ = false;
+    num_dropped_ = 0;
+  }
+
+  FrameMailbox::~FrameMailbox() {
+    // Nothing to do
+  }
+
+  void FrameMailbox::put(const std::shared_ptr<FrameSnapshot>& frame) {
+    std::unique_lock<std::mutex> ul(lock_);
+    if (frame_ != NULL) {
+      num_dropped_++;
+    }
+    frame_ = frame;
+    not_empty_.notify_one();
+  }
+
+  bool FrameMailbox::take(std::shared_ptr<FrameSnapshot>& frame) {
+    std::unique_lock<std::mutex> ul(lock_);
+    while (frame_ == NULL && !closed_) {
+      not_empty_.wait(ul);
+    }
+    if (frame_ == NULL) {
+      return false;
+    }
+    frame.swap(frame_);
+    frame_.reset();
+    return true;
+  }
+
+  void FrameMailbox::close() {
+    std::unique_lock<std::mutex> ul(lock_);
+    closed_ = true;
+    not_empty_.notify_all();
+  }
+
+  uint64_t FrameMailbox::num_dropped() {
+    std::unique_lock<std::mutex> ul(lock_);
+    return num_dropped_;
+  }
+
+};  // namespace kinect_interface_primesense
@@ -0,0 +1,467 @@
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include "kinect_interface_primesense/grid_graph_cut.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+#define GG_INFINITE_D 0x7fffffff  // Larger than any distance to a terminal
+
+namespace kinect_interface_primesense {
+
+  GridGraphCut::GridGraphCut() {
+    w_ = 0;
+    h_ = 0;
+    pw_ = 0;
+    ph_ = 0;
+    n_ = 0;
+    cap_ = NULL;
+    tr_cap_ = NULL;
+    tree_ = NULL;
+    parent_ = NULL;
+    ts_ = NULL;
+    dist_ = NULL;
+    active_ = NULL;
+    active_queue_ = NULL;
+    orphan_queue_ = NULL;
+    flow_ = 0;
+    time_ = 0;
+  }
+
+  GridGraphCut::~GridGraphCut() {
+    releaseData();
+  }
+
+  void GridGraphCut::releaseData() {
+    SAFE_DELETE_ARR(cap_);
+    SAFE_DELETE_ARR(tr_cap_);
+    SAFE_DELETE_ARR(tree_);
+    SAFE_DELETE_ARR(parent_);
+    SAFE_DELETE_ARR(ts_);
+    SAFE_DELETE_ARR(dist_);
+    SAFE_DELETE_ARR(active_);
+    SAFE_DELETE_ARR(active_queue_);
+    SAFE_DELETE_ARR(orphan_queue_);
+  }
+
+  void GridGraphCut::init(const uint32_t width, const uint32_t height) {
+    if (width == 0 || height == 0) {
+      throw std::wruntime_error("GridGraphCut::init() - ERROR: "
+        "width and height must be positive!");
+    }
+    if (width != w_ || height != h_) {
+      releaseData();
+      w_ = width;
+      h_ = height;
+      pw_ = w_ + 2;
+      ph_ = h_ + 2;
+      n_ = static_cast<int32_t>(pw_ * ph_);
+      cap_ = new float[n_ * GG_NUM_DIRECTIONS];
+      tr_cap_ = new float[n_];
+      tree_ = new uint8_t[n_];
+      parent_ = new uint8_t[n_];
+      ts_ = new int32_t[n_];
+      dist_ = new int32_t[n_];
+      active_ = new uint8_t[n_];
+      active_queue_ = new int32_t[n_];
+      orphan_queue_ = new int32_t[n_];
+
+      const int32_t pw = static_cast<int32_t>(pw_);
+      offset_[GG_RIGHT] = 1;
+      offset_[GG_LEFT] = -1;
+      offset_[GG_DOWN] = pw;
+      offset_[GG_UP] = -pw;
+      offset_[GG_DOWN_RIGHT] = pw + 1;
+      offset_[GG_UP_LEFT] = -pw - 1;
+      offset_[GG_DOWN_LEFT] = pw - 1;
+      offset_[GG_UP_RIGHT] = -pw + 1;
+    }
+    reset();
+  }
+
+  void GridGraphCut::reset() {
+    memset(cap_, 0, n_ * GG_NUM_DIRECTIONS * sizeof(cap_[0]));
+    memset(tr_cap_, 0, n_ * sizeof(tr_cap_[0]));
+    memset(tree_, GG_TREE_FREE, n_ * sizeof(tree_[0]));
+    flow_ = 0;
+  }
+
+  // Same as Graph::add_tweights: only the difference is stored, the common
+  // part can go straight to the flow
+  void GridGraphCut::addTerminalWeights(const uint32_t u, const uint32_t v,
+    const float cap_source, const float cap_sink) {
+    const int32_t i = (v + 1) * pw_ + (u + 1);
+    float source = cap_source;
+    float sink = cap_sink;
+    const float delta = tr_cap_[i];
+    if (delta > 0) {
+      source += delta;
+    } else {
+      sink -= delta;
+    }
+    flow_ += source < sink ? source : sink;
+    tr_cap_[i] = source - sink;
+  }
+
+  void GridGraphCut::addEdge(const uint32_t u, const uint32_t v,
+    const GridGraphDirection dir, const float cap_fwd, const float cap_rev) {
+    const int32_t i = (v + 1) * pw_ + (u + 1);
+    const int32_t j = i + offset_[dir];
+    const uint32_t u_j = j % pw_;
+    const uint32_t v_j = j / pw_;
+    if (u >= w_ || v >= h_ || u_j < 1 || u_j > w_ || v_j < 1 || v_j > h_) {
+      throw std::wruntime_error("GridGraphCut::addEdge() - ERROR: "
+        "edge leaves the image!");
+    }
+    cap(dir, i) += cap_fwd;
+    cap(dir ^ 1, j) += cap_rev;
+  }
+
+  void GridGraphCut::setActive(const int32_t i) {
+    if (!active_[i]) {
+      active_[i] = 1;
+      active_queue_[(active_head_ + active_count_) % n_] = i;
+      active_count_++;
+    }
+  }
+
+  int32_t GridGraphCut::nextActive() {
+    while (active_count_ > 0) {
+      const int32_t i = active_queue_[active_head_];
+      active_head_ = (active_head_ + 1) % n_;
+      active_count_--;
+      active_[i] = 0;
+      if (tree_[i] != GG_TREE_FREE) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  void GridGraphCut::setOrphan(const int32_t i) {
+    parent_[i] = GG_PARENT_ORPHAN;
+    orphan_queue_[(orphan_head_ + orphan_count_) % n_] = i;
+    orphan_count_++;
+  }
+
+  float GridGraphCut::maxflow() {
+    memset(active_, 0, n_ * sizeof(active_[0]));
+    memset(ts_, 0, n_ * sizeof(ts_[0]));
+    active_head_ = 0;
+    active_count_ = 0;
+    orphan_head_ = 0;
+    orphan_count_ = 0;
+    time_ = 0;
+
+    // Every node with terminal capacity starts a tree.  The border nodes have
+    // none so they stay free (and can't be grown into since there are no
+    // edges to them).
+    for (int32_t i = 0; i < n_; i++) {
+      if (tr_cap_[i] > 0) {
+        tree_[i] = GG_TREE_SOURCE;
+        parent_[i] = GG_PARENT_TERMINAL;
+        dist_[i] = 1;
+        setActive(i);
+      } else if (tr_cap_[i] < 0) {
+        tree_[i] = GG_TREE_SINK;
+        parent_[i] = GG_PARENT_TERMINAL;
+        dist_[i] = 1;
+        setActive(i);
+      } else {
+        tree_[i] = GG_TREE_FREE;
+        parent_[i] = GG_PARENT_NONE;
+      }
+    }
+
+    int32_t cur_node = -1;
+    while (true) {
+      if (cur_node < 0 || tree_[cur_node] == GG_TREE_FREE) {
+        cur_node = nextActive();
+        if (cur_node < 0) {
+          break;
+        }
+      }
+
+      int32_t src_node, dir;
+      if (!grow(cur_node, src_node, dir)) {
+        cur_node = -1;  // This node is done, move onto the next active one
+        continue;
+      }
+
+      // Keep working on cur_node after the augmentation (if it is still in a
+      // tree), it may have more paths
+      time_++;
+      augment(src_node, dir);
+      while (orphan_count_ > 0) {
+        const int32_t i = orphan_queue_[orphan_head_];
+        orphan_head_ = (orphan_head_ + 1) % n_;
+        orphan_count_--;
+        if (tree_[i] == GG_TREE_SOURCE) {
+          processSourceOrphan(i);
+        } else {
+          processSinkOrphan(i);
+        }
+      }
+    }
+
+    return flow_;
+  }
+
+  // grow - Add i's free neighbours to its tree.  If a neighbour is in the
+  // other tree there is a path from the source to the sink through the edge
+  // src_node --> src_node + offset[dir], and the function returns true.
+  bool GridGraphCut::grow(const int32_t i, int32_t& src_node, int32_t& dir) {
+    if (tree_[i] == GG_TREE_SOURCE) {
+      for (int32_t d = 0; d < GG_NUM_DIRECTIONS; d++) {
+        if (cap(d, i) <= 0) {
+          continue;
+        }
+        const int32_t j = i + offset_[d];
+        if (tree_[j] == GG_TREE_FREE) {
+          tree_[j] = GG_TREE_SOURCE;
+          parent_[j] = static_cast<uint8_t>(d ^ 1);
+          ts_[j] = ts_[i];
+          dist_[j] = dist_[i] + 1;
+          setActive(j);
+        } else if (tree_[j] == GG_TREE_SINK) {
+          src_node = i;
+          dir = d;
+          return true;
+        } else if (ts_[j] <= ts_[i] && dist_[j] > dist_[i]) {
+          // Shorten the path back to the terminal (heuristic from BK)
+          parent_[j] = static_cast<uint8_t>(d ^ 1);
+          ts_[j] = ts_[i];
+          dist_[j] = dist_[i] + 1;
+        }
+      }
+    } else {
+      for (int32_t d = 0; d < GG_NUM_DIRECTIONS; d++) {
+        const int32_t j = i + offset_[d];
+        if (cap(d ^ 1, j) <= 0) {
+          continue;
+        }
+        if (tree_[j] == GG_TREE_FREE) {
+          tree_[j] = GG_TREE_SINK;
+          parent_[j] = static_cast<uint8_t>(d ^ 1);
+          ts_[j] = ts_[i];
+          dist_[j] = dist_[i] + 1;
+          setActive(j);
+        } else if (tree_[j] == GG_TREE_SOURCE) {
+          src_node = j;
+          dir = d ^ 1;
+          return true;
+        } else if (ts_[j] <= ts_[i] && dist_[j] > dist_[i]) {
+          parent_[j] = static_cast<uint8_t>(d ^ 1);
+          ts_[j] = ts_[i];
+          dist_[j] = dist_[i] + 1;
+        }
+      }
+    }
+    return false;
+  }
+
+  void GridGraphCut::augment(const int32_t src_node, const int32_t dir) {
+    const int32_t sink_node = src_node + offset_[dir];
+
+    // Find the bottleneck capacity
+    float bottleneck = cap(dir, src_node);
+    int32_t i = src_node;
+    while (parent_[i] != GG_PARENT_TERMINAL) {
+      const int32_t p = i + offset_[parent_[i]];
+      const float c = cap(parent_[i] ^ 1, p);  // p --> i
+      bottleneck = c < bottleneck ? c : bottleneck;
+      i = p;
+    }
+    bottleneck = tr_cap_[i] < bottleneck ? tr_cap_[i] : bottleneck;
+    i = sink_node;
+    while (parent_[i] != GG_PARENT_TERMINAL) {
+      const float c = cap(parent_[i], i);  // i --> parent
+      bottleneck = c < bottleneck ? c : bottleneck;
+      i = i + offset_[parent_[i]];
+    }
+    bottleneck = -tr_cap_[i] < bottleneck ? -tr_cap_[i] : bottleneck;
+
+    // Push the flow, saturated edges make orphans
+    cap(dir, src_node) -= bottleneck;
+    cap(dir ^ 1, sink_node) += bottleneck;
+    i = src_node;
+    while (parent_[i] != GG_PARENT_TERMINAL) {
+      const int32_t d = parent_[i];
+      const int32_t p = i + offset_[d];
+      cap(d, i) += bottleneck;
+      cap(d ^ 1, p) -= bottleneck;
+      if (cap(d ^ 1, p) <= 0) {
+        setOrphan(i);
+      }
+      i = p;
+    }
+    tr_cap_[i] -= bottleneck;
+    if (tr_cap_[i] <= 0) {
+      setOrphan(i);
+    }
+    i = sink_node;
+    while (parent_[i] != GG_PARENT_TERMINAL) {
+      const int32_t d = parent_[i];
+      const int32_t p = i + offset_[d];
+      cap(d ^ 1, p) += bottleneck;
+      cap(d, i) -= bottleneck;
+      if (cap(d, i) <= 0) {
+        setOrphan(i);
+      }
+      i = p;
+    }
+    tr_cap_[i] += bottleneck;
+    if (tr_cap_[i] >= 0) {
+      setOrphan(i);
+    }
+
+    flow_ += bottleneck;
+  }
+
+  // processSourceOrphan - Try to find a new parent for i in the source tree
+  // (one that still leads back to the source), otherwise free i and orphan
+  // its children.
+  void GridGraphCut::processSourceOrphan(const int32_t i) {
+    int32_t best_dir = -1;
+    int32_t best_dist = GG_INFINITE_D;
+    for (int32_t d = 0; d < GG_NUM_DIRECTIONS; d++) {
+      const int32_t j = i + offset_[d];
+      if (tree_[j] != GG_TREE_SOURCE || cap(d ^ 1, j) <= 0) {
+        continue;
+      }
+      // Walk up to the terminal (or an orphan) from j
+      int32_t k = j;
+      int32_t dist = 0;
+      while (true) {
+        if (ts_[k] == time_) {
+          dist += dist_[k];
+          break;
+        }
+        const uint8_t p = parent_[k];
+        dist++;
+        if (p == GG_PARENT_TERMINAL) {
+          ts_[k] = time_;
+          dist_[k] = 1;
+          break;
+        }
+        if (p == GG_PARENT_ORPHAN) {
+          dist = GG_INFINITE_D;
+          break;
+        }
+        k += offset_[p];
+      }
+      if (dist < GG_INFINITE_D) {
+        if (dist < best_dist) {
+          best_dir = d;
+          best_dist = dist;
+        }
+        // Cache the distances along the path
+        for (k = j; ts_[k] != time_; k += offset_[parent_[k]]) {
+          ts_[k] = time_;
+          dist_[k] = dist;
+          dist--;
+        }
+      }
+    }
+
+    if (best_dir >= 0) {
+      parent_[i] = static_cast<uint8_t>(best_dir);
+      ts_[i] = time_;
+      dist_[i] = best_dist + 1;
+      return;
+    }
+
+    // No parent, i becomes free
+    for (int32_t d = 0; d < GG_NUM_DIRECTIONS; d++) {
+      const int32_t j = i + offset_[d];
+      if (tree_[j] != GG_TREE_SOURCE) {
+        continue;
+      }
+      if (cap(d ^ 1, j) > 0) {
+        setActive(j);
+      }
+      const uint8_t p = parent_[j];
+      if (p < GG_NUM_DIRECTIONS && j + offset_[p] == i) {
+        setOrphan(j);
+      }
+    }
+    tree_[i] = GG_TREE_FREE;
+    parent_[i] = GG_PARENT_NONE;
+  }
+
+  void GridGraphCut::processSinkOrphan(const int32_t i) {
+    int32_t best_dir = -1;
+    int32_t best_dist = GG_INFINITE_D;
+    for (int32_t d = 0; d < GG_NUM_DIRECTIONS; d++) {
+      const int32_t j = i + offset_[d];
+      if (tree_[j] != GG_TREE_SINK || cap(d, i) <= 0) {
+        continue;
+      }
+      int32_t k = j;
+      int32_t dist = 0;
+      while (true) {
+        if (ts_[k] == time_) {
+          dist += dist_[k];
+          break;
+        }
+        const uint8_t p = parent_[k];
+        dist++;
+        if (p == GG_PARENT_TERMINAL) {
+          ts_[k] = time_;
+          dist_[k] = 1;
+          break;
+        }
+        if (p == GG_PARENT_ORPHAN) {
+          dist = GG_INFINITE_D;
+          break;
+        }
+        k += offset_[p];
+      }
+      if (dist < GG_INFINITE_D) {
+        if (dist < best_dist) {
+          best_dir = d;
+          best_dist = dist;
+        }
+        for (k = j; ts_[k] != time_; k += offset_[parent_[k]]) {
+          ts_[k] = time_;
+          dist_[k] = dist;
+          dist--;
+        }
+      }
+    }
+
+    if (best_dir >= 0) {
+      parent_[i] = static_cast<uint8_t>(best_dir);
+      ts_[i] = time_;
+      dist_[i] = best_dist + 1;
+      return;
+    }
+
+    for (int32_t d = 0; d < GG_NUM_DIRECTIONS; d++) {
+      const int32_t j = i + offset_[d];
+      if (tree_[j] != GG_TREE_SINK) {
+        continue;
+      }
+      if (cap(d, i) > 0) {
+        setActive(j);
+      }
+      const uint8_t p = parent_[j];
+      if (p < GG_NUM_DIRECTIONS && j + offset_[p] == i) {
+        setOrphan(j);
+      }
+    }
+    tree_[i] = GG_TREE_FREE;
+    parent_[i] = GG_PARENT_NONE;
+  }
+
+  void GridGraphCut::getSegmentation(uint8_t* labels) const {
+    for (uint32_t v = 0; v < h_; v++) {
+      const uint8_t* tree = &tree_[(v + 1) * pw_ + 1];
+      uint8_t* dst = &labels[v * w_];
+      for (uint32_t u = 0; u < w_; u++) {
+        dst[u] = tree[u] == GG_TREE_SOURCE ? 1 : 0;
+      }
+    }
+  }
+
+}  // namespace kinect_interface_primesense
@@ -0,0 +1,259 @@
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include "kinect_interface_primesense/hand_detector/decision_forest_sweep.h"
+#include "kinect_interface_primesense/hand_detector/decision_tree_func.h"
+#include "kinect_interface_primesense/hand_detector/decision_tree_structs.h"
+#include "kinect_interface_primesense/depth_image_data.h"
+#include "kinect_interface/task_scheduler.h"
+#include "jtil/data_str/vector_managed.h"
+
+using std::string;
+using jtil::data_str::VectorManaged;
+using jtil::threading::Callback;
+using kinect_interface::TaskScheduler;
+using kinect_interface::runTasks;
+using namespace jtil::threading;
+
+#define SAFE_DELETE(x) do { if (x != NULL) { delete x; x = NULL; } } while (0);
+
+namespace kinect_interface_primesense {
+namespace hand_detector {
+
+  DecisionForestSweep::DecisionForestSweep(TaskScheduler* ts) {
+    ts_ = ts;
+    data_ = NULL;
+    forest_ = NULL;
+    num_trees_ = 0;
+    num_pix_ = 0;
+    num_fixed_false_neg_ = 0;
+    configs_ = NULL;
+    num_configs_ = 0;
+    leaf_cbs_ = NULL;
+
+    // Thread i scores configs i, i + num_threads, ...
+    const uint32_t num_threads = ts_ != NULL ? ts_->num_threads() : 1;
+    config_cbs_ = new VectorManaged<Callback<void>*>(num_threads);
+    for (uint32_t i = 0; i < num_threads; i++) {
+      config_cbs_->pushBack(MakeCallableMany(
+        &DecisionForestSweep::evaluateConfigs, this, i));
+    }
+  }
+
+  DecisionForestSweep::~DecisionForestSweep() {
+    SAFE_DELETE(leaf_cbs_);
+    SAFE_DELETE(config_cbs_);
+  }
+
+  void DecisionForestSweep::init(const DepthImageData* data,
+    const DecisionTree* forest, const uint32_t num_trees) {
+    data_ = data;
+    forest_ = forest;
+    num_trees_ = num_trees;
+
+    // Pixels with no valid depth are always labeled background
+    num_pix_ = (uint64_t)(data->im_width * data->im_height) * data->num_images;
+    num_fixed_false_neg_ = 0;
+    pix_.clear();
+    for (uint64_t i = 0; i < num_pix_; i++) {
+      if (data->image_data[i] != 0 && data->image_data[i] < GDT_MAX_DIST) {
+        pix_.push_back((int32_t)i);
+      } else if (data->label_data[i] != 0) {
+        num_fixed_false_neg_++;
+      }
+    }
+
+    // The tree structure, to map leaves to their ancestors later
+    parent_.resize(num_trees);
+    node_height_.resize(num_trees);
+    order_.resize(num_trees);
+    for (uint32_t t = 0; t < num_trees; t++) {
+      const DecisionTree& tree = forest[t];
+      std::vector<int32_t>& parent = parent_[t];
+      std::vector<uint32_t>& node_height = node_height_[t];
+      std::vector<int32_t>& order = order_[t];
+      parent.assign(tree.num_nodes, -1);
+      node_height.assign(tree.num_nodes, 0);
+      order.clear();
+      order.push_back(0);
+      node_height[0] = 1;
+      for (size_t i = 0; i < order.size(); i++) {
+        const int32_t n = order[i];
+        if (tree.tree[n].left_child != -1 &&
+          node_height[n] < tree.tree_height) {
+          const int32_t children[2] = {tree.tree[n].left_child,
+            tree.tree[n].right_child};
+          for (uint32_t c = 0; c < 2; c++) {
+            parent[children[c]] = n;
+            node_height[children[c]] = node_height[n] + 1;
+            order.push_back(children[c]);
+          }
+        }
+      }
+    }
+
+    // Walk every tree once per pixel
+    leaves_.resize(num_trees * pix_.size());
+    SAFE_DELETE(leaf_cbs_);
+    const uint32_t num_threads = ts_ != NULL ? ts_->num_threads() : 1;
+    leaf_cbs_ = new VectorManaged<Callback<void>*>(num_threads);
+    const uint32_t n_pixels = (uint32_t)pix_.size();
+    const uint32_t n_pixels_per_thread = 1 + n_pixels / num_threads;
+    for (uint32_t i = 0; i < num_threads; i++) {
+      const uint32_t start = std::min<uint32_t>(i * n_pixels_per_thread,
+        n_pixels);
+      const uint32_t end = std::min<uint32_t>(start + n_pixels_per_thread,
+        n_pixels);
+      leaf_cbs_->pushBack(MakeCallableMany(
+        &DecisionForestSweep::cacheLeavesRange, this, start, end));
+    }
+    runTasks(ts_, leaf_cbs_);
+  }
+
+  void DecisionForestSweep::cacheLeavesRange(const uint32_t start,
+    const uint32_t end) {
+    const int32_t width = data_->im_width;
+    const int32_t height = data_->im_height;
+    const int16_t* image_data = data_->image_data;
+    const size_t num_valid = pix_.size();
+    for (uint32_t t = 0; t < num_trees_; t++) {
+      const DecisionTree& tree = forest_[t];
+      for (uint32_t i = start; i < end; i++) {
+        const int32_t index = pix_[i];
+        int32_t node = 0;
+        uint32_t cur_height = 1;
+        while (cur_height < tree.tree_height &&
+          tree.tree[node].left_child != -1) {
+          const DecisionTreeNode& n = tree.tree[node];
+          if (WL_FUNC(index, n.coeff0, n.coeff1, n.coeff2, n.wl_func, width,
+            height, image_data)) {
+            node = n.left_child;
+          } else {
+            node = n.right_child;
+          }
+          cur_height++;
+        }
+        leaves_[t * num_valid + i] = node;
+      }
+    }
+  }
+
+  void DecisionForestSweep::evaluate(ForestSweepConfig* configs,
+    const uint32_t num_configs) {
+    for (uint32_t i = 0; i < num_configs; i++) {
+      for (uint32_t j = 0; j < configs[i].trees.size(); j++) {
+        if (configs[i].trees[j] >= num_trees_) {
+          throw std::runtime_error("DecisionForestSweep::evaluate() - "
+            "ERROR: tree index out of range!");
+        }
+      }
+    }
+    configs_ = configs;
+    num_configs_ = num_configs;
+    runTasks(ts_, config_cbs_);
+    configs_ = NULL;
+    num_configs_ = 0;
+  }
+
+  void DecisionForestSweep::evaluateConfigs(const uint32_t thread) {
+    for (uint32_t i = thread; i < num_configs_; i += config_cbs_->size()) {
+      evaluateConfig(configs_[i]);
+    }
+  }
+
+  void DecisionForestSweep::evaluateConfig(ForestSweepConfig& config) {
+    const uint32_t num_trees = (uint32_t)config.trees.size();
+    // As in evaluateDecisionForestPixel, a max_height of 0 is no cutoff
+    const uint32_t max_height = config.max_height > 0 ? config.max_height :
+      std::numeric_limits<uint32_t>::max();
+    const size_t num_valid = pix_.size();
+
+    // cutoff[k][leaf] - The node tree k stops at with this max_height
+    std::vector<std::vector<int32_t>> cutoff(num_trees);
+    for (uint32_t k = 0; k < num_trees; k++) {
+      const uint32_t t = config.trees[k];
+      std::vector<int32_t>& cur = cutoff[k];
+      cur.assign(forest_[t].num_nodes, -1);
+      for (size_t i = 0; i < order_[t].size(); i++) {
+        const int32_t n = order_[t][i];
+        cur[n] = node_height_[t][n] <= max_height ? n : cur[parent_[t][n]];
+      }
+    }
+
+    // Same accumulation (and order) as evaluateDecisionForestPixel
+    uint64_t num_false_pos = 0;
+    uint64_t num_false_neg = num_fixed_false_neg_;
+    float hist[NUM_LABELS];
+    for (size_t i = 0; i < num_valid; i++) {
+      for (uint32_t l = 0; l < NUM_LABELS; l++) {
+#ifndef MULTIPLY_LEAVES
+        hist[l] = 0;
+#else
+        hist[l] = 1;
+#endif
+      }
+      for (uint32_t k = 0; k < num_trees; k++) {
+        const uint32_t t = config.trees[k];
+        const int32_t node = cutoff[k][leaves_[t * num_valid + i]];
+        const float* prob = forest_[t].tree[node].prob;
+        for (uint32_t l = 0; l < NUM_LABELS; l++) {
+#ifndef MULTIPLY_LEAVES
+          hist[l] += prob[l];
+#else
+          hist[l] *= prob[l];
+#endif
+        }
+      }
+      uint8_t pixel_label = 0;
+      float max_hist = -1;
+      for (uint8_t l = 0; l < NUM_LABELS; l++) {
+        if (hist[l] > max_hist) {
+          max_hist = hist[l];
+          pixel_label = l;
+        }
+      }
+      const uint8_t label = data_->label_data[pix_[i]];
+      if (pixel_label != label) {
+        if (label == 0) {
+          num_false_pos++;
+        } else {
+          num_false_neg++;
+        }
+      }
+    }
+    config.num_false_pos = num_false_pos;
+    config.num_false_neg = num_false_neg;
+    config.error = static_cast<float>(num_false_pos + num_false_neg) /
+      static_cast<float>(num_pix_);
+  }
+
+  void DecisionForestSweep::saveCSV(const std::string& filename,
+    const std::string& data_set, const ForestSweepConfig* configs,
+    const uint32_t num_configs, const bool append) {
+    std::ofstream file(filename.c_str(),
+      append ? (std::ios::out | std::ios::app) : std::ios::out);
+    if (!file.is_open()) {
+      throw std::runtime_error("DecisionForestSweep::saveCSV() - ERROR: "
+        "could not open " + filename);
+    }
+    if (!append) {
+      file << "data_set,trees,num_trees,max_height,error,num_false_pos,";
+      file << "num_false_neg" << std::endl;
+    }
+    for (uint32_t i = 0; i < num_configs; i++) {
+      const ForestSweepConfig& c = configs[i];
+      file << data_set << ",";
+      for (uint32_t j = 0; j < c.trees.size(); j++) {
+        file << c.trees[j] << (j + 1 < c.trees.size() ? " " : "");
+      }
+      file << "," << c.trees.size() << "," << c.max_height << ",";
+      file << c.error << "," << c.num_false_pos << "," << c.num_false_neg;
+      file << std::endl;
+    }
+    file.close();
+  }
+
+};  // namespace hand_detector
+};  // namespace kinect_interface_primesense
@@ -6,9 +6,10 @@
 #include "kinect_interface_primesense/hand_detector/decision_tree_structs.h"
 #include "kinect_interface_primesense/hand_detector/evaluate_decision_forest.h"
 #include "kinect_interface_primesense/open_ni_funcs.h"
+#include "kinect_interface/task_scheduler.h"
+#include "kinect_interface/trace.h"
 #include "jtil/image_util/image_util.h"
 #include "jtil/file_io/file_io.h"
-#include "jtil/threading/thread_pool.h"
 #include "jtorch/jtorch.h"
 #include "jtil/data_str/vector_managed.h"
 
@@ -17,6 +18,8 @@ using std::runtime_error;
 using jtil::data_str::Vector;
 using jtil::data_str::VectorManaged;
 using jtil::threading::Callback;
+using kinect_interface::TaskScheduler;
+using kinect_interface::runTasks;
 using namespace jtil::math;
 using namespace jtil::threading;
 using namespace jtil::image_util;
@@ -39,7 +42,7 @@ namespace hand_detector {
      {-o_r, -o_r}, {-o_r, 0}, {-o_r, +o_r}, {0, +o_r}, {+o_r, +o_r}, {+o_r, 0},
      {+o_r, -o_r}, {0, -o_r}};
 
-  HandDetector::HandDetector(ThreadPool* tp) {
+  HandDetector::HandDetector(TaskScheduler* ts) {
     stage2_med_filter_radius_ = HD_STARTING_MED_FILT_RAD;
     stage3_grow_filter_radius_ = HD_STARTING_GROW_FILT_RAD;
     stage1_shrink_filter_radius_ = HD_STARTING_SHRINK_FILT_RAD;
@@ -62,7 +65,7 @@ namespace hand_detector {
     forest_ = NULL;
     num_trees_ = 0;
 
-    tp_ = tp;
+    ts_ = ts;
     thread_cbs_ = NULL;
   }
 
@@ -115,11 +118,11 @@ namespace hand_detector {
     max_height_to_evaluate_ = max_height_ < max_height_to_evaluate_ ? max_height_ 
                              : max_height_to_evaluate_;
 
-    const int num_threads = tp_->num_workers();
+    const int num_threads = ts_ != NULL ? ts_->num_threads() : 1;
     thread_cbs_ = new VectorManaged<Callback<void>*>(num_threads);
 
     // Figure out the load balance accross worker threads.  This thread will act
-    // as a worker thread as well.
+    // as a worker thread as well (it helps while it waits on the scheduler).
     uint32_t n_pixels = down_width_*down_height_;
     uint32_t n_pixels_per_thread = 1 + n_pixels / num_threads;
     for (int32_t i = 0; i < num_threads; i++) {
@@ -260,11 +263,13 @@ namespace hand_detector {
   }
 
   void HandDetector::createLabels(const int16_t* depth_data) {
+    TRACE_SCOPE(TRACE_FOREST_EVAL);
     evaluateForest(depth_data);
   }
 
   void HandDetector::filterLabels(uint8_t*& dst, uint8_t*& src, uint8_t*& tmp,
     int16_t* depth, const int32_t w, const int32_t h) {
+    TRACE_SCOPE(TRACE_LABEL_FILTER);
     ShrinkFilter<uint8_t>(tmp, src, w, h, 
       stage1_shrink_filter_radius_);
     MedianLabelFilter<uint8_t, int16_t>(dst, tmp, depth, w, h, 
@@ -278,6 +283,7 @@ namespace hand_detector {
 
   void HandDetector::filterLabelsThreshold(uint8_t*& dst, uint8_t*& src, 
     uint8_t*& tmp, int16_t* depth, const int32_t w, const int32_t h) {
+    TRACE_SCOPE(TRACE_LABEL_FILTER);
     memcpy(tmp, src, w * h * sizeof(tmp[0]));
     GrowFilterDepthThreshold(dst, tmp, depth, w, h, 
       stage3_grow_filter_radius_);
@@ -333,17 +339,7 @@ namespace hand_detector {
   };
 
   void HandDetector::evaluateForestMultithreaded() {
-    threads_finished_ = 0;
-    for (uint32_t i = 0; i < thread_cbs_->size(); i++) {
-      tp_->addTask((*thread_cbs_)[i]);
-    }
-
-    // Wait until the other threads are done
-    std::unique_lock<std::mutex> ul(thread_update_lock_);  // Get lock
-    while (threads_finished_ != thread_cbs_->size()) {
-      not_finished_.wait(ul);
-    }
-    ul.unlock();  // Release lock
+    runTasks(ts_, thread_cbs_);
   }
 
   void HandDetector::evaluateForestPixelRange(const uint32_t istart, 
@@ -351,11 +347,6 @@ namespace hand_detector {
     for (uint32_t i = istart; i <= iend; i++) {
       evaluateForestPixel(i);
     }
-
-    std::unique_lock<std::mutex> ul(thread_update_lock_);
-    threads_finished_++;
-    not_finished_.notify_all();  // Signify that all threads might have finished
-    ul.unlock();
   }
 
   void HandDetector::evaluateForestPixel(const uint32_t index) {
@@ -373,6 +364,7 @@ namespace hand_detector {
 
   void HandDetector::floodFillLabelData(bool* rhand_found, float* rhand_uvd, 
     bool* lhand_found, float* lhand_uvd) {
+    TRACE_SCOPE(TRACE_FLOOD_FILL);
     // re-use the labels_evaluated data instead of allocating more
     //hands_uv_min_.resize(0);
     //hands_uv_max_.resize(0);
@@ -553,6 +545,7 @@ namespace hand_detector {
   // HandStatistics --> One day I will completely remove HandStatistics
   void HandDetector::findHandLabelsFloodFill(const float* pt_hand_uvd, 
     const float* xyz, uint8_t* label) {
+    TRACE_SCOPE(TRACE_FLOOD_FILL);
     float pt_hand_xyz[3];
     OpenNIFuncs::xnConvertProjectiveToRealWorld(1, pt_hand_uvd, 
       pt_hand_xyz);
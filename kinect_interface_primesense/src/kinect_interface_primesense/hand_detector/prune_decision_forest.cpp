@@ -0,0 +1,347 @@
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <queue>
+#include <iostream>
+#include "kinect_interface_primesense/hand_detector/prune_decision_forest.h"
+#include "kinect_interface_primesense/hand_detector/evaluate_decision_forest.h"
+#include "kinect_interface_primesense/hand_detector/decision_tree_func.h"
+#include "kinect_interface_primesense/hand_detector/decision_tree_structs.h"
+#include "kinect_interface_primesense/depth_image_data.h"
+
+using std::cout;
+using std::endl;
+
+namespace kinect_interface_primesense {
+namespace hand_detector {
+
+  namespace {
+
+    // A subtree that could be collapsed.  The smallest error increase per
+    // leaf removed comes out of the queue first.
+    struct PruneCandidate {
+      float cost_per_leaf;
+      int32_t node;
+      uint32_t version;
+      bool operator<(const PruneCandidate& a) const {
+        return cost_per_leaf > a.cost_per_leaf;
+      }
+    };
+
+    // findLeaf - The node that evaluateDecisionForestPixel stops at (with
+    // max_height >= tree.tree_height).  index is into the whole image array.
+    int32_t findLeaf(const DecisionTree& tree, const int16_t* image_data,
+      const int32_t width, const int32_t height, const int32_t index) {
+      int32_t node = 0;
+      uint32_t cur_height = 1;
+      while (cur_height < tree.tree_height &&
+        tree.tree[node].left_child != -1) {
+        const DecisionTreeNode& n = tree.tree[node];
+        if (WL_FUNC(index, n.coeff0, n.coeff1, n.coeff2, n.wl_func, width,
+          height, image_data)) {
+          node = n.left_child;
+        } else {
+          node = n.right_child;
+        }
+        cur_height++;
+      }
+      return node;
+    }
+
+    void initHist(float* hist) {
+      for (uint32_t i = 0; i < NUM_LABELS; i++) {
+#ifndef MULTIPLY_LEAVES
+        hist[i] = 0;
+#else
+        hist[i] = 1;
+#endif
+      }
+    }
+
+    void accumHist(float* hist, const float* prob) {
+      for (uint32_t i = 0; i < NUM_LABELS; i++) {
+#ifndef MULTIPLY_LEAVES
+        hist[i] += prob[i];
+#else
+        hist[i] *= prob[i];
+#endif
+      }
+    }
+
+    // pixelError - Is the label wrong when the other trees give hist and
+    // this tree gives prob?
+    bool pixelError(const float* hist, const float* prob,
+      const uint8_t label) {
+      float cur_hist[NUM_LABELS];
+      memcpy(cur_hist, hist, sizeof(cur_hist));
+      accumHist(cur_hist, prob);
+      uint8_t pixel_label = 0;
+      float max_hist = -1;
+      for (uint8_t i = 0; i < NUM_LABELS; i++) {
+        if (cur_hist[i] > max_hist) {
+          max_hist = cur_hist[i];
+          pixel_label = i;
+        }
+      }
+      return pixel_label != label;
+    }
+
+  };  // unnamed namespace
+
+  float selectDecisionForestTrees(uint32_t* selected, uint32_t& num_selected,
+    const DepthImageData* data, const DecisionTree* forest,
+    const uint32_t num_trees, const uint32_t max_trees) {
+    uint32_t max_height = 0;
+    for (uint32_t i = 0; i < num_trees; i++) {
+      max_height = std::max<uint32_t>(max_height, forest[i].tree_height);
+    }
+    // Shallow copies of the selected trees (plus the candidate), since
+    // evaluateDecisionForestError wants them next to each other
+    DecisionTree* subset = new DecisionTree[max_trees];
+    std::vector<bool> used(num_trees, false);
+    num_selected = 0;
+    // With no trees every pixel is labeled background
+    float cur_error = evaluateDecisionForestError(data, subset, 0, false, 0,
+      max_height);
+    while (num_selected < max_trees) {
+      int32_t best_tree = -1;
+      float best_error = cur_error;
+      for (uint32_t i = 0; i < num_trees; i++) {
+        if (used[i]) {
+          continue;
+        }
+        subset[num_selected] = forest[i];
+        float error = evaluateDecisionForestError(data, subset,
+          num_selected + 1, false, 0, max_height);
+        if (error < best_error) {
+          best_error = error;
+          best_tree = i;
+        }
+      }
+      if (best_tree == -1) {
+        break;  // No tree makes it any better
+      }
+      subset[num_selected] = forest[best_tree];
+      selected[num_selected] = best_tree;
+      used[best_tree] = true;
+      num_selected++;
+      cur_error = best_error;
+      cout << "selectDecisionForestTrees - added tree " << best_tree;
+      cout << " (" << num_selected << " trees) --> validation error = ";
+      cout << (cur_error * 100) << "%" << endl;
+    }
+    delete[] subset;
+    return cur_error;
+  }
+
+  void copyDecisionForest(DecisionTree*& forest_out,
+    const DecisionTree* forest, const uint32_t* indices,
+    const uint32_t num_trees) {
+    forest_out = new DecisionTree[num_trees];
+    for (uint32_t i = 0; i < num_trees; i++) {
+      const DecisionTree& src = forest[indices[i]];
+      forest_out[i].tree_height = src.tree_height;
+      forest_out[i].num_nodes = src.num_nodes;
+      forest_out[i].tree = new DecisionTreeNode[src.num_nodes];
+      memcpy(forest_out[i].tree, src.tree,
+        src.num_nodes * sizeof(src.tree[0]));
+    }
+  }
+
+  uint32_t pruneDecisionForest(DecisionTree* forest, const uint32_t num_trees,
+    const DepthImageData* data, const float max_error_increase) {
+    // Only pixels with a valid depth are evaluated; the rest are labeled
+    // background whatever the forest looks like.
+    const int32_t width = data->im_width;
+    const int32_t height = data->im_height;
+    const uint64_t num_pix = (uint64_t)(width * height) * data->num_images;
+    std::vector<int32_t> pix;
+    for (uint64_t i = 0; i < num_pix; i++) {
+      if (data->image_data[i] != 0 && data->image_data[i] < GDT_MAX_DIST) {
+        pix.push_back((int32_t)i);
+      }
+    }
+    const size_t num_valid = pix.size();
+
+    // The leaf every pixel ends up at, per tree
+    std::vector<int32_t> leaves(num_trees * num_valid);
+    for (uint32_t t = 0; t < num_trees; t++) {
+      for (size_t p = 0; p < num_valid; p++) {
+        leaves[t * num_valid + p] = findLeaf(forest[t], data->image_data,
+          width, height, pix[p]);
+      }
+    }
+
+    // Everything is counted in misclassified pixels
+    const int64_t max_cost = (int64_t)(max_error_increase * (float)num_pix);
+    int64_t total_cost = 0;
+    uint32_t num_removed = 0;
+    std::vector<float> hist(num_valid * NUM_LABELS);
+    for (uint32_t t = 0; t < num_trees; t++) {
+      DecisionTree& tree = forest[t];
+      const uint32_t num_nodes = tree.num_nodes;
+
+      // The histograms of the other trees stay fixed while pruning this one
+      for (size_t p = 0; p < num_valid; p++) {
+        float* cur_hist = &hist[p * NUM_LABELS];
+        initHist(cur_hist);
+        for (uint32_t i = 0; i < num_trees; i++) {
+          if (i != t) {
+            accumHist(cur_hist, forest[i].tree[leaves[i * num_valid + p]].prob);
+          }
+        }
+      }
+
+      // Breadth first order, so children always come after their parent.
+      // Nodes at tree_height are leaves even if they have children.
+      std::vector<int32_t> order;
+      std::vector<int32_t> parent(num_nodes, -1);
+      std::vector<uint32_t> node_height(num_nodes, 0);
+      std::vector<bool> internal(num_nodes, false);
+      order.push_back(0);
+      node_height[0] = 1;
+      for (size_t i = 0; i < order.size(); i++) {
+        const int32_t n = order[i];
+        if (tree.tree[n].left_child != -1 &&
+          node_height[n] < tree.tree_height) {
+          internal[n] = true;
+          const int32_t children[2] = {tree.tree[n].left_child,
+            tree.tree[n].right_child};
+          for (uint32_t c = 0; c < 2; c++) {
+            parent[children[c]] = n;
+            node_height[children[c]] = node_height[n] + 1;
+            order.push_back(children[c]);
+          }
+        }
+      }
+
+      // cost[n] - The extra misclassified pixels if n became a leaf
+      std::vector<int64_t> cost(num_nodes, 0);
+      for (size_t p = 0; p < num_valid; p++) {
+        const float* cur_hist = &hist[p * NUM_LABELS];
+        const uint8_t label = data->label_data[pix[p]];
+        const int32_t leaf = leaves[t * num_valid + p];
+        const int64_t leaf_error =
+          pixelError(cur_hist, tree.tree[leaf].prob, label) ? 1 : 0;
+        for (int32_t a = parent[leaf]; a != -1; a = parent[a]) {
+          const int64_t error =
+            pixelError(cur_hist, tree.tree[a].prob, label) ? 1 : 0;
+          cost[a] += error - leaf_error;
+        }
+      }
+
+      std::vector<uint32_t> num_leaves(num_nodes, 1);
+      for (size_t i = order.size(); i > 0; i--) {
+        const int32_t n = order[i - 1];
+        if (internal[n]) {
+          num_leaves[n] = num_leaves[tree.tree[n].left_child] +
+            num_leaves[tree.tree[n].right_child];
+        }
+      }
+
+      // Weakest link: collapse the cheapest subtree per leaf removed.  When
+      // a subtree is collapsed its ancestors' cost and size change, so they
+      // are re-queued and their old entries are dropped by version.
+      std::priority_queue<PruneCandidate> queue;
+      std::vector<uint32_t> version(num_nodes, 0);
+      std::vector<bool> collapsed(num_nodes, false);
+      for (size_t i = 0; i < order.size(); i++) {
+        const int32_t n = order[i];
+        if (internal[n]) {
+          PruneCandidate c = {(float)cost[n] / (float)(num_leaves[n] - 1),
+            n, 0};
+          queue.push(c);
+        }
+      }
+      const int64_t tree_start_cost = total_cost;
+      while (!queue.empty()) {
+        const PruneCandidate c = queue.top();
+        queue.pop();
+        if (c.version != version[c.node]) {
+          continue;
+        }
+        bool inside_collapsed = false;
+        for (int32_t a = parent[c.node]; a != -1; a = parent[a]) {
+          if (collapsed[a]) {
+            inside_collapsed = true;
+            break;
+          }
+        }
+        if (inside_collapsed) {
+          continue;
+        }
+        const int64_t cur_cost = cost[c.node];
+        if (cur_cost > 0 && total_cost + cur_cost > max_cost) {
+          break;
+        }
+        collapsed[c.node] = true;
+        total_cost += cur_cost;
+#ifdef VERBOSE_PRUNE
+        cout << "pruneDecisionForest - tree " << t << ", node " << c.node;
+        cout << ": " << num_leaves[c.node] << " leaves --> 1, cost ";
+        cout << cur_cost << " pixels" << endl;
+#endif
+        const uint32_t leaves_removed = num_leaves[c.node] - 1;
+        for (int32_t a = parent[c.node]; a != -1; a = parent[a]) {
+          cost[a] -= cur_cost;
+          num_leaves[a] -= leaves_removed;
+          version[a]++;
+          PruneCandidate ca = {(float)cost[a] / (float)(num_leaves[a] - 1),
+            a, version[a]};
+          queue.push(ca);
+        }
+      }
+
+      // Repack the tree without the collapsed subtrees
+      std::vector<int32_t> keep;
+      std::vector<int32_t> new_index(num_nodes, -1);
+      keep.push_back(0);
+      new_index[0] = 0;
+      for (size_t i = 0; i < keep.size(); i++) {
+        const int32_t n = keep[i];
+        if (internal[n] && !collapsed[n]) {
+          new_index[tree.tree[n].left_child] = (int32_t)keep.size();
+          keep.push_back(tree.tree[n].left_child);
+          new_index[tree.tree[n].right_child] = (int32_t)keep.size();
+          keep.push_back(tree.tree[n].right_child);
+        }
+      }
+      DecisionTreeNode* new_tree = new DecisionTreeNode[keep.size()];
+      for (size_t i = 0; i < keep.size(); i++) {
+        const int32_t n = keep[i];
+        new_tree[i] = tree.tree[n];
+        if (internal[n] && !collapsed[n]) {
+          new_tree[i].left_child = new_index[tree.tree[n].left_child];
+          new_tree[i].right_child = new_index[tree.tree[n].right_child];
+        } else {
+          new_tree[i].left_child = -1;
+          new_tree[i].right_child = -1;
+        }
+      }
+      cout << "pruneDecisionForest - tree " << t << ": " << num_nodes;
+      cout << " --> " << keep.size() << " nodes, " <<
+        (total_cost - tree_start_cost) << " more misclassified pixels" << endl;
+      num_removed += num_nodes - (uint32_t)keep.size();
+      delete[] tree.tree;
+      tree.tree = new_tree;
+      tree.num_nodes = (uint32_t)keep.size();
+
+      for (size_t p = 0; p < num_valid; p++) {
+        leaves[t * num_valid + p] = findLeaf(tree, data->image_data, width,
+          height, pix[p]);
+      }
+    }
+    return num_removed;
+  }
+
+  uint32_t countDecisionForestNodes(const DecisionTree* forest,
+    const uint32_t num_trees) {
+    uint32_t num_nodes = 0;
+    for (uint32_t i = 0; i < num_trees; i++) {
+      num_nodes += forest[i].num_nodes;
+    }
+    return num_nodes;
+  }
+
+};  // namespace hand_detector
+};  // namespace kinect_interface_primesense
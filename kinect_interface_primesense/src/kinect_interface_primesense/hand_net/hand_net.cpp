@@ -14,6 +14,7 @@
 #include "jtorch/tensor.h"
 #include "kinect_interface_primesense/hand_net/hand_model_coeff.h"  // for HandCoeff
 #include "kinect_interface_primesense/hand_net/hand_model.h"  // for HandModel
+#include "kinect_interface/trace.h"
 #include "kinect_interface_primesense/open_ni_funcs.h"
 #include "kinect_interface_primesense/hand_detector/decision_tree_structs.h"  // GDT_MAX_DIST
 #include "jtil/image_util/image_util.h"
@@ -194,13 +195,18 @@ namespace hand_net {
 
   void HandNet::calcConvnetHeatMap(const int16_t* depth, 
     const uint8_t* label, bool flip_convnet_input) {
+    TRACE_SCOPE(TRACE_CONVNET);
     if (conv_network_ == NULL || image_generator_ == NULL) {
       std::cout << "HandNet::calcHandCoeff() - ERROR: Convnet not loaded";
       std::cout << " from file!" << std::endl;
     }
 
     calcHandImage(depth, label, flip_convnet_input);  // Creates HPF hand image
+    evaluateConvnet(flip_convnet_input);
+    fitHeatMaps();
+  }
 
+  void HandNet::evaluateConvnet(const bool flip_convnet_input) {
     // Copy over the hand images in the input data structures
     TorchData* im = image_generator_->hpf_hand_image();
 
@@ -220,7 +226,9 @@ namespace hand_net {
           heat_map_size_, heat_map_size_, 1);
       }
     }
+  }
 
+  void HandNet::fitHeatMaps() {
     // For each of the heat maps, fit a gaussian to it
     const Int4* pos_wh = &image_generator_->hand_pos_wh();
     for (uint32_t i = 0; i < num_output_features_; i++) { 
@@ -267,6 +275,7 @@ namespace hand_net {
 
   void HandNet::calcConvnetPose(const int16_t* depth, const uint8_t* label,
     const float smoothing_factor, const uint64_t max_pso_iterations) {
+    TRACE_SCOPE(TRACE_PSO);
     // Try fitting in projected space from the rest pose:
     rhand_prev_pose_->copyCoeffFrom(rhand_cur_pose_);
     g_hand_net_ = this;
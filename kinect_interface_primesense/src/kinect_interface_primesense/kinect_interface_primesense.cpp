@@ -8,6 +8,8 @@
 #include "kinect_interface_primesense/kinect_interface_primesense.h"
 #include "kinect_interface_primesense/kinect_device_listener.h"
 #include "kinect_interface_primesense/open_ni_funcs.h"
+#include "kinect_interface_primesense/depth_registration.h"
+#include "kinect_interface_primesense/frame_snapshot.h"
 #include "kinect_interface_primesense/hand_detector/hand_detector.h"
 #include "jtil/jtil.h"
 #include "jtil/clk/clk.h"
@@ -18,7 +20,8 @@
 #include "jtil/exceptions/wruntime_error.h"
 #include "kinect_interface_primesense/depth_images_io.h"
 #include "kinect_interface_primesense/hand_net/hand_net.h"
-#include "jtil/threading/thread_pool.h"
+#include "kinect_interface/task_scheduler.h"
+#include "kinect_interface/trace.h"
 
 #include "OpenNI.h"
 #include "OniCAPI.h"
@@ -43,6 +46,8 @@ using jtil::math::Float3;
 using jtil::clk::Clk;
 using namespace jtil::data_str;
 using namespace jtil::threading;
+using kinect_interface::TaskScheduler;
+using kinect_interface::TaskGroup;
 using openni::PixelFormat;
 using openni::DepthPixel;
 using namespace jtil::file_io;
@@ -62,14 +67,16 @@ namespace kinect_interface_primesense {
   KinectInterfacePrimesense::KinectInterfacePrimesense(const char* device_uri) {
     device_initialized_ = false;
     device_ = NULL;
-    pts_world_ = NULL;
     pts_uvd_ = NULL;
-    labels_ = NULL;
     hand_detector_ = NULL;
     image_io_ = NULL;
-    depth_1mm_ = NULL;
-    registered_rgb_ = NULL;
     openni_funcs_ = NULL;
+    converting_ = NULL;
+    latest_version_ = 0;
+    detect_stopped_ = false;
+    data_lock_count_ = 0;
+    convert_mailbox_ = new FrameMailbox();
+    detect_mailbox_ = new FrameMailbox();
     depth_dim_.zeros();
     rgb_dim_.zeros();
     ir_dim_.zeros();
@@ -81,12 +88,18 @@ namespace kinect_interface_primesense {
     depth_frame_number_ = 0;
     rgb_frame_number_ = 0;
     ir_frame_number_ = 0;
-    tp_ = NULL;
+    ts_ = NULL;
 
     init(device_uri);
 
-    //  Now spawn the Kinect Update Thread
+    //  Now spawn the pipeline threads (consumers first)
     kinect_running_ = true;
+    Callback<void>* detect_body = MakeCallableOnce(
+      &KinectInterfacePrimesense::detectThread, this);
+    detect_thread_ = MakeThread(detect_body);
+    Callback<void>* convert_body = MakeCallableOnce(
+      &KinectInterfacePrimesense::convertThread, this);
+    convert_thread_ = MakeThread(convert_body);
     Callback<void>* threadBody = MakeCallableOnce(
       &KinectInterfacePrimesense::kinectUpdateThread, this);
     kinect_thread_ = MakeThread(threadBody);
@@ -114,21 +127,17 @@ namespace kinect_interface_primesense {
       device_->close();
     }
 
-    if (tp_) {
-      tp_->stop();
-    }
-    SAFE_DELETE(tp_);
     SAFE_DELETE(device_listener_);
-    if (depth_format_100um_) {
-      SAFE_DELETE_ARR(depth_1mm_);
-    }
     SAFE_DELETE(hand_detector_);
     SAFE_DELETE(image_io_);
-    SAFE_DELETE_ARR(registered_rgb_);
     SAFE_DELETE_ARR(pts_uvd_);
-    SAFE_DELETE_ARR(pts_world_);
-    SAFE_DELETE_ARR(labels_);
     SAFE_DELETE(openni_funcs_);
+    SAFE_DELETE(convert_mailbox_);
+    SAFE_DELETE(detect_mailbox_);
+    // Snapshots still held by readers keep the pool alive
+    locked_frame_.reset();
+    latest_.reset();
+    frame_pool_.reset();
     for (uint32_t i = 0; i < NUM_STREAMS; i++) {
       SAFE_DELETE(frames_[i]);
       SAFE_DELETE(streams_[i]);
@@ -228,9 +237,10 @@ namespace kinect_interface_primesense {
   void KinectInterfacePrimesense::init(const char* device_uri) {
     initOpenNI(device_uri);
 
-    // Create a thread pool for parallelizing the UVD to depth calculations
-    uint32_t num_threads = KINECT_INTERFACE_NUM_WORKER_THREADS;
-    tp_ = new jtil::threading::ThreadPool(num_threads);
+    // Parallelize the UVD to depth calculations on the shared scheduler (one
+    // band per scheduler thread)
+    ts_ = TaskScheduler::get();
+    uint32_t num_threads = ts_->num_threads();
     if (KINECT_INTERFACE_NUM_CONVERTER_THREADS > 1) {
       uint32_t n_pixels = depth_dim_[0] * depth_dim_[1];
       uint32_t n_pixels_per_thread = 1 + n_pixels / num_threads;  // round up
@@ -245,7 +255,7 @@ namespace kinect_interface_primesense {
       }
     }
 
-    hand_detector_ = new HandDetector(tp_);
+    hand_detector_ = new HandDetector(ts_);
     hand_detector_->init(depth_dim_[0], depth_dim_[1]);
 
     image_io_ = new DepthImagesIO();
@@ -286,10 +296,8 @@ namespace kinect_interface_primesense {
     initDepth();
 
     const int depth_size = depth_dim_[0] * depth_dim_[1];
-    labels_ = new uint8_t[depth_size];
-    pts_world_ = new float[3 * depth_size];
     pts_uvd_ = new float[3 * depth_size];
-    registered_rgb_ = new uint8_t[3 * depth_size];
+    frame_pool_ = FrameSnapshotPool::create(depth_dim_[0], depth_dim_[1]);
 
     // Open a connection to the device's rgb channel
     GET_SETTING("sync_ir_stream", bool, sync_ir_stream_);
@@ -448,10 +456,6 @@ namespace kinect_interface_primesense {
     }
 
     frames_[DEPTH_STREAM] = new openni::VideoFrameRef();
-
-    if (depth_format_100um_) {
-      depth_1mm_ = new uint16_t[depth_dim_[0] * depth_dim_[1]];
-    }
   }
 
   void KinectInterfacePrimesense::initRGB(const bool start) {
@@ -595,15 +599,13 @@ namespace kinect_interface_primesense {
         continue;  // Happens when USB bus is timing out I think
       }
 
-      data_lock_.lock();
-
+      // Only this thread touches frames_, so there is no lock here
       for (uint32_t i = 0; i < NUM_STREAMS; i++) {
         if (stream_ready[i]) {
           streams_[i]->readFrame(frames_[i]);
           switch (i) {
           case DEPTH_STREAM:
             depth_frame_number_++;
-            depth_frame_time_ = 1e-6 * (double)frames_[i]->getTimestamp();
             break;
           case RGB_STREAM:
             rgb_frame_number_++;
@@ -618,74 +620,145 @@ namespace kinect_interface_primesense {
       // Check if we're running again.  Someone may have shut down the thread
       // while we were waiting on the OpenNI library
       if (!kinect_running_) {
-        data_lock_.unlock();
         break;
       }
 
       if (stream_ready[DEPTH_STREAM]) {
-        if (depth_format_100um_) {
-          uint16_t* depth_src = (uint16_t*)frames_[DEPTH_STREAM]->getData(); 
-          for (int32_t i = 0; i < depth_dim_[0] * depth_dim_[1]; i++) {
-            depth_1mm_[i] = depth_src[i] / 10;
-          }
-        } else {
-          depth_1mm_ = (uint16_t*)frames_[DEPTH_STREAM]->getData(); 
-        }
-
-        performConversions();
-
-        bool detect_hands, found_hand;
-        GET_SETTING("detect_hands", bool, detect_hands);
-        if (detect_hands) {
-          found_hand = hand_detector_->findHandLabels((int16_t*)depth_1mm_, 
-            pts_world_, HDLabelMethod::HDFloodfill, labels_);
-          if (!found_hand) {
-            memset(labels_, 0, sizeof(labels_[0]) * src_dim);
-          }
-        }
-
-        if (!detect_hands || !found_hand) {
-          memset(labels_, 0, sizeof(labels_[0]) * src_dim);
-        }
-      }  // if (stream_ready[DEPTH_STREAM]) {
-      
-      data_lock_.unlock();
+        // Copy the frame out of OpenNI's buffers and hand it to the
+        // conversion stage (which drops it if it is still busy with the
+        // last one)
+        std::shared_ptr<FrameSnapshot> frame = frame_pool_->acquire();
+        captureFrame(frame.get());
+        convert_mailbox_->put(frame);
+      }
 
       std::this_thread::yield();
 
     }  // end while (app::App::app_running)
+    convert_mailbox_->close();
     cout << "kinectUpdateThread shutting down..." << endl;
   }
 
-  void KinectInterfacePrimesense::performConversions() {
-    openni_funcs_->ConvertDepthImageToProjective(depth(), pts_uvd_);
+  void KinectInterfacePrimesense::captureFrame(FrameSnapshot* frame) {
+    const int32_t n_pixels = depth_dim_[0] * depth_dim_[1];
+    frame->depth_frame_number = depth_frame_number_;
+    frame->rgb_frame_number = rgb_frame_number_;
+    frame->ir_frame_number = ir_frame_number_;
+    frame->depth_frame_time = 1e-6 * 
+      (double)frames_[DEPTH_STREAM]->getTimestamp();
+    // Read once here so every stage sees the same value for this frame
+    bool detect_hands;
+    GET_SETTING("detect_hands", bool, detect_hands);
+    frame->detect_hands = detect_hands;
+    TRACE_SET_FRAME(frame->depth_frame_number);
+    TRACE_SENSOR_FRAME(frame->depth_frame_number, 
+      1000 * (int64_t)frames_[DEPTH_STREAM]->getTimestamp());  // us --> ns
+    TRACE_SCOPE(TRACE_CAPTURE);
+
+    const uint16_t* depth_src = 
+      (const uint16_t*)frames_[DEPTH_STREAM]->getData(); 
     if (depth_format_100um_) {
-      for (int32_t i = 2; i < 3 * depth_dim_[0] * depth_dim_[1]; i+=3) {
-        pts_uvd_[i] /= 10.0f;
+      for (int32_t i = 0; i < n_pixels; i++) {
+        frame->depth[i] = depth_src[i] / 10;
       }
+    } else {
+      memcpy(frame->depth, depth_src, sizeof(frame->depth[0]) * n_pixels);
     }
 
-    if (KINECT_INTERFACE_NUM_CONVERTER_THREADS == 1) {
-      convertDepthToWorld(0, src_dim-1);
-      convertRGBToDepth(0, src_dim-1);
+    // The rgb (or ir) frame is the last one read, which may be older than
+    // the depth frame.  The snapshot is recycled, so if there isn't one yet
+    // clear it rather than leave an old frame's image in it.
+    if (!sync_ir_stream_) {
+      if (frames_[RGB_STREAM]->isValid()) {
+        memcpy(frame->rgb, frames_[RGB_STREAM]->getData(), 
+          sizeof(frame->rgb[0]) * n_pixels * 3);
+      } else {
+        memset(frame->rgb, 0, sizeof(frame->rgb[0]) * n_pixels * 3);
+      }
     } else {
-      executeThreadCallbacks(tp_, pts_world_thread_cbs_);
-      executeThreadCallbacks(tp_, rgb_thread_cbs_);
+      if (frames_[IR_STREAM] != NULL && frames_[IR_STREAM]->isValid()) {
+        memcpy(frame->ir, frames_[IR_STREAM]->getData(), 
+          sizeof(frame->ir[0]) * n_pixels * 2);
+      } else {
+        memset(frame->ir, 0, sizeof(frame->ir[0]) * n_pixels * 2);
+      }
+    }
+  }
+
+  void KinectInterfacePrimesense::convertThread() {
+    SetThreadName("KinectInterfacePrimesense::convertThread()");
+    std::shared_ptr<FrameSnapshot> frame;
+    while (convert_mailbox_->take(frame)) {
+      performConversions(frame.get());
+      detect_mailbox_->put(frame);
+      frame.reset();
     }
+    detect_mailbox_->close();
   }
 
-  void KinectInterfacePrimesense::executeThreadCallbacks(jtil::threading::ThreadPool* tp, 
-    jtil::data_str::VectorManaged<jtil::threading::Callback<void>*>& cbs) {
-    threads_finished_ = 0;
-    for (uint32_t i = 0; i < cbs.size(); i++) {
-      tp_->addTask(cbs[i]);
+  void KinectInterfacePrimesense::detectThread() {
+    SetThreadName("KinectInterfacePrimesense::detectThread()");
+    std::shared_ptr<FrameSnapshot> frame;
+    while (detect_mailbox_->take(frame)) {
+      detectHands(frame.get());
+      // Publish it: nothing writes to the frame from here on
+      std::unique_lock<std::mutex> ul(latest_lock_);
+      frame->version = ++latest_version_;
+      latest_ = frame;
+      ul.unlock();
+      latest_published_.notify_all();
+      frame.reset();
     }
-    // Wait for all threads to finish
-    std::unique_lock<std::mutex> ul(thread_update_lock_);  // Get lock
-    while (threads_finished_ != cbs.size()) {
-      not_finished_.wait(ul);
+    std::unique_lock<std::mutex> ul(latest_lock_);
+    detect_stopped_ = true;
+    ul.unlock();
+    latest_published_.notify_all();
+  }
+
+  void KinectInterfacePrimesense::detectHands(FrameSnapshot* frame) {
+    TRACE_SET_FRAME(frame->depth_frame_number);
+    TRACE_SCOPE(TRACE_DETECT);
+    const bool detect_hands = frame->detect_hands;
+    frame->found_hand = false;
+    if (detect_hands) {
+      frame->found_hand = hand_detector_->findHandLabels(
+        (int16_t*)frame->depth, frame->xyz, HDLabelMethod::HDFloodfill, 
+        frame->labels);
+      memcpy(frame->labels_filtered, hand_detector_->labels_filtered(), 
+        sizeof(frame->labels_filtered[0]) * src_dim);
+      memcpy(frame->labels_evaluated, hand_detector_->labels_evaluated(), 
+        sizeof(frame->labels_evaluated[0]) * src_dim);
+    } else {
+      memset(frame->labels_filtered, 0, 
+        sizeof(frame->labels_filtered[0]) * src_dim);
+      memset(frame->labels_evaluated, 0, 
+        sizeof(frame->labels_evaluated[0]) * src_dim);
+    }
+
+    if (!detect_hands || !frame->found_hand) {
+      memset(frame->labels, 0, sizeof(frame->labels[0]) * src_dim);
+    }
+  }
+
+  void KinectInterfacePrimesense::performConversions(FrameSnapshot* frame) {
+    TRACE_SET_FRAME(frame->depth_frame_number);
+    TRACE_SCOPE(TRACE_CONVERT);
+    // The depth is already in mm (captureFrame converts it)
+    openni_funcs_->ConvertDepthImageToProjective(frame->depth, pts_uvd_);
+
+    converting_ = frame;
+    if (KINECT_INTERFACE_NUM_CONVERTER_THREADS == 1) {
+      convertDepthToWorld(0, src_dim-1);
+      convertRGBToDepth(0, src_dim-1);
+    } else {
+      // The two conversions are independent, so there is no barrier between
+      // them
+      TaskGroup conversions;
+      ts_->addTasks(&pts_world_thread_cbs_, conversions);
+      ts_->addTasks(&rgb_thread_cbs_, conversions);
+      ts_->wait(conversions);
     }
-    ul.unlock();  // Release lock
+    converting_ = NULL;
   }
 
   void KinectInterfacePrimesense::convertDepthToWorld(const uint32_t start, 
@@ -695,7 +768,7 @@ namespace kinect_interface_primesense {
     // github it looks expensive.  The other is digging into the c src directly
     // and defining our own version.
     float* pts_uvd_start = &pts_uvd_[start*3];
-    float* pts_world_start = &pts_world_[start*3];
+    float* pts_world_start = &converting_->xyz[start*3];
     const uint32_t count = end - start + 1;
     openni_funcs_->convertDepthToWorldCoordinates(pts_uvd_start, 
       pts_world_start, count);
@@ -708,21 +781,24 @@ namespace kinect_interface_primesense {
     //    d[i], &pts_world_[i*3], &pts_world_[i*3+1], &pts_world_[i*3+2]);
     //}
 
-    std::unique_lock<std::mutex> ul(thread_update_lock_);
-    threads_finished_++;
-    not_finished_.notify_all();  // Signify that all threads might have finished
-    ul.unlock();
   }
 
   void KinectInterfacePrimesense::convertRGBToDepth(const uint32_t start, 
     const uint32_t end) {
+    uint8_t* registered_rgb = converting_->registered_rgb;
     if (!sync_ir_stream_) {
-      const uint16_t* d = depth();
-      OniStreamHandle dhandle = streams_[DEPTH_STREAM]->_getHandle();
-      OniStreamHandle chandle = streams_[RGB_STREAM]->_getHandle();
+      const uint16_t* d = converting_->depth;
       int rgb_u;
       int rgb_v;
-      uint8_t* rgb = (uint8_t*)frames_[RGB_STREAM]->getData();
+      const uint8_t* rgb = converting_->rgb;
+      // The lookup tables give the same pixels as TranslateSinglePixel below
+      const DepthRegistration* reg = openni_funcs_->registration();
+      if (reg != NULL && reg->color_w() == src_width && 
+        reg->color_h() == src_height) {
+        reg->registerRGB(registered_rgb, rgb, d, start, end - start + 1,
+          flip_image_);
+        return;
+      }
       for (uint32_t i = start; i <= end; i++) {
         uint32_t u = i % depth_dim_[0];
         uint32_t v = i / depth_dim_[0];
@@ -731,13 +807,13 @@ namespace kinect_interface_primesense {
         //  *streams_[DEPTH_STREAM], *streams_[RGB_IR_STREAM], u, v, d[i], &rgb_u, &rgb_v);
         //if (rc == openni::Status::STATUS_OK) {
         //  int src_index = rgb_v * src_width + rgb_u;
-        //  registered_rgb_[i * 3] = rgb[src_index * 3];
-        //  registered_rgb_[i * 3 + 1] = rgb[src_index * 3 + 1];
-        //  registered_rgb_[i * 3 + 2] = rgb[src_index * 3 + 2];
+        //  registered_rgb[i * 3] = rgb[src_index * 3];
+        //  registered_rgb[i * 3 + 1] = rgb[src_index * 3 + 1];
+        //  registered_rgb[i * 3 + 2] = rgb[src_index * 3 + 2];
         //} else {
-        //  registered_rgb_[i * 3] = 0;
-        //  registered_rgb_[i * 3 + 1] = 0;
-        //  registered_rgb_[i * 3 + 2] = 0;
+        //  registered_rgb[i * 3] = 0;
+        //  registered_rgb[i * 3 + 1] = 0;
+        //  registered_rgb[i * 3 + 2] = 0;
         //}
 
         //  // My version:
@@ -746,69 +822,120 @@ namespace kinect_interface_primesense {
         if (d[i] != 0 && rgb_u < src_width && rgb_v < src_height && rgb_u >= 0 &&
           rgb_v >= 0) {
             int src_index = rgb_v * src_width + rgb_u;
-            registered_rgb_[i * 3] = rgb[src_index * 3];
-            registered_rgb_[i * 3 + 1] = rgb[src_index * 3 + 1];
-            registered_rgb_[i * 3 + 2] = rgb[src_index * 3 + 2];
+            registered_rgb[i * 3] = rgb[src_index * 3];
+            registered_rgb[i * 3 + 1] = rgb[src_index * 3 + 1];
+            registered_rgb[i * 3 + 2] = rgb[src_index * 3 + 2];
         } else {
-          registered_rgb_[i * 3] = 0;
-          registered_rgb_[i * 3 + 1] = 0;
-          registered_rgb_[i * 3 + 2] = 0;
+          registered_rgb[i * 3] = 0;
+          registered_rgb[i * 3 + 1] = 0;
+          registered_rgb[i * 3 + 2] = 0;
         }
       }
     } else {
       for (uint32_t i = start; i <= end; i++) {
-        registered_rgb_[i * 3] = 255;
-        registered_rgb_[i * 3 + 1] = 255;
-        registered_rgb_[i * 3 + 2] = 255;
+        registered_rgb[i * 3] = 255;
+        registered_rgb[i * 3 + 1] = 255;
+        registered_rgb[i * 3 + 2] = 255;
       }
     }
 
-    std::unique_lock<std::mutex> ul(thread_update_lock_);
-    threads_finished_++;
-    not_finished_.notify_all();  // Signify that all threads might have finished
-    ul.unlock();
+  }
+
+  std::shared_ptr<const FrameSnapshot> KinectInterfacePrimesense::latestFrame() {
+    std::unique_lock<std::mutex> ul(latest_lock_);
+    return latest_;
+  }
+
+  std::shared_ptr<const FrameSnapshot> KinectInterfacePrimesense::waitForFrame(
+    const uint64_t version) {
+    std::unique_lock<std::mutex> ul(latest_lock_);
+    while (!detect_stopped_ && (latest_ == NULL || latest_->version <= version)) {
+      latest_published_.wait(ul);
+    }
+    if (latest_ == NULL || latest_->version <= version) {
+      return std::shared_ptr<const FrameSnapshot>();
+    }
+    return latest_;
+  }
+
+  uint64_t KinectInterfacePrimesense::dropped_frames() {
+    return convert_mailbox_->num_dropped() + detect_mailbox_->num_dropped();
+  }
+
+  void KinectInterfacePrimesense::lockData() {
+    data_lock_.lock();
+    if (data_lock_count_++ == 0) {
+      locked_frame_ = latestFrame();
+    }
+  }
+
+  void KinectInterfacePrimesense::unlockData() {
+    if (--data_lock_count_ == 0) {
+      locked_frame_.reset();
+    }
+    data_lock_.unlock();
   }
 
   const uint8_t* KinectInterfacePrimesense::rgb() const { 
-    return (uint8_t*)frames_[RGB_STREAM]->getData(); 
+    return locked_frame_ != NULL ? locked_frame_->rgb : NULL; 
   } 
 
   const uint8_t* KinectInterfacePrimesense::ir() const { 
-    return (uint8_t*)frames_[IR_STREAM]->getData(); 
+    return locked_frame_ != NULL ? locked_frame_->ir : NULL; 
   } 
 
   const uint8_t* KinectInterfacePrimesense::registered_rgb() const { 
-    return registered_rgb_; 
+    return locked_frame_ != NULL ? locked_frame_->registered_rgb : NULL; 
   } 
 
   const float* KinectInterfacePrimesense::xyz() const {
-    return pts_world_;
+    return locked_frame_ != NULL ? locked_frame_->xyz : NULL;
   }
 
   const uint16_t* KinectInterfacePrimesense::depth() const { 
-    return (uint16_t*)frames_[DEPTH_STREAM]->getData(); 
+    return locked_frame_ != NULL ? locked_frame_->depth : NULL; 
   }
 
   const uint16_t* KinectInterfacePrimesense::depth1mm() const { 
-    return depth_1mm_; 
+    return locked_frame_ != NULL ? locked_frame_->depth : NULL; 
+  }
+
+  const uint8_t* KinectInterfacePrimesense::labels() const { 
+    return locked_frame_ != NULL ? locked_frame_->labels : NULL; 
+  }
+
+  double KinectInterfacePrimesense::depth_frame_time() const {
+    return locked_frame_ != NULL ? locked_frame_->depth_frame_time : 0;
+  }
+
+  const uint64_t KinectInterfacePrimesense::depth_frame_number() const {
+    return locked_frame_ != NULL ? locked_frame_->depth_frame_number : 0;
+  }
+
+  const uint64_t KinectInterfacePrimesense::rgb_frame_number() const {
+    return locked_frame_ != NULL ? locked_frame_->rgb_frame_number : 0;
+  }
+
+  const uint64_t KinectInterfacePrimesense::ir_frame_number() const {
+    return locked_frame_ != NULL ? locked_frame_->ir_frame_number : 0;
   }
 
   void KinectInterfacePrimesense::shutdownKinect() {
-    data_lock_.lock();
     kinect_running_ = false;
-    data_lock_.unlock();
     cout << "kinectUpdateThread shutdown requested..." << endl;
+    // The capture stage closes the conversion stage's mailbox when it exits
+    // and so on down the pipeline
     kinect_thread_.join();
+    convert_thread_.join();
+    detect_thread_.join();
   }
 
   const uint8_t* KinectInterfacePrimesense::filteredDecisionForestLabels() const {
-    return hand_detector_->labels_filtered();
+    return locked_frame_ != NULL ? locked_frame_->labels_filtered : NULL;
   }
 
   const uint8_t* KinectInterfacePrimesense::rawDecisionForestLabels() const {
-    return hand_detector_->labels_evaluated();
+    return locked_frame_ != NULL ? locked_frame_->labels_evaluated : NULL;
   }
 
 }  // namespace kinect_interface_primesense
-
-
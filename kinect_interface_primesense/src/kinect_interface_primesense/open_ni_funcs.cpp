@@ -6,6 +6,7 @@
 #include <fstream>
 #include "kinect_interface_primesense/open_ni_funcs.h"
 #include "kinect_interface_primesense/calibration_data.h"
+#include "kinect_interface_primesense/depth_registration.h"
 #include "jtil/exceptions/wruntime_error.h"
 
 #define SAFE_DELETE(x) if (x != NULL) { delete x; x = NULL; }
@@ -49,6 +50,7 @@ namespace kinect_interface_primesense {
     const float hFOV, const float vFOV, const uint32_t internal_dev_id) {
     internal_dev_id_ = internal_dev_id;
     cal_data_ = NULL;
+    registration_ = NULL;
     nXRes_ = (float)nXRes;
     nYRes_ = (float)nYRes;
     fHFOV_ = hFOV;
@@ -80,6 +82,7 @@ namespace kinect_interface_primesense {
 	  coeffX_ = nXRes_ / xzFactor_;
 	  coeffY_ = nYRes_ / yzFactor_;
     cal_data_ = NULL;
+    registration_ = NULL;
     try {
       loadCalibrationData();
     } catch (std::exception e) {
@@ -89,6 +92,7 @@ namespace kinect_interface_primesense {
   }
 
   OpenNIFuncs::~OpenNIFuncs() {
+    SAFE_DELETE(registration_);
     SAFE_DELETE(cal_data_);
   }
 
@@ -338,6 +342,12 @@ namespace kinect_interface_primesense {
     m_depthResolution.y = (int)nYRes_;
     m_colorResolution.x = (int)nXRes_;
     m_colorResolution.y = (int)nYRes_;
+
+    registration_ = new DepthRegistration(m_pRegTable, m_pDepth2ShiftTable,
+      m_depthResolution.x, m_depthResolution.y, m_colorResolution.x,
+      m_colorResolution.y, cal_data_->m_blob.params1080.rgbRegXValScale,
+      cal_data_->m_pPadInfo->nCroppingLines - 
+      cal_data_->m_pPadInfo->nStartLines);
   }
 
 }  // namespace kinect_interface_primesense
@@ -0,0 +1,172 @@
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include "kinect_interface_primesense/red_hand_relabeler.h"
+#include "kinect_interface/task_scheduler.h"
+#include "jtil/data_str/vector_managed.h"
+#include "jtil/data_str/vector.h"
+#include "jtil/data_str/triple.h"
+#include "jtil/exceptions/wruntime_error.h"
+
+using std::string;
+using jtil::data_str::Vector;
+using jtil::data_str::VectorManaged;
+using jtil::data_str::Triple;
+using jtil::threading::Callback;
+using kinect_interface::TaskScheduler;
+using kinect_interface::runTasks;
+using namespace jtil::threading;
+
+#define SAFE_DELETE(x) do { if (x != NULL) { delete x; x = NULL; } } while (0);
+#define SAFE_DELETE_ARR(x) do { if (x != NULL) { delete[] x; x = NULL; } } while (0);
+
+namespace kinect_interface_primesense {
+
+  // Everything a task touches while processing a file
+  struct RedHandRelabelContext {
+    DepthImagesIO image_io;
+    int16_t depth[src_dim];
+    uint8_t label[src_dim];
+  };
+
+  RedHandRelabeler::RedHandRelabeler(TaskScheduler* ts,
+    const RedHandParams& params, const PROCESSED_FORMAT format) : 
+    params_(params), format_(format) {
+    ts_ = ts;
+    num_contexts_ = ts_ != NULL ? ts_->num_threads() : 1;
+    files_ = NULL;
+    next_file_ = 0;
+    num_failed_ = 0;
+    writer_ = NULL;
+    writes_finished_ = false;
+    num_written_ = 0;
+
+    contexts_ = new RedHandRelabelContext*[num_contexts_];
+    context_cbs_ = new VectorManaged<Callback<void>*>(num_contexts_);
+    for (uint32_t i = 0; i < num_contexts_; i++) {
+      contexts_[i] = new RedHandRelabelContext();
+      context_cbs_->pushBack(MakeCallableMany(
+        &RedHandRelabeler::relabelContext, this, i));
+    }
+  }
+
+  RedHandRelabeler::~RedHandRelabeler() {
+    for (uint32_t i = 0; i < num_contexts_; i++) {
+      SAFE_DELETE(contexts_[i]);
+    }
+    SAFE_DELETE_ARR(contexts_);
+    SAFE_DELETE(context_cbs_);
+  }
+
+  uint32_t RedHandRelabeler::relabelDirectory(const string& directory,
+    const uint32_t kinect_num) {
+    DepthImagesIO image_io;
+    Vector<Triple<char*, int64_t, int64_t>> files_in_directory;
+    image_io.GetFilesInDirectory(files_in_directory, directory, kinect_num,
+      "hands_");
+    std::vector<string> files;
+    for (uint32_t i = 0; i < files_in_directory.size(); i++) {
+      files.push_back(directory + string(files_in_directory[i].first));
+      delete[] files_in_directory[i].first;
+    }
+    return relabelFiles(files);
+  }
+
+  uint32_t RedHandRelabeler::relabelFiles(const std::vector<string>& files) {
+    files_ = &files;
+    next_file_ = 0;
+    num_failed_ = 0;
+    num_written_ = 0;
+    writes_finished_ = false;
+    writer_ = new std::thread(&RedHandRelabeler::writerThread, this);
+
+    runTasks(ts_, context_cbs_);
+
+    // Let the writer drain the queue and exit
+    std::unique_lock<std::mutex> ul_write(write_lock_);
+    writes_finished_ = true;
+    write_queue_not_empty_.notify_all();
+    ul_write.unlock();
+    writer_->join();
+    SAFE_DELETE(writer_);
+
+    files_ = NULL;
+    return num_written_;
+  }
+
+  void RedHandRelabeler::relabelContext(const uint32_t context) {
+    RedHandRelabelContext* cur = contexts_[context];
+    while (true) {
+      const uint32_t cur_file = next_file_++;
+      if (cur_file >= files_->size()) {
+        break;
+      }
+      const string& file = (*files_)[cur_file];
+      try {
+        cur->image_io.LoadCompressedImageWithRedHands(file, params_,
+          cur->depth, cur->label);
+        const uint8_t* compressed;
+        uint32_t size = cur->image_io.compressProcessedDepthLabel(cur->depth,
+          cur->label, compressed, format_);
+        queueWrite(DepthImagesIO::processedFilename(file), compressed, size);
+      } catch (std::runtime_error e) {
+        // Don't let one bad file kill the whole batch
+        num_failed_++;
+        std::unique_lock<std::mutex> ul_print(print_lock_);
+        std::cout << "RedHandRelabeler - ERROR processing " << file << ": ";
+        std::cout << e.what() << std::endl;
+      }
+    }
+  }
+
+  void RedHandRelabeler::queueWrite(const string& filename,
+    const uint8_t* data, const uint32_t size) {
+    RedHandRelabelWrite write;
+    write.filename = filename;
+    write.data = new uint8_t[size];
+    write.size = size;
+    memcpy(write.data, data, size);
+
+    std::unique_lock<std::mutex> ul(write_lock_);
+    while (write_queue_.size() >= RELABELER_MAX_QUEUED_WRITES) {
+      write_queue_not_full_.wait(ul);
+    }
+    write_queue_.push_back(write);
+    write_queue_not_empty_.notify_one();
+    ul.unlock();
+  }
+
+  void RedHandRelabeler::writerThread() {
+    while (true) {
+      std::unique_lock<std::mutex> ul(write_lock_);
+      while (write_queue_.empty() && !writes_finished_) {
+        write_queue_not_empty_.wait(ul);
+      }
+      if (write_queue_.empty()) {
+        return;  // writes_finished_ and nothing left to write
+      }
+      RedHandRelabelWrite write = write_queue_.front();
+      write_queue_.pop_front();
+      write_queue_not_full_.notify_all();
+      ul.unlock();
+
+      // If the open fails then the failbit is set and the write does nothing
+      std::ofstream ofile(write.filename.c_str(),
+        std::ios::out | std::ios::binary);
+      ofile.write(reinterpret_cast<const char*>(write.data), write.size);
+      ofile.close();
+      if (!ofile.fail()) {
+        num_written_++;
+      } else {
+        num_failed_++;
+        std::unique_lock<std::mutex> ul_print(print_lock_);
+        std::cout << "RedHandRelabeler - ERROR writing " << write.filename;
+        std::cout << std::endl;
+      }
+      SAFE_DELETE_ARR(write.data);
+    }
+  }
+
+};  // namespace kinect_interface_primesense
@@ -0,0 +1,152 @@
+#include "kinect_interface_primesense/red_pixel_classifier.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define RED_PIXEL_CLASSIFIER_SSE2
+  #include <emmintrin.h>
+#endif
+
+namespace kinect_interface_primesense {
+
+  void classifyRedPixelsScalar(const RedHandParams& params,
+    const uint8_t* rgb, uint8_t* red_pixels, const uint32_t num_pixels,
+    uint8_t* hsv) {
+    uint8_t cur_hsv[3];
+    for (uint32_t i = 0; i < num_pixels; i++) {
+      uint8_t* hsv_dst = hsv != NULL ? &hsv[i * 3] : cur_hsv;
+      rgbToHSVPixel(hsv_dst, &rgb[i * 3]);
+      red_pixels[i] = isRedPixel(params, &rgb[i * 3], hsv_dst) ? 1 : 0;
+    }
+  }
+
+#ifdef RED_PIXEL_CLASSIFIER_SSE2
+
+  // abs for 32 bit integer lanes (_mm_abs_epi32 is SSSE3)
+  static inline __m128i absEpi32(const __m128i x) {
+    const __m128i sign = _mm_srai_epi32(x, 31);
+    return _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+  }
+
+  // classifyRedPixels4 - 4 pixels starting at rgb, returns a 0 / 0xffffffff
+  // mask per pixel.  Every float operation is the same as rgbToHSVPixel().
+  static inline __m128i classifyRedPixels4(const RedHandParams& params,
+    const int32_t hue_offset, const uint8_t* rgb, uint8_t* hsv) {
+    const __m128i r = _mm_setr_epi32(rgb[0], rgb[3], rgb[6], rgb[9]);
+    const __m128i g = _mm_setr_epi32(rgb[1], rgb[4], rgb[7], rgb[10]);
+    const __m128i b = _mm_setr_epi32(rgb[2], rgb[5], rgb[8], rgb[11]);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 k255 = _mm_set1_ps(255.0f);
+    const __m128 R = _mm_div_ps(_mm_cvtepi32_ps(r), k255);
+    const __m128 G = _mm_div_ps(_mm_cvtepi32_ps(g), k255);
+    const __m128 B = _mm_div_ps(_mm_cvtepi32_ps(b), k255);
+
+    const __m128 max = _mm_max_ps(_mm_max_ps(R, G), B);
+    const __m128 min = _mm_min_ps(_mm_min_ps(R, G), B);
+    const __m128 D = _mm_sub_ps(max, min);
+    // D / max is NaN when max == 0, those lanes are zeroed
+    const __m128 S = _mm_and_ps(_mm_div_ps(D, max), _mm_cmpneq_ps(max, zero));
+
+    // Pick the numerator and offset per lane, in the same order as the
+    // if / else if / else in rgbToHSVPixel()
+    const __m128 is_r = _mm_cmpeq_ps(max, R);
+    const __m128 is_g = _mm_andnot_ps(is_r, _mm_cmpeq_ps(max, G));
+    const __m128 is_b = _mm_andnot_ps(_mm_or_ps(is_r, is_g),
+      _mm_cmpeq_ps(max, max));
+    const __m128 num = _mm_or_ps(_mm_or_ps(
+      _mm_and_ps(is_r, _mm_sub_ps(G, B)),
+      _mm_and_ps(is_g, _mm_sub_ps(B, R))),
+      _mm_and_ps(is_b, _mm_sub_ps(R, G)));
+    const __m128 offset = _mm_or_ps(_mm_or_ps(
+      _mm_and_ps(_mm_and_ps(is_r, _mm_cmplt_ps(G, B)), _mm_set1_ps(6.0f)),
+      _mm_and_ps(is_g, _mm_set1_ps(2.0f))),
+      _mm_and_ps(is_b, _mm_set1_ps(4.0f)));
+    __m128 H = _mm_add_ps(_mm_div_ps(num, D), offset);
+    H = _mm_div_ps(H, _mm_set1_ps(6.0f));
+    H = _mm_and_ps(H, _mm_cmpneq_ps(max, min));  // achromatic --> 0
+
+    const __m128i h = _mm_cvttps_epi32(_mm_mul_ps(H, k255));
+    const __m128i s = _mm_cvttps_epi32(_mm_mul_ps(S, k255));
+    const __m128i v = _mm_cvttps_epi32(_mm_mul_ps(max, k255));
+
+    if (hsv != NULL) {
+      int32_t h_arr[4], s_arr[4], v_arr[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(h_arr), h);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(s_arr), s);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(v_arr), v);
+      for (uint32_t i = 0; i < 4; i++) {
+        hsv[i * 3] = static_cast<uint8_t>(h_arr[i]);
+        hsv[i * 3 + 1] = static_cast<uint8_t>(s_arr[i]);
+        hsv[i * 3 + 2] = static_cast<uint8_t>(v_arr[i]);
+      }
+    }
+
+    // (h + hue_offset) % 255: h is in [0, 255) and hue_offset is in
+    // (-255, 255), so only values >= 255 need wrapping.
+    __m128i delta_hue = _mm_add_epi32(h, _mm_set1_epi32(hue_offset));
+    delta_hue = _mm_sub_epi32(delta_hue, _mm_and_si128(
+      _mm_cmpgt_epi32(delta_hue, _mm_set1_epi32(254)), _mm_set1_epi32(255)));
+    delta_hue = absEpi32(_mm_sub_epi32(delta_hue, _mm_set1_epi32(128)));
+    const __m128i delta_sat = absEpi32(_mm_sub_epi32(s,
+      _mm_set1_epi32(params.red_sat_target)));
+    const __m128i delta_val = absEpi32(_mm_sub_epi32(v,
+      _mm_set1_epi32(params.red_val_target)));
+
+    __m128i red = _mm_cmplt_epi32(delta_hue,
+      _mm_set1_epi32(params.red_hue_threshold));
+    red = _mm_and_si128(red, _mm_cmplt_epi32(delta_sat,
+      _mm_set1_epi32(params.red_sat_threshold)));
+    red = _mm_and_si128(red, _mm_cmplt_epi32(delta_val,
+      _mm_set1_epi32(params.red_val_threshold)));
+    red = _mm_and_si128(red, _mm_cmpgt_epi32(r,
+      _mm_set1_epi32(params.red_red_min)));
+    red = _mm_and_si128(red, _mm_cmplt_epi32(b,
+      _mm_set1_epi32(params.red_blue_max)));
+    red = _mm_and_si128(red, _mm_cmplt_epi32(g,
+      _mm_set1_epi32(params.red_green_max)));
+    // || (h + s + v) >= hsv_total_threshold
+    const __m128i total = _mm_add_epi32(_mm_add_epi32(h, s), v);
+    const __m128i below_total = _mm_cmplt_epi32(total,
+      _mm_set1_epi32(params.hsv_total_threshold));
+    return _mm_or_si128(red, _mm_andnot_si128(below_total,
+      _mm_cmpeq_epi32(total, total)));
+  }
+
+  void classifyRedPixels(const RedHandParams& params, const uint8_t* rgb,
+    uint8_t* red_pixels, const uint32_t num_pixels, uint8_t* hsv) {
+    const int32_t hue_offset = (params.red_hue_target + 128) % 255;
+    const __m128i one = _mm_set1_epi8(1);
+    const uint32_t num_pixels_sse = num_pixels - (num_pixels % 16);
+    for (uint32_t i = 0; i < num_pixels_sse; i += 16) {
+      const uint8_t* cur_rgb = &rgb[i * 3];
+      uint8_t* cur_hsv = hsv != NULL ? &hsv[i * 3] : NULL;
+      const __m128i red0 = classifyRedPixels4(params, hue_offset, cur_rgb,
+        cur_hsv);
+      const __m128i red1 = classifyRedPixels4(params, hue_offset,
+        cur_rgb + 12, cur_hsv != NULL ? cur_hsv + 12 : NULL);
+      const __m128i red2 = classifyRedPixels4(params, hue_offset,
+        cur_rgb + 24, cur_hsv != NULL ? cur_hsv + 24 : NULL);
+      const __m128i red3 = classifyRedPixels4(params, hue_offset,
+        cur_rgb + 36, cur_hsv != NULL ? cur_hsv + 36 : NULL);
+      // 0 / -1 in 32 bits --> 16 bits --> 8 bits (saturation keeps -1)
+      const __m128i red = _mm_packs_epi16(_mm_packs_epi32(red0, red1),
+        _mm_packs_epi32(red2, red3));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&red_pixels[i]),
+        _mm_and_si128(red, one));
+    }
+    // The remainder (depth_dim is a multiple of 16, but don't count on it)
+    classifyRedPixelsScalar(params, &rgb[num_pixels_sse * 3],
+      &red_pixels[num_pixels_sse], num_pixels - num_pixels_sse,
+      hsv != NULL ? &hsv[num_pixels_sse * 3] : NULL);
+  }
+
+#else
+
+  void classifyRedPixels(const RedHandParams& params, const uint8_t* rgb,
+    uint8_t* red_pixels, const uint32_t num_pixels, uint8_t* hsv) {
+    classifyRedPixelsScalar(params, rgb, red_pixels, num_pixels, hsv);
+  }
+
+#endif  // RED_PIXEL_CLASSIFIER_SSE2
+
+};  // namespace kinect_interface_primesense
@@ -0,0 +1,235 @@
+//
+//  depth_registration_test.cpp
+//
+//  Checks that DepthRegistration::colorIndices and colorIndicesScalar give
+//  the same color pixel as OpenNIFuncs::TranslateSinglePixel, for both
+//  mirror settings, on synthetic calibration blobs (written to
+//  calibration_info1080_<id>.bin in the working directory, which is where
+//  OpenNIFuncs loads them from):
+//   0. A plausible sensor: reg_x close to x * rgbRegXValScale, reg_y close
+//      to y + the padding lines, and a depth to shift table that falls off
+//      with depth
+//   1. Random registration and shift tables (any uint16_t), an odd
+//      rgbRegXValScale and more start lines than cropping lines, so lots of
+//      pixels map outside the color image or wrap around
+//
+//  For blob 1 at QQVGA (not mirrored) every pixel is tested with every
+//  depth from 0 to MAX_Z.  Everything else is tested with TEST_NUM_DEPTHS
+//  depths per pixel spread over the whole range (TranslateSinglePixel is
+//  slow enough that a full sweep of everything takes minutes).  The depth
+//  of pixel p in sweep step z is (z + p * TEST_DEPTH_STRIDE) % (MAX_Z + 1),
+//  so neighbouring pixels (the lanes of the SSE2 version) have different
+//  depths, and each image is converted in chunks of 1 to 37 pixels so every
+//  start offset and remainder length is used.
+//
+//  Fails (returns 1) on any mismatch.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <fstream>
+#include "kinect_interface_primesense/open_ni_funcs.h"
+#include "kinect_interface_primesense/depth_registration.h"
+#include "kinect_interface_primesense/calibration_data.h"
+
+using kinect_interface_primesense::OpenNIFuncs;
+using kinect_interface_primesense::DepthRegistration;
+using kinect_interface_primesense::CalibrationData;
+
+#define TEST_DEV_ID_BASE 9000  // calibration_info1080_<id>.bin
+#define TEST_NUM_BLOBS 2
+#define TEST_NUM_DEPTHS 257
+#define TEST_DEPTH_STRIDE 40503  // Odd, so every pixel sees every depth
+#define TEST_MAX_CHUNK 37
+
+static uint32_t lcg(uint32_t& seed) {
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 8;
+}
+
+static void makeRegTable(uint16_t* reg, const uint32_t w, const uint32_t h,
+  const uint32_t blob, const int32_t x_scale, const uint32_t lines,
+  uint32_t& seed) {
+  for (uint32_t y = 0; y < h; y++) {
+    for (uint32_t x = 0; x < w; x++) {
+      const uint32_t i = (y * w + x) * 2;
+      if (blob == 0) {
+        const int32_t dx = (int32_t)(lcg(seed) % 33) - 16;
+        const int32_t dy = (int32_t)(lcg(seed) % 5) - 2;
+        const int32_t rx = (int32_t)x * x_scale + dx;
+        const int32_t ry = (int32_t)y + (int32_t)lines + dy;
+        reg[i] = (uint16_t)(rx < 0 ? 0 : rx);
+        reg[i + 1] = (uint16_t)(ry < 0 ? 0 : ry);
+      } else {
+        reg[i] = (uint16_t)lcg(seed);
+        reg[i + 1] = (uint16_t)lcg(seed);
+      }
+    }
+  }
+}
+
+static void makeShiftTable(uint16_t* shift, const uint32_t blob,
+  const int32_t x_scale, uint32_t& seed) {
+  for (uint32_t z = 0; z <= MAX_Z; z++) {
+    if (blob == 0) {
+      // Disparity falls off as 1 / z (in x_scale units of a pixel)
+      shift[z] = (uint16_t)(z == 0 ? 0 : 40 * x_scale * 500 / (z + 500));
+    } else {
+      shift[z] = (uint16_t)lcg(seed);
+    }
+  }
+}
+
+// writeBlob - In the layout OpenNIFuncs::loadCalibrationData() reads
+static bool writeBlob(const uint32_t blob) {
+  CalibrationData* cal = new CalibrationData();
+  memset(cal, 0, sizeof(*cal));
+  uint32_t seed = 31337 + blob;
+  const int32_t x_scale = blob == 0 ? 16 : 7;
+  PadInfo pad;
+  pad.nStartLines = blob == 0 ? 1 : 9;
+  pad.nEndLines = 0;
+  pad.nCroppingLines = blob == 0 ? 4 : 3;
+  cal->m_blob.params1080.padInfo_QQVGA = pad;
+  cal->m_blob.params1080.padInfo_QVGA = pad;
+  cal->m_blob.params1080.padInfo_VGA = pad;
+  cal->m_blob.params1080.rgbRegXValScale = x_scale;
+  const uint32_t lines = (uint32_t)(pad.nCroppingLines - pad.nStartLines);
+  makeRegTable(cal->m_pRegistrationTable_QQVGA, 160, 120, blob, x_scale,
+    lines, seed);
+  makeRegTable(cal->m_pRegistrationTable_QVGA, 320, 240, blob, x_scale,
+    lines, seed);
+  makeRegTable(cal->m_pRegistrationTable_VGA, 640, 480, blob, x_scale,
+    lines, seed);
+  makeShiftTable(cal->m_pDepthToShiftTable_QQVGA, blob, x_scale, seed);
+  makeShiftTable(cal->m_pDepthToShiftTable_QVGA, blob, x_scale, seed);
+  makeShiftTable(cal->m_pDepthToShiftTable_VGA, blob, x_scale, seed);
+
+  char filename[256];
+  snprintf(filename, 256, "calibration_info1080_%d.bin",
+    TEST_DEV_ID_BASE + blob);
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+  bool ok = file.is_open();
+  if (ok) {
+    file.write((char*)&cal->m_blob, sizeof(cal->m_blob));
+    file.write((char*)cal->m_pRegistrationTable_QQVGA,
+      sizeof(cal->m_pRegistrationTable_QQVGA));
+    file.write((char*)cal->m_pRegistrationTable_QVGA,
+      sizeof(cal->m_pRegistrationTable_QVGA));
+    file.write((char*)cal->m_pRegistrationTable_VGA,
+      sizeof(cal->m_pRegistrationTable_VGA));
+    file.write((char*)cal->m_pDepthToShiftTable_QQVGA,
+      sizeof(cal->m_pDepthToShiftTable_QQVGA));
+    file.write((char*)cal->m_pDepthToShiftTable_QVGA,
+      sizeof(cal->m_pDepthToShiftTable_QVGA));
+    file.write((char*)cal->m_pDepthToShiftTable_VGA,
+      sizeof(cal->m_pDepthToShiftTable_VGA));
+    ok = file.good();
+    file.close();
+  }
+  delete cal;
+  return ok;
+}
+
+// testBlob - Returns the number of mismatches.  num_valid counts the pixels
+// that TranslateSinglePixel maps inside the color image.
+static uint64_t testBlob(const uint32_t blob, const uint32_t w,
+  const uint32_t h, const uint32_t num_depths,
+  const uint32_t num_depths_mirror, uint64_t& num_tested,
+  uint64_t& num_valid) {
+  OpenNIFuncs funcs(w, h, OpenNIFuncs::fHFOV_primesense_109,
+    OpenNIFuncs::fVFOV_primesense_109, TEST_DEV_ID_BASE + blob);
+  const DepthRegistration* reg = funcs.registration();
+  if (reg == NULL) {
+    printf("  blob %u (%ux%u): the calibration data didn't load\n", blob, w,
+      h);
+    return 1;
+  }
+  const uint32_t n = w * h;
+  const uint32_t color_w = (uint32_t)reg->color_w();
+  const uint32_t color_h = (uint32_t)reg->color_h();
+  std::vector<uint16_t> depth(n);
+  std::vector<int32_t> indices(n);
+  std::vector<int32_t> indices_scalar(n);
+  uint32_t seed = 4321 + blob;
+  uint64_t num_diff = 0;
+
+  for (uint32_t m = 0; m < 2; m++) {
+    const bool mirror = m == 1;
+    const uint32_t n_steps = mirror ? num_depths_mirror : num_depths;
+    for (uint32_t step = 0; step < n_steps; step++) {
+      // Spread the steps over the whole depth range
+      const uint32_t z0 = (uint32_t)((uint64_t)step * (MAX_Z + 1) / n_steps);
+      for (uint32_t p = 0; p < n; p++) {
+        depth[p] = (uint16_t)((z0 + p * TEST_DEPTH_STRIDE) % (MAX_Z + 1));
+      }
+      for (uint32_t start = 0; start < n;) {
+        uint32_t count = 1 + lcg(seed) % TEST_MAX_CHUNK;
+        count = count < n - start ? count : n - start;
+        reg->colorIndices(&indices[start], &depth[0], start, count, mirror);
+        reg->colorIndicesScalar(&indices_scalar[start], &depth[0], start,
+          count, mirror);
+        start += count;
+      }
+
+      for (uint32_t p = 0; p < n; p++) {
+        int x, y;
+        const bool ok = funcs.TranslateSinglePixel(p % w, p / w, depth[p], x,
+          y, mirror);
+        int32_t expected = -1;
+        if (ok && (uint32_t)x < color_w && (uint32_t)y < color_h) {
+          expected = y * (int32_t)color_w + x;
+          num_valid++;
+        }
+        // translate() doesn't do the z == 0 or bounds tests
+        int tx, ty;
+        reg->translate(p % w, p / w, depth[p], mirror, tx, ty);
+        const bool translate_ok = depth[p] == 0 || (tx == x && ty == y);
+        if (indices[p] != expected || indices_scalar[p] != expected ||
+          !translate_ok) {
+          if (num_diff < 10) {
+            printf("  blob %u (%ux%u%s): pixel (%u, %u) depth %u: %d / %d "
+              "(scalar) / %d (TranslateSinglePixel)\n", blob, w, h,
+              mirror ? ", mirrored" : "", p % w, p / w, depth[p], indices[p],
+              indices_scalar[p], expected);
+          }
+          num_diff++;
+        }
+      }
+      num_tested += n;
+    }
+  }
+  return num_diff;
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t num_diff = 0;
+  uint64_t num_tested = 0;
+  uint64_t num_valid = 0;
+  for (uint32_t blob = 0; blob < TEST_NUM_BLOBS; blob++) {
+    if (!writeBlob(blob)) {
+      printf("depth_registration_test: couldn't write the calibration "
+        "data\nFAILED\n");
+      return 1;
+    }
+    num_diff += testBlob(blob, 160, 120, blob == 1 ? MAX_Z + 1 :
+      TEST_NUM_DEPTHS, TEST_NUM_DEPTHS, num_tested, num_valid);
+    num_diff += testBlob(blob, 640, 480, TEST_NUM_DEPTHS, TEST_NUM_DEPTHS,
+      num_tested, num_valid);
+    char filename[256];
+    snprintf(filename, 256, "calibration_info1080_%d.bin",
+      TEST_DEV_ID_BASE + blob);
+    remove(filename);
+  }
+
+  printf("depth_registration_test: %llu pixels tested, %llu inside the "
+    "color image\n", (unsigned long long)num_tested,
+    (unsigned long long)num_valid);
+  printf("  mismatches: %llu\n", (unsigned long long)num_diff);
+  // If nothing maps inside the color image only the -1 path was tested
+  const bool passed = num_diff == 0 && num_valid > 0 &&
+    num_valid < num_tested;
+  printf(passed ? "PASSED\n" : "FAILED\n");
+  return passed ? 0 : 1;
+}
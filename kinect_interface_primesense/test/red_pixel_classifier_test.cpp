@@ -0,0 +1,207 @@
+//
+//  red_pixel_classifier_test.cpp
+//
+//  Checks that classifyRedPixels (SSE2 when it's compiled in) gives exactly
+//  the same red mask and HSV image as classifyRedPixelsScalar for:
+//   - Every 24 bit RGB color (so every saturated value and every tie at the
+//     hue / saturation / value and hsv_total thresholds that can happen),
+//     with the default parameters and with parameters at the edges of
+//     their ranges (hue targets that wrap, zero and maximum thresholds)
+//   - Random RGB with random parameters
+//   - Pixel counts that aren't a multiple of 16 (1 to 47 pixels, starting
+//     at every pixel offset into the buffer), making sure nothing past the
+//     last pixel is written
+//
+//  Fails (returns 1) on any mismatch.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "kinect_interface_primesense/red_pixel_classifier.h"
+#include "kinect_interface_primesense/depth_images_io.h"
+
+using kinect_interface_primesense::RedHandParams;
+using kinect_interface_primesense::DepthImagesIO;
+using kinect_interface_primesense::classifyRedPixels;
+using kinect_interface_primesense::classifyRedPixelsScalar;
+using kinect_interface_primesense::rgbToHSVPixel;
+
+#define TEST_NUM_COLORS (256 * 256 * 256)
+#define TEST_NUM_RANDOM_PIXELS (640 * 480)
+#define TEST_NUM_RANDOM_PARAMS 16
+#define TEST_MAX_SHORT_RUN 47
+#define TEST_GUARD 0xcd
+
+static uint32_t lcg(uint32_t& seed) {
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 8;
+}
+
+// compare - Runs both versions (with and without the HSV output) and
+// returns the number of mismatched pixels
+static uint32_t compare(const RedHandParams& params, const uint8_t* rgb,
+  const uint32_t num_pixels) {
+  // One guard pixel past the end of every output
+  std::vector<uint8_t> red(num_pixels + 1, TEST_GUARD);
+  std::vector<uint8_t> red_scalar(num_pixels + 1, TEST_GUARD);
+  std::vector<uint8_t> red_no_hsv(num_pixels + 1, TEST_GUARD);
+  std::vector<uint8_t> hsv((num_pixels + 1) * 3, TEST_GUARD);
+  std::vector<uint8_t> hsv_scalar((num_pixels + 1) * 3, TEST_GUARD);
+
+  classifyRedPixels(params, rgb, &red[0], num_pixels, &hsv[0]);
+  classifyRedPixels(params, rgb, &red_no_hsv[0], num_pixels);
+  classifyRedPixelsScalar(params, rgb, &red_scalar[0], num_pixels,
+    &hsv_scalar[0]);
+
+  uint32_t num_diff = 0;
+  for (uint32_t i = 0; i <= num_pixels; i++) {
+    if (red[i] != red_scalar[i] || red_no_hsv[i] != red_scalar[i] ||
+      hsv[i * 3] != hsv_scalar[i * 3] ||
+      hsv[i * 3 + 1] != hsv_scalar[i * 3 + 1] ||
+      hsv[i * 3 + 2] != hsv_scalar[i * 3 + 2]) {
+      if (num_diff < 10) {
+        if (i < num_pixels) {
+          printf("  pixel %u (rgb %d %d %d): red %d / %d, hsv %d %d %d / "
+            "%d %d %d\n", i, rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2],
+            red[i], red_scalar[i], hsv[i * 3], hsv[i * 3 + 1],
+            hsv[i * 3 + 2], hsv_scalar[i * 3], hsv_scalar[i * 3 + 1],
+            hsv_scalar[i * 3 + 2]);
+        } else {
+          printf("  wrote past the last pixel (%u pixels)\n", num_pixels);
+        }
+      }
+      num_diff++;
+    }
+  }
+  return num_diff;
+}
+
+// countTies - The number of colors that land exactly on one of the
+// thresholds (so a < vs <= mistake would show up)
+static uint32_t countTies(const RedHandParams& params, const uint8_t* rgb,
+  const uint32_t num_pixels) {
+  const int32_t hue_offset = (params.red_hue_target + 128) % 255;
+  uint32_t num_ties = 0;
+  for (uint32_t i = 0; i < num_pixels; i++) {
+    uint8_t hsv[3];
+    rgbToHSVPixel(hsv, &rgb[i * 3]);
+    const int32_t delta_hue = abs(((int32_t)hsv[0] + hue_offset) % 255 - 128);
+    if (delta_hue == params.red_hue_threshold ||
+      abs((int32_t)hsv[1] - params.red_sat_target) ==
+      params.red_sat_threshold ||
+      abs((int32_t)hsv[2] - params.red_val_target) ==
+      params.red_val_threshold ||
+      (int32_t)hsv[0] + hsv[1] + hsv[2] == params.hsv_total_threshold) {
+      num_ties++;
+    }
+  }
+  return num_ties;
+}
+
+static RedHandParams randomParams(uint32_t& seed) {
+  RedHandParams params = DepthImagesIO::redHandParams();
+  params.red_hue_threshold = (int32_t)(lcg(seed) % 130);
+  params.red_sat_threshold = (int32_t)(lcg(seed) % 256);
+  params.red_val_threshold = (int32_t)(lcg(seed) % 256);
+  params.red_hue_target = (int32_t)(lcg(seed) % 256);
+  params.red_sat_target = (int32_t)(lcg(seed) % 256);
+  params.red_val_target = (int32_t)(lcg(seed) % 256);
+  params.hsv_total_threshold = (int32_t)(lcg(seed) % 766);
+  params.red_red_min = (int32_t)(lcg(seed) % 256);
+  params.red_blue_max = (int32_t)(lcg(seed) % 256);
+  params.red_green_max = (int32_t)(lcg(seed) % 256);
+  return params;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t num_diff = 0;
+  uint32_t num_pixels_tested = 0;
+  uint32_t num_ties = 0;
+  uint32_t num_red = 0;
+
+  // Every color, with the default and the edge case parameters
+  std::vector<uint8_t> colors(TEST_NUM_COLORS * 3);
+  for (uint32_t i = 0; i < TEST_NUM_COLORS; i++) {
+    colors[i * 3] = (uint8_t)(i >> 16);
+    colors[i * 3 + 1] = (uint8_t)(i >> 8);
+    colors[i * 3 + 2] = (uint8_t)i;
+  }
+  const RedHandParams defaults = DepthImagesIO::redHandParams();
+  std::vector<RedHandParams> edge_params;
+  edge_params.push_back(defaults);
+  const int32_t hue_targets[] = {0, 126, 127, 128, 254, 255};
+  for (uint32_t i = 0; i < sizeof(hue_targets) / sizeof(hue_targets[0]);
+    i++) {
+    RedHandParams params = defaults;
+    params.red_hue_target = hue_targets[i];
+    edge_params.push_back(params);
+  }
+  // Only the hue matters, with the threshold between the two delta_hue
+  // values on either side of the % 255 wrap
+  RedHandParams params_wrap = defaults;
+  params_wrap.red_hue_threshold = 128;
+  params_wrap.red_sat_threshold = 256;
+  params_wrap.red_val_threshold = 256;
+  params_wrap.red_red_min = -1;
+  params_wrap.red_blue_max = 256;
+  params_wrap.red_green_max = 256;
+  edge_params.push_back(params_wrap);
+  RedHandParams params_zero = defaults;  // Nothing passes the red test
+  params_zero.red_hue_threshold = 0;
+  params_zero.red_sat_threshold = 0;
+  params_zero.red_val_threshold = 0;
+  params_zero.hsv_total_threshold = 0;  // ... but everything passes this
+  edge_params.push_back(params_zero);
+  RedHandParams params_max = defaults;  // Everything passes the red test
+  params_max.red_hue_threshold = 255;
+  params_max.red_sat_threshold = 256;
+  params_max.red_val_threshold = 256;
+  params_max.hsv_total_threshold = 766;
+  params_max.red_red_min = -1;
+  params_max.red_blue_max = 256;
+  params_max.red_green_max = 256;
+  edge_params.push_back(params_max);
+
+  for (uint32_t p = 0; p < edge_params.size(); p++) {
+    num_diff += compare(edge_params[p], &colors[0], TEST_NUM_COLORS);
+    num_pixels_tested += TEST_NUM_COLORS;
+  }
+  num_ties = countTies(defaults, &colors[0], TEST_NUM_COLORS);
+  std::vector<uint8_t> red(TEST_NUM_COLORS);
+  classifyRedPixelsScalar(defaults, &colors[0], &red[0], TEST_NUM_COLORS);
+  for (uint32_t i = 0; i < TEST_NUM_COLORS; i++) {
+    num_red += red[i];
+  }
+
+  // Random colors and parameters
+  uint32_t seed = 1234;
+  std::vector<uint8_t> rgb(TEST_NUM_RANDOM_PIXELS * 3);
+  for (uint32_t i = 0; i < TEST_NUM_RANDOM_PIXELS * 3; i++) {
+    rgb[i] = (uint8_t)lcg(seed);
+  }
+  for (uint32_t p = 0; p < TEST_NUM_RANDOM_PARAMS; p++) {
+    num_diff += compare(randomParams(seed), &rgb[0], TEST_NUM_RANDOM_PIXELS);
+    num_pixels_tested += TEST_NUM_RANDOM_PIXELS;
+  }
+
+  // Short runs (not a multiple of 16) at every offset into the buffer
+  for (uint32_t n = 1; n <= TEST_MAX_SHORT_RUN; n++) {
+    for (uint32_t offset = 0; offset < 16; offset++) {
+      num_diff += compare(defaults, &rgb[offset * 3], n);
+      num_pixels_tested += n;
+    }
+  }
+
+  printf("red_pixel_classifier_test: %u pixels compared\n",
+    num_pixels_tested);
+  printf("  colors on a threshold (default params): %u\n", num_ties);
+  printf("  red colors (default params): %u\n", num_red);
+  printf("  mismatches: %u\n", num_diff);
+
+  // Without red pixels or ties the exhaustive pass would test less than it
+  // says it does
+  const bool passed = num_diff == 0 && num_ties > 0 && num_red > 0;
+  printf(passed ? "PASSED\n" : "FAILED\n");
+  return passed ? 0 : 1;
+}
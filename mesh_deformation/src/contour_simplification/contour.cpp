@@ -16,12 +16,8 @@ using std::runtime_error;
 using std::string;
 
 namespace contour_simplification {
-  math::Float3 Contour::v;
-  math::Float3 Contour::w;
-  math::Float3 Contour::cur_norm;
   const Float3 Contour::contour_normal(0, 0, -1);
 
-
   Contour::Contour(const Float3* v1, uint32_t contour_index, uint32_t curr) {
     this->v1 = *v1;
     this->contour_index = contour_index;
@@ -52,6 +48,9 @@ namespace contour_simplification {
   }
   
   void Contour::calcLengthAndAngle(Vector<Contour>* contours) {
+    // Locals (not static) so separate ContourSimplification instances can run
+    // on different threads
+    Float3 v, w, cur_norm;
     v.sub(&contours->at(next)->v1, &v1);  // Vector from this point to the next
     w.sub(&v1, &contours->at(prev)->v1);  // Vector from last point to this
     length = v.length();
@@ -35,9 +35,6 @@ namespace contour_simplification {
     void invalidateContour();
     
   private:
-    static math::Float3 v;
-    static math::Float3 w;
-    static math::Float3 cur_norm;
     static const math::Float3 contour_normal;
   };
 };  // namespace contour_simplification
@@ -0,0 +1,182 @@
+//
+//  contour_batch.cpp
+//
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#ifdef __APPLE__
+#include <dirent.h> // for opendir(), readdir(), and closedir()
+#endif
+#if defined(WIN32) || defined(_WIN32)
+#include "dirent_win.h" // for opendir(), readdir(), and closedir()
+#endif
+#include "contour_simplification/contour_batch.h"
+#include "file_io/file_io.h"
+
+using data_str::Vector;
+using math::Float3;
+using std::string;
+
+namespace contour_simplification {
+
+  // Everything a worker thread touches while processing a file
+  struct ContourBatchWorker {
+    ContourSimplification simplifier;
+    Vector<float> float_data;
+    Vector<unsigned char> char_data;
+    Vector<Float3> vertices;
+    Vector<unsigned char> mask;
+  };
+
+  ContourBatch::ContourBatch(uint32_t num_threads) {
+    num_threads_ = num_threads;
+    if (num_threads_ == 0) {
+      num_threads_ = std::thread::hardware_concurrency();
+    }
+    if (num_threads_ == 0) {
+      num_threads_ = 1;  // hardware_concurrency() isn't always known
+    }
+    workers_.capacity(num_threads_);
+    for (uint32_t i = 0; i < num_threads_; i++) {
+      workers_.pushBack(new ContourBatchWorker());
+    }
+  }
+
+  ContourBatch::~ContourBatch() {
+    for (uint32_t i = 0; i < workers_.size(); i++) {
+      delete workers_[i];
+    }
+  }
+
+  void ContourBatch::listHandFiles(const string& data_path,
+    std::vector<string>* files) {
+    DIR *dir_data = opendir(data_path.c_str());
+    if (!dir_data) {
+      throw std::runtime_error(string("Cannot open directory: ") + data_path);
+    }
+    files->clear();
+    struct dirent *entry;
+    while ((entry = readdir(dir_data))) {
+      string cur_file = string(entry->d_name);
+      if (cur_file.size() > 10 && cur_file.substr(0,6) == string("hands_") &&
+          cur_file.substr(cur_file.size() - 4, 4) == string(".bin")) {
+        files->push_back(cur_file);
+      }
+    }
+    closedir(dir_data);
+
+    // readdir order is file system dependant, sort so the output is repeatable
+    std::sort(files->begin(), files->end());
+  }
+
+  uint32_t ContourBatch::processDirectory(const string& data_path,
+    const string& output_file, uint32_t target_contour_count, uint32_t width,
+    uint32_t height) {
+    data_path_ = data_path;
+    target_contour_count_ = target_contour_count;
+    width_ = width;
+    height_ = height;
+    listHandFiles(data_path_, &files_);
+
+    // Open the output file before doing the work so that a bad path fails fast
+    std::ofstream file(output_file.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error(string("error opening file:") + output_file);
+    }
+    file.close();
+
+    records_.clear();
+    records_.resize(files_.size());
+    next_file_ = 0;
+    num_failed_ = 0;
+
+    uint32_t num_threads = std::min<uint32_t>(num_threads_, 
+      static_cast<uint32_t>(files_.size()));
+    std::cout << "ContourBatch: processing " << files_.size() << " files on ";
+    std::cout << num_threads << " threads" << std::endl;
+    if (num_threads <= 1) {
+      workerThread(0);
+    } else {
+      Vector<std::thread*> threads;
+      threads.capacity(num_threads);
+      for (uint32_t i = 0; i < num_threads; i++) {
+        threads.pushBack(new std::thread(&ContourBatch::workerThread, this,
+                                         i));
+      }
+      for (uint32_t i = 0; i < num_threads; i++) {
+        threads[i]->join();
+        delete threads[i];
+      }
+    }
+
+    saveRecords(output_file);
+    return static_cast<uint32_t>(files_.size()) - num_failed_;
+  }
+
+  void ContourBatch::workerThread(uint32_t thread_id) {
+    ContourBatchWorker* worker = workers_[thread_id];
+    while (true) {
+      uint32_t cur_file = next_file_++;
+      if (cur_file >= files_.size()) {
+        return;
+      }
+      processFile(worker, cur_file);
+    }
+  }
+
+  void ContourBatch::processFile(ContourBatchWorker* worker, uint32_t file) {
+    try {
+      file_io::LoadHandData(data_path_ + files_[file], width_, height_,
+        &worker->float_data, &worker->char_data, &worker->vertices, NULL,
+        &worker->mask);
+      worker->simplifier.simplifyContour(target_contour_count_,
+        &worker->vertices, &worker->mask, width_, height_);
+      std::ostringstream record(std::ios::out | std::ios::binary);
+      worker->simplifier.writeContour(&record);
+      records_[file] = record.str();
+    } catch (std::runtime_error e) {
+      // Don't let one bad file kill the whole batch, just leave an empty record
+      num_failed_++;
+      records_[file] = string("");
+      std::lock_guard<std::mutex> lock(print_lock_);
+      std::cerr << "ContourBatch: " << files_[file] << " failed: " << e.what();
+      std::cerr << std::endl;
+    }
+  }
+
+  void ContourBatch::saveRecords(const string& output_file) {
+    std::ofstream file(output_file.c_str(), std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error(string("error opening file:") + output_file);
+    }
+
+    // The index goes first, so work out its size before writing the offsets
+    uint32_t num_files = static_cast<uint32_t>(files_.size());
+    uint64_t offset = sizeof(num_files);
+    for (uint32_t i = 0; i < num_files; i++) {
+      offset += sizeof(uint32_t) + files_[i].size() + sizeof(uint64_t) +
+        sizeof(uint32_t);
+    }
+
+    file.write(reinterpret_cast<const char*>(&num_files), sizeof(num_files));
+    for (uint32_t i = 0; i < num_files; i++) {
+      uint32_t name_size = static_cast<uint32_t>(files_[i].size());
+      uint32_t record_size = static_cast<uint32_t>(records_[i].size());
+      file.write(reinterpret_cast<const char*>(&name_size), sizeof(name_size));
+      file.write(files_[i].c_str(), name_size);
+      file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+      file.write(reinterpret_cast<const char*>(&record_size),
+                 sizeof(record_size));
+      offset += record_size;
+    }
+    for (uint32_t i = 0; i < num_files; i++) {
+      file.write(records_[i].c_str(), records_[i].size());
+    }
+    file.flush();
+    file.close();
+  }
+
+}  // namespace contour_simplification
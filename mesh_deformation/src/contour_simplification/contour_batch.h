@@ -0,0 +1,83 @@
+//
+//  contour_batch.h
+//
+//  Headless version of processHandData() (in main/kinect_funcs.cpp): runs
+//  marching squares + contour culling on every hands_*.bin file in a
+//  directory and writes all of the contours into a single indexed file.
+//
+//  The files are shared between num_threads worker threads, each with its
+//  own ContourSimplification instance and load buffers, so nothing is shared
+//  between threads except the next file index.  No OpenGL is needed.
+//
+//  The output file will be layed out like this:
+//   1. number of files (32bit unsigned int)
+//   2. For each file i (sorted by name):
+//      --> length of the file name (32bit unsigned int)
+//      --> file name (chars, no null terminator)
+//      --> byte offset of the contour record from the start of the output
+//          file (64bit unsigned int)
+//      --> size of the contour record in bytes (32bit unsigned int, 0 if the
+//          file could not be processed)
+//   3. For each file i:
+//      --> contour record, same layout as saveContourToFile()
+//
+
+#ifndef CONTOUR_SIMPLIFICATION_CONTOUR_BATCH_HEADER
+#define CONTOUR_SIMPLIFICATION_CONTOUR_BATCH_HEADER
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include "contour_simplification/contour_simplification.h"
+#include "data_str/vector.h"
+#include "math/math_types.h"
+
+namespace contour_simplification {
+
+  struct ContourBatchWorker;
+
+  class ContourBatch {
+  public:
+    // num_threads = 0 --> one thread per hardware thread
+    ContourBatch(uint32_t num_threads = 0);
+    ~ContourBatch();
+
+    // processDirectory - Returns the number of files that were processed
+    // without errors.  Throws if data_path or output_file can't be opened.
+    uint32_t processDirectory(const std::string& data_path,
+      const std::string& output_file, uint32_t target_contour_count,
+      uint32_t width, uint32_t height);
+
+    // listHandFiles - The hands_*.bin file names in data_path (sorted)
+    static void listHandFiles(const std::string& data_path,
+      std::vector<std::string>* files);
+
+    inline uint32_t num_threads() const { return num_threads_; }
+
+  private:
+    uint32_t num_threads_;
+    data_str::Vector<ContourBatchWorker*> workers_;
+
+    // Per job data
+    std::string data_path_;
+    uint32_t target_contour_count_;
+    uint32_t width_, height_;
+    // Note: std::vector since data_str::Vector doesn't call the destructors
+    std::vector<std::string> files_;
+    std::vector<std::string> records_;  // Per file
+    std::atomic<uint32_t> next_file_;
+    std::atomic<uint32_t> num_failed_;
+    std::mutex print_lock_;
+
+    void workerThread(uint32_t thread_id);
+    void processFile(ContourBatchWorker* worker, uint32_t file);
+    void saveRecords(const std::string& output_file);
+
+    // Non-copyable, non-assignable.
+    ContourBatch(ContourBatch&);
+    ContourBatch& operator=(const ContourBatch&);
+  };
+};  // namespace contour_simplification
+
+#endif  // CONTOUR_SIMPLIFICATION_CONTOUR_BATCH_HEADER
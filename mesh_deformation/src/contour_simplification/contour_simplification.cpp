@@ -462,7 +462,12 @@ namespace contour_simplification {
     if (!file.is_open()) {
       throw std::runtime_error(std::string("error opening file:") + filename);
     }
-    
+    writeContour(&file);
+    file.flush();
+    file.close();
+  }
+
+  void ContourSimplification::writeContour(std::ostream* stream) {
     size_t Float3_elem_size = sizeof(contours_[0].v1[0])*3;
     uint32_t num_contours = contours_starts_.size();
     
@@ -476,24 +481,21 @@ namespace contour_simplification {
     //           --> Contour[i].segment[j].y (32bit float)
     //           --> Contour[i].segment[j].z (32bit float)
   
-    file.write(reinterpret_cast<const char*>(&num_contours), 
-               sizeof(num_contours));
-    file.flush();
+    stream->write(reinterpret_cast<const char*>(&num_contours), 
+                  sizeof(num_contours));
     for (uint32_t i = 0; i < contours_num_elements_.size(); i++) {
-      file.write(reinterpret_cast<const char*>(contours_num_elements_.at(i)), 
-                 sizeof(num_contours));
-      file.flush();
+      stream->write(reinterpret_cast<const char*>(contours_num_elements_.at(i)),
+                    sizeof(num_contours));
     }
     for (uint32_t i = 0; i < contours_starts_.size(); i++) {
       uint32_t start_contour = contours_starts_[i];
       uint32_t cur_contour = start_contour;
       do {
         Contour* cont = contours_.at(cur_contour);
-        file.write(reinterpret_cast<const char*>(cont->v1.m), Float3_elem_size);
-        file.flush();        
+        stream->write(reinterpret_cast<const char*>(cont->v1.m), 
+                      Float3_elem_size);
         cur_contour = cont->next;
       } while (cur_contour != start_contour);
     }
-    file.close();
   }
 }  // namespace contour_simplification
@@ -14,6 +14,7 @@
 #ifndef CONTOUR_SIMPLIFICATION_CONTOUR_SIMPLIFICATION_HEADER
 #define CONTOUR_SIMPLIFICATION_CONTOUR_SIMPLIFICATION_HEADER
 
+#include <ostream>
 #include "contour_simplification/contour.h"
 #include "data_str/vector.h"
 #include "math/math_types.h"
@@ -43,6 +44,9 @@ namespace contour_simplification {
     data_str::Vector<uint32_t>* getContourStarts() { return &contours_starts_; }
     void printContours();
     void saveContourToFile(std::string file);
+    // writeContour - Same layout as saveContourToFile (an empty contour is
+    // written as 0 contours)
+    void writeContour(std::ostream* stream);
 
   private:
     void marchingSquares(data_str::Vector<math::Float3>* vertices, 
@@ -0,0 +1,112 @@
+//
+//  arena_allocator.cpp
+//
+
+#include <cstdlib>
+#include <cstring>
+#include "data_str/arena_allocator.h"
+#include "exceptions/wruntime_error.h"
+
+namespace data_str {
+
+  ArenaAllocator::ArenaAllocator(uint64_t block_size) {
+    blocks_ = NULL;
+    num_blocks_ = 0;
+    max_blocks_ = 0;
+    block_size_ = block_size < ALIGNMENT ? ALIGNMENT : block_size;
+    bytes_reserved_ = 0;
+    reset();
+  }
+
+  ArenaAllocator::~ArenaAllocator() {
+    for (uint32_t i = 0; i < num_blocks_; i++) {
+#ifdef _WIN32
+      _aligned_free(blocks_[i].data);
+#else
+      free(blocks_[i].data);
+#endif
+    }
+    if (blocks_) {
+      delete[] blocks_;
+    }
+  }
+
+  void ArenaAllocator::reset() {
+    cur_block_ = 0;
+    cur_offset_ = 0;
+    bytes_used_ = 0;
+    memset(free_lists_, 0, sizeof(free_lists_));
+  }
+
+  uint32_t ArenaAllocator::sizeClass(uint64_t size) {
+    uint32_t size_class = 0;
+    while ((static_cast<uint64_t>(ALIGNMENT) << size_class) < size) {
+      size_class++;
+    }
+    if (size_class >= ARENA_NUM_SIZE_CLASSES) {
+      throw std::wruntime_error("ArenaAllocator::sizeClass: size too big.");
+    }
+    return size_class;
+  }
+
+  void ArenaAllocator::addBlock(uint64_t size) {
+    if (num_blocks_ == max_blocks_) {
+      max_blocks_ = max_blocks_ == 0 ? 4 : max_blocks_ * 2;
+      Block* blocks_old = blocks_;
+      blocks_ = new Block[max_blocks_];
+      for (uint32_t i = 0; i < num_blocks_; i++) {
+        blocks_[i] = blocks_old[i];
+      }
+      if (blocks_old) {
+        delete[] blocks_old;
+      }
+    }
+#ifdef _WIN32
+    void* temp = _aligned_malloc(static_cast<size_t>(size), ALIGNMENT);
+#else
+    void* temp = malloc(static_cast<size_t>(size));
+#endif
+    if (temp == NULL) {
+      throw std::wruntime_error("ArenaAllocator::addBlock: Malloc Failed.");
+    }
+    blocks_[num_blocks_].data = reinterpret_cast<uint8_t*>(temp);
+    blocks_[num_blocks_].size = size;
+    num_blocks_++;
+    bytes_reserved_ += size;
+  }
+
+  void* ArenaAllocator::allocate(uint64_t size) {
+    uint32_t size_class = sizeClass(size);
+    if (free_lists_[size_class] != NULL) {
+      void* ptr = free_lists_[size_class];
+      free_lists_[size_class] = *reinterpret_cast<void**>(ptr);
+      return ptr;
+    }
+
+    // Otherwise bump allocate, moving on to the next block (or a new one)
+    // if it doesn't fit in the current block
+    uint64_t class_size = static_cast<uint64_t>(ALIGNMENT) << size_class;
+    while (cur_block_ < num_blocks_ &&
+      cur_offset_ + class_size > blocks_[cur_block_].size) {
+      cur_block_++;
+      cur_offset_ = 0;
+    }
+    if (cur_block_ == num_blocks_) {
+      addBlock(class_size > block_size_ ? class_size : block_size_);
+    }
+    void* ptr = blocks_[cur_block_].data + cur_offset_;
+    cur_offset_ += class_size;
+    bytes_used_ += class_size;
+    return ptr;
+  }
+
+  void ArenaAllocator::release(void* ptr, uint64_t size) {
+    if (ptr == NULL) {
+      return;
+    }
+    uint32_t size_class = sizeClass(size);
+    *reinterpret_cast<void**>(ptr) = free_lists_[size_class];
+    free_lists_[size_class] = ptr;
+  }
+
+};  // namespace data_str
@@ -0,0 +1,81 @@
+//
+//  arena_allocator.h
+//
+//  A memory arena for the temporary data of one operation (for instance one
+//  mesh simplification per frame).  Memory is handed out by bumping an offset
+//  through a few large blocks, and everything is given back at once with
+//  reset(), which is O(1).  The blocks are kept for the next operation, so
+//  once the arena has grown to the working set size there are no more malloc
+//  calls (or page faults on freshly mapped memory).
+//
+//  Allocations are rounded up to a power of two size class, and release()
+//  puts a buffer on the free list of its class to be handed out again before
+//  the next reset().  A data_str::Vector that grows by doubling therefore
+//  passes its old buffer on to whatever container grows next.
+//
+//  The containers that take an ArenaAllocator* (Vector, MinHeap, HashMap and
+//  mesh_simplification::MinHeapEdges) allocate from it instead of the heap.
+//  They only release memory back to the arena when they grow, never in
+//  clear() or their destructor, so they can be destroyed after the reset.
+//  They must not be used after the reset though.
+//
+//  NOTE: Not thread safe, use one arena per thread.
+//
+
+#ifndef DATA_STR_ARENA_ALLOCATOR_HEADER
+#define DATA_STR_ARENA_ALLOCATOR_HEADER
+
+#include "alignment/data_align.h"
+#include "math/math_types.h"  // for uint
+
+#define ARENA_DEFAULT_BLOCK_SIZE (1 << 22)  // Bytes (bigger requests get
+                                            // a block of their own)
+#define ARENA_NUM_SIZE_CLASSES 32  // ALIGNMENT << 31 bytes max
+
+namespace data_str {
+
+  class ArenaAllocator {
+  public:
+    explicit ArenaAllocator(uint64_t block_size = ARENA_DEFAULT_BLOCK_SIZE);
+    ~ArenaAllocator();
+
+    // allocate - At least size bytes, aligned to ALIGNMENT
+    void* allocate(uint64_t size);
+    // release - ptr must be from allocate(size) since the last reset()
+    void release(void* ptr, uint64_t size);
+    // reset - Give back everything that was allocated (blocks are kept)
+    void reset();
+
+    // Bytes handed out since the last reset (including released buffers)
+    inline uint64_t bytes_used() const { return bytes_used_; }
+    inline uint64_t bytes_reserved() const { return bytes_reserved_; }
+    inline uint32_t num_blocks() const { return num_blocks_; }
+
+  private:
+    struct Block {
+      uint8_t* data;
+      uint64_t size;
+    };
+
+    Block* blocks_;
+    uint32_t num_blocks_;
+    uint32_t max_blocks_;
+    uint32_t cur_block_;
+    uint64_t cur_offset_;
+    uint64_t block_size_;
+    uint64_t bytes_used_;
+    uint64_t bytes_reserved_;
+    void* free_lists_[ARENA_NUM_SIZE_CLASSES];  // Singly linked through the
+                                                // first word of each buffer
+
+    static uint32_t sizeClass(uint64_t size);
+    void addBlock(uint64_t size);
+
+    // Non-copyable, non-assignable.
+    ArenaAllocator(ArenaAllocator&);
+    ArenaAllocator& operator=(const ArenaAllocator&);
+  };
+
+};  // namespace data_str
+
+#endif  // DATA_STR_ARENA_ALLOCATOR_HEADER
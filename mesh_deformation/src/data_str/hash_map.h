@@ -16,13 +16,21 @@
 //        hash_map is not responsible for handling cleanup when Vector<type*> is
 //        used.
 //
+//  NOTE: If an ArenaAllocator is given, the table comes from the arena and
+//        the destructor does not free it (see arena_allocator.h).  The key and
+//        value destructors are then never called, so they must not own any
+//        memory.
+//
 
 #ifndef DATA_STR_HASH_MAP_HEADER
 #define DATA_STR_HASH_MAP_HEADER
 
 #include <stdio.h>  // For printf()
+#include <string.h>  // For memset()
+#include <new>  // For placement new
 #include "math/math_types.h"  // for uint
 #include "data_str/pair.h"
+#include "data_str/arena_allocator.h"
 #include "exceptions/wruntime_error.h"
 
 #ifndef NULL
@@ -37,7 +45,7 @@ namespace data_str {
     // Function pointer for the hash function
     typedef uint32_t (*HashFunc) (uint32_t size, TKey key);
 
-    HashMap(uint32_t size, HashFunc hash_func);
+    HashMap(uint32_t size, HashFunc hash_func, ArenaAllocator* arena = NULL);
     ~HashMap();
 
     inline uint32_t size() { return size_; }
@@ -56,8 +64,13 @@ namespace data_str {
     static const float max_load_;
 
     HashFunc hash_func_;
+    ArenaAllocator* arena_;  // NULL --> heap
     uint32_t linearProbeFunc(uint32_t hash, uint32_t probe_index);
     void rehash();
+    void allocTable(uint32_t size, Pair<TKey, TValue>*& table, 
+      bool*& bucket_full);
+    void freeTable(uint32_t size, Pair<TKey, TValue>* table, 
+      bool* bucket_full);
 
     // Non-copyable, non-assignable.
     HashMap(HashMap&);
@@ -74,28 +87,61 @@ namespace data_str {
   };
 
   template <class TKey, class TValue>
-  HashMap<TKey, TValue>::HashMap(uint32_t size, HashFunc hash_func) {
+  HashMap<TKey, TValue>::HashMap(uint32_t size, HashFunc hash_func,
+    ArenaAllocator* arena) {
     hash_func_ = hash_func;
+    arena_ = arena;
     load_factor_ = 0;
     count_ = 0;
     size_ = size;
     if (size_ < 1) {
       throw std::wruntime_error("HashMap<TKey, TValue>::HashMap: size < 1");
     }
-    table_ = new Pair<TKey, TValue>[size_];
-    bucket_full_ = new bool[size_];
-    memset(bucket_full_, false, size_*sizeof(bucket_full_[0]));
+    allocTable(size_, table_, bucket_full_);
+  };
+
+  template <class TKey, class TValue>
+  void HashMap<TKey, TValue>::allocTable(uint32_t size, 
+    Pair<TKey, TValue>*& table, bool*& bucket_full) {
+    if (arena_) {
+      table = reinterpret_cast<Pair<TKey, TValue>*>(
+        arena_->allocate(size * sizeof(Pair<TKey, TValue>)));
+      for (uint32_t i = 0; i < size; i++) {
+        new(table + i) Pair<TKey, TValue>();
+      }
+      bucket_full = reinterpret_cast<bool*>(
+        arena_->allocate(size * sizeof(bool)));
+    } else {
+      table = new Pair<TKey, TValue>[size];
+      bucket_full = new bool[size];
+    }
+    memset(bucket_full, false, size*sizeof(bucket_full[0]));
+  };
+
+  template <class TKey, class TValue>
+  void HashMap<TKey, TValue>::freeTable(uint32_t size, 
+    Pair<TKey, TValue>* table, bool* bucket_full) {
+    if (arena_) {
+      arena_->release(table, size * sizeof(Pair<TKey, TValue>));
+      arena_->release(bucket_full, size * sizeof(bool));
+    } else {
+      delete[] table;
+      delete[] bucket_full;
+    }
   };
 
   template <class TKey, class TValue>
   void HashMap<TKey, TValue>::rehash() {
     // printf("HashMap rehash\n");
-    uint32_t new_size = size_*2;
-    Pair<TKey, TValue>* new_table = new Pair<TKey, TValue>[new_size];
-    bool* new_bucket_full = new bool[new_size];
-    memset(new_bucket_full, false, new_size*sizeof(new_bucket_full[0]));
+    uint32_t old_size = size_;
+    Pair<TKey, TValue>* new_table;
+    bool* new_bucket_full;
+    allocTable(old_size*2, new_table, new_bucket_full);
+    // The new size must be set before re-inserting: the hash and probe
+    // functions use size_ and lookup() will use the new size
+    size_ = old_size*2;
     // manually insert all the old key/value pairs into the hash table
-    for (uint32_t j = 0; j < size_; j ++) {
+    for (uint32_t j = 0; j < old_size; j ++) {
       if (bucket_full_[j]) {
         TKey curKey = table_[j].first;
         TValue curValue = table_[j].second;
@@ -119,15 +165,16 @@ namespace data_str {
         }
       }  // end if (bucket_full_[i])
     }
-    size_ = new_size;
-    delete[] table_;
-    delete[] bucket_full_;
+    freeTable(old_size, table_, bucket_full_);
     table_ = new_table;
     bucket_full_ = new_bucket_full;
   };
 
   template <class TKey, class TValue>
   HashMap<TKey, TValue>::~HashMap() {
+    if (arena_) {
+      return;  // The arena owns the table
+    }
     if (table_)
       delete[] table_;
     if (bucket_full_)
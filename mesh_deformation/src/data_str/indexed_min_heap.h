@@ -0,0 +1,260 @@
+//
+//  indexed_min_heap.h
+//
+//  A binary min heap of (key, id) pairs, where the ids are integers in
+//  [0, max_id).  The heap keeps track of where every id is stored, so the key
+//  of an id can be changed (decrease-key or increase-key) or the id removed
+//  in O(log n) time.
+//
+//  NOTE: Keys are compared with operator<.  An id can only be in the heap
+//        once.  The heap can be built from an array in O(n) time.
+//
+
+#ifndef DATA_STR_INDEXED_MIN_HEAP_HEADER
+#define DATA_STR_INDEXED_MIN_HEAP_HEADER
+
+#include <stdio.h>  // For printf()
+#include <string>
+#ifdef __APPLE__
+#include <stdexcept>
+#endif
+#include "alignment/data_align.h"
+#include "math/math_types.h"  // for uint
+#include "data_str/vector.h"
+
+namespace data_str {
+
+  template <typename T>
+  class IndexedMinHeap {
+  public:
+    explicit IndexedMinHeap(uint32_t max_id = 0);
+    ~IndexedMinHeap();
+
+    // resize - Empty the heap and set the valid id range to [0, max_id)
+    void resize(uint32_t max_id);
+    // build - Add num ids at once (O(n)).  The heap must be empty.
+    void build(const uint32_t* ids, const T* keys, uint32_t num);
+
+    void insert(uint32_t id, const T& key);
+    void update(uint32_t id, const T& key);  // Inserts if id isn't in the heap
+    void remove(uint32_t id);
+    uint32_t removeMin(T* key = NULL);  // Returns the id
+
+    inline bool contains(uint32_t id) { return pos_[id] != MAX_UINT32; }
+    inline const T& key(uint32_t id) { return keys_[pos_[id]]; }
+    inline uint32_t size() { return ids_.size(); }
+
+    bool validate();  // For testing purposes (do not delete)
+    void print();
+
+  private:
+    data_str::Vector<T> keys_;  // Heap order
+    data_str::Vector<uint32_t> ids_;  // Heap order
+    data_str::Vector<uint32_t> pos_;  // Per id, MAX_UINT32 if not in the heap
+
+    void swap(uint32_t i, uint32_t j);
+    void reheapifyUp(uint32_t i);
+    void reheapifyDown(uint32_t i);
+    inline static uint32_t getParent(uint32_t i) { return (i - 1) >> 1; }
+    inline static uint32_t getLChild(uint32_t i) { return (i << 1) + 1; }
+    inline static uint32_t getRChild(uint32_t i) { return (i << 1) + 2; }
+  };
+
+  template <typename T>
+  IndexedMinHeap<T>::IndexedMinHeap(uint32_t max_id) {
+    resize(max_id);
+  };
+
+  template <typename T>
+  IndexedMinHeap<T>::~IndexedMinHeap() {
+
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::resize(uint32_t max_id) {
+    if (keys_.capacity() < max_id) {
+      keys_.capacity(max_id);
+      ids_.capacity(max_id);
+    }
+    keys_.resize(0);
+    ids_.resize(0);
+    if (pos_.capacity() < max_id) {
+      pos_.capacity(max_id);
+    }
+    pos_.resize(max_id);
+    for (uint32_t i = 0; i < max_id; i++) {
+      pos_[i] = MAX_UINT32;
+    }
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::build(const uint32_t* ids, const T* keys,
+    uint32_t num) {
+    if (ids_.size() != 0) {
+      throw std::runtime_error("IndexedMinHeap<T>::build() - ERROR: heap is "
+        "not empty!");
+    }
+    if (num > pos_.size()) {
+      throw std::runtime_error("IndexedMinHeap<T>::build() - ERROR: too many "
+        "ids!");
+    }
+    keys_.resize(num);
+    ids_.resize(num);
+    for (uint32_t i = 0; i < num; i++) {
+      keys_[i] = keys[i];
+      ids_[i] = ids[i];
+      pos_[ids[i]] = i;
+    }
+    // Now heapify from the bottom up
+    // Note: the first non-leaf is size / 2 - 1
+    for (uint32_t i = num / 2; i > 0; i--) {
+      reheapifyDown(i - 1);
+    }
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::insert(uint32_t id, const T& key) {
+#if defined(DEBUG) || defined(_DEBUG)
+    if (contains(id)) {
+      throw std::runtime_error("IndexedMinHeap<T>::insert() - ERROR: id is "
+        "already in the heap!");
+    }
+#endif
+    pos_[id] = ids_.size();
+    keys_.pushBack(key);
+    ids_.pushBack(id);
+    reheapifyUp(ids_.size() - 1);
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::update(uint32_t id, const T& key) {
+    uint32_t i = pos_[id];
+    if (i == MAX_UINT32) {
+      insert(id, key);
+      return;
+    }
+    if (key < keys_[i]) {
+      keys_[i] = key;
+      reheapifyUp(i);
+    } else {
+      keys_[i] = key;
+      reheapifyDown(i);
+    }
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::remove(uint32_t id) {
+    uint32_t i = pos_[id];
+    if (i == MAX_UINT32) {
+      return;
+    }
+    uint32_t last = ids_.size() - 1;
+    if (i != last) {
+      swap(i, last);
+    }
+    keys_.resize(last);
+    ids_.resize(last);
+    pos_[id] = MAX_UINT32;
+    if (i != last) {
+      // The element moved into i can go either way
+      uint32_t moved_id = ids_[i];
+      reheapifyUp(i);
+      if (pos_[moved_id] == i) {
+        reheapifyDown(i);
+      }
+    }
+  };
+
+  template <typename T>
+  uint32_t IndexedMinHeap<T>::removeMin(T* key) {
+    if (ids_.size() == 0) {
+      throw std::runtime_error("IndexedMinHeap<T>::removeMin() - ERROR: heap "
+        "is empty!");
+    }
+    uint32_t id = ids_[0];
+    if (key != NULL) {
+      *key = keys_[0];
+    }
+    remove(id);
+    return id;
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::swap(uint32_t i, uint32_t j) {
+    T tmp_key = keys_[i];
+    keys_[i] = keys_[j];
+    keys_[j] = tmp_key;
+    uint32_t tmp_id = ids_[i];
+    ids_[i] = ids_[j];
+    ids_[j] = tmp_id;
+    pos_[ids_[i]] = i;
+    pos_[ids_[j]] = j;
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::reheapifyUp(uint32_t i) {
+    while (i > 0) {
+      uint32_t parent = getParent(i);
+      if (!(keys_[i] < keys_[parent])) {
+        return;
+      }
+      swap(i, parent);
+      i = parent;
+    }
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::reheapifyDown(uint32_t i) {
+    uint32_t size = ids_.size();
+    while (true) {
+      uint32_t smallest = i;
+      uint32_t l = getLChild(i);
+      uint32_t r = getRChild(i);
+      if (l < size && keys_[l] < keys_[smallest]) {
+        smallest = l;
+      }
+      if (r < size && keys_[r] < keys_[smallest]) {
+        smallest = r;
+      }
+      if (smallest == i) {
+        return;
+      }
+      swap(i, smallest);
+      i = smallest;
+    }
+  };
+
+  template <typename T>
+  bool IndexedMinHeap<T>::validate() {
+    for (uint32_t i = 1; i < ids_.size(); i++) {
+      if (keys_[i] < keys_[getParent(i)]) {
+        return false;  // the parent is greater than a child!  not a min heap!
+      }
+    }
+    for (uint32_t i = 0; i < ids_.size(); i++) {
+      if (pos_[ids_[i]] != i) {
+        return false;  // The index is out of date
+      }
+    }
+    return true;
+  };
+
+  template <typename T>
+  void IndexedMinHeap<T>::print() {
+    if (ids_.size() == 0) {
+      printf("IndexedMinHeap[] = []\n");
+      return;
+    }
+    printf("IndexedMinHeap[0:%d] = [", ids_.size()-1);
+    for (uint32_t i = 0; i < ids_.size(); i++) {
+      printf("%d", ids_[i]);
+      if (i != ids_.size() - 1) {
+        printf(", ");
+      }
+    }
+    printf("]\n");
+  };
+
+};  // namespace data_str
+
+#endif  // DATA_STR_INDEXED_MIN_HEAP_HEADER
@@ -10,6 +10,8 @@
 //        If the template class is a complex container (sorry for the Java
 //        lingo), then many copy constructors will be called.
 //
+//  NOTE: The heap storage can come from an ArenaAllocator (see vector.h).
+//
 
 #ifndef DATA_STR_MIN_HEAP_HEADER
 #define DATA_STR_MIN_HEAP_HEADER
@@ -27,8 +29,8 @@ namespace data_str {
   template <typename T>
   class MinHeap {
   public:
-    MinHeap(T* data, uint32_t data_size);
-    MinHeap(uint32_t reserved_size);
+    MinHeap(T* data, uint32_t data_size, ArenaAllocator* arena = NULL);
+    MinHeap(uint32_t reserved_size, ArenaAllocator* arena = NULL);
     ~MinHeap();
 
     T removeMin();
@@ -51,7 +53,8 @@ namespace data_str {
   };
 
   template <typename T>
-  MinHeap<T>::MinHeap(T* data, uint32_t data_size) {
+  MinHeap<T>::MinHeap(T* data, uint32_t data_size, ArenaAllocator* arena) 
+    : pvec_(0, arena) {
     if (data_size == 0) {
       throw std::runtime_error("Heap<T>::Heap() - Error, data size is 0!");
     }
@@ -75,7 +78,8 @@ namespace data_str {
   };
   
   template <typename T>
-  MinHeap<T>::MinHeap(uint32_t reserved_size) {
+  MinHeap<T>::MinHeap(uint32_t reserved_size, ArenaAllocator* arena) 
+    : pvec_(0, arena) {
     if (reserved_size == 0) {
       throw std::runtime_error("Heap<T>::Heap() - Error, reserved size is 0!");
     }
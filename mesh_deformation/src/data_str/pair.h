@@ -35,7 +35,7 @@ namespace data_str {
   };
 
   template <typename TFirst, typename TSecond>
-  Pair& Pair<TFirst, TSecond>::operator= (const Pair<TFirst, TSecond>& a) {
+  Pair<TFirst, TSecond>& Pair<TFirst, TSecond>::operator= (const Pair<TFirst, TSecond>& a) {
     if (this == &a) {  // if both point to the same memory
       return *this; 
     }
@@ -10,6 +10,10 @@
 //        transferred.  That is, the vector is not responsible for handling
 //        cleanup when Vector<type*> is used.
 //
+//  NOTE: If an ArenaAllocator is given, the storage comes from the arena and
+//        is only handed back to it when the vector grows.  clear() and the
+//        destructor just drop the pointer (see arena_allocator.h).
+//
 
 #ifndef DATA_STR_VECTOR_HEADER
 #define DATA_STR_VECTOR_HEADER
@@ -18,6 +22,7 @@
 #include "alignment/data_align.h"
 #include "math/math_types.h"  // for uint
 #include "exceptions/wruntime_error.h"
+#include "data_str/arena_allocator.h"
 
 #ifdef __APPLE__
   #define INLINE inline
@@ -30,7 +35,7 @@ namespace data_str {
   template <typename T>
   class Vector {
   public:
-    explicit Vector(uint32_t capacity = 0);
+    explicit Vector(uint32_t capacity = 0, ArenaAllocator* arena = NULL);
     ~Vector();
 
     void capacity(uint32_t capacity);  // Request manual capacity increase
@@ -51,11 +56,13 @@ namespace data_str {
     uint32_t size_;
     uint32_t capacity_;  // will only grow or shrink by a factor of 2
     T* pvec_;
+    ArenaAllocator* arena_;  // NULL --> heap
   };
 
   template <typename T>
-  Vector<T>::Vector(uint32_t capacity) {  // capacity = 0
+  Vector<T>::Vector(uint32_t capacity, ArenaAllocator* arena) {
     pvec_ = NULL;
+    arena_ = arena;
     capacity_ = 0;
     size_ = 0;
     if (capacity != 0) {
@@ -65,7 +72,7 @@ namespace data_str {
 
   template <typename T>
   Vector<T>::~Vector() {
-    if (pvec_) { 
+    if (pvec_ && !arena_) { 
 #ifdef _WIN32
       _aligned_free(pvec_); 
 #else
@@ -86,11 +93,19 @@ namespace data_str {
       T dummy;
       static_cast<void>(dummy);  // Get rid of unreference local variable warn
       void* temp = NULL;
-      temp = _aligned_malloc(capacity * sizeof(dummy), ALIGNMENT);
+      if (arena_) {
+        temp = arena_->allocate(capacity * sizeof(dummy));
+      } else {
+        temp = _aligned_malloc(capacity * sizeof(dummy), ALIGNMENT);
+      }
 #else
       T dummy;
       void* temp = NULL;
-      temp = malloc(capacity * sizeof(dummy));
+      if (arena_) {
+        temp = arena_->allocate(capacity * sizeof(dummy));
+      } else {
+        temp = malloc(capacity * sizeof(dummy));
+      }
 #endif
 
       if (temp == NULL) { 
@@ -114,11 +129,15 @@ namespace data_str {
           }
         }
 
+        if (arena_) {
+          arena_->release(pvec_old, capacity_ * sizeof(T));
+        } else {
 #ifdef _WIN32
-        _aligned_free(pvec_old); 
+          _aligned_free(pvec_old); 
 #else
-        free(pvec_old); 
+          free(pvec_old); 
 #endif
+        }
         pvec_old = NULL;
       }
 
@@ -134,14 +153,14 @@ namespace data_str {
   template <typename T>
   void Vector<T>::clear() {
     size_ = 0;
-    if (pvec_) { 
+    if (pvec_ && !arena_) { 
 #ifdef _WIN32
       _aligned_free(pvec_); 
 #else
       free(pvec_);
 #endif      
-      pvec_ = NULL; 
     }
+    pvec_ = NULL;
     capacity_ = 0;
   };
 
@@ -6,10 +6,14 @@
 //
 
 #include <iostream>
+#include <string.h>
 #include "file_io/file_io.h"
 #include <stdio.h>
 #include <stdlib.h>
 
+using data_str::Vector;
+using math::Float3;
+
 namespace file_io {
   
 #ifdef __APPLE__
@@ -22,5 +26,79 @@ namespace file_io {
     return std::string("");  // empty string for now
   }
 #endif  
+
+  // Grow the vector if necessary and set it's size (without deallocation)
+  template <class T>
+  static void setSize(Vector<T>* vec, uint32_t size) {
+    if (vec->capacity() < size) {
+      vec->capacity(size);
+    }
+    vec->resize(size);
+  }
+
+  void LoadHandData(const std::string& filename, uint32_t width,
+    uint32_t height, Vector<float>* float_data, Vector<unsigned char>* char_data,
+    Vector<Float3>* vertices, Vector<Float3>* rgb,
+    Vector<unsigned char>* mask) {
+    // ios::ate -> Postion read pointer at end of file (so we can read the size)
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary | 
+                       std::ios::ate);
+    if (!file.is_open()) {
+      throw std::runtime_error(std::string("error opening file:") + filename);
+    }
+
+    uint32_t num_pts = width * height;
+    uint32_t float_data_size = num_pts * 3 * sizeof(float);
+    uint32_t char_data_size = num_pts * 4 * sizeof(unsigned char);
+    uint32_t size_bytes = static_cast<uint32_t>(file.tellg());
+    if (size_bytes < float_data_size + char_data_size) {
+      throw std::runtime_error(std::string("error, file size is too small: ") +
+                               filename);
+    }
+
+    setSize(float_data, num_pts * 3);
+    setSize(char_data, num_pts * 4);  // rgb and mask
+    setSize(vertices, num_pts);
+    setSize(mask, num_pts);
+    if (rgb != NULL) {
+      setSize(rgb, num_pts);
+    }
+
+    file.seekg (0, std::ios::beg);  // Go to the beginning of the file
+    file.read (reinterpret_cast<char*>(float_data->at(0)), float_data_size);
+    file.read (reinterpret_cast<char*>(char_data->at(0)), char_data_size);
+    file.close();
+
+    const float* fdata = float_data->at(0);
+    const unsigned char* cdata = char_data->at(0);
+    memset(mask->at(0), 0, sizeof(unsigned char)*num_pts);
+    Float3 com;  
+    uint32_t com_pts = 0;
+    com.zeros();
+    for (uint32_t i = 0; i < num_pts; i ++) {
+      (*vertices)[i][0] = fdata[i*3];
+      (*vertices)[i][1] = fdata[i*3+1];
+      (*vertices)[i][2] = fdata[i*3+2];
+      if (rgb != NULL) {
+        (*rgb)[i][0] = static_cast<float>(cdata[i*3])/255.0f;
+        (*rgb)[i][1] = static_cast<float>(cdata[i*3+1])/255.0f;
+        (*rgb)[i][2] = static_cast<float>(cdata[i*3+2])/255.0f;
+      }
+      (*mask)[i] = cdata[num_pts*3+i];
+
+      if ((*mask)[i]) {
+        Float3::add(&com, &com, vertices->at(i));
+        com_pts++;
+      }    
+    }
+    Float3::scale(&com, 1.0f / static_cast<float>(com_pts));
+
+    // Now, just for debug purposes, we will subtract off the COM
+    for (uint32_t i = 0; i < num_pts; i ++) {
+      if ((*mask)[i]) {
+        Float3::sub(vertices->at(i), vertices->at(i), &com);
+      }
+    }
+  }
   
 }  // namespace file_io
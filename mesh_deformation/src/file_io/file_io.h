@@ -11,9 +11,22 @@
 #include <iostream>
 #include <fstream>
 #include "math/math_types.h"
+#include "data_str/vector.h"
 
 namespace file_io {
   std::string GetHomePath();
+
+  // LoadHandData - Load a hands_*.bin file (width*height*3 floats of xyz then
+  // width*height*4 bytes of rgb and mask).  The mask center of mass is
+  // subtracted from the masked vertices.  rgb may be NULL.  float_data and
+  // char_data are just temporary read buffers, so that callers can reuse
+  // them between files (and so that this is safe to call from many threads).
+  void LoadHandData(const std::string& filename, uint32_t width,
+    uint32_t height, data_str::Vector<float>* float_data,
+    data_str::Vector<unsigned char>* char_data,
+    data_str::Vector<math::Float3>* vertices,
+    data_str::Vector<math::Float3>* rgb,
+    data_str::Vector<unsigned char>* mask);
   
   template <class T>
   void SaveArrayToFile(const T* arr, uint32_t size, const std::string& filename) {
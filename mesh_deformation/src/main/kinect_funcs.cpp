@@ -20,16 +20,18 @@
 #include "main/kinect_funcs.h"
 #include "file_io/file_io.h"
 #include "mesh_simplification/mesh_simplification.h"
+#include "mesh_simplification/quadric_simplification.h"
 
 using math::Float4x4;
 using mesh_simplification::MeshSimplification;
+using mesh_simplification::QuadricSimplification;
 using std::stringstream;
 using std::string;
 using std::endl;
 
 uint32_t size_kinect_data;
-float* kinect_float_data_raw = NULL;
-unsigned char* kinect_char_data_raw = NULL;
+Vector<float> kinect_float_data_raw;
+Vector<unsigned char> kinect_char_data_raw;
 Vector<Float3> rgb_raw;  // This is the original kinect data
 Vector<Float3> rgb;  // data after simplification
 Vector<unsigned char> pts_mask;
@@ -39,6 +41,8 @@ Vector<uint32_t> hand_mesh_indices;
 Vector<Float3> hand_mesh_normals;
 uint32_t edge_reduction = 0;
 MeshSimplification* hand_mesh_simplifier;
+QuadricSimplification* hand_quadric_simplifier;
+bool use_quadric_simplification = false;
 ContourSimplification* hand_contour_simplifier;
 uint32_t target_contour_size = 600;
 uint32_t target_contour_size_to_file = 200;
@@ -98,74 +102,9 @@ void processHandData() {
 }
 
 void initKinectData(std::string filename) {
-
-  // ios::ate -> Postion read pointer at end of file (so we can read the size)
-  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
-  if (!file.is_open()) {
-    throw std::runtime_error(std::string("error opening file:") + 
-                             filename);
-  }
-  
   size_kinect_data = width * height;
-  
-  if (kinect_float_data_raw == NULL) {
-    kinect_float_data_raw = new float[width*height*3];
-  }
-  if (kinect_char_data_raw == NULL) {
-    kinect_char_data_raw = new unsigned char[width*height*4]; // rgb and mask
-  }
-  
-  if (hand_mesh_vertices_raw.capacity() < size_kinect_data) {
-    hand_mesh_vertices_raw.capacity(size_kinect_data);
-  }
-  hand_mesh_vertices_raw.resize(size_kinect_data);
-  if (rgb_raw.capacity() < size_kinect_data) {
-    rgb_raw.capacity(size_kinect_data);
-  }
-  rgb_raw.resize(size_kinect_data);
-  if (pts_mask.capacity() < size_kinect_data) {
-    pts_mask.capacity(size_kinect_data);
-  }
-  pts_mask.resize(size_kinect_data);  
-  
-  uint32_t size_bytes = static_cast<uint32_t>(file.tellg());
-  if (size_bytes < kinect_data_raw_size) {
-    throw std::runtime_error("error, file size is too small");
-  }
-  file.seekg (0, std::ios::beg);  // Go to the beginning of the file
-  
-  file.read (reinterpret_cast<char*>(kinect_float_data_raw), 
-             width*height*3*sizeof(kinect_float_data_raw[0]));
-  file.read (reinterpret_cast<char*>(kinect_char_data_raw), 
-             width*height*4*sizeof(kinect_char_data_raw[0]));  
-  file.close();
-  
-  memset(pts_mask.at(0), 0, sizeof(unsigned char)*size_kinect_data);
-  Float3 com;  
-  uint32_t com_pts = 0;
-  com.zeros();
-  for (uint32_t i = 0; i < size_kinect_data; i ++) {
-    hand_mesh_vertices_raw[i][0] = kinect_float_data_raw[i*3];
-    hand_mesh_vertices_raw[i][1] = kinect_float_data_raw[i*3+1];
-    hand_mesh_vertices_raw[i][2] = kinect_float_data_raw[i*3+2];
-    rgb_raw[i][0] = static_cast<float>(kinect_char_data_raw[i*3])/255.0f;
-    rgb_raw[i][1] = static_cast<float>(kinect_char_data_raw[i*3+1])/255.0f;
-    rgb_raw[i][2] = static_cast<float>(kinect_char_data_raw[i*3+2])/255.0f;
-    pts_mask[i] = kinect_char_data_raw[width*height*3+i];
-    
-    if (pts_mask[i]) {
-      Float3::add(&com, &com, &hand_mesh_vertices_raw[i]);
-      com_pts++;
-    }    
-  }
-  Float3::scale(&com, 1.0f / static_cast<float>(com_pts));
-  
-  // Now, just for debug purposes, we will subtract off the COM
-  for (uint32_t i = 0; i < size_kinect_data; i ++) {
-    if (pts_mask[i]) {
-      Float3::sub(&hand_mesh_vertices_raw[i], &hand_mesh_vertices_raw[i], &com);
-    }
-  }
+  file_io::LoadHandData(filename, width, height, &kinect_float_data_raw,
+    &kinect_char_data_raw, &hand_mesh_vertices_raw, &rgb_raw, &pts_mask);
 
   hand_mesh_vertices = hand_mesh_vertices_raw;
   rgb = rgb_raw;
@@ -451,7 +390,7 @@ void drawKinectData() {
       glEnd();
       glEnable(GL_LIGHTING);
     } else {
-      if (!draw_winged_edge) {
+      if (!draw_winged_edge || use_quadric_simplification) {
         drawVertexIndexNormalArr(&hand_mesh_vertices, 
                                  &hand_mesh_indices, 
                                  &hand_mesh_normals, 
@@ -602,7 +541,14 @@ void updateKinectData() {
     exit(-1);
   }
   
-  if (edge_reduction != 0) {
+  if (edge_reduction != 0 && use_quadric_simplification) {
+    // Each edge collapse removes 2 faces (1 on the contour)
+    uint32_t num_faces = hand_mesh_indices.size() / 3;
+    uint32_t target_num_faces = num_faces > 2 * edge_reduction ? 
+      num_faces - 2 * edge_reduction : 0;
+    hand_quadric_simplifier->simplifyMesh(target_num_faces, 
+      &hand_mesh_vertices, &hand_mesh_indices, &hand_mesh_normals, &rgb);
+  } else if (edge_reduction != 0) {
     hand_mesh_simplifier->simplifyMesh(edge_reduction, &hand_mesh_vertices,
       &hand_mesh_indices, &hand_mesh_normals, &rgb);
   } else {
@@ -11,6 +11,7 @@
 #include "data_str/vector.h"
 #include "math/math_types.h"
 #include "mesh_simplification/mesh_simplification.h"
+#include "mesh_simplification/quadric_simplification.h"
 #include "contour_simplification/contour_simplification.h"
 
 #if defined(DEBUG) || defined(_DEBUG)
@@ -24,6 +25,7 @@ using math::Float3;
 using math::Float4;
 using mesh_simplification::Edge;
 using mesh_simplification::MeshSimplification;
+using mesh_simplification::QuadricSimplification;
 using contour_simplification::Contour;
 using contour_simplification::ContourSimplification;
 
@@ -52,8 +54,8 @@ const uint32_t kinect_data_raw_size = (width*height*3*sizeof(float) +
                                        width*height*4*sizeof(char));
 extern const Float4 edge_cols[8];
 extern uint32_t size_kinect_data;
-extern float* kinect_float_data_raw;
-extern unsigned char* kinect_char_data_raw;
+extern Vector<float> kinect_float_data_raw;
+extern Vector<unsigned char> kinect_char_data_raw;
 extern Vector<Float3> rgb_raw;  // This is the original kinect data
 extern Vector<Float3> rgb;  // data after simplification
 extern Vector<unsigned char> pts_mask;
@@ -63,11 +65,14 @@ extern Vector<uint32_t> hand_mesh_indices;
 extern Vector<Float3> hand_mesh_normals;
 extern uint32_t edge_reduction;
 extern uint32_t target_contour_size;
+extern uint32_t target_contour_size_to_file;
 extern bool draw_point_cloud;
 extern bool draw_wireframes;
 extern bool draw_winged_edge;
 extern bool draw_hand;
 extern MeshSimplification* hand_mesh_simplifier;
+extern QuadricSimplification* hand_quadric_simplifier;
+extern bool use_quadric_simplification;
 extern ContourSimplification* hand_contour_simplifier;
 extern bool draw_contour;
 void RenderStrokeFontString(int x, int y, void *font,
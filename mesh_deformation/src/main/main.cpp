@@ -31,6 +31,8 @@
 #include "mesh_simplification/test_plane.h"
 #include "string_util/string_util.h"
 #include "main/kinect_funcs.h"
+#include "contour_simplification/contour_batch.h"
+#include "mesh_simplification/simplification_benchmark.h"
 
 using namespace std;
 using renderer::Camera;
@@ -43,6 +45,8 @@ using data_str::Vector;
 using mesh_simplification::MeshSimplification;
 using mesh_simplification::Edge;
 using mesh_simplification::TestPlane;
+using contour_simplification::ContourBatch;
+using mesh_simplification::SimplificationBenchmark;
 
 Clock* clk = NULL;
 
@@ -566,6 +570,12 @@ void keyboard(unsigned char key, int x, int y) {
     case 'v':
       processHandData();
       break;
+    case 'g':
+    case 'G':
+      use_quadric_simplification = !use_quadric_simplification;
+      printf("use_quadric_simplification = %d\n", 
+        use_quadric_simplification ? 1 : 0);
+      break;
   }
 }
 
@@ -589,6 +599,7 @@ int main(int argc, char *argv[])
   usage_text.pushBack("n - draw contour");
   usage_text.pushBack("h - draw hand mesh");
   usage_text.pushBack("v - process hand data (in ~/Desktop/hand_mesh/*)");
+  usage_text.pushBack("g - quadric (vs winged edge) hand mesh simplification");
   usage_text.pushBack("-+ - adjust number of hand edges (coarse)");
   usage_text.pushBack("[] - adjust number of hand edges (fine)");
   usage_text.pushBack(";' - adjust number of plane edges (coarse)");
@@ -598,6 +609,28 @@ int main(int argc, char *argv[])
   try {
     clk = new Clock();
     t1 = clk->getTime();
+
+    // Headless batch mode:
+    // --contours <data_dir/> <output_file> [num_threads]
+    if (argc >= 4 && string(argv[1]) == string("--contours")) {
+      uint32_t num_threads = argc >= 5 ? atoi(argv[4]) : 0;
+      ContourBatch batch(num_threads);
+      uint32_t num_ok = batch.processDirectory(string(argv[2]), 
+        string(argv[3]), target_contour_size_to_file, width, height);
+      cout << "Processed " << num_ok << " files in " << clk->getTime() - t1;
+      cout << " seconds" << endl;
+      return 0;
+    }
+
+    // --mesh_bench [num_frames] [edge_reduction]
+    if (argc >= 2 && string(argv[1]) == string("--mesh_bench")) {
+      uint32_t num_frames = argc >= 3 ? atoi(argv[2]) : 30;
+      uint32_t edge_reduction = argc >= 4 ? atoi(argv[3]) : 50000;
+      SimplificationBenchmark bench(mesh_settings);
+      bench.run(num_frames, edge_reduction);
+      return 0;
+    }
+
 #ifdef _WIN32
     std::string full_filename = std::string("./") + lHand_filename;
 #endif
@@ -625,6 +658,7 @@ int main(int argc, char *argv[])
 
     plane_mesh_simplifier = new MeshSimplification(mesh_settings);
     hand_mesh_simplifier = new MeshSimplification(mesh_settings);
+    hand_quadric_simplifier = new QuadricSimplification(mesh_settings);
     hand_contour_simplifier = new ContourSimplification();
     
     glutInit(&argc, argv);
@@ -0,0 +1,388 @@
+//
+//  half_edge_mesh.cpp
+//
+
+#include <iostream>
+#include <string>
+#include "mesh_simplification/half_edge_mesh.h"
+#include "exceptions/wruntime_error.h"
+
+using data_str::Vector;
+using std::wruntime_error;
+using std::wstring;
+
+namespace mesh_simplification {
+
+  HalfEdgeMesh::HalfEdgeMesh() {
+    num_faces_ = 0;
+    cur_mark_ = 0;
+  }
+
+  HalfEdgeMesh::~HalfEdgeMesh() {
+
+  }
+
+  // Grow the vector if necessary and set it's size (without deallocation)
+  template <typename T>
+  static void setSize(Vector<T>* vec, uint32_t size) {
+    if (vec->capacity() < size) {
+      vec->capacity(size);
+    }
+    vec->resize(size);
+  }
+
+  void HalfEdgeMesh::build(uint32_t num_vertices, Vector<uint32_t>* indices) {
+    if (indices->size() % 3 != 0) {
+      throw wruntime_error(wstring(L"HalfEdgeMesh::build() - ERROR: ") +
+        wstring(L"sizeof(indices) must be a multiple of 3"));
+    }
+    uint32_t num_he = indices->size();
+    setSize(&he_origin_, num_he);
+    setSize(&he_twin_, num_he);
+    setSize(&face_removed_, num_he / 3);
+    setSize(&vert_he_, num_vertices);
+    setSize(&vert_locked_, num_vertices);
+    setSize(&vert_mark_, num_vertices);
+    setSize(&vert_start_, num_vertices + 1);
+
+    for (uint32_t h = 0; h < num_he; h++) {
+      if ((*indices)[h] >= num_vertices) {
+        throw wruntime_error(wstring(L"HalfEdgeMesh::build() - ERROR: ") +
+          wstring(L"index is out of range"));
+      }
+      he_origin_[h] = (*indices)[h];
+      he_twin_[h] = HE_NONE;
+    }
+    num_faces_ = 0;
+    for (uint32_t f = 0; f < num_he / 3; f++) {
+      uint32_t v0 = he_origin_[f * 3];
+      uint32_t v1 = he_origin_[f * 3 + 1];
+      uint32_t v2 = he_origin_[f * 3 + 2];
+      // Drop degenerate input faces
+      face_removed_[f] = (v0 == v1 || v1 == v2 || v2 == v0) ? 1 : 0;
+      num_faces_ += 1 - face_removed_[f];
+    }
+    for (uint32_t v = 0; v < num_vertices; v++) {
+      vert_he_[v] = HE_NONE;
+      vert_locked_[v] = 0;
+      vert_mark_[v] = 0;
+    }
+    cur_mark_ = 0;
+
+    // Bucket the half-edges by their origin vertex (counting sort)
+    for (uint32_t v = 0; v <= num_vertices; v++) {
+      vert_start_[v] = 0;
+    }
+    for (uint32_t h = 0; h < num_he; h++) {
+      if (!faceRemoved(face(h))) {
+        vert_start_[he_origin_[h] + 1]++;
+      }
+    }
+    for (uint32_t v = 0; v < num_vertices; v++) {
+      vert_start_[v + 1] += vert_start_[v];
+    }
+    setSize(&vert_hes_, vert_start_[num_vertices]);
+    for (uint32_t h = 0; h < num_he; h++) {
+      if (!faceRemoved(face(h))) {
+        vert_hes_[vert_start_[he_origin_[h]]++] = h;
+      }
+    }
+    for (uint32_t v = num_vertices; v > 0; v--) {  // Undo the start offsets
+      vert_start_[v] = vert_start_[v - 1];
+    }
+    vert_start_[0] = 0;
+
+    linkTwins();
+    findVertexHalfEdges();
+  }
+
+  void HalfEdgeMesh::linkTwins() {
+    for (uint32_t h = 0; h < he_origin_.size(); h++) {
+      if (faceRemoved(face(h)) || he_twin_[h] != HE_NONE) {
+        continue;
+      }
+      uint32_t a = origin(h);
+      uint32_t b = dest(h);
+      // Half-edges b -> a
+      uint32_t num_twins = 0;
+      uint32_t twin_he = HE_NONE;
+      for (uint32_t i = vert_start_[b]; i < vert_start_[b + 1]; i++) {
+        if (dest(vert_hes_[i]) == a) {
+          num_twins++;
+          twin_he = vert_hes_[i];
+        }
+      }
+      // Other half-edges a -> b (inconsistent winding or non-manifold)
+      uint32_t num_same = 0;
+      for (uint32_t i = vert_start_[a]; i < vert_start_[a + 1]; i++) {
+        if (vert_hes_[i] != h && dest(vert_hes_[i]) == b) {
+          num_same++;
+        }
+      }
+      if (num_twins == 1 && num_same == 0 && he_twin_[twin_he] == HE_NONE) {
+        he_twin_[h] = twin_he;
+        he_twin_[twin_he] = h;
+      }
+    }
+  }
+
+  void HalfEdgeMesh::findVertexHalfEdges() {
+    for (uint32_t v = 0; v < vert_he_.size(); v++) {
+      uint32_t num_he = vert_start_[v + 1] - vert_start_[v];
+      if (num_he == 0) {
+        continue;  // Not used by any face
+      }
+      vert_he_[v] = vert_hes_[vert_start_[v]];
+      // If the faces around v are not a single fan, then v is non-manifold
+      outgoing(v, &ring_);
+      if (ring_.size() != num_he) {
+        vert_locked_[v] = 1;
+      }
+    }
+  }
+
+  bool HalfEdgeMesh::outgoing(uint32_t v, Vector<uint32_t>* ring) {
+    ring->resize(0);
+    uint32_t h0 = vert_he_[v];
+    if (h0 == HE_NONE) {
+      return false;
+    }
+    // Walk back to the boundary edge leaving v (if there is one)
+    uint32_t h = h0;
+    uint32_t count = 0;
+    while (he_twin_[h] != HE_NONE && count < he_origin_.size()) {
+      h = next(he_twin_[h]);
+      count++;
+      if (h == h0) {
+        break;
+      }
+    }
+    uint32_t start = h;
+    // Now walk the fan
+    do {
+      ring->pushBack(h);
+      uint32_t t = he_twin_[prev(h)];
+      if (t == HE_NONE) {
+        break;
+      }
+      h = t;
+    } while (h != start && ring->size() < he_origin_.size());
+    return he_twin_[start] == HE_NONE;
+  }
+
+  void HalfEdgeMesh::markNeighbours(Vector<uint32_t>* ring) {
+    cur_mark_++;
+    for (uint32_t i = 0; i < ring->size(); i++) {
+      vert_mark_[dest((*ring)[i])] = cur_mark_;
+    }
+    if (ring->size() > 0) {
+      vert_mark_[origin(prev((*ring)[ring->size() - 1]))] = cur_mark_;
+    }
+  }
+
+  uint32_t HalfEdgeMesh::numMarkedNeighbours(Vector<uint32_t>* ring) {
+    uint32_t num_marked = 0;
+    for (uint32_t i = 0; i < ring->size(); i++) {
+      if (vert_mark_[dest((*ring)[i])] == cur_mark_) {
+        num_marked++;
+      }
+    }
+    if (ring->size() > 0) {
+      uint32_t last = origin(prev((*ring)[ring->size() - 1]));
+      // For a closed fan the last neighbour is also the first
+      if (last != dest((*ring)[0]) && vert_mark_[last] == cur_mark_) {
+        num_marked++;
+      }
+    }
+    return num_marked;
+  }
+
+  bool HalfEdgeMesh::canCollapse(uint32_t h) {
+    if (faceRemoved(face(h))) {
+      return false;
+    }
+    uint32_t a = origin(h);
+    uint32_t b = dest(h);
+    if (vertexLocked(a) || vertexLocked(b)) {
+      return false;
+    }
+    uint32_t t = he_twin_[h];
+    // Collapsing a triangle that hangs off the mesh by one edge would leave
+    // the opposite vertex without any faces
+    if (he_twin_[next(h)] == HE_NONE && he_twin_[prev(h)] == HE_NONE) {
+      return false;
+    }
+    if (t != HE_NONE && he_twin_[next(t)] == HE_NONE &&
+      he_twin_[prev(t)] == HE_NONE) {
+      return false;
+    }
+
+    // The link condition: the only vertices connected to both a and b must
+    // be the vertices opposite the edge, otherwise the collapse will create
+    // duplicate edges (and non-manifold geometry).
+    bool a_boundary = outgoing(a, &ring_);
+    markNeighbours(&ring_);
+    bool b_boundary = outgoing(b, &ring_);
+    uint32_t num_common = numMarkedNeighbours(&ring_);
+    if (num_common != (t != HE_NONE ? 2u : 1u)) {
+      return false;
+    }
+    // Collapsing an interior edge between two boundary vertices pinches the
+    // mesh into two fans that share a vertex
+    if (t != HE_NONE && a_boundary && b_boundary) {
+      return false;
+    }
+
+    // Interior vertices opposite the edge with only 3 neighbours would end up
+    // with two faces that share all 3 vertices
+    uint32_t opposite[2];
+    opposite[0] = origin(prev(h));
+    opposite[1] = t != HE_NONE ? origin(prev(t)) : HE_NONE;
+    for (uint32_t i = 0; i < 2; i++) {
+      if (opposite[i] != HE_NONE) {
+        bool boundary = outgoing(opposite[i], &ring_);
+        if (!boundary && ring_.size() <= 3) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void HalfEdgeMesh::setTwin(uint32_t h0, uint32_t h1) {
+    if (h0 != HE_NONE) {
+      he_twin_[h0] = h1;
+    }
+    if (h1 != HE_NONE) {
+      he_twin_[h1] = h0;
+    }
+  }
+
+  uint32_t HalfEdgeMesh::firstLiveHalfEdge(const uint32_t* candidates,
+    uint32_t num) {
+    for (uint32_t i = 0; i < num; i++) {
+      if (candidates[i] != HE_NONE && !faceRemoved(face(candidates[i]))) {
+        return candidates[i];
+      }
+    }
+    return HE_NONE;
+  }
+
+  uint32_t HalfEdgeMesh::collapse(uint32_t h) {
+    uint32_t a = origin(h);
+    uint32_t b = dest(h);
+    uint32_t t = he_twin_[h];
+    outgoing(b, &ring_);  // Before we change anything
+
+    // Remove the face on the forward side and stitch the outer edges together
+    uint32_t hn = next(h);  // b -> c
+    uint32_t hp = prev(h);  // c -> a
+    uint32_t c = origin(hp);
+    uint32_t t1 = he_twin_[hn];  // c -> b
+    uint32_t t2 = he_twin_[hp];  // a -> c
+    setTwin(t1, t2);
+    face_removed_[face(h)] = 1;
+    num_faces_--;
+
+    // Same for the face on the backward side
+    uint32_t d = HE_NONE;
+    uint32_t t3 = HE_NONE;
+    uint32_t t4 = HE_NONE;
+    if (t != HE_NONE) {
+      uint32_t gn = next(t);  // a -> d
+      uint32_t gp = prev(t);  // d -> b
+      d = origin(gp);
+      t3 = he_twin_[gn];  // d -> a
+      t4 = he_twin_[gp];  // b -> d
+      setTwin(t3, t4);
+      face_removed_[face(t)] = 1;
+      num_faces_--;
+    }
+
+    // Everything that left b now leaves a
+    for (uint32_t i = 0; i < ring_.size(); i++) {
+      if (!faceRemoved(face(ring_[i]))) {
+        he_origin_[ring_[i]] = a;
+      }
+    }
+    vert_he_[b] = HE_NONE;
+
+    // Make sure a, c and d point to half-edges that still exist
+    uint32_t cand[5];
+    cand[0] = vert_he_[a];
+    cand[1] = t2;
+    cand[2] = t4;
+    cand[3] = t1 != HE_NONE ? next(t1) : HE_NONE;
+    cand[4] = t3 != HE_NONE ? next(t3) : HE_NONE;
+    vert_he_[a] = firstLiveHalfEdge(cand, 5);
+    if (vert_he_[a] == HE_NONE) {
+      vert_he_[a] = firstLiveHalfEdge(ring_.at(0), ring_.size());
+    }
+    cand[0] = vert_he_[c];
+    cand[1] = t1;
+    cand[2] = t2 != HE_NONE ? next(t2) : HE_NONE;
+    vert_he_[c] = firstLiveHalfEdge(cand, 3);
+    if (d != HE_NONE) {
+      cand[0] = vert_he_[d];
+      cand[1] = t3;
+      cand[2] = t4 != HE_NONE ? next(t4) : HE_NONE;
+      vert_he_[d] = firstLiveHalfEdge(cand, 3);
+    }
+    return b;
+  }
+
+  void HalfEdgeMesh::toFaces(Vector<uint32_t>* indices) {
+    if (indices->capacity() < num_faces_ * 3) {
+      indices->capacity(num_faces_ * 3);
+    }
+    indices->resize(0);
+    for (uint32_t f = 0; f < face_removed_.size(); f++) {
+      if (!faceRemoved(f)) {
+        indices->pushBack(he_origin_[f * 3]);
+        indices->pushBack(he_origin_[f * 3 + 1]);
+        indices->pushBack(he_origin_[f * 3 + 2]);
+      }
+    }
+  }
+
+  bool HalfEdgeMesh::validate() {
+    uint32_t num_faces = 0;
+    for (uint32_t h = 0; h < he_origin_.size(); h++) {
+      if (faceRemoved(face(h))) {
+        continue;
+      }
+      if (h % 3 == 0) {
+        num_faces++;
+      }
+      if (origin(h) == dest(h)) {
+        std::cout << "Degenerate face " << face(h) << std::endl;
+        return false;
+      }
+      if (vertexRemoved(origin(h))) {
+        std::cout << "Face " << face(h) << " uses a removed vertex" << std::endl;
+        return false;
+      }
+      uint32_t t = he_twin_[h];
+      if (t != HE_NONE) {
+        if (faceRemoved(face(t)) || he_twin_[t] != h || origin(t) != dest(h) ||
+          dest(t) != origin(h)) {
+          std::cout << "Half-edge " << h << " has a bad twin" << std::endl;
+          return false;
+        }
+      }
+    }
+    if (num_faces != num_faces_) {
+      std::cout << "The face count is wrong" << std::endl;
+      return false;
+    }
+    for (uint32_t v = 0; v < vert_he_.size(); v++) {
+      uint32_t h = vert_he_[v];
+      if (h != HE_NONE && (faceRemoved(face(h)) || origin(h) != v)) {
+        std::cout << "Vertex " << v << " has a bad half-edge" << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+};  // namespace mesh_simplification
@@ -0,0 +1,100 @@
+//
+//  half_edge_mesh.h
+//
+//  A flat, index based half-edge mesh for triangle meshes.  There are no
+//  pointers: half-edge h belongs to face h / 3 and the next and previous
+//  half-edges of a face are found with arithmetic, so the only per half-edge
+//  data is the origin vertex and the twin index.
+//
+//  Edges that are shared by more than two faces (or two faces with
+//  inconsistent winding) are treated as boundary edges.  Vertices whose faces
+//  do not form a single fan (two fans touching at a vertex) are marked as
+//  locked and are never collapsed.
+//
+//  Faces and vertices are never erased, only marked as removed, so that the
+//  vertex indices stay valid for the caller's vertex array.
+//
+
+#ifndef MESH_SIMPLIFICATION_HALF_EDGE_MESH_HEADER
+#define MESH_SIMPLIFICATION_HALF_EDGE_MESH_HEADER
+
+#include "math/math_types.h"
+#include "data_str/vector.h"
+
+#define HE_NONE MAX_UINT32
+
+namespace mesh_simplification {
+
+  class HalfEdgeMesh {
+  public:
+    HalfEdgeMesh();
+    ~HalfEdgeMesh();
+
+    // build - indices are triangles (anticlockwise) into num_vertices verts
+    void build(uint32_t num_vertices, data_str::Vector<uint32_t>* indices);
+    // toFaces - write the remaining faces
+    void toFaces(data_str::Vector<uint32_t>* indices);
+
+    static inline uint32_t face(uint32_t h) { return h / 3; }
+    static inline uint32_t next(uint32_t h) { return h % 3 == 2 ? h - 2 : h + 1; }
+    static inline uint32_t prev(uint32_t h) { return h % 3 == 0 ? h + 2 : h - 1; }
+    inline uint32_t origin(uint32_t h) { return he_origin_[h]; }
+    inline uint32_t dest(uint32_t h) { return he_origin_[next(h)]; }
+    inline uint32_t twin(uint32_t h) { return he_twin_[h]; }  // or HE_NONE
+    // edgeId - The same id for both half-edges of an edge
+    inline uint32_t edgeId(uint32_t h) {
+      uint32_t t = he_twin_[h];
+      return (t != HE_NONE && t < h) ? t : h;
+    }
+
+    inline bool faceRemoved(uint32_t f) { return face_removed_[f] != 0; }
+    inline bool vertexRemoved(uint32_t v) { return vert_he_[v] == HE_NONE; }
+    inline bool vertexLocked(uint32_t v) { return vert_locked_[v] != 0; }
+    inline uint32_t num_faces() { return num_faces_; }
+    inline uint32_t num_half_edges() { return he_origin_.size(); }
+    inline uint32_t num_vertices() { return vert_he_.size(); }
+
+    // outgoing - All half-edges leaving v, in clockwise order.  If v is on
+    // the boundary the boundary edge leaving v is first and the function
+    // returns true.
+    bool outgoing(uint32_t v, data_str::Vector<uint32_t>* ring);
+
+    // canCollapse - Checks that collapsing the edge (removing dest(h) and
+    // keeping origin(h)) keeps the mesh manifold and creates no duplicate
+    // edges or degenerate triangles.
+    bool canCollapse(uint32_t h);
+    // collapse - Returns the vertex that was removed
+    uint32_t collapse(uint32_t h);
+
+    bool validate();  // For testing purposes (do not delete)
+
+  private:
+    data_str::Vector<uint32_t> he_origin_;
+    data_str::Vector<uint32_t> he_twin_;
+    data_str::Vector<uint8_t> face_removed_;
+    data_str::Vector<uint32_t> vert_he_;  // One outgoing half-edge per vertex
+    data_str::Vector<uint8_t> vert_locked_;
+    uint32_t num_faces_;
+
+    // Temporary data
+    data_str::Vector<uint32_t> vert_start_;  // CSR list of half-edges / vert
+    data_str::Vector<uint32_t> vert_hes_;
+    data_str::Vector<uint32_t> vert_mark_;
+    uint32_t cur_mark_;
+    data_str::Vector<uint32_t> ring_;
+
+    void linkTwins();
+    void findVertexHalfEdges();
+    // ring is the output of outgoing() for the vertex
+    void markNeighbours(data_str::Vector<uint32_t>* ring);
+    uint32_t numMarkedNeighbours(data_str::Vector<uint32_t>* ring);
+    inline void setTwin(uint32_t h0, uint32_t h1);
+    uint32_t firstLiveHalfEdge(const uint32_t* candidates, uint32_t num);
+
+    // Non-copyable, non-assignable.
+    HalfEdgeMesh(HalfEdgeMesh&);
+    HalfEdgeMesh& operator=(const HalfEdgeMesh&);
+  };
+};  // namespace mesh_simplification
+
+#endif  // MESH_SIMPLIFICATION_HALF_EDGE_MESH_HEADER
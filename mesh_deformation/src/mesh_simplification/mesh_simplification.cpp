@@ -583,8 +583,10 @@ namespace mesh_simplification {
       we->at(i)->calcCost(vertices, settings_.edge_cost_func);
     }
     
-    // Create a min-heap of edges:
-    MinHeapEdges heap(we);
+    // Create a min-heap of edges (the previous call's heap is long gone, so
+    // its arena memory can be reused without going back to malloc):
+    arena_.reset();
+    MinHeapEdges heap(we, &arena_);
 
     for (uint32_t i = 0; i < edge_reduction && heap.size() > 3; i++) {
       Edge* min_edge = heap.removeMin();
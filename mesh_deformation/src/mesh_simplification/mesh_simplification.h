@@ -170,6 +170,7 @@ namespace mesh_simplification {
     data_str::Vector<Edge> we_;
     data_str::Vector<Edge*> vertex_edges_;
     data_str::Vector<math::Float3> vertex_reference_vectors_;
+    data_str::ArenaAllocator arena_;  // Per call storage (the edge heap)
     math::Float3 tmp1_;
     math::Float3 tmp2_;
     MeshSettings settings_;
@@ -24,7 +24,8 @@
 
 namespace mesh_simplification {
 
-  MinHeapEdges::MinHeapEdges(data_str::Vector<Edge>* we) {
+  MinHeapEdges::MinHeapEdges(data_str::Vector<Edge>* we, 
+    data_str::ArenaAllocator* arena) : pvec_(0, arena) {
     if (we->size() == 0) {
       throw std::wruntime_error("MinHeapEdges::MinHeapEdges() - Error, data size is 0!");
     }
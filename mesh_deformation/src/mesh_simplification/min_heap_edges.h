@@ -9,6 +9,8 @@
 //  NOTE: The heap can be built in O(n) time.  this is a modified version of the
 //        regular data_str::MinHeap to use pointers to edges for speed.
 //
+//  NOTE: The heap storage can come from an ArenaAllocator (see vector.h).
+//
 
 #ifndef MESH_SIMPLIFICATION_MIN_HEAP_EDGES_HEADER
 #define MESH_SIMPLIFICATION_MIN_HEAP_EDGES_HEADER
@@ -28,7 +30,8 @@ namespace mesh_simplification {
   
   class MinHeapEdges {
   public:
-    MinHeapEdges(data_str::Vector<Edge>* we);
+    MinHeapEdges(data_str::Vector<Edge>* we, 
+      data_str::ArenaAllocator* arena = NULL);
     ~MinHeapEdges();
 
     Edge* removeMin();
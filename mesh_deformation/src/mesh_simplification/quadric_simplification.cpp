@@ -0,0 +1,457 @@
+//
+//  quadric_simplification.cpp
+//
+
+#include <iostream>
+#include <string>
+#include <limits>
+#include "mesh_simplification/quadric_simplification.h"
+#include "exceptions/wruntime_error.h"
+
+using data_str::Vector;
+using math::Float3;
+using std::wruntime_error;
+using std::wstring;
+
+// Below this many elements the threads cost more than they save
+#define QUADRIC_MIN_PARALLEL_SIZE 4096
+
+namespace mesh_simplification {
+
+  void Quadric::zeros() {
+    a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = 0;
+  }
+
+  void Quadric::setPlane(double a, double b, double c, double d,
+    double weight) {
+    a2 = weight * a * a; ab = weight * a * b; ac = weight * a * c;
+    ad = weight * a * d; b2 = weight * b * b; bc = weight * b * c;
+    bd = weight * b * d; c2 = weight * c * c; cd = weight * c * d;
+    d2 = weight * d * d;
+  }
+
+  void Quadric::add(const Quadric& other) {
+    a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+    b2 += other.b2; bc += other.bc; bd += other.bd; c2 += other.c2;
+    cd += other.cd; d2 += other.d2;
+  }
+
+  void Quadric::add(const Quadric& q0, const Quadric& q1) {
+    *this = q0;
+    add(q1);
+  }
+
+  // v^t Q v for v = [pos, 1]
+  double Quadric::error(const double* pos) const {
+    const double x = pos[0];
+    const double y = pos[1];
+    const double z = pos[2];
+    return x * (a2 * x + 2 * (ab * y + ac * z + ad)) +
+      y * (b2 * y + 2 * (bc * z + bd)) + z * (c2 * z + 2 * cd) + d2;
+  }
+
+  // Solve A * pos = -b where A is the upper 3x3 block of Q (Cramer's rule)
+  bool Quadric::optimalPosition(double* pos) const {
+    const double det = a2 * (b2 * c2 - bc * bc) - ab * (ab * c2 - bc * ac) +
+      ac * (ab * bc - b2 * ac);
+    const double scale = a2 + b2 + c2;
+    if (fabs(det) <= 1e-9 * scale * scale * scale) {
+      return false;
+    }
+    const double inv_det = 1.0 / det;
+    pos[0] = -inv_det * (ad * (b2 * c2 - bc * bc) - bd * (ab * c2 - ac * bc) +
+      cd * (ab * bc - ac * b2));
+    pos[1] = -inv_det * (a2 * (bd * c2 - cd * bc) - ab * (ad * c2 - cd * ac) +
+      ac * (ad * bc - bd * ac));
+    pos[2] = -inv_det * (a2 * (b2 * cd - bc * bd) - ab * (ab * cd - bc * ad) +
+      ac * (ab * bd - b2 * ad));
+    return true;
+  }
+
+  // Grow the vector if necessary and set it's size (without deallocation)
+  template <typename T>
+  static void setSize(Vector<T>* vec, uint32_t size) {
+    if (vec->capacity() < size) {
+      vec->capacity(size);
+    }
+    vec->resize(size);
+  }
+
+  QuadricSimplification::QuadricSimplification(const MeshSettings& settings) :
+    normal_calc_(settings) {
+    settings_ = settings;
+    num_collapses_ = 0;
+    job_id_ = 0;
+    job_num_workers_done_ = 0;
+    workers_stop_ = false;
+    job_func_ = NULL;
+    job_num_ = 0;
+    job_vertices_ = NULL;
+    for (uint32_t i = 0; i < QUADRIC_NUM_THREADS - 1; i++) {
+      workers_[i] = new std::thread(&QuadricSimplification::workerThread, this,
+        i);
+    }
+  }
+
+  QuadricSimplification::~QuadricSimplification() {
+    std::unique_lock<std::mutex> ul(job_lock_);
+    workers_stop_ = true;
+    job_started_.notify_all();
+    ul.unlock();
+    for (uint32_t i = 0; i < QUADRIC_NUM_THREADS - 1; i++) {
+      workers_[i]->join();
+      delete workers_[i];
+    }
+  }
+
+  uint32_t QuadricSimplification::rangeStart(uint32_t num, uint32_t range) {
+    return (uint32_t)(((uint64_t)num * range) / QUADRIC_NUM_THREADS);
+  }
+
+  void QuadricSimplification::parallelRange(RangeFunc func, uint32_t num,
+    Vector<Float3>* vertices) {
+    if (num < QUADRIC_MIN_PARALLEL_SIZE || QUADRIC_NUM_THREADS <= 1) {
+      (this->*func)(0, num, vertices);
+      return;
+    }
+    std::unique_lock<std::mutex> ul(job_lock_);
+    job_func_ = func;
+    job_num_ = num;
+    job_vertices_ = vertices;
+    job_num_workers_done_ = 0;
+    job_id_++;
+    job_started_.notify_all();
+    ul.unlock();
+
+    // The calling thread does the first range
+    (this->*func)(0, rangeStart(num, 1), vertices);
+
+    ul.lock();
+    while (job_num_workers_done_ < QUADRIC_NUM_THREADS - 1) {
+      job_finished_.wait(ul);
+    }
+  }
+
+  void QuadricSimplification::workerThread(uint32_t worker) {
+    uint64_t last_job_id = 0;
+    std::unique_lock<std::mutex> ul(job_lock_);
+    while (true) {
+      while (job_id_ == last_job_id && !workers_stop_) {
+        job_started_.wait(ul);
+      }
+      if (workers_stop_) {
+        return;
+      }
+      last_job_id = job_id_;
+      RangeFunc func = job_func_;
+      uint32_t num = job_num_;
+      Vector<Float3>* vertices = job_vertices_;
+      ul.unlock();
+
+      (this->*func)(rangeStart(num, worker + 1), rangeStart(num, worker + 2),
+        vertices);
+
+      ul.lock();
+      job_num_workers_done_++;
+      job_finished_.notify_one();
+    }
+  }
+
+  void QuadricSimplification::simplifyMesh(uint32_t target_num_faces,
+    Vector<Float3>* vertices, Vector<uint32_t>* indices,
+    Vector<Float3>* normals_return, Vector<Float3>* colors) {
+    mesh_.build(vertices->size(), indices);
+    calcQuadrics(vertices);
+    calcEdgeCosts(vertices);
+    collapseEdges(target_num_faces, vertices, colors);
+    mesh_.toFaces(indices);
+    normal_calc_.calcNormalsPerVertex(normals_return, vertices, indices);
+  }
+
+  void QuadricSimplification::calcQuadrics(Vector<Float3>* vertices) {
+    setSize(&face_quadrics_, mesh_.num_half_edges() / 3);
+    setSize(&vert_quadrics_, vertices->size());
+    parallelRange(&QuadricSimplification::calcFaceQuadrics,
+      face_quadrics_.size(), vertices);
+    // Each vertex sums the quadrics of its own faces, so there are no races
+    parallelRange(&QuadricSimplification::calcVertexQuadrics,
+      vert_quadrics_.size(), vertices);
+  }
+
+  void QuadricSimplification::calcFaceQuadrics(uint32_t start, uint32_t end,
+    Vector<Float3>* vertices) {
+    for (uint32_t f = start; f < end; f++) {
+      Quadric* q = face_quadrics_.at(f);
+      q->zeros();
+      if (mesh_.faceRemoved(f)) {
+        continue;
+      }
+      const Float3* p0 = vertices->at(mesh_.origin(f * 3));
+      const Float3* p1 = vertices->at(mesh_.origin(f * 3 + 1));
+      const Float3* p2 = vertices->at(mesh_.origin(f * 3 + 2));
+      double e1[3], e2[3], n[3];
+      for (uint32_t i = 0; i < 3; i++) {
+        e1[i] = (double)p1->m[i] - (double)p0->m[i];
+        e2[i] = (double)p2->m[i] - (double)p0->m[i];
+      }
+      n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+      n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+      n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+      double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (len <= 0) {
+        continue;
+      }
+      n[0] /= len;
+      n[1] /= len;
+      n[2] /= len;
+      double d = -(n[0] * p0->m[0] + n[1] * p0->m[1] + n[2] * p0->m[2]);
+      q->setPlane(n[0], n[1], n[2], d, 0.5 * len);  // Weighted by the area
+    }
+  }
+
+  // The plane through the boundary edge p0 -> p1 that is perpendicular to
+  // the edge's face
+  static void addBoundaryPlane(Quadric* q, const Float3* p0, const Float3* p1,
+    const Float3* p2) {
+    double e[3], e2[3], n[3], bn[3];
+    for (uint32_t i = 0; i < 3; i++) {
+      e[i] = (double)p1->m[i] - (double)p0->m[i];
+      e2[i] = (double)p2->m[i] - (double)p0->m[i];
+    }
+    n[0] = e[1] * e2[2] - e[2] * e2[1];
+    n[1] = e[2] * e2[0] - e[0] * e2[2];
+    n[2] = e[0] * e2[1] - e[1] * e2[0];
+    bn[0] = e[1] * n[2] - e[2] * n[1];
+    bn[1] = e[2] * n[0] - e[0] * n[2];
+    bn[2] = e[0] * n[1] - e[1] * n[0];
+    double len = sqrt(bn[0] * bn[0] + bn[1] * bn[1] + bn[2] * bn[2]);
+    if (len <= 0) {
+      return;
+    }
+    bn[0] /= len;
+    bn[1] /= len;
+    bn[2] /= len;
+    double d = -(bn[0] * p0->m[0] + bn[1] * p0->m[1] + bn[2] * p0->m[2]);
+    double edge_len_sq = e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+    Quadric plane;
+    plane.setPlane(bn[0], bn[1], bn[2], d,
+      QUADRIC_BOUNDARY_WEIGHT * edge_len_sq);
+    q->add(plane);
+  }
+
+  void QuadricSimplification::calcVertexQuadrics(uint32_t start, uint32_t end,
+    Vector<Float3>* vertices) {
+    Vector<uint32_t> ring(16);  // One per thread
+    for (uint32_t v = start; v < end; v++) {
+      Quadric* q = vert_quadrics_.at(v);
+      q->zeros();
+      if (mesh_.vertexRemoved(v)) {
+        continue;
+      }
+      mesh_.outgoing(v, &ring);
+      for (uint32_t i = 0; i < ring.size(); i++) {
+        uint32_t h = ring[i];
+        uint32_t p = HalfEdgeMesh::prev(h);
+        q->add(face_quadrics_[HalfEdgeMesh::face(h)]);
+        // Every boundary edge is added to both of it's vertices
+        if (mesh_.twin(h) == HE_NONE) {  // v -> dest(h)
+          addBoundaryPlane(q, vertices->at(v), vertices->at(mesh_.dest(h)),
+            vertices->at(mesh_.origin(p)));
+        }
+        if (mesh_.twin(p) == HE_NONE) {  // origin(p) -> v
+          addBoundaryPlane(q, vertices->at(mesh_.origin(p)), vertices->at(v),
+            vertices->at(mesh_.dest(h)));
+        }
+      }
+    }
+  }
+
+  void QuadricSimplification::calcEdgeCosts(Vector<Float3>* vertices) {
+    uint32_t num_he = mesh_.num_half_edges();
+    setSize(&edge_cost_, num_he);
+    setSize(&edge_pos_, num_he);
+    parallelRange(&QuadricSimplification::calcEdgeCostRange, num_he,
+      vertices);
+
+    // Build the heap in O(n) from the edges
+    edge_ids_.resize(0);
+    edge_id_costs_.resize(0);
+    if (edge_ids_.capacity() < num_he) {
+      edge_ids_.capacity(num_he);
+      edge_id_costs_.capacity(num_he);
+    }
+    for (uint32_t h = 0; h < num_he; h++) {
+      if (!mesh_.faceRemoved(HalfEdgeMesh::face(h)) && mesh_.edgeId(h) == h) {
+        edge_ids_.pushBack(h);
+        edge_id_costs_.pushBack(edge_cost_[h]);
+      }
+    }
+    heap_.resize(num_he);
+    if (edge_ids_.size() > 0) {
+      heap_.build(edge_ids_.at(0), edge_id_costs_.at(0), edge_ids_.size());
+    }
+  }
+
+  void QuadricSimplification::calcEdgeCostRange(uint32_t start, uint32_t end,
+    Vector<Float3>* vertices) {
+    for (uint32_t h = start; h < end; h++) {
+      if (!mesh_.faceRemoved(HalfEdgeMesh::face(h)) && mesh_.edgeId(h) == h) {
+        edge_cost_[h] = calcEdgeCost(h, vertices, edge_pos_.at(h));
+      }
+    }
+  }
+
+  float QuadricSimplification::calcEdgeCost(uint32_t h,
+    Vector<Float3>* vertices, Float3* pos) {
+    Quadric q;
+    q.add(vert_quadrics_[mesh_.origin(h)], vert_quadrics_[mesh_.dest(h)]);
+    const Float3* pa = vertices->at(mesh_.origin(h));
+    const Float3* pb = vertices->at(mesh_.dest(h));
+
+    // Try the two end points (and the midpoint and the optimal position if
+    // the vertices can move)
+    double cand[4][3];
+    uint32_t num_cand = 2;
+    for (uint32_t i = 0; i < 3; i++) {
+      cand[0][i] = pa->m[i];
+      cand[1][i] = pb->m[i];
+    }
+    if (settings_.vertex_merge_method == MidpointVertexMerge) {
+      for (uint32_t i = 0; i < 3; i++) {
+        cand[2][i] = 0.5 * (cand[0][i] + cand[1][i]);
+      }
+      num_cand = 3;
+      if (q.optimalPosition(cand[3])) {
+        num_cand = 4;
+      }
+    }
+    double min_err = std::numeric_limits<double>::infinity();
+    uint32_t best = 0;
+    for (uint32_t i = 0; i < num_cand; i++) {
+      double err = q.error(cand[i]);
+      if (err < min_err) {
+        min_err = err;
+        best = i;
+      }
+    }
+    pos->set((float)cand[best][0], (float)cand[best][1], (float)cand[best][2]);
+    return min_err > 0 ? (float)min_err : 0.0f;  // Round off can make it < 0
+  }
+
+  bool QuadricSimplification::faceFlips(uint32_t h, Float3* pos,
+    Vector<Float3>* vertices) {
+    // origin(h) moves to pos
+    Float3* p0 = vertices->at(mesh_.origin(h));
+    Float3* p1 = vertices->at(mesh_.dest(h));
+    Float3* p2 = vertices->at(mesh_.origin(HalfEdgeMesh::prev(h)));
+    Float3 e1, e2, n_before, n_after;
+    e1.sub(p1, p0);
+    e2.sub(p2, p0);
+    n_before.cross(&e1, &e2);
+    e1.sub(p1, pos);
+    e2.sub(p2, pos);
+    n_after.cross(&e1, &e2);
+    float len_before = Float3::length(&n_before);
+    float len_after = Float3::length(&n_after);
+    if (len_before <= 0) {
+      return false;  // Already degenerate
+    }
+    if (len_after <= 0) {
+      return true;  // Would become degenerate
+    }
+    return Float3::dot(&n_before, &n_after) <
+      QUADRIC_MIN_FACE_NORMAL_DOT_PROD * len_before * len_after;
+  }
+
+  bool QuadricSimplification::collapseFlipsFaces(uint32_t h, Float3* pos,
+    Vector<Float3>* vertices) {
+    uint32_t f0 = HalfEdgeMesh::face(h);
+    uint32_t t = mesh_.twin(h);
+    uint32_t f1 = t != HE_NONE ? HalfEdgeMesh::face(t) : HE_NONE;
+    uint32_t v[2];
+    v[0] = mesh_.origin(h);
+    v[1] = mesh_.dest(h);
+    for (uint32_t j = 0; j < 2; j++) {
+      mesh_.outgoing(v[j], &ring_);
+      for (uint32_t i = 0; i < ring_.size(); i++) {
+        uint32_t f = HalfEdgeMesh::face(ring_[i]);
+        if (f != f0 && f != f1 && faceFlips(ring_[i], pos, vertices)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void QuadricSimplification::collapseEdges(uint32_t target_num_faces,
+    Vector<Float3>* vertices, Vector<Float3>* colors) {
+    num_collapses_ = 0;
+    while (mesh_.num_faces() > target_num_faces && heap_.size() > 0) {
+      uint32_t h = heap_.removeMin();
+      // Lazy invalidation: edges that were removed (or merged into another
+      // edge) by earlier collapses are still in the heap
+      if (mesh_.faceRemoved(HalfEdgeMesh::face(h)) || mesh_.edgeId(h) != h) {
+        continue;
+      }
+      // Edges that can't be collapsed are dropped, they get re-inserted if a
+      // neighbouring collapse changes their cost
+      if (!mesh_.canCollapse(h)) {
+        continue;
+      }
+      Float3 pos = edge_pos_[h];
+      if (collapseFlipsFaces(h, &pos, vertices)) {
+        continue;
+      }
+
+      uint32_t v1 = mesh_.origin(h);
+      uint32_t v2 = mesh_.collapse(h);
+      vertices->at(v1)->set(&pos);
+      vert_quadrics_.at(v1)->add(vert_quadrics_[v2]);
+      // Next make the color the average of the two
+      if (colors != NULL) {
+        colors->at(v1)->add(colors->at(v1), colors->at(v2));
+        colors->at(v1)->scale(0.5f);
+      }
+      // Smash all old vertices together so that errors are very obvious
+      vertices->at(v2)->set(vertices->at(v2)->m[0], vertices->at(v2)->m[1],
+        REMOVED_VERTEX_POSITION_Z);
+      num_collapses_++;
+
+      updateEdgeCosts(v1, vertices);
+
+#ifdef DEBUG_MODE_VALIDATE_HEAP
+      if (!heap_.validate()) {
+        printf("ERROR: The heap is corrupt!");
+        printf("exiting on collapse %d\n", num_collapses_);
+        return;
+      }
+#endif
+
+#ifdef DEBUG_MODE_VALIDATE_WE_STRUCTURE
+      if (!mesh_.validate()) {
+        printf("exiting on collapse %d\n", num_collapses_);
+        return;
+      }
+#endif
+    }
+  }
+
+  void QuadricSimplification::updateEdgeCosts(uint32_t v,
+    Vector<Float3>* vertices) {
+    mesh_.outgoing(v, &ring_);
+    for (uint32_t i = 0; i < ring_.size(); i++) {
+      uint32_t id = mesh_.edgeId(ring_[i]);
+      edge_cost_[id] = calcEdgeCost(id, vertices, edge_pos_.at(id));
+      heap_.update(id, edge_cost_[id]);
+    }
+    // On the boundary the last edge into v isn't the twin of an outgoing edge
+    if (ring_.size() > 0) {
+      uint32_t p = HalfEdgeMesh::prev(ring_[ring_.size() - 1]);
+      if (mesh_.twin(p) == HE_NONE) {
+        edge_cost_[p] = calcEdgeCost(p, vertices, edge_pos_.at(p));
+        heap_.update(p, edge_cost_[p]);
+      }
+    }
+  }
+
+};  // namespace mesh_simplification
@@ -0,0 +1,140 @@
+//
+//  quadric_simplification.h
+//
+//  Mesh simplification by edge collapse, ordered by the quadric error metric
+//  from "Surface Simplification Using Quadric Error Metrics" (Garland,
+//  Heckbert).  Same input and output as MeshSimplification::simplifyMesh, but
+//  the mesh is stored as a flat HalfEdgeMesh and the edge costs live in an
+//  IndexedMinHeap, so after each collapse only the edges around the kept
+//  vertex are re-keyed.  Edges that were removed by a collapse are left in
+//  the heap and skipped when they reach the top (lazy invalidation).
+//
+//  Unlike MeshSimplification:
+//   - Contour edges can be collapsed, boundary constraint planes (weighted by
+//     QUADRIC_BOUNDARY_WEIGHT) keep the contour in place.
+//   - A collapse that would flip (or make degenerate) any of the remaining
+//     faces around the edge is rejected, so the mesh does not invert.
+//   - The stopping criteria is the number of faces left in the mesh.
+//
+//  The face and vertex quadrics and the initial edge costs are calculated on
+//  QUADRIC_NUM_THREADS threads: the calling thread plus worker threads that
+//  are started once in the constructor and sleep between meshes.
+//
+
+#ifndef MESH_SIMPLIFICATION_QUADRIC_SIMPLIFICATION_HEADER
+#define MESH_SIMPLIFICATION_QUADRIC_SIMPLIFICATION_HEADER
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "mesh_simplification/mesh_simplification.h"
+#include "mesh_simplification/half_edge_mesh.h"
+#include "data_str/indexed_min_heap.h"
+#include "data_str/vector.h"
+#include "math/math_types.h"
+
+#define QUADRIC_BOUNDARY_WEIGHT 100.0
+#define QUADRIC_MIN_FACE_NORMAL_DOT_PROD 0.2f  // After vs before the collapse
+#define QUADRIC_NUM_THREADS 4
+
+namespace mesh_simplification {
+
+  // Symmetric 4x4 error quadric (only the upper triangle is stored)
+  struct Quadric {
+  public:
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+    void zeros();
+    // setPlane - plane a*x + b*y + c*z + d = 0, (a, b, c) must be unit length
+    void setPlane(double a, double b, double c, double d, double weight);
+    void add(const Quadric& other);
+    void add(const Quadric& q0, const Quadric& q1);
+    double error(const double* pos) const;
+    // optimalPosition - returns false if the quadric is singular
+    bool optimalPosition(double* pos) const;
+  };
+
+  class QuadricSimplification {
+  public:
+    // settings.normal_method is used for the normals that are returned.  If
+    // settings.vertex_merge_method is StaticVertexMerge then collapsed edges
+    // are moved to one of their vertices, otherwise to the position with the
+    // least error.
+    QuadricSimplification(const MeshSettings& settings);
+    ~QuadricSimplification();
+
+    // Top level external function.  Collapses edges until there are at most
+    // target_num_faces faces (or no more edges can be collapsed).  Removed
+    // vertices stay in the vertex array (like MeshSimplification).
+    void simplifyMesh(uint32_t target_num_faces,
+      data_str::Vector<math::Float3>* vertices,
+      data_str::Vector<uint32_t>* indices,
+      data_str::Vector<math::Float3>* normals_return,
+      data_str::Vector<math::Float3>* colors = NULL);
+
+    HalfEdgeMesh* getHalfEdgeMesh() { return &mesh_; }
+    inline uint32_t num_collapses() const { return num_collapses_; }
+
+  private:
+    MeshSettings settings_;
+    HalfEdgeMesh mesh_;
+    MeshSimplification normal_calc_;  // Just for calcNormalsPerVertex
+    data_str::Vector<Quadric> face_quadrics_;
+    data_str::Vector<Quadric> vert_quadrics_;
+    data_str::Vector<float> edge_cost_;  // Per half-edge (edge ids only)
+    data_str::Vector<math::Float3> edge_pos_;  // Per half-edge (edge ids only)
+    data_str::Vector<uint32_t> edge_ids_;
+    data_str::Vector<float> edge_id_costs_;
+    data_str::IndexedMinHeap<float> heap_;
+    data_str::Vector<uint32_t> ring_;
+    uint32_t num_collapses_;
+
+    // Multithreading: worker i runs range i + 1 of the current job
+    typedef void (QuadricSimplification::*RangeFunc)(uint32_t start,
+      uint32_t end, data_str::Vector<math::Float3>* vertices);
+    std::thread* workers_[QUADRIC_NUM_THREADS - 1];
+    std::mutex job_lock_;
+    std::condition_variable job_started_;
+    std::condition_variable job_finished_;
+    uint64_t job_id_;
+    uint32_t job_num_workers_done_;
+    bool workers_stop_;
+    RangeFunc job_func_;
+    uint32_t job_num_;
+    data_str::Vector<math::Float3>* job_vertices_;
+
+    // TOP LEVEL INTERNAL FUNCTIONS
+    void calcQuadrics(data_str::Vector<math::Float3>* vertices);
+    void calcEdgeCosts(data_str::Vector<math::Float3>* vertices);
+    void collapseEdges(uint32_t target_num_faces,
+      data_str::Vector<math::Float3>* vertices,
+      data_str::Vector<math::Float3>* colors);
+
+    // HELPER FUNCTIONS
+    void calcFaceQuadrics(uint32_t start, uint32_t end,
+      data_str::Vector<math::Float3>* vertices);
+    void calcVertexQuadrics(uint32_t start, uint32_t end,
+      data_str::Vector<math::Float3>* vertices);
+    void calcEdgeCostRange(uint32_t start, uint32_t end,
+      data_str::Vector<math::Float3>* vertices);
+    float calcEdgeCost(uint32_t h, data_str::Vector<math::Float3>* vertices,
+      math::Float3* pos);
+    bool collapseFlipsFaces(uint32_t h, math::Float3* pos,
+      data_str::Vector<math::Float3>* vertices);
+    bool faceFlips(uint32_t h, math::Float3* pos,
+      data_str::Vector<math::Float3>* vertices);
+    void updateEdgeCosts(uint32_t v, data_str::Vector<math::Float3>* vertices);
+    // parallelRange - Split [0, num) into QUADRIC_NUM_THREADS ranges and run
+    // func on each (blocking)
+    void parallelRange(RangeFunc func, uint32_t num,
+      data_str::Vector<math::Float3>* vertices);
+    void workerThread(uint32_t worker);
+    static uint32_t rangeStart(uint32_t num, uint32_t range);
+
+    // Non-copyable, non-assignable.
+    QuadricSimplification(QuadricSimplification&);
+    QuadricSimplification& operator=(const QuadricSimplification&);
+  };
+};  // namespace mesh_simplification
+
+#endif  // MESH_SIMPLIFICATION_QUADRIC_SIMPLIFICATION_HEADER
@@ -0,0 +1,258 @@
+//
+//  simplification_benchmark.cpp
+//
+
+#include <stdio.h>  // For printf()
+#include <cmath>
+#include <limits>
+#include "mesh_simplification/simplification_benchmark.h"
+#include "mesh_simplification/min_heap_edges.h"
+#include "mesh_simplification/edge.h"
+#include "data_str/min_heap.h"
+#include "data_str/hash_map.h"
+#include "data_str/hash_funcs.h"
+#include "clock/clock.h"
+#include "exceptions/wruntime_error.h"
+
+using data_str::Vector;
+using data_str::MinHeap;
+using data_str::HashMap;
+using data_str::ArenaAllocator;
+using math::Float3;
+
+#define BENCHMARK_HASH_START_SIZE 1021  // Grows to the edge count by rehashing
+
+namespace mesh_simplification {
+
+  SimplificationBenchmark::SimplificationBenchmark(const MeshSettings& settings,
+    uint32_t width, uint32_t height) : simplifier_(settings) {
+    width_ = width;
+    height_ = height;
+    if (width_ < 2 || height_ < 2) {
+      throw std::wruntime_error("SimplificationBenchmark::"
+        "SimplificationBenchmark() - Grid must be at least 2x2");
+    }
+  }
+
+  SimplificationBenchmark::~SimplificationBenchmark() {
+  }
+
+  void SimplificationBenchmark::createGridMesh(uint32_t width, uint32_t height,
+    uint32_t frame, Vector<Float3>* vertices, Vector<uint32_t>* indices) {
+    uint32_t num_vertices = width * height;
+    if (vertices->capacity() < num_vertices) {
+      vertices->capacity(num_vertices);
+    }
+    vertices->resize(num_vertices);
+    uint32_t max_indices = 6 * (width - 1) * (height - 1);
+    if (indices->capacity() < max_indices) {
+      indices->capacity(max_indices);
+    }
+    indices->resize(0);
+
+    // A blob moving in front of a slanted wall.  Simple LCG so that every
+    // platform generates the same frames.
+    uint32_t seed = 12345 + frame * 7919;
+    float w = static_cast<float>(width);
+    float h = static_cast<float>(height);
+    float fr = static_cast<float>(frame);
+    float blob_u = 0.5f * w + 0.25f * w * sinf(0.1f * fr);
+    float blob_v = 0.5f * h + 0.15f * h * cosf(0.07f * fr);
+    float blob_rad = 0.125f * h;
+    float shadow_rad = blob_rad + 8.0f;
+    for (uint32_t v = 0; v < height; v++) {
+      for (uint32_t u = 0; u < width; u++) {
+        float du = static_cast<float>(u) - blob_u;
+        float dv = static_cast<float>(v) - blob_v;
+        float dist_sq = du * du + dv * dv;
+        float z;
+        if (dist_sq < blob_rad * blob_rad) {
+          z = 700.0f - 60.0f * sqrtf(1.0f - dist_sq / (blob_rad * blob_rad));
+        } else if (du < 0 && dist_sq < shadow_rad * shadow_rad) {
+          z = 0;  // The IR projector's shadow on the wall
+        } else {
+          z = 1800.0f + 0.3f * (static_cast<float>(u) - 0.5f * w);
+        }
+        seed = seed * 1664525 + 1013904223;
+        if ((seed >> 16) % 100 == 0) {
+          z = 0;  // Dropout
+        } else if (z > 0) {
+          z += static_cast<float>(static_cast<int32_t>((seed >> 8) % 5) - 2) *
+            z / 1000.0f;
+        }
+        Float3* pt = vertices->at(v * width + u);
+        pt->m[0] = (static_cast<float>(u) - 0.5f * w) * z /
+          BENCHMARK_FOCAL_LENGTH;
+        pt->m[1] = (0.5f * h - static_cast<float>(v)) * z /
+          BENCHMARK_FOCAL_LENGTH;
+        pt->m[2] = z;
+      }
+    }
+
+    // Same triangulation as TestPlane, skipping triangles with a missing
+    // vertex or across a depth discontinuity
+    for (uint32_t v = 0; v < height - 1; v++) {
+      for (uint32_t u = 0; u < width - 1; u++) {
+        uint32_t quad[4] = {width * v + u, width * v + u + 1,
+          width * (v + 1) + u, width * (v + 1) + u + 1};
+        uint32_t tris[2][3] = {{quad[0], quad[1], quad[3]},
+          {quad[0], quad[3], quad[2]}};
+        for (uint32_t t = 0; t < 2; t++) {
+          float z_min = (*vertices)[tris[t][0]].m[2];
+          float z_max = z_min;
+          for (uint32_t i = 1; i < 3; i++) {
+            float z = (*vertices)[tris[t][i]].m[2];
+            z_min = z < z_min ? z : z_min;
+            z_max = z > z_max ? z : z_max;
+          }
+          if (z_min > 0 && z_max - z_min < BENCHMARK_MAX_DEPTH_STEP) {
+            indices->pushBack(tris[t][0]);
+            indices->pushBack(tris[t][1]);
+            indices->pushBack(tris[t][2]);
+          }
+        }
+      }
+    }
+  }
+
+  void SimplificationBenchmark::run(uint32_t num_frames,
+    uint32_t edge_reduction) {
+    printf("Mesh simplification benchmark: %dx%d grid, %d frames, ",
+      width_, height_, num_frames);
+    printf("%d edges removed per frame\n", edge_reduction);
+
+    Clock clk;
+    double heap_edges_t[2] = {0, 0};  // {heap, arena}
+    double min_heap_t[2] = {0, 0};
+    double hash_map_t[2] = {0, 0};
+    double simplify_t = 0;
+    for (uint32_t frame = 0; frame < num_frames; frame++) {
+      createGridMesh(width_, height_, frame, &grid_vertices_, &grid_indices_);
+
+      // The winged edge structure (with edge costs) for this frame
+      vertices_ = grid_vertices_;
+      indices_ = grid_indices_;
+      simplifier_.simplifyMesh(0, &vertices_, &indices_, &normals_);
+      if (frame == 0) {
+        printf("  %d vertices, %d triangles, %d edges\n", grid_vertices_.size(),
+          grid_indices_.size() / 3, simplifier_.getWEStructure()->size());
+      }
+
+      heap_edges_t[0] += timeHeapEdges(edge_reduction, NULL);
+      min_heap_t[0] += timeMinHeap(edge_reduction, NULL);
+      hash_map_t[0] += timeHashMap(NULL);
+
+      arena_.reset();  // O(1), everything from the last frame is gone
+      heap_edges_t[1] += timeHeapEdges(edge_reduction, &arena_);
+      min_heap_t[1] += timeMinHeap(edge_reduction, &arena_);
+      hash_map_t[1] += timeHashMap(&arena_);
+
+      vertices_ = grid_vertices_;
+      indices_ = grid_indices_;
+      double t0 = clk.getTime();
+      simplifier_.simplifyMesh(edge_reduction, &vertices_, &indices_,
+        &normals_);
+      simplify_t += clk.getTime() - t0;
+    }
+
+    double ms = 1000.0 / static_cast<double>(num_frames > 0 ? num_frames : 1);
+    printf("  Average time per frame (ms):    heap     arena\n");
+    printf("    MinHeapEdges build + remove: %7.3f  %7.3f\n",
+      heap_edges_t[0] * ms, heap_edges_t[1] * ms);
+    printf("    MinHeap insert + remove:     %7.3f  %7.3f\n",
+      min_heap_t[0] * ms, min_heap_t[1] * ms);
+    printf("    HashMap insert + lookup:     %7.3f  %7.3f\n",
+      hash_map_t[0] * ms, hash_map_t[1] * ms);
+    printf("    MeshSimplification::simplifyMesh: %7.3f\n", simplify_t * ms);
+    printf("  Arena: %.2f MB reserved in %d blocks, %.2f MB used last frame\n",
+      static_cast<double>(arena_.bytes_reserved()) / (1024.0 * 1024.0),
+      arena_.num_blocks(),
+      static_cast<double>(arena_.bytes_used()) / (1024.0 * 1024.0));
+  }
+
+  double SimplificationBenchmark::timeHeapEdges(uint32_t edge_reduction,
+    ArenaAllocator* arena) {
+    Vector<Edge>* we = simplifier_.getWEStructure();
+    Clock clk;
+    double t0 = clk.getTime();
+    {
+      MinHeapEdges heap(we, arena);
+      for (uint32_t i = 0; i < edge_reduction && heap.size() > 0; i++) {
+        heap.removeMin();
+      }
+    }
+    return clk.getTime() - t0;
+  }
+
+  double SimplificationBenchmark::timeMinHeap(uint32_t edge_reduction,
+    ArenaAllocator* arena) {
+    Vector<Edge>* we = simplifier_.getWEStructure();
+    bool sorted = true;
+    Clock clk;
+    double t0 = clk.getTime();
+    {
+      MinHeap<float> heap(1, arena);
+      for (uint32_t i = 0; i < we->size(); i++) {
+        float cost = (*we)[i].cost;
+        heap.insert(cost);
+      }
+      // The storage doubles from a single element on the way up (and with an
+      // arena the old buffers are recycled), so check nothing got lost
+      float last_cost = -std::numeric_limits<float>::infinity();
+      for (uint32_t i = 0; i < edge_reduction && heap.size() > 0; i++) {
+        float cost = heap.removeMin();
+        sorted = sorted && cost >= last_cost;
+        last_cost = cost;
+      }
+    }
+    double t = clk.getTime() - t0;
+    if (!sorted) {
+      throw std::wruntime_error("SimplificationBenchmark::timeMinHeap() - "
+        "Costs removed out of order");
+    }
+    return t;
+  }
+
+  uint32_t SimplificationBenchmark::edgeKey(const Edge& edge) {
+    uint32_t lo = edge.v1 < edge.v2 ? edge.v1 : edge.v2;
+    uint32_t hi = edge.v1 < edge.v2 ? edge.v2 : edge.v1;
+    uint32_t dir;
+    if (hi - lo == 1) {
+      dir = 0;  // Horizontal
+    } else if (hi - lo == width_) {
+      dir = 1;  // Vertical
+    } else if (hi - lo == width_ + 1) {
+      dir = 2;  // Diagonal
+    } else {
+      dir = 3;
+    }
+    return lo * 4 + dir;
+  }
+
+  double SimplificationBenchmark::timeHashMap(ArenaAllocator* arena) {
+    Vector<Edge>* we = simplifier_.getWEStructure();
+    uint32_t num_found = 0;
+    Clock clk;
+    double t0 = clk.getTime();
+    {
+      HashMap<uint32_t, uint32_t> map(BENCHMARK_HASH_START_SIZE,
+        &data_str::HashUint, arena);
+      for (uint32_t i = 0; i < we->size(); i++) {
+        map.insert(edgeKey((*we)[i]), i);
+      }
+      for (uint32_t i = 0; i < we->size(); i++) {
+        uint32_t index;
+        if (map.lookup(edgeKey((*we)[i]), index) && index == i) {
+          num_found++;
+        }
+      }
+    }
+    double t = clk.getTime() - t0;
+    if (num_found != we->size()) {
+      throw std::wruntime_error("SimplificationBenchmark::timeHashMap() - "
+        "Edge lookup failed");
+    }
+    return t;
+  }
+
+};  // namespace mesh_simplification
@@ -0,0 +1,73 @@
+//
+//  simplification_benchmark.h
+//
+//  Headless timing of the per frame allocations in the mesh simplification
+//  path.  A synthetic depth frame (a hand sized blob in front of a wall, with
+//  sensor noise, dropouts and a shadow) is meshed as a regular grid with one
+//  vertex per pixel and 2 triangles per valid quad, like the kinect meshes.
+//
+//  For every frame it times, once with heap allocations and once out of a
+//  data_str::ArenaAllocator that is reset at the start of the frame:
+//   1. Building a MinHeapEdges over the winged edge structure and removing
+//      edge_reduction edges (what MeshSimplification::cullEdges does).
+//   2. Inserting every edge cost into a data_str::MinHeap (grown by doubling
+//      from a single element) and removing edge_reduction of them.
+//   3. Inserting every edge into a data_str::HashMap keyed by its vertex pair
+//      (starting small, so it rehashes) and looking each of them up again.
+//  and finally the whole MeshSimplification::simplifyMesh call.
+//
+
+#ifndef MESH_SIMPLIFICATION_SIMPLIFICATION_BENCHMARK_HEADER
+#define MESH_SIMPLIFICATION_SIMPLIFICATION_BENCHMARK_HEADER
+
+#include "data_str/vector.h"
+#include "data_str/arena_allocator.h"
+#include "math/math_types.h"
+#include "mesh_simplification/mesh_simplification.h"
+
+#define BENCHMARK_WIDTH 640
+#define BENCHMARK_HEIGHT 480
+#define BENCHMARK_FOCAL_LENGTH 575.0f  // Kinect depth camera (pixels)
+#define BENCHMARK_MAX_DEPTH_STEP 50.0f  // mm, no triangles across bigger steps
+
+namespace mesh_simplification {
+
+  class SimplificationBenchmark {
+  public:
+    SimplificationBenchmark(const MeshSettings& settings,
+      uint32_t width = BENCHMARK_WIDTH, uint32_t height = BENCHMARK_HEIGHT);
+    ~SimplificationBenchmark();
+
+    // run - Prints the average time per frame of each test
+    void run(uint32_t num_frames, uint32_t edge_reduction);
+
+    // createGridMesh - The synthetic frame (deterministic for a given frame)
+    static void createGridMesh(uint32_t width, uint32_t height,
+      uint32_t frame, data_str::Vector<math::Float3>* vertices,
+      data_str::Vector<uint32_t>* indices);
+
+  private:
+    uint32_t width_;
+    uint32_t height_;
+    MeshSimplification simplifier_;
+    data_str::ArenaAllocator arena_;
+    data_str::Vector<math::Float3> grid_vertices_;
+    data_str::Vector<uint32_t> grid_indices_;
+    data_str::Vector<math::Float3> vertices_;
+    data_str::Vector<uint32_t> indices_;
+    data_str::Vector<math::Float3> normals_;
+
+    double timeHeapEdges(uint32_t edge_reduction,
+      data_str::ArenaAllocator* arena);
+    double timeMinHeap(uint32_t edge_reduction,
+      data_str::ArenaAllocator* arena);
+    double timeHashMap(data_str::ArenaAllocator* arena);
+    uint32_t edgeKey(const Edge& edge);
+
+    // Non-copyable, non-assignable.
+    SimplificationBenchmark(SimplificationBenchmark&);
+    SimplificationBenchmark& operator=(const SimplificationBenchmark&);
+  };
+};  // namespace mesh_simplification
+
+#endif  // MESH_SIMPLIFICATION_SIMPLIFICATION_BENCHMARK_HEADER